@@ -67,6 +67,7 @@ void EXTI9_5_IRQHandler(void);
 void TIM1_UP_TIM10_IRQHandler(void);
 void TIM2_IRQHandler(void);
 void I2C1_EV_IRQHandler(void);
+void I2C1_ER_IRQHandler(void);
 void SPI1_IRQHandler(void);
 void USART1_IRQHandler(void);
 void USART3_IRQHandler(void);
@@ -83,6 +84,8 @@ extern EXTI_HandleTypeDef hexti2;
 extern EXTI_HandleTypeDef hexti3;
 extern EXTI_HandleTypeDef hexti4;
 extern EXTI_HandleTypeDef hexti5;
+extern EXTI_HandleTypeDef hexti7;
+void DMA2_Stream4_IRQHandler(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
@@ -53,7 +53,7 @@ extern TIM_HandleTypeDef htim11;
 extern TIM_HandleTypeDef htim13;
 
 /* USER CODE BEGIN Private defines */
-
+extern TIM_HandleTypeDef htim5;
 /* USER CODE END Private defines */
 
 void MX_TIM1_Init(void);
@@ -70,7 +70,7 @@ void MX_TIM13_Init(void);
 void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
 
 /* USER CODE BEGIN Prototypes */
-
+void MX_TIM5_Init(void);
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
@@ -116,6 +116,7 @@ int main(void)
   MX_TIM4_Init();
   MX_FSMC_Init();
   /* USER CODE BEGIN 2 */
+  MX_TIM5_Init();
   fmc_test();
   /* USER CODE END 2 */
 
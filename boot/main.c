@@ -0,0 +1,290 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "stm32f4xx.h"
+#include "common/crc/crc.h"
+#include "device/ota/ota.h"
+#include "device/w25qx/config/index.h"
+
+/**
+ * 引导程序, 位于内部 flash 扇区 0 (16KB), 每次复位后先执行
+ * 读取外部 flash 中的暂存区头, 状态为等待安装时把固件复制到 DEVICE_OTA_APP_ADDR,
+ * 校验通过并把状态写为已安装之后才跳转; 复制中掉电时状态仍为等待安装, 下次启动重新复制
+ * 只使用寄存器, 不依赖 HAL, 时钟为复位后的 HSI 16MHz
+ * W25Q64 接在 SPI1 (PA5 SCK, PA6 MISO, PA7 MOSI), 片选为 PA15, 与 device_config 中的配置一致
+ */
+
+// 复制失败时的重试次数, 全部失败后复位重新开始
+#define COPY_RETRY 3
+
+#define IMAGE_ADDR (DEVICE_OTA_STAGING_ADDR + W25QX_SECTOR_SIZE)
+#define IMAGE_SIZE_MAX ((DEVICE_OTA_STAGING_SECTOR_COUNT - 1) * W25QX_SECTOR_SIZE)
+#define STATE_ADDR (DEVICE_OTA_STAGING_ADDR + offsetof(Device_ota_header, state))
+
+// W25QX 命令
+#define W25QX_WRITE_ENABLE 0x06
+#define W25QX_PAGE_PROGRAM 0x02
+#define W25QX_READ_DATA 0x03
+#define W25QX_READ_STATUS_1 0x05
+#define W25QX_RELEASE_POWER_DOWN 0xAB
+
+#define CS_PIN 15
+
+// 内部 flash 解锁密钥和按字编程, 与 HAL 中的定义相同
+#define FLASH_KEY1 0x45670123u
+#define FLASH_KEY2 0xCDEF89ABu
+#define FLASH_PSIZE_WORD FLASH_CR_PSIZE_1
+
+static void spi_init(void);
+static void spi_deinit(void);
+static uint8_t spi_exchange(uint8_t byte);
+static void flash_select(void);
+static void flash_deselect(void);
+static void flash_command(uint8_t cmd, uint32_t addr);
+static void flash_wait(void);
+static void flash_read(uint32_t addr, void *data, uint32_t len);
+static void flash_program(uint32_t addr, const void *data, uint32_t len);
+
+static bool header_valid(const Device_ota_header *ph);
+static bool staged_valid(const Device_ota_header *ph);
+static bool copy(const Device_ota_header *ph);
+static bool mark_installed(void);
+static bool vectors_valid(uint32_t sp, uint32_t reset, uint32_t size);
+static void internal_wait(void);
+static uint32_t sector_end(uint32_t sector);
+static void jump_to_app(void) __attribute__((noreturn));
+
+static uint8_t read_buffer[W25QX_PAGE_SIZE] = {0};
+
+int main(void) {
+  spi_init();
+
+  Device_ota_header header = {0};
+  flash_read(DEVICE_OTA_STAGING_ADDR, &header, sizeof(header));
+
+  // 与 device/ota 相同: 低半字为 0 且不是全 0 为等待安装, 写入已安装时掉电留下的值也按等待安装处理
+  const bool ready = header_valid(&header)
+    && (header.state & 0xFFFFu) == 0
+    && header.state != DEVICE_OTA_HEADER_STATE_INSTALLED;
+
+  // 暂存区中的固件损坏时不擦除内部 flash, 继续运行原来的程序
+  if (ready && staged_valid(&header)) {
+    bool ok = false;
+    for (uint32_t i = 0; i < COPY_RETRY && ok == false; ++i) ok = copy(&header);
+    if (ok) ok = mark_installed();
+    if (ok == false) NVIC_SystemReset();
+  }
+
+  spi_deinit();
+  jump_to_app();
+}
+
+static void spi_init(void) {
+  RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
+  RCC->APB2ENR |= RCC_APB2ENR_SPI1EN;
+  (void)RCC->APB2ENR;
+
+  // PA15 复位后为 JTDI, 改为推挽输出并拉高
+  GPIOA->BSRR = 1u << CS_PIN;
+  GPIOA->MODER = (GPIOA->MODER & ~(3u << (CS_PIN * 2))) | (1u << (CS_PIN * 2));
+  GPIOA->OSPEEDR |= 3u << (CS_PIN * 2);
+
+  // PA5 ~ PA7 复用为 SPI1 (AF5)
+  for (uint32_t pin = 5; pin <= 7; ++pin) {
+    GPIOA->MODER = (GPIOA->MODER & ~(3u << (pin * 2))) | (2u << (pin * 2));
+    GPIOA->OSPEEDR |= 3u << (pin * 2);
+    GPIOA->AFR[0] = (GPIOA->AFR[0] & ~(0xFu << (pin * 4))) | (5u << (pin * 4));
+  }
+
+  // 模式 0, 主机, 软件片选, 二分频 8MHz
+  SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI;
+  SPI1->CR1 |= SPI_CR1_SPE;
+
+  // 应用程序可能让 flash 进入了掉电模式, 唤醒后至少等待 3us
+  flash_select();
+  spi_exchange(W25QX_RELEASE_POWER_DOWN);
+  flash_deselect();
+  for (volatile uint32_t i = 0; i < 100; ++i);
+}
+
+// 恢复复位后的状态, 应用程序按自己的配置重新初始化
+static void spi_deinit(void) {
+  SPI1->CR1 = 0;
+  RCC->APB2RSTR |= RCC_APB2RSTR_SPI1RST;
+  RCC->APB2RSTR &= ~RCC_APB2RSTR_SPI1RST;
+  RCC->AHB1RSTR |= RCC_AHB1RSTR_GPIOARST;
+  RCC->AHB1RSTR &= ~RCC_AHB1RSTR_GPIOARST;
+  RCC->APB2ENR &= ~RCC_APB2ENR_SPI1EN;
+  RCC->AHB1ENR &= ~RCC_AHB1ENR_GPIOAEN;
+}
+
+static uint8_t spi_exchange(uint8_t byte) {
+  while ((SPI1->SR & SPI_SR_TXE) == 0);
+  *(volatile uint8_t *)&SPI1->DR = byte;
+  while ((SPI1->SR & SPI_SR_RXNE) == 0);
+  return *(volatile uint8_t *)&SPI1->DR;
+}
+
+static void flash_select(void) {
+  // 清除之前残留的接收数据
+  while (SPI1->SR & SPI_SR_RXNE) (void)SPI1->DR;
+  GPIOA->BSRR = 1u << (CS_PIN + 16);
+}
+
+static void flash_deselect(void) {
+  while (SPI1->SR & SPI_SR_BSY);
+  GPIOA->BSRR = 1u << CS_PIN;
+}
+
+// 拉低片选并发送命令和 24 位地址, 不拉高片选
+static void flash_command(uint8_t cmd, uint32_t addr) {
+  flash_select();
+  spi_exchange(cmd);
+  spi_exchange((addr >> 16) & 0xFF);
+  spi_exchange((addr >> 8) & 0xFF);
+  spi_exchange(addr & 0xFF);
+}
+
+static void flash_wait(void) {
+  flash_select();
+  spi_exchange(W25QX_READ_STATUS_1);
+  while (spi_exchange(0xFF) & 0x01);
+  flash_deselect();
+}
+
+static void flash_read(uint32_t addr, void *data, uint32_t len) {
+  uint8_t *p = data;
+  flash_command(W25QX_READ_DATA, addr);
+  while (len--) *p++ = spi_exchange(0xFF);
+  flash_deselect();
+}
+
+// 只在一页之内编程
+static void flash_program(uint32_t addr, const void *data, uint32_t len) {
+  const uint8_t *p = data;
+
+  flash_select();
+  spi_exchange(W25QX_WRITE_ENABLE);
+  flash_deselect();
+
+  flash_command(W25QX_PAGE_PROGRAM, addr);
+  while (len--) spi_exchange(*p++);
+  flash_deselect();
+  flash_wait();
+}
+
+static bool header_valid(const Device_ota_header *ph) {
+  if (ph->magic != DEVICE_OTA_MAGIC) return false;
+  if (ph->header_crc != crc32(0, ph, offsetof(Device_ota_header, header_crc))) return false;
+  return ph->size > 0 && ph->size <= IMAGE_SIZE_MAX && ph->size <= DEVICE_OTA_APP_SIZE;
+}
+
+// 重新校验暂存区中的固件, 并检查开头的向量表
+static bool staged_valid(const Device_ota_header *ph) {
+  uint32_t vectors[2] = {0};
+  flash_read(IMAGE_ADDR, vectors, sizeof(vectors));
+  if (vectors_valid(vectors[0], vectors[1], ph->size) == false) return false;
+
+  uint32_t crc = 0;
+  for (uint32_t offset = 0; offset < ph->size; offset += sizeof(read_buffer)) {
+    const uint32_t len = ph->size - offset < sizeof(read_buffer) ? ph->size - offset : sizeof(read_buffer);
+    flash_read(IMAGE_ADDR + offset, read_buffer, len);
+    crc = crc32(crc, read_buffer, len);
+  }
+
+  return crc == ph->crc;
+}
+
+/**
+ * @brief 擦除覆盖固件的内部 flash 扇区, 按字从外部 flash 连续读取并编程, 最后校验 CRC
+ * 引导程序在扇区 0 中执行, 擦除和编程其他扇区期间 CPU 取指会暂停, 不需要复制到 RAM
+ * @param ph
+ * @return true 校验通过
+ */
+static bool copy(const Device_ota_header *ph) {
+  bool ok = true;
+
+  internal_wait();
+  if (FLASH->CR & FLASH_CR_LOCK) {
+    FLASH->KEYR = FLASH_KEY1;
+    FLASH->KEYR = FLASH_KEY2;
+  }
+  FLASH->SR = FLASH_SR_EOP | FLASH_SR_OPERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR;
+
+  // 3.3V 供电, 按字擦除和编程; 从扇区 1 开始, 不擦除引导程序
+  const uint32_t app_offset = DEVICE_OTA_APP_ADDR - DEVICE_OTA_BOOT_ADDR;
+  for (uint32_t sector = 1; sector_end(sector - 1) < app_offset + ph->size; ++sector) {
+    FLASH->CR = FLASH_CR_SER | (sector << FLASH_CR_SNB_Pos) | FLASH_PSIZE_WORD;
+    FLASH->CR |= FLASH_CR_STRT;
+    internal_wait();
+  }
+
+  flash_command(W25QX_READ_DATA, IMAGE_ADDR);
+  FLASH->CR = FLASH_CR_PG | FLASH_PSIZE_WORD;
+  for (uint32_t offset = 0; offset < ph->size; offset += 4) {
+    // 不足一个字的部分读到固件之后的空白数据
+    uint32_t word = 0;
+    for (uint32_t i = 0; i < 4; ++i) word |= (uint32_t)spi_exchange(0xFF) << (i * 8);
+    *(volatile uint32_t *)(DEVICE_OTA_APP_ADDR + offset) = word;
+    internal_wait();
+  }
+  flash_deselect();
+
+  if (FLASH->SR & (FLASH_SR_OPERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR)) ok = false;
+  FLASH->CR = FLASH_CR_LOCK;
+
+  // 缓存中可能还有擦除前的数据
+  FLASH->ACR &= ~(FLASH_ACR_ICEN | FLASH_ACR_DCEN);
+  FLASH->ACR |= FLASH_ACR_ICRST | FLASH_ACR_DCRST;
+  FLASH->ACR &= ~(FLASH_ACR_ICRST | FLASH_ACR_DCRST);
+  FLASH->ACR |= FLASH_ACR_ICEN | FLASH_ACR_DCEN;
+
+  if (crc32(0, (const uint8_t *)DEVICE_OTA_APP_ADDR, ph->size) != ph->crc) ok = false;
+
+  return ok;
+}
+
+// 把 state 编程为全 0 并读回确认
+static bool mark_installed(void) {
+  const uint32_t state = DEVICE_OTA_HEADER_STATE_INSTALLED;
+  flash_program(STATE_ADDR, &state, sizeof(state));
+
+  uint32_t check = DEVICE_OTA_HEADER_STATE_RECEIVING;
+  flash_read(STATE_ADDR, &check, sizeof(check));
+  return check == DEVICE_OTA_HEADER_STATE_INSTALLED;
+}
+
+// 栈顶在 RAM 或 CCMRAM 中, 复位地址为 Thumb 地址且在程序范围内
+static bool vectors_valid(uint32_t sp, uint32_t reset, uint32_t size) {
+  const bool sp_valid = (sp > 0x20000000u && sp <= 0x20020000u) || (sp > 0x10000000u && sp <= 0x10010000u);
+  const bool reset_valid = (reset & 1) && reset >= DEVICE_OTA_APP_ADDR && reset < DEVICE_OTA_APP_ADDR + size;
+  return sp_valid && reset_valid;
+}
+
+static void internal_wait(void) {
+  while (FLASH->SR & FLASH_SR_BSY);
+}
+
+// 扇区结束位置相对内部 flash 起始地址的偏移: 0~3 为 16KB, 4 为 64KB, 5~11 为 128KB
+static uint32_t sector_end(uint32_t sector) {
+  if (sector < 4) return (sector + 1) * 0x4000u;
+  if (sector == 4) return 0x20000u;
+  return (sector - 3) * 0x20000u;
+}
+
+// 内部 flash 中没有有效的程序时停在这里, 需要用调试器烧录
+static void jump_to_app(void) {
+  const uint32_t *const vectors = (const uint32_t *)DEVICE_OTA_APP_ADDR;
+  const uint32_t sp = vectors[0], reset = vectors[1];
+  if (vectors_valid(sp, reset, DEVICE_OTA_APP_SIZE) == false) for (;;);
+
+  __disable_irq();
+  SysTick->CTRL = 0;
+  SCB->VTOR = DEVICE_OTA_APP_ADDR;
+  __DSB();
+  __ISB();
+  __set_MSP(sp);
+  __enable_irq();
+  ((void (*)(void))reset)();
+  for (;;);
+}
@@ -1,7 +1,77 @@
 const net = require('net');
+const fs = require('fs');
 
 const PORT = Number(process.env.PORT || process.argv[2] || 9000);
 const HOST = process.env.HOST || '0.0.0.0';
+// 升级用的固件(.bin), 每次 OTA INFO 时重新读取, 重新编译后不需要重启服务
+const FIRMWARE = process.env.FIRMWARE || process.argv[3] || '';
+// 单次 OTA GET 的最大字节数, 与设备端 CHUNK_SIZE 一致
+const OTA_CHUNK_MAX = 512;
+
+// CRC-32, 与设备端 common/crc 相同
+const CRC_TABLE = new Uint32Array(256).map((_, n) => {
+  let c = n;
+  for (let k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >>> 1) : c >>> 1;
+  return c >>> 0;
+});
+function crc32(buf) {
+  let c = 0xFFFFFFFF;
+  for (const b of buf) c = CRC_TABLE[(c ^ b) & 0xFF] ^ (c >>> 8);
+  return (c ^ 0xFFFFFFFF) >>> 0;
+}
+const hex8 = (n) => n.toString(16).padStart(8, '0');
+
+// 读取固件, 版本号默认取文件修改时间, 也可以用 FIRMWARE_VERSION 指定
+function loadFirmware() {
+  if (!FIRMWARE) throw new Error('no firmware');
+  const data = fs.readFileSync(FIRMWARE);
+  const version = Number(process.env.FIRMWARE_VERSION || Math.floor(fs.statSync(FIRMWARE).mtimeMs / 1000));
+  return { data, crc: crc32(data), version };
+}
+
+/**
+ * 固件升级协议, 返回 null 表示不是 OTA 命令
+ * OTA INFO               -> OTA INFO <size> <crc> <version>
+ * OTA GET <offset> <len> -> OTA DATA <offset> <len> <crc> <base64>
+ * 数据用 Base64 编码, 设备端经过 AT 指令读取, 二进制数据可能与 AT 响应的结束标志混淆
+ * 设备端断线重连后从已写入的位置继续请求, 服务端不需要保存进度
+ */
+function handleOta(state, line) {
+  const args = line.trim().split(/\s+/);
+  if (args[0].toUpperCase() !== 'OTA') return null;
+
+  try {
+    switch ((args[1] || '').toUpperCase()) {
+      case 'INFO': {
+        state.firmware = loadFirmware();
+        state.sent = 0;
+        state.start = Date.now();
+        const { data, crc, version } = state.firmware;
+        return `OTA INFO ${data.length} ${hex8(crc)} ${version}\r\n`;
+      }
+      case 'GET': {
+        if (!state.firmware) return 'OTA ERR no info\r\n';
+        const { data } = state.firmware;
+        const offset = Number(args[2]), len = Number(args[3]);
+        if (!Number.isInteger(offset) || !Number.isInteger(len) || len <= 0 || len > OTA_CHUNK_MAX || offset + len > data.length) {
+          return 'OTA ERR bad range\r\n';
+        }
+        const chunk = data.subarray(offset, offset + len);
+        state.sent += len;
+        // 每 16KB 打印一次服务端看到的吞吐量
+        if (Math.floor((offset + len) / 16384) !== Math.floor(offset / 16384) || offset + len === data.length) {
+          const seconds = (Date.now() - state.start) / 1000;
+          console.log(`[ota] ${offset + len}/${data.length} bytes, ${(state.sent / seconds).toFixed(0)} B/s`);
+        }
+        return `OTA DATA ${offset} ${len} ${hex8(crc32(chunk))} ${chunk.toString('base64')}\r\n`;
+      }
+      default:
+        return 'OTA ERR unknown\r\n';
+    }
+  } catch (err) {
+    return `OTA ERR ${err.message}\r\n`;
+  }
+}
 
 const server = net.createServer((socket) => {
   const peer = `${socket.remoteAddress}:${socket.remotePort}`;
@@ -14,6 +84,7 @@ const server = net.createServer((socket) => {
 
   // 按 \r\n 解析行
   let buf = Buffer.alloc(0);
+  const ota = {};
   socket.on('data', (chunk) => {
     buf = Buffer.concat([buf, chunk]);
     // 查找 CRLF 作为一帧
@@ -23,10 +94,14 @@ const server = net.createServer((socket) => {
       buf = buf.subarray(idx + 2);               // 跳过 CRLF
       const line = frame.toString('utf8');
 
-      console.log(`[${peer}] <= ${JSON.stringify(line)}`);
+      // OTA GET 太多, 只打印进度
+      if (!/^OTA GET /i.test(line)) console.log(`[${peer}] <= ${JSON.stringify(line)}`);
 
-      // 简单协议：PING -> PONG，其他回显
-      if (line.trim().toUpperCase() === 'PING') {
+      // 简单协议：PING -> PONG，OTA 命令见 handleOta，其他回显
+      const otaReply = handleOta(ota, line);
+      if (otaReply !== null) {
+        socket.write(otaReply);
+      } else if (line.trim().toUpperCase() === 'PING') {
         socket.write('PONG\r\n');
       } else if (line.length) {
         socket.write(`ECHO: ${line}\r\n`);
@@ -45,5 +120,6 @@ const server = net.createServer((socket) => {
 
 server.listen(PORT, HOST, () => {
   console.log(`TCP server listening on ${HOST}:${PORT}`);
+  if (FIRMWARE) console.log(`OTA firmware: ${FIRMWARE}`);
   console.log('提示: 请确保 Windows 防火墙放行该端口。');
 });
\ No newline at end of file
@@ -59,14 +59,15 @@ void adc_test() {
     err = pds->ops->fill_window(pds, 0xfff0);
     if (err) goto print_err_tag;
 
-    err = pdp->ops->read(pdp, &power_value, 1);
-    if (err) goto print_err_tag;
+    // 刚启动扫描时可能还没有采样结果
+    err = pdp->ops->read_latest(pdp, &power_value);
+    if (err && err != ENODATA) goto print_err_tag;
     snprintf((char *)str, 50, "power value: %d", power_value);
     err = pds->ops->set_ascii_str(pds, str, strlen((char *)str), 0, 0, 0x0000);
     if (err) goto print_err_tag;
 
-    err = pdl->ops->read(pdl, &light_value, 1);
-    if (err) goto print_err_tag;
+    err = pdl->ops->read_latest(pdl, &light_value);
+    if (err && err != ENODATA) goto print_err_tag;
     snprintf((char *)str, 50, "light value: %d", light_value);
     err = pds->ops->set_ascii_str(pds, str, strlen((char *)str), 16, 0, 0x0000);
     if (err) goto print_err_tag;
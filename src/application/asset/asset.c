@@ -0,0 +1,176 @@
+#include "asset.h"
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "common/errno/errno.h"
+#include "common/timebase/timebase.h"
+#include "device_config/gpio/gpio.h"
+#include "device_config/usart/usart.h"
+#include "device_config/spi/spi.h"
+#include "device_config/w25qx/w25qx.h"
+#include "device_config/st7789v2/st7789v2.h"
+#include "device_config/asset/asset.h"
+#include "device/w25qx/config/index.h"
+
+// 从调试串口收到该字符时开始接收资源包, 发送端为 tools/asset
+#define UPLOAD_COMMAND 'u'
+// 每收到一块回复一次 OK, 串口接收缓冲只有 255 字节
+#define UPLOAD_BLOCK_SIZE 128
+#define UPLOAD_TIMEOUT_MS 5000
+#define BACKGROUND_COLOR 0xFFFF
+
+static errno_t init(void);
+static errno_t show(Device_asset *pda);
+static errno_t upload(Device_asset *pda, const Device_USART *pdu);
+static errno_t receive_exact(const Device_USART *pdu, uint8_t *data, uint32_t len);
+
+static uint8_t upload_buffer[UPLOAD_BLOCK_SIZE] = {0};
+
+void asset_test(void) {
+  errno_t err = init();
+  if (err) goto print_err_tag;
+
+  Device_USART *pdu = NULL;
+  err = Device_USART_find(&pdu, DEVICE_USART_DEBUG);
+  if (err) goto print_err_tag;
+  err = pdu->ops->init(pdu);
+  if (err) goto print_err_tag;
+
+  Device_ST7789V2 *pds = NULL;
+  err = Device_ST7789V2_find(&pds, DEVICE_ST7789V2_1);
+  if (err) goto print_err_tag;
+  err = pds->ops->init(pds);
+  if (err) goto print_err_tag;
+  err = pds->ops->clear_screen(pds, BACKGROUND_COLOR);
+  if (err) goto print_err_tag;
+
+  Device_asset *pda = NULL;
+  err = Device_asset_find(&pda, DEVICE_ASSET_1);
+  if (err) goto print_err_tag;
+
+  err = pda->ops->init(pda);
+  if (err == ENOENT || err == EBADMSG) {
+    printf("no asset pack, err: %d, send '%c' to upload\r\n", err, UPLOAD_COMMAND);
+  } else if (err) {
+    goto print_err_tag;
+  } else {
+    err = show(pda);
+    if (err) goto print_err_tag;
+  }
+
+  while (1) {
+    uint8_t command = 0;
+    uint32_t command_len = 0;
+    err = pdu->ops->receive(pdu, &command, &command_len, 1);
+    if (err) goto print_err_tag;
+    if (command_len == 1 && command == UPLOAD_COMMAND) {
+      err = upload(pda, pdu);
+      if (err) {
+        printf("ERR %d\r\n", err);
+        continue;
+      }
+      printf("DONE\r\n");
+      err = show(pda);
+      if (err) printf("asset show err: %d\r\n", err);
+    }
+  }
+
+  print_err_tag:
+  printf("asset_test_err\r\nerr: %d\r\n", err);
+  while (1);
+}
+
+// 测试用的资源名称与 tools/asset/example.json 一致
+static errno_t show(Device_asset *pda) {
+  errno_t err = ESUCCESS;
+
+  const uint32_t begin_us = now_us();
+  err = pda->ops->draw_image(pda, "logo", 0, 0);
+  if (err && err != ENOENT) return err;
+  const uint32_t image_us = timebase_elapsed_us(begin_us);
+
+  err = pda->ops->draw_text(pda, "font16", "STM32 mini car\nasset test", 200, 0, 0x0000, BACKGROUND_COLOR);
+  if (err && err != ENOENT) return err;
+
+  printf("draw image: %" PRIu32 " us\r\n", image_us);
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 接收资源包写入 flash
+ * 收到命令后回复 READY, 之后收 4 字节长度(小端), 擦除后回复 OK, 再按块接收, 每块写入后回复 OK
+ * @param pda
+ * @param pdu
+ * @return errno_t
+ */
+static errno_t upload(Device_asset *pda, const Device_USART *pdu) {
+  errno_t err = ESUCCESS;
+
+  printf("READY\r\n");
+
+  uint32_t size = 0;
+  err = receive_exact(pdu, (uint8_t *)&size, sizeof(size));
+  if (err) return err;
+  if (size == 0 || size > pda->region_size) return EFBIG;
+
+  const uint16_t sector_count = (size + W25QX_SECTOR_SIZE - 1) / W25QX_SECTOR_SIZE;
+  err = pda->flash->ops->erase(pda->flash, pda->base_addr, sector_count);
+  if (err) return err;
+  printf("OK\r\n");
+
+  for (uint32_t offset = 0; offset < size; offset += UPLOAD_BLOCK_SIZE) {
+    const uint32_t len = size - offset > UPLOAD_BLOCK_SIZE ? UPLOAD_BLOCK_SIZE : size - offset;
+    err = receive_exact(pdu, upload_buffer, len);
+    if (err) return err;
+    err = pda->flash->ops->write(pda->flash, pda->base_addr + offset, upload_buffer, len);
+    if (err) return err;
+    printf("OK\r\n");
+  }
+
+  return pda->ops->init(pda);
+}
+
+static errno_t receive_exact(const Device_USART *pdu, uint8_t *data, uint32_t len) {
+  const uint32_t begin_ms = now_ms();
+
+  while (len) {
+    uint32_t data_len = 0;
+    errno_t err = pdu->ops->receive(pdu, data, &data_len, len);
+    if (err) return err;
+    data += data_len;
+    len -= data_len;
+    if (now_ms() - begin_ms > UPLOAD_TIMEOUT_MS) return ETIMEDOUT;
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t init(void) {
+  errno_t err = ESUCCESS;
+
+  err = timebase_init();
+  if (err) return err;
+
+  err = Device_config_GPIO_register();
+  if (err) return err;
+
+  err = Device_config_USART_register();
+  if (err) return err;
+
+  err = Device_config_SPI_register();
+  if (err) return err;
+
+  err = Device_config_W25QX_register();
+  if (err) return err;
+
+  err = Device_config_ST7789V2_register();
+  if (err) return err;
+
+  err = Device_config_asset_register();
+  if (err) return err;
+
+  return ESUCCESS;
+}
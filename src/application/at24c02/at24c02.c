@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include "common/errno/errno.h"
 #include "device/gpio/gpio.h"
 #include "device_config/gpio/gpio.h"
@@ -12,6 +13,8 @@
 #include "device_config/spi/spi.h"
 #include "device/w25qx/w25qx.h"
 #include "device_config/w25qx/w25qx.h"
+#include "device/kv/kv.h"
+#include "device_config/kv/kv.h"
 #include "device/st7789v2/st7789v2.h"
 #include "device_config/st7789v2/st7789v2.h"
 #include "device/i2c/i2c.h"
@@ -73,6 +76,15 @@ void at24c02_test() {
   }
   err = pda->ops->write(pda, 0x00, w_data, w_data_len - 1);
   if (err) goto print_err_tag;
+  // 写入只修改缓存, 等待写回后再读取
+  err = pda->ops->flush(pda);
+  if (err) goto print_err_tag;
+
+  // 累计的写回次数保存在 kv 中, 复位后不清零; 写入的内容与芯片中相同时不写回, 次数不变
+  uint32_t page_writes = 0;
+  err = pda->ops->get_page_writes(pda, 0, &page_writes);
+  if (err) goto print_err_tag;
+  printf("page 0 writes: %" PRIu32 "\r\n", page_writes);
 
   const uint16_t r_data_len = 27;
   uint8_t *r_data = (uint8_t *)calloc(r_data_len, sizeof(uint8_t));
@@ -125,6 +137,12 @@ static errno_t init(void) {
   err = Device_config_W25QX_register();
   if (err) goto print_err_tag;
 
+  err = Device_KV_module_init();
+  if (err) goto print_err_tag;
+
+  err = Device_config_KV_register();
+  if (err) goto print_err_tag;
+
   err = Device_ST7789V2_module_init();
   if (err) goto print_err_tag;
 
@@ -1,5 +1,6 @@
 #include "dht11.h"
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -46,19 +47,30 @@ void dht11_test() {
   err = pdd->ops->init(pdd);
 
   while (1) {
+    // 发起测量后立即返回, 结果在中断中解码并缓存
+    err = pdd->ops->measure(pdd);
+    if (err && err != EBUSY) goto print_err_tag;
+    err = delay_s(2);
+    if (err) goto print_err_tag;
+
     uint8_t data[4] = {0};
-    err = pdd->ops->read(pdd, data);
+    uint32_t age_ms = 0;
+    err = pdd->ops->read(pdd, data, &age_ms);
+    if (err == ENODATA) continue;
     if (err) goto print_err_tag;
-    uint8_t str[50] = {0};
-    snprintf((char *)str, 50, "H: %d.%d\r\nT: %d.%d", data[0], data[1], data[2], data[3]);
+    // 测量期间借用了右后轮测速的中断线, 显示借用次数和最长时间
+    Device_DHT11_stats stats = {0};
+    err = pdd->ops->get_stats(pdd, &stats);
+    if (err) goto print_err_tag;
+    uint8_t str[80] = {0};
+    snprintf((char *)str, 80, "H: %d.%d\r\nT: %d.%d\r\nage: %" PRIu32 "ms\r\nEXTI5: %" PRIu32 " x %" PRIu32 "us",
+      data[0], data[1], data[2], data[3], age_ms, stats.borrows, stats.borrowed_us_max);
     err = pds->ops->fill_window(pds, 0xfff0);
     if (err) goto print_err_tag;
     err = pds->ops->set_ascii_str(pds, str, strlen((char *)str), 0, 0, 0x0000);
     if (err) goto print_err_tag;
     err = pds->ops->refresh_window(pds);
     if (err) goto print_err_tag;
-    err = delay_s(2);
-    if (err) goto print_err_tag;
   }
 
   print_err_tag:
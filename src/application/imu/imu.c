@@ -0,0 +1,310 @@
+#include "imu.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "stm32f4xx_hal.h"
+#include "common/pid/pid.h"
+#include "common/trajectory/trajectory.h"
+#include "common/attitude/attitude.h"
+#include "common/timebase/timebase.h"
+#include "device_config/gpio/gpio.h"
+#include "device_config/usart/usart.h"
+#include "device_config/timer/timer.h"
+#include "device_config/pwm/pwm.h"
+#include "device_config/motor/motor.h"
+#include "device_config/speed_test/speed_test.h"
+#include "device_config/wheel/wheel.h"
+#include "device_config/i2c/i2c.h"
+#include "device_config/mpu6050/mpu6050.h"
+
+/**
+ * 陀螺仪辅助的直线和转向控制: 沿正方形行驶, 直行时保持航向, 每条边结束后原地左转 90 度
+ * 航向误差单位为 0.01 度, 输出为两侧车轮转速差(0.01 转/分), 航向偏右(误差为正)时右轮加速
+ */
+// 控制周期, 单位为微秒
+#define CONTROL_PERIOD_US 2000
+#define CONTROL_RATE_HZ (1000000 / CONTROL_PERIOD_US)
+// 直行的车轮目标转速, 单位为 0.01 转/分
+#define RPM_STRAIGHT 15000
+#define LEG_MS 2000
+#define LEG_COUNT 4
+// 每次转向的角度, 单位为 0.01 度
+#define TURN_CDEG 9000
+// 误差和角速度都小于以下值时认为转向完成, 单位为 0.01 度和 0.01 度/秒
+#define TURN_TOLERANCE_CDEG 100
+#define TURN_SETTLE_CDPS 500
+// 融合结果超过该时间没有更新时停车
+#define IMU_TIMEOUT_MS 20
+#define FULL_TURN_CDEG 36000
+#define REPORT_INTERVAL_MS 1000
+
+/**
+ * 航向 PI 参数, 10 度误差时转速差约 60 转/分, 积分消除直行时左右电机的差异
+ * 微分由陀螺仪角速度直接给出, 不对航向差分
+ */
+static const Pid_param heading_param = {
+  .kp = Q16_FROM_FLOAT(6.0),
+  .ki = Q16_FROM_FLOAT(0.002),
+  .kd = 0,
+  .kff = 0,
+  .kaff = 0,
+  .ff_offset = 0,
+  .out_min = -2 * RPM_STRAIGHT,
+  .out_max = 2 * RPM_STRAIGHT,
+};
+// 角速度误差(0.01 度/秒)的增益, 跟随转向曲线的角速度并抑制超调
+#define YAW_RATE_GAIN Q16_FROM_FLOAT(2.0)
+static Pid heading_pid = {0};
+
+// 目标航向曲线, 位置单位为 0.01 度, 不归一化, 最大 90 度/秒
+static const Trajectory_param heading_profile_param = {
+  .max_velocity = 9000,
+  .max_acceleration = 36000,
+  .max_jerk = 0,
+  .period_us = CONTROL_PERIOD_US,
+};
+static Trajectory heading_profile = {0};
+
+typedef enum {
+  STATE_CALIBRATING,
+  STATE_STRAIGHT,
+  STATE_TURN,
+  STATE_DONE,
+} State;
+
+static errno_t init(void);
+static errno_t callback(void);
+static errno_t set_wheels(int32_t left, int32_t right);
+static errno_t stop_wheels(void);
+
+static Device_timer *pdtimer = NULL;
+static Device_wheel *pdw_hl = NULL, *pdw_hr = NULL, *pdw_tl = NULL, *pdw_tr = NULL;
+static const Device_MPU6050 *pdm = NULL;
+static volatile State state = STATE_CALIBRATING;
+static uint32_t state_start_ms = 0;
+static uint8_t leg = 0;
+// 控制中断的最长耗时, 单位为微秒
+static volatile uint32_t control_us_max = 0;
+
+void imu_test(void) {
+  errno_t err = ESUCCESS;
+
+  printf("imu_test start\r\n");
+
+  err = init();
+  if (err) goto err_tag;
+
+  err = Device_wheel_find(&pdw_hl, DEVICE_WHEEL_HEAD_LEFT);
+  if (err) goto err_tag;
+  err = Device_wheel_find(&pdw_hr, DEVICE_WHEEL_HEAD_RIGHT);
+  if (err) goto err_tag;
+  err = Device_wheel_find(&pdw_tl, DEVICE_WHEEL_TAIL_LEFT);
+  if (err) goto err_tag;
+  err = Device_wheel_find(&pdw_tr, DEVICE_WHEEL_TAIL_RIGHT);
+  if (err) goto err_tag;
+  err = pdw_hl->ops->init(pdw_hl);
+  if (err) goto err_tag;
+  err = pdw_hr->ops->init(pdw_hr);
+  if (err) goto err_tag;
+  err = pdw_tl->ops->init(pdw_tl);
+  if (err) goto err_tag;
+  err = pdw_tr->ops->init(pdw_tr);
+  if (err) goto err_tag;
+
+  err = pid_init(&heading_pid, &heading_param);
+  if (err) goto err_tag;
+  err = trajectory_init(&heading_profile, &heading_profile_param, 0);
+  if (err) goto err_tag;
+
+  // 初始化后开始标定零偏, 期间需要保持静止
+  err = Device_MPU6050_find(&pdm, DEVICE_MPU6050_1);
+  if (err) goto err_tag;
+  err = pdm->ops->init(pdm);
+  if (err) goto err_tag;
+  printf("imu: calibrating, keep still\r\n");
+
+  err = Device_timer_find(&pdtimer, DEVICE_TIMER_TIM6);
+  if (err) goto err_tag;
+  err = pdtimer->ops->set_period_elapsed_callback(pdtimer, callback);
+  if (err) goto err_tag;
+  err = pdtimer->ops->set_period(pdtimer, CONTROL_PERIOD_US);
+  if (err) goto err_tag;
+  bool timer_running = false;
+  err = pdtimer->ops->is_running(pdtimer, &timer_running);
+  if (err) goto err_tag;
+  if (timer_running == false) {
+    err = pdtimer->ops->start(pdtimer, DEVICE_TIMER_START_MODE_IT);
+    if (err) goto err_tag;
+  }
+
+  // 融合耗时按一个采样周期的 CPU 周期数给出占比
+  const uint32_t sample_cycles = SystemCoreClock / 1000;
+  uint32_t last_report_ms = now_ms();
+
+  while (1) {
+    if (now_ms() - last_report_ms < REPORT_INTERVAL_MS) continue;
+    last_report_ms = now_ms();
+
+    Device_MPU6050_attitude attitude = {0};
+    err = pdm->ops->get_attitude(pdm, &attitude);
+    if (err) goto err_tag;
+    Device_MPU6050_stats stats = {0};
+    err = pdm->ops->get_stats(pdm, &stats);
+    if (err) goto err_tag;
+
+    printf(
+      "imu: state %d, heading %ld, yaw rate %ld (0.01 deg), samples %lu, overflows %lu, errors %lu\r\n"
+      , (int)state
+      , (long)((int64_t)attitude.heading * 100 >> Q16_SHIFT)
+      , (long)((int64_t)attitude.yaw_rate * 100 >> Q16_SHIFT)
+      , (unsigned long)stats.samples, (unsigned long)stats.overflows, (unsigned long)stats.errors
+    );
+    printf(
+      "imu: fusion %lu/%lu cycles per sample (max %lu), control max %lu us\r\n"
+      , (unsigned long)stats.fusion_cycles_last, (unsigned long)sample_cycles
+      , (unsigned long)stats.fusion_cycles_max, (unsigned long)control_us_max
+    );
+  }
+
+  err_tag:
+  printf("imu_test_err\r\nerr: %d\r\n", err);
+  while (1);
+}
+
+static errno_t init(void) {
+  errno_t err = ESUCCESS;
+
+  err = Device_config_GPIO_register();
+  if (err) return err;
+
+  err = Device_config_USART_register();
+  if (err) return err;
+
+  err = Device_config_timer_register();
+  if (err) return err;
+
+  err = Device_config_PWM_register();
+  if (err) return err;
+
+  err = Device_config_motor_register();
+  if (err) return err;
+
+  err = Device_config_speed_test_register();
+  if (err) return err;
+
+  err = Device_config_wheel_register();
+  if (err) return err;
+
+  err = Device_config_I2C_register();
+  if (err) return err;
+
+  err = Device_config_MPU6050_register();
+  if (err) return err;
+
+  return timebase_init();
+}
+
+/**
+ * @brief 控制中断, 每个周期执行一次
+ * 目标航向按转向曲线变化, 航向误差经过 PI 得到转速差, 再加上角速度跟随项:
+ * turn = PI(目标航向 - 航向) + k * (曲线角速度 - 陀螺仪角速度)
+ */
+static errno_t callback(void) {
+  const uint32_t start_us = now_us();
+  errno_t err = ESUCCESS;
+
+  Device_MPU6050_attitude attitude = {0};
+  err = pdm->ops->get_attitude(pdm, &attitude);
+  if (err) goto cb_err_tag;
+
+  if (state == STATE_DONE) return ESUCCESS;
+  if (state == STATE_CALIBRATING) {
+    if (attitude.ready == false) return ESUCCESS;
+    trajectory_reset(&heading_profile, (int32_t)((int64_t)attitude.heading * 100 >> Q16_SHIFT));
+    pid_reset(&heading_pid);
+    leg = 0;
+    state_start_ms = now_ms();
+    state = STATE_STRAIGHT;
+  }
+
+  // 传感器或总线故障时不能继续按航向控制
+  if (attitude.age_ms > IMU_TIMEOUT_MS) {
+    err = ETIMEDOUT;
+    goto cb_err_tag;
+  }
+
+  const int32_t target = trajectory_step(&heading_profile);
+  const int32_t target_rate = (int32_t)(heading_profile.velocity * CONTROL_RATE_HZ >> Q16_SHIFT);
+  // 目标航向先归一化到一圈以内, 再换算为 Q16 度
+  const q16_t target_q16 = (q16_t)((int64_t)(target % FULL_TURN_CDEG) * Q16_ONE / 100);
+  const int32_t error = (int32_t)((int64_t)attitude_heading_diff(target_q16, attitude.heading) * 100 >> Q16_SHIFT);
+  const int32_t yaw_rate = (int32_t)((int64_t)attitude.yaw_rate * 100 >> Q16_SHIFT);
+
+  int32_t turn = 0;
+  err = pid_update(&heading_pid, error, 0, &turn);
+  if (err) goto cb_err_tag;
+  turn += (int32_t)((int64_t)YAW_RATE_GAIN * (target_rate - yaw_rate) >> Q16_SHIFT);
+
+  int32_t base = 0;
+  switch (state) {
+    case STATE_STRAIGHT: {
+      base = RPM_STRAIGHT;
+      if (now_ms() - state_start_ms < LEG_MS) break;
+      if (++leg >= LEG_COUNT) {
+        state = STATE_DONE;
+        err = stop_wheels();
+        if (err) goto cb_err_tag;
+        return ESUCCESS;
+      }
+      trajectory_set_target(&heading_profile, heading_profile.target + TURN_CDEG);
+      state = STATE_TURN;
+      base = 0;
+      break;
+    }
+    case STATE_TURN: {
+      const bool settled = trajectory_done(&heading_profile)
+        && abs(error) < TURN_TOLERANCE_CDEG && abs(yaw_rate) < TURN_SETTLE_CDPS;
+      if (settled) {
+        pid_reset(&heading_pid);
+        state_start_ms = now_ms();
+        state = STATE_STRAIGHT;
+      }
+      break;
+    }
+    default: break;
+  }
+
+  err = set_wheels(base - turn, base + turn);
+  if (err) goto cb_err_tag;
+
+  const uint32_t elapsed_us = timebase_elapsed_us(start_us);
+  if (elapsed_us > control_us_max) control_us_max = elapsed_us;
+
+  return ESUCCESS;
+
+  cb_err_tag:
+  state = STATE_DONE;
+  stop_wheels();
+  return EIO;
+}
+
+static errno_t set_wheels(int32_t left, int32_t right) {
+  errno_t err = pdw_hl->ops->set_target(pdw_hl, left);
+  if (err) return err;
+  err = pdw_tl->ops->set_target(pdw_tl, left);
+  if (err) return err;
+  err = pdw_hr->ops->set_target(pdw_hr, right);
+  if (err) return err;
+  return pdw_tr->ops->set_target(pdw_tr, right);
+}
+
+static errno_t stop_wheels(void) {
+  errno_t err = pdw_hl->ops->stop(pdw_hl);
+  if (err) return err;
+  err = pdw_tl->ops->stop(pdw_tl);
+  if (err) return err;
+  err = pdw_hr->ops->stop(pdw_hr);
+  if (err) return err;
+  return pdw_tr->ops->stop(pdw_tr);
+}
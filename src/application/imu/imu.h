@@ -0,0 +1,3 @@
+#pragma once
+
+void imu_test(void);
@@ -0,0 +1,77 @@
+#include "kv.h"
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "common/errno/errno.h"
+#include "device_config/gpio/gpio.h"
+#include "device_config/usart/usart.h"
+#include "device_config/spi/spi.h"
+#include "device_config/w25qx/w25qx.h"
+#include "device_config/kv/kv.h"
+
+// 测试用的键
+#define KEY_BOOT_COUNT 1
+#define KEY_NAME 2
+
+static errno_t init(void);
+
+void kv_test(void) {
+  errno_t err = init();
+  if (err) goto print_err_tag;
+
+  Device_KV *pd = NULL;
+  err = Device_KV_find(&pd, DEVICE_KV_SETTINGS);
+  if (err) goto print_err_tag;
+  err = pd->ops->init(pd);
+  if (err) goto print_err_tag;
+
+  // 启动次数, 每次上电加 1
+  uint32_t boot_count = 0;
+  err = pd->ops->get(pd, KEY_BOOT_COUNT, &boot_count, sizeof(boot_count), NULL);
+  if (err && err != ENOENT) goto print_err_tag;
+  ++boot_count;
+  err = pd->ops->set(pd, KEY_BOOT_COUNT, &boot_count, sizeof(boot_count));
+  if (err) goto print_err_tag;
+  printf("boot count: %" PRIu32 "\r\n", boot_count);
+
+  const char name[] = "STM32_mini_car";
+  err = pd->ops->set(pd, KEY_NAME, name, sizeof(name));
+  if (err) goto print_err_tag;
+
+  char read_name[32] = {0};
+  uint16_t len = 0;
+  err = pd->ops->get(pd, KEY_NAME, read_name, sizeof(read_name), &len);
+  if (err) goto print_err_tag;
+  printf("name: %s, len: %d\r\n", read_name, len);
+
+  while (1) {
+
+  }
+
+  print_err_tag:
+  printf("kv_test_err\r\nerr: %d\r\n", err);
+  while (1);
+}
+
+static errno_t init(void) {
+  errno_t err = ESUCCESS;
+
+  err = Device_config_GPIO_register();
+  if (err) return err;
+
+  err = Device_config_USART_register();
+  if (err) return err;
+
+  err = Device_config_SPI_register();
+  if (err) return err;
+
+  err = Device_config_W25QX_register();
+  if (err) return err;
+
+  err = Device_config_KV_register();
+  if (err) return err;
+
+  return ESUCCESS;
+}
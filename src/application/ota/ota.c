@@ -0,0 +1,287 @@
+#include "ota.h"
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "common/errno/errno.h"
+#include "common/crc/crc.h"
+#include "common/base64/base64.h"
+#include "common/timebase/timebase.h"
+#include "device_config/gpio/gpio.h"
+#include "device_config/usart/usart.h"
+#include "device_config/timer/timer.h"
+#include "device_config/spi/spi.h"
+#include "device_config/w25qx/w25qx.h"
+#include "device_config/ota/ota.h"
+#include "device_config/wifi_bluetooth/wifi_bluetooth.h"
+
+/**
+ * 与 server/main.js 的文本协议, 每行以 \r\n 结束:
+ * OTA INFO                    -> OTA INFO <size> <crc> <version>
+ * OTA GET <offset> <len>      -> OTA DATA <offset> <len> <crc> <base64>
+ * 出错时回复 OTA ERR <原因>, crc 为 8 位十六进制
+ * 数据用 Base64 编码, AT 指令的响应以 \r\nOK\r\n 结束, 二进制数据中出现这个序列时会提前结束
+ */
+#define SERVER_HOST "124.156.213.226"
+#define SERVER_PORT 9000
+// 每次请求的字节数, 编码后一行约 720 字节, 模组一次返回
+#define CHUNK_SIZE 512
+#define LINE_SIZE 1024
+#define LINE_TIMEOUT_MS 5000
+// 一块数据校验失败时的重试次数
+#define CHUNK_RETRY 3
+// 每接收这么多字节打印一次进度
+#define REPORT_INTERVAL 0x4000
+
+static errno_t init(void);
+static errno_t request_info(Device_wifi_bluetooth *pdw, uint32_t *rt_size_ptr, uint32_t *rt_crc_ptr, uint32_t *rt_version_ptr);
+static errno_t request_chunk(Device_wifi_bluetooth *pdw, uint32_t offset, uint32_t len, uint8_t *data);
+static errno_t send_line(Device_wifi_bluetooth *pdw, const char *line);
+// 读取一行以 prefix 开头的响应, 跳过其他行(例如连接时的 WELCOME), 返回 prefix 之后的部分
+static errno_t read_line(Device_wifi_bluetooth *pdw, const char *prefix, char **rt_line_ptr);
+
+// 两块数据轮流使用, 一块在编程时接收另一块
+static uint8_t chunk_buffers[2][CHUNK_SIZE] = {0};
+// 接收到的数据, [0, line_consumed) 为上一次返回的行
+static char line_buffer[LINE_SIZE + 1] = {0};
+static uint32_t line_len = 0;
+static uint32_t line_consumed = 0;
+static uint8_t socket_buffer[LINE_SIZE] = {0};
+
+void ota_test(void) {
+  errno_t err = init();
+  if (err) goto print_err_tag;
+
+  Device_ota *pdo = NULL;
+  err = Device_ota_find(&pdo, DEVICE_OTA_1);
+  if (err) goto print_err_tag;
+  err = pdo->ops->init(pdo);
+  if (err) goto print_err_tag;
+
+  Device_ota_state state = DEVICE_OTA_STATE_EMPTY;
+  uint32_t staged_version = 0;
+  err = pdo->ops->get_state(pdo, &state, &staged_version);
+  if (err) goto print_err_tag;
+
+  // 上次接收完成但没有安装(例如安装前复位)
+  if (state == DEVICE_OTA_STATE_READY) {
+    printf("ota: install staged version %" PRIu32 "\r\n", staged_version);
+    err = pdo->ops->install(pdo);
+    goto print_err_tag;
+  }
+
+  Device_wifi_bluetooth *pdw = NULL;
+  err = Device_wifi_bluetooth_find(&pdw, DEVICE_WIFI_BLUETOOTH_1);
+  if (err) goto print_err_tag;
+  err = pdw->ops->init(pdw);
+  if (err) goto print_err_tag;
+  err = pdw->ops->join_wifi_ap(pdw, (uint8_t *)"Law_of_Cycles", (uint8_t *)"Homura_9630");
+  if (err) goto print_err_tag;
+  err = pdw->ops->create_socket_connection(pdw, TCP_CLIENT, (uint8_t *)SERVER_HOST, SERVER_PORT);
+  if (err) goto print_err_tag;
+
+  uint32_t size = 0, crc = 0, version = 0;
+  err = request_info(pdw, &size, &crc, &version);
+  if (err) goto print_err_tag;
+  printf("ota: server version %" PRIu32 ", %" PRIu32 " bytes, crc %08" PRIx32 "\r\n", version, size, crc);
+
+  if (state == DEVICE_OTA_STATE_INSTALLED && staged_version == version) {
+    printf("ota: version %" PRIu32 " already installed\r\n", version);
+    goto close_tag;
+  }
+
+  uint32_t offset = 0;
+  err = pdo->ops->begin(pdo, size, crc, version, &offset);
+  if (err) goto print_err_tag;
+  if (offset > 0) printf("ota: resume from %" PRIu32 "\r\n", offset);
+
+  // 统计吞吐量, flash_us 为等待上一块编程完成的时间, 接近 0 说明瓶颈在串口和网络
+  const uint32_t resume_offset = offset;
+  const uint32_t start_ms = now_ms();
+  uint32_t flash_us = 0, report_offset = offset;
+  uint8_t index = 0;
+
+  while (offset < size) {
+    const uint32_t len = size - offset < CHUNK_SIZE ? size - offset : CHUNK_SIZE;
+
+    err = request_chunk(pdw, offset, len, chunk_buffers[index]);
+    if (err) goto print_err_tag;
+
+    const uint32_t write_start_us = now_us();
+    err = pdo->ops->write(pdo, offset, chunk_buffers[index], len);
+    if (err) goto print_err_tag;
+    flash_us += timebase_elapsed_us(write_start_us);
+
+    offset += len;
+    index ^= 1;
+
+    if (offset - report_offset >= REPORT_INTERVAL || offset == size) {
+      const uint32_t elapsed_ms = now_ms() - start_ms;
+      const uint32_t bytes = offset - resume_offset;
+      printf(
+        "ota: %" PRIu32 "/%" PRIu32 " bytes, %" PRIu32 " B/s, flash wait %" PRIu32 " ms\r\n"
+        , offset, size, elapsed_ms ? (uint32_t)((uint64_t)bytes * 1000 / elapsed_ms) : 0, flash_us / 1000
+      );
+      report_offset = offset;
+    }
+  }
+
+  err = pdo->ops->finish(pdo);
+  if (err) goto print_err_tag;
+  printf("ota: verified, installing\r\n");
+
+  err = pdw->ops->delete_socket_connection(pdw, SERVER_PORT);
+  if (err) goto print_err_tag;
+
+  err = pdo->ops->install(pdo);
+  goto print_err_tag;
+
+  close_tag:
+  err = pdw->ops->delete_socket_connection(pdw, SERVER_PORT);
+  if (err) goto print_err_tag;
+  for (;;);
+
+  print_err_tag:
+  printf("ota_test_err\r\nerr: %d\r\n", err);
+  for (;;);
+
+  return;
+}
+
+static errno_t request_info(Device_wifi_bluetooth *pdw, uint32_t *rt_size_ptr, uint32_t *rt_crc_ptr, uint32_t *rt_version_ptr) {
+  errno_t err = send_line(pdw, "OTA INFO\r\n");
+  if (err) return err;
+
+  char *line = NULL;
+  err = read_line(pdw, "OTA INFO ", &line);
+  if (err) return err;
+
+  char *end = NULL;
+  *rt_size_ptr = strtoul(line, &end, 10);
+  if (*end != ' ') return EPROTO;
+  *rt_crc_ptr = strtoul(end + 1, &end, 16);
+  if (*end != ' ') return EPROTO;
+  *rt_version_ptr = strtoul(end + 1, &end, 10);
+  if (*end != '\0') return EPROTO;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 请求一块数据并解码到 data
+ * 偏移、长度或 CRC 不对时重新请求, 连续失败 CHUNK_RETRY 次后返回 EBADMSG
+ */
+static errno_t request_chunk(Device_wifi_bluetooth *pdw, uint32_t offset, uint32_t len, uint8_t *data) {
+  char request[40] = {0};
+  snprintf(request, sizeof(request), "OTA GET %" PRIu32 " %" PRIu32 "\r\n", offset, len);
+
+  for (uint8_t retry = 0; retry < CHUNK_RETRY; ++retry) {
+    errno_t err = send_line(pdw, request);
+    if (err) return err;
+
+    char *line = NULL;
+    err = read_line(pdw, "OTA DATA ", &line);
+    if (err) return err;
+
+    char *end = NULL;
+    const uint32_t data_offset = strtoul(line, &end, 10);
+    if (*end != ' ') continue;
+    const uint32_t data_len = strtoul(end + 1, &end, 10);
+    if (*end != ' ') continue;
+    const uint32_t data_crc = strtoul(end + 1, &end, 16);
+    if (*end != ' ') continue;
+    if (data_offset != offset || data_len != len) continue;
+
+    const char *encoded = end + 1;
+    uint32_t decoded_len = 0;
+    err = base64_decode(encoded, strlen(encoded), data, CHUNK_SIZE, &decoded_len);
+    if (err) continue;
+    if (decoded_len != len || crc32(0, data, len) != data_crc) continue;
+
+    return ESUCCESS;
+  }
+
+  return EBADMSG;
+}
+
+static errno_t send_line(Device_wifi_bluetooth *pdw, const char *line) {
+  return pdw->ops->socket_send(pdw, SERVER_PORT, (uint8_t *)line, strlen(line));
+}
+
+static errno_t read_line(Device_wifi_bluetooth *pdw, const char *prefix, char **rt_line_ptr) {
+  const uint32_t prefix_len = strlen(prefix);
+  const uint32_t start_ms = now_ms();
+
+  for (;;) {
+    // 移除上一次返回的行
+    memmove(line_buffer, line_buffer + line_consumed, line_len - line_consumed);
+    line_len -= line_consumed;
+    line_consumed = 0;
+
+    char *line_end = NULL;
+    for (uint32_t i = 0; i + 1 < line_len; ++i) {
+      if (line_buffer[i] == '\r' && line_buffer[i + 1] == '\n') {
+        line_end = &line_buffer[i];
+        break;
+      }
+    }
+
+    if (line_end != NULL) {
+      *line_end = '\0';
+      line_consumed = line_end - line_buffer + 2;
+      if (strncmp(line_buffer, "OTA ERR", 7) == 0) {
+        printf("ota: server %s\r\n", line_buffer);
+        return EPROTO;
+      }
+      if (strncmp(line_buffer, prefix, prefix_len) == 0) {
+        *rt_line_ptr = line_buffer + prefix_len;
+        return ESUCCESS;
+      }
+      continue;
+    }
+
+    if (now_ms() - start_ms > LINE_TIMEOUT_MS) return ETIMEDOUT;
+
+    uint32_t len = 0;
+    errno_t err = pdw->ops->socket_read(pdw, SERVER_PORT, socket_buffer, &len, sizeof(socket_buffer));
+    if (err) return err;
+    if (len > LINE_SIZE - line_len) return EOVERFLOW;
+    memcpy(line_buffer + line_len, socket_buffer, len);
+    line_len += len;
+  }
+}
+
+static errno_t init(void) {
+  errno_t err = ESUCCESS;
+
+  err = Device_config_GPIO_register();
+  if (err) goto print_err_tag;
+
+  err = Device_config_USART_register();
+  if (err) goto print_err_tag;
+
+  err = Device_config_timer_register();
+  if (err) goto print_err_tag;
+
+  err = Device_config_SPI_register();
+  if (err) goto print_err_tag;
+
+  err = Device_config_W25QX_register();
+  if (err) goto print_err_tag;
+
+  err = Device_config_ota_register();
+  if (err) goto print_err_tag;
+
+  err = Device_config_wifi_bluetooth_register();
+  if (err) goto print_err_tag;
+
+  err = timebase_init();
+  if (err) goto print_err_tag;
+
+  return ESUCCESS;
+
+  print_err_tag:
+  printf("ota_test_init_err\r\nerr: %d\r\n", err);
+  return err;
+}
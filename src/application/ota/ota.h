@@ -0,0 +1,3 @@
+#pragma once
+
+void ota_test(void);
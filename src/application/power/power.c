@@ -0,0 +1,179 @@
+#include "power.h"
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "common/errno/errno.h"
+#include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
+#include "device_config/gpio/gpio.h"
+#include "device_config/usart/usart.h"
+#include "device_config/timer/timer.h"
+#include "device_config/spi/spi.h"
+#include "device_config/st7789v2/st7789v2.h"
+#include "device_config/w25qx/w25qx.h"
+#include "device_config/adc/adc.h"
+#include "device_config/power/power.h"
+#include "device_config/wifi_bluetooth/wifi_bluetooth.h"
+
+// 上报电池状态的服务器, 与 wifi_bluetooth 测试相同
+#define WIFI_SSID "Law_of_Cycles"
+#define WIFI_PWD "Homura_9630"
+#define WIFI_HOST "124.156.213.226"
+#define WIFI_PORT 9000
+
+static errno_t init(void);
+static errno_t wifi_connect(Device_wifi_bluetooth *pdw);
+
+static const char *const level_names[DEVICE_POWER_LEVEL_COUNT] = {
+  [DEVICE_POWER_LEVEL_NORMAL] = "normal",
+  [DEVICE_POWER_LEVEL_SAVING] = "saving",
+  [DEVICE_POWER_LEVEL_LOW] = "low",
+  [DEVICE_POWER_LEVEL_CRITICAL] = "critical",
+};
+
+void power_test(void) {
+  #define WIDTH 200
+  #define HEIGHT 50
+  #define ONE_PIXEL_BYTE_NUM 2
+
+  const uint32_t display_memory_size = WIDTH * HEIGHT * ONE_PIXEL_BYTE_NUM;
+  uint8_t display_memory[WIDTH * HEIGHT * ONE_PIXEL_BYTE_NUM] = {0};
+
+  errno_t err = init();
+  if (err) goto print_err_tag;
+
+  Device_ST7789V2 *pds = NULL;
+  err = Device_ST7789V2_find(&pds, DEVICE_ST7789V2_1);
+  if (err) goto print_err_tag;
+  err = pds->ops->init(pds);
+  if (err) goto print_err_tag;
+  err = pds->ops->clear_screen(pds, 0xFFFF);
+  if (err) goto print_err_tag;
+  err = pds->ops->set_display_memory(pds, display_memory, display_memory_size);
+  if (err) goto print_err_tag;
+  err = pds->ops->set_window(pds, 10, 10, 10 + HEIGHT - 1, 10 + WIDTH - 1);
+  if (err) goto print_err_tag;
+
+  const Device_W25QX *pdf = NULL;
+  err = Device_W25QX_find(&pdf, DEVICE_W25Q64);
+  if (err) goto print_err_tag;
+  err = pdf->ops->init(pdf);
+  if (err) goto print_err_tag;
+
+  Device_power *pdp = NULL;
+  err = Device_power_find(&pdp, DEVICE_POWER_BATTERY);
+  if (err) goto print_err_tag;
+  err = pdp->ops->init(pdp);
+  if (err) goto print_err_tag;
+
+  // 连接失败时只显示, 不上报
+  Device_wifi_bluetooth *pdw = NULL;
+  err = Device_wifi_bluetooth_find(&pdw, DEVICE_WIFI_BLUETOOTH_1);
+  if (err) goto print_err_tag;
+  err = wifi_connect(pdw);
+  if (err) printf("power_test wifi err: %d\r\n", err);
+  const bool wifi_connected = err == ESUCCESS;
+
+  Device_power_status status = {0};
+  const Device_power_policy *policy = NULL;
+  uint32_t last_refresh_ms = 0;
+  uint32_t last_send_ms = 0;
+  uint8_t str[50] = {0};
+
+  while (1) {
+    err = pdp->ops->update(pdp);
+    if (err == ENODATA) {
+      delay_ms(10);
+      continue;
+    }
+    if (err) goto print_err_tag;
+
+    err = pdp->ops->get_status(pdp, &status);
+    if (err) goto print_err_tag;
+    err = pdp->ops->get_policy(pdp, &policy);
+    if (err) goto print_err_tag;
+
+    // 刷新周期为 0 或屏幕睡眠时不刷新
+    if (policy->display_refresh_ms != 0 && status.sleeping == false
+      && now_ms() - last_refresh_ms >= policy->display_refresh_ms) {
+      last_refresh_ms = now_ms();
+
+      err = pds->ops->fill_window(pds, 0xfff0);
+      if (err) goto print_err_tag;
+
+      snprintf((char *)str, 50, "%" PRIu32 "mV %d%% %s", status.voltage_mv, status.soc, level_names[status.level]);
+      err = pds->ops->set_ascii_str(pds, str, strlen((char *)str), 0, 0, 0x0000);
+      if (err) goto print_err_tag;
+
+      snprintf((char *)str, 50, "trend: %" PRId32 "mV/min", status.trend_mv_per_min);
+      err = pds->ops->set_ascii_str(pds, str, strlen((char *)str), 16, 0, 0x0000);
+      if (err) goto print_err_tag;
+
+      err = pds->ops->refresh_window(pds);
+      if (err) goto print_err_tag;
+    }
+
+    // 按策略的间隔上报, 间隔为 0 时停止上报
+    if (wifi_connected && policy->wifi_send_interval_ms != 0
+      && now_ms() - last_send_ms >= policy->wifi_send_interval_ms) {
+      last_send_ms = now_ms();
+
+      snprintf((char *)str, 50, "%" PRIu32 "mV %d%% %s\r\n", status.voltage_mv, status.soc, level_names[status.level]);
+      err = pdw->ops->socket_send(pdw, WIFI_PORT, str, strlen((char *)str));
+      if (err) printf("power_test wifi send err: %d\r\n", err);
+    }
+
+    delay_ms(policy->sensor_poll_ms);
+  }
+
+  print_err_tag:
+  printf("power_test_err\r\nerr: %d\r\n", err);
+  while (1);
+
+  return;
+}
+
+static errno_t init(void) {
+  errno_t err = ESUCCESS;
+
+  err = Device_config_GPIO_register();
+  if (err) return err;
+
+  err = Device_config_USART_register();
+  if (err) return err;
+
+  err = Device_config_timer_register();
+  if (err) return err;
+
+  err = Device_config_SPI_register();
+  if (err) return err;
+
+  err = Device_config_ST7789V2_register();
+  if (err) return err;
+
+  err = Device_config_W25QX_register();
+  if (err) return err;
+
+  err = Device_config_ADC_register();
+  if (err) return err;
+
+  err = Device_config_power_register();
+  if (err) return err;
+
+  err = Device_config_wifi_bluetooth_register();
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t wifi_connect(Device_wifi_bluetooth *pdw) {
+  errno_t err = pdw->ops->init(pdw);
+  if (err) return err;
+
+  err = pdw->ops->join_wifi_ap(pdw, (uint8_t *)WIFI_SSID, (uint8_t *)WIFI_PWD);
+  if (err) return err;
+
+  return pdw->ops->create_socket_connection(pdw, TCP_CLIENT, (uint8_t *)WIFI_HOST, WIFI_PORT);
+}
@@ -1,6 +1,7 @@
 #include "speed_test.h"
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
 #include "common/delay/delay.h"
@@ -86,21 +87,27 @@ void speed_test_test(void) {
   err = pdst_hl->ops->init(pdst_hl);
   if (err) goto err_tag;
 
-  float speed = 0;
-  uint8_t speed_str[20] = {0};
+  uint32_t rpm = 0, distance = 0;
+  uint8_t speed_str[40] = {0};
 
   while (1) {
-    err = pdst_hl->ops->get_speed(pdst_hl, &speed);
+    err = pdst_hl->ops->get_rpm(pdst_hl, &rpm);
     if (err) goto err_tag;
 
-    snprintf((char *)speed_str, 20, "speed: %0.3f", speed);
+    err = pdst_hl->ops->get_distance(pdst_hl, &distance);
+    if (err) goto err_tag;
+
+    err = pds->ops->fill_window(pds, window_background_color);
+    if (err) goto err_tag;
+
+    snprintf((char *)speed_str, 40, "rpm: %" PRIu32 ".%02" PRIu32 "\r\nmm: %" PRIu32, rpm / 100, rpm % 100, distance);
     err = pds->ops->set_ascii_str(pds, speed_str, strlen((char *)speed_str), 0, 0, 0x0000);
     if (err) goto err_tag;
 
     err = pds->ops->refresh_window(pds);
     if (err) goto err_tag;
 
-    delay_s(1);
+    delay_ms(200);
   }
 
   err_tag:
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include "common/delay/delay.h"
+#include "common/pid/pid.h"
+#include "common/timebase/timebase.h"
 #include "device_config/gpio/gpio.h"
 #include "device_config/usart/usart.h"
 #include "device_config/timer/timer.h"
@@ -14,13 +16,53 @@
 #include "device_config/motor/motor.h"
 #include "device_config/speed_test/speed_test.h"
 #include "device_config/tracker/tracker.h"
+#include "device_config/wheel/wheel.h"
+#include "device_config/w25qx/w25qx.h"
+#include "device_config/adc/adc.h"
+#include "device_config/power/power.h"
+#include "device_config/ultrasonic/ultrasonic.h"
+#include "device_config/recorder/recorder.h"
+
+// 循迹控制周期, 单位为微秒
+#define CONTROL_PERIOD_US 2000
+// 车轮目标转速, 单位为 0.01 转/分
+#define RPM_FAST 20000
+#define RPM_SLOW 10000
+// 丢线超过该时间后停车
+#define LOST_TIMEOUT_MS 1000
+// 每隔多少个控制周期记录一次, 即每 10 毫秒一个样本
+#define RECORD_DIVIDER 5
+// 从调试串口收到该字符时导出记录
+#define DUMP_COMMAND 'd'
+
+/**
+ * 转向 PD 参数, 输入为导航线位置(-3500 ~ 3500), 输出为两侧车轮转速差
+ * 导航线偏到最边缘探头时, 转速差约为 2 倍基础速度, 即内侧车轮反转
+ */
+static const Pid_param steering_param = {
+  .kp = Q16_FROM_FLOAT(12.0),
+  .ki = 0,
+  .kd = Q16_FROM_FLOAT(40.0),
+  .kff = 0,
+  .kaff = 0,
+  .ff_offset = 0,
+  .out_min = -2 * RPM_FAST,
+  .out_max = 2 * RPM_FAST,
+};
+static Pid steering = {0};
 
 static errno_t init(void);
 static errno_t callback(void);
+static errno_t record(const Device_tracker_line *const pl);
+static errno_t dump_sink(void *arg, const uint8_t *data, uint32_t len);
 
 static Device_timer *pdtimer = NULL;
-static Device_motor *pdm_hl = NULL, *pdm_hr = NULL, *pdm_tl = NULL, *pdm_tr = NULL;
+static Device_wheel *pdw_hl = NULL, *pdw_hr = NULL, *pdw_tl = NULL, *pdw_tr = NULL;
 static Device_tracker *pdt = NULL;
+static Device_ultrasonic *pdus = NULL;
+static Device_recorder *pdr = NULL;
+// 由主循环更新, 控制中断中记录
+static volatile uint16_t battery_mv = 0;
 
 void tracker_test(void) {
   errno_t err = ESUCCESS;
@@ -30,12 +72,70 @@ void tracker_test(void) {
   err = init();
   if (err) goto err_tag;
 
+  err = Device_wheel_find(&pdw_hl, DEVICE_WHEEL_HEAD_LEFT);
+  if (err) goto err_tag;
+  err = Device_wheel_find(&pdw_hr, DEVICE_WHEEL_HEAD_RIGHT);
+  if (err) goto err_tag;
+  err = Device_wheel_find(&pdw_tl, DEVICE_WHEEL_TAIL_LEFT);
+  if (err) goto err_tag;
+  err = Device_wheel_find(&pdw_tr, DEVICE_WHEEL_TAIL_RIGHT);
+  if (err) goto err_tag;
+  err = pdw_hl->ops->init(pdw_hl);
+  if (err) goto err_tag;
+  err = pdw_hr->ops->init(pdw_hr);
+  if (err) goto err_tag;
+  err = pdw_tl->ops->init(pdw_tl);
+  if (err) goto err_tag;
+  err = pdw_tr->ops->init(pdw_tr);
+  if (err) goto err_tag;
+  
+  err = Device_tracker_find(&pdt, DEVICE_TRACKER_1);
+  if (err) goto err_tag;
+  err = pdt->ops->init(pdt);
+  if (err) goto err_tag;
+  err = pid_init(&steering, &steering_param);
+  if (err) goto err_tag;
+
+  Device_USART *pdu = NULL;
+  err = Device_USART_find(&pdu, DEVICE_USART_DEBUG);
+  if (err) goto err_tag;
+  err = pdu->ops->init(pdu);
+  if (err) goto err_tag;
+
+  const Device_W25QX *pdf = NULL;
+  err = Device_W25QX_find(&pdf, DEVICE_W25Q64);
+  if (err) goto err_tag;
+  err = pdf->ops->init(pdf);
+  if (err) goto err_tag;
+
+  Device_power *pdp = NULL;
+  err = Device_power_find(&pdp, DEVICE_POWER_BATTERY);
+  if (err) goto err_tag;
+  err = pdp->ops->init(pdp);
+  if (err) goto err_tag;
+
+  err = Device_ultrasonic_find(&pdus, DEVICE_ULTRASONIC_1);
+  if (err) goto err_tag;
+  err = pdus->ops->init(pdus);
+  if (err) goto err_tag;
+  err = pdus->ops->start(pdus);
+  if (err) goto err_tag;
+
+  // 记录接在上次运行的记录后面
+  err = Device_recorder_find(&pdr, DEVICE_RECORDER_1);
+  if (err) goto err_tag;
+  err = pdr->ops->init(pdr);
+  if (err) goto err_tag;
+  err = pdr->ops->start(pdr);
+  if (err) goto err_tag;
+
+  // 所有设备就绪后再启动循迹控制定时器
   err = Device_timer_find(&pdtimer, DEVICE_TIMER_TIM6);
   if (err) goto err_tag;
   
   err = pdtimer->ops->set_period_elapsed_callback(pdtimer, callback);
   if (err) goto err_tag;
-  err = pdtimer->ops->set_period(pdtimer, 5000);
+  err = pdtimer->ops->set_period(pdtimer, CONTROL_PERIOD_US);
   if (err) goto err_tag;
   bool timer_running = false;
   err = pdtimer->ops->is_running(pdtimer, &timer_running);
@@ -45,26 +145,47 @@ void tracker_test(void) {
     if (err) goto err_tag;
   }
 
-  err = Device_motor_find(&pdm_hl, DEVICE_MOTOR_HEAD_LEFT);
-  if (err) goto err_tag;
-  err = Device_motor_find(&pdm_hr, DEVICE_MOTOR_HEAD_RIGHT);
-  if (err) goto err_tag;
-  err = Device_motor_find(&pdm_tl, DEVICE_MOTOR_TAIL_LEFT);
-  if (err) goto err_tag;
-  err = Device_motor_find(&pdm_tr, DEVICE_MOTOR_TAIL_RIGHT);
-  if (err) goto err_tag;
-  
-  err = Device_tracker_find(&pdt, DEVICE_TRACKER_1);
-  if (err) goto err_tag;
-  err = pdt->ops->init(pdt);
-  if (err) goto err_tag;
+  const Device_power_policy *policy = NULL;
+  Device_power_status power_status = {0};
+  uint32_t last_power_ms = 0;
+  uint32_t recorder_errors = 0;
 
   while (1) {
-    // uint8_t center = 0;
-    // err = pdt->ops->get_line_center(pdt, &center);
-    // if (err) goto err_tag;
-    // printf("tracker_value\r\nin line: %d\r\nline center: %d\r\n", (center & 0x80) >> 7, center & 0x7F);
-    // delay_s(1);
+    // 记录的页在后台写入 flash, 这里不会等待擦除或编程完成
+    // 写入失败只丢失这一页, 记录器下次重试, 打印后继续循迹
+    err = pdr->ops->poll(pdr);
+    if (err) printf("recorder poll err: %d, count: %lu\r\n", err, (unsigned long)++recorder_errors);
+
+    err = pdp->ops->get_policy(pdp, &policy);
+    if (err) goto err_tag;
+    if (now_ms() - last_power_ms >= policy->sensor_poll_ms) {
+      last_power_ms = now_ms();
+      err = pdp->ops->update(pdp);
+      if (err && err != ENODATA) goto err_tag;
+      if (err == ESUCCESS) {
+        err = pdp->ops->get_status(pdp, &power_status);
+        if (err) goto err_tag;
+        battery_mv = (uint16_t)power_status.voltage_mv;
+      }
+    }
+
+    uint8_t command = 0;
+    uint32_t command_len = 0;
+    err = pdu->ops->receive(pdu, &command, &command_len, 1);
+    if (err) goto err_tag;
+    if (command_len == 1 && command == DUMP_COMMAND) {
+      // 导出期间暂停记录, 循迹控制不受影响
+      err = pdr->ops->stop(pdr);
+      if (err) goto err_tag;
+      err = pdr->ops->dump(pdr, dump_sink, pdu);
+      if (err) goto err_tag;
+      uint32_t dropped = 0;
+      err = pdr->ops->get_dropped(pdr, &dropped);
+      if (err) goto err_tag;
+      printf("\r\nrecorder dump end, dropped: %lu\r\n", (unsigned long)dropped);
+      err = pdr->ops->start(pdr);
+      if (err) goto err_tag;
+    }
   }
 
   err_tag:
@@ -100,6 +221,24 @@ static errno_t init(void) {
   
   err = Device_config_tracker_register();
   if (err) return err;
+  
+  err = Device_config_wheel_register();
+  if (err) return err;
+
+  err = Device_config_W25QX_register();
+  if (err) return err;
+
+  err = Device_config_ADC_register();
+  if (err) return err;
+
+  err = Device_config_power_register();
+  if (err) return err;
+
+  err = Device_config_ultrasonic_register();
+  if (err) return err;
+
+  err = Device_config_recorder_register();
+  if (err) return err;
 
   return ESUCCESS;
 }
@@ -107,132 +246,90 @@ static errno_t init(void) {
 static errno_t callback(void) {
   errno_t err = ESUCCESS;
 
-  uint8_t center = 0;
-  err = pdt->ops->get_line_center(pdt, &center);
-  if (err) return err;
+  Device_tracker_line line = {0};
+  err = pdt->ops->get_line(pdt, &line);
+  if (err) goto cb_err_tag;
+
+  err = record(&line);
+  if (err) goto cb_err_tag;
 
-  if ((center & 0x80) == 0) {
-    // 未检查到导航线
-    err = pdm_hl->ops->stop(pdm_hl);
+  // 丢线超时, 停车
+  if (line.status == DEVICE_TRACKER_LINE_LOST && line.lost_ms > LOST_TIMEOUT_MS) {
+    err = pdw_hl->ops->stop(pdw_hl);
     if (err) goto cb_err_tag;
-    err = pdm_tl->ops->stop(pdm_tl);
+    err = pdw_tl->ops->stop(pdw_tl);
     if (err) goto cb_err_tag;
-    err = pdm_hr->ops->stop(pdm_hr);
+    err = pdw_hr->ops->stop(pdw_hr);
     if (err) goto cb_err_tag;
-    err = pdm_tr->ops->stop(pdm_tr);
+    err = pdw_tr->ops->stop(pdw_tr);
     if (err) goto cb_err_tag;
-  } else {
-    switch (center & 0x7F) {
-      case 0: {
-        // 导航线在最左边
-        err = pdm_hl->ops->backward(pdm_hl, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tl->ops->backward(pdm_tl, 0xFF);
-        if (err) goto cb_err_tag;
-
-        err = pdm_hr->ops->forward(pdm_hr, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tr->ops->forward(pdm_tr, 0xFF);
-        if (err) goto cb_err_tag;
-
-        break;
-      }
-      case 1: {
-        // 导航线在从左往右第二个
-        err = pdm_hl->ops->stop(pdm_hl);
-        if (err) goto cb_err_tag;
-        err = pdm_tl->ops->stop(pdm_tl);
-        if (err) goto cb_err_tag;
-
-        err = pdm_hr->ops->forward(pdm_hr, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tr->ops->forward(pdm_tr, 0xFF);
-        if (err) goto cb_err_tag;
-
-        break;
-      }
-      case 2: {
-        // 导航线在从左往右第三个
-        err = pdm_hl->ops->forward(pdm_hl, 0x80);
-        if (err) goto cb_err_tag;
-        err = pdm_tl->ops->forward(pdm_tl, 0x80);
-        if (err) goto cb_err_tag;
-
-        err = pdm_hr->ops->forward(pdm_hr, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tr->ops->forward(pdm_tr, 0xFF);
-        if (err) goto cb_err_tag;
-
-        break;
-      }
-      case 3: {
-        // 导航线在中间
-        err = pdm_hl->ops->forward(pdm_hl, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tl->ops->forward(pdm_tl, 0xFF);
-        if (err) goto cb_err_tag;
-
-        err = pdm_hr->ops->forward(pdm_hr, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tr->ops->forward(pdm_tr, 0xFF);
-        if (err) goto cb_err_tag;
-
-        break;
-      }
-      case 4: {
-        // 导航线在从右往左第三个
-        err = pdm_hl->ops->forward(pdm_hl, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tl->ops->forward(pdm_tl, 0xFF);
-        if (err) goto cb_err_tag;
-
-        err = pdm_hr->ops->forward(pdm_hr, 0x80);
-        if (err) goto cb_err_tag;
-        err = pdm_tr->ops->forward(pdm_tr, 0x80);
-        if (err) goto cb_err_tag;
-
-        break;
-      }
-      case 5: {
-        // 导航线在从右往左第二个
-        err = pdm_hl->ops->forward(pdm_hl, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tl->ops->forward(pdm_tl, 0xFF);
-        if (err) goto cb_err_tag;
-
-        err = pdm_hr->ops->stop(pdm_hr);
-        if (err) goto cb_err_tag;
-        err = pdm_tr->ops->stop(pdm_tr);
-        if (err) goto cb_err_tag;
-
-        break;
-      }
-      case 6: {
-        // 导航线在最右边
-        err = pdm_hl->ops->forward(pdm_hl, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tl->ops->forward(pdm_tl, 0xFF);
-        if (err) goto cb_err_tag;
-
-        err = pdm_hr->ops->backward(pdm_hr, 0xFF);
-        if (err) goto cb_err_tag;
-        err = pdm_tr->ops->backward(pdm_tr, 0xFF);
-        if (err) goto cb_err_tag;
-
-        break;
-      }
-      default: {
-        goto cb_err_tag;
-      }
-    }
+    return ESUCCESS;
   }
 
+  // 目标位置为 0(导航线在正中), 输出为两侧车轮的转速差, 导航线偏右时输出为负
+  int32_t turn = 0;
+  err = pid_update(&steering, 0, line.position, &turn);
+  if (err) goto cb_err_tag;
+
+  // 丢线或偏离较大时降低基础速度
+  const int32_t base = line.status == DEVICE_TRACKER_LINE_LOST ? RPM_SLOW : RPM_FAST;
+  const int32_t left = base - turn, right = base + turn;
+
+  err = pdw_hl->ops->set_target(pdw_hl, left);
+  if (err) goto cb_err_tag;
+  err = pdw_tl->ops->set_target(pdw_tl, left);
+  if (err) goto cb_err_tag;
+  err = pdw_hr->ops->set_target(pdw_hr, right);
+  if (err) goto cb_err_tag;
+  err = pdw_tr->ops->set_target(pdw_tr, right);
+  if (err) goto cb_err_tag;
+
   return ESUCCESS;
 
   cb_err_tag:
-  err = pdm_hl->ops->stop(pdm_hl);
-  err = pdm_tl->ops->stop(pdm_tl);
-  err = pdm_hr->ops->stop(pdm_hr);
-  err = pdm_tr->ops->stop(pdm_tr);
+  err = pdw_hl->ops->stop(pdw_hl);
+  err = pdw_tl->ops->stop(pdw_tl);
+  err = pdw_hr->ops->stop(pdw_hr);
+  err = pdw_tr->ops->stop(pdw_tr);
   return EIO;
 }
+
+static errno_t record(const Device_tracker_line *const pl) {
+  static uint8_t divider = 0;
+  if (++divider < RECORD_DIVIDER) return ESUCCESS;
+  divider = 0;
+
+  errno_t err = ESUCCESS;
+  Device_wheel *const wheels[4] = {pdw_hl, pdw_hr, pdw_tl, pdw_tr};
+  Device_recorder_sample sample = {0};
+
+  for (uint8_t i = 0; i < 4; ++i) {
+    int32_t rpm = 0, target = 0;
+    err = wheels[i]->ops->get_rpm(wheels[i], &rpm);
+    if (err) return err;
+    err = wheels[i]->ops->get_target(wheels[i], &target);
+    if (err) return err;
+    sample.wheel_rpm[i] = (int16_t)(rpm / 10);
+    sample.wheel_target[i] = (int16_t)(target / 10);
+  }
+
+  sample.tracker_raw = pl->raw;
+  sample.tracker_status = (uint8_t)pl->status;
+  sample.tracker_position = pl->position;
+
+  uint32_t distance = 0;
+  err = pdus->ops->read(pdus, &distance);
+  if (err == ESUCCESS) sample.distance_mm = (uint16_t)(distance / 10);
+  sample.battery_mv = battery_mv;
+
+  // 缓冲区满或导出期间丢弃样本, 不影响控制
+  err = pdr->ops->record(pdr, &sample);
+  if (err && err != ENOBUFS && err != EPERM) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t dump_sink(void *arg, const uint8_t *data, uint32_t len) {
+  const Device_USART *const pdu = arg;
+  return pdu->ops->transmit(pdu, (uint8_t *)data, len);
+}
@@ -47,10 +47,14 @@ void ultrasonic_test() {
   if (err) goto print_err_tag;
   err = pdu->ops->init(pdu);
   if (err) goto print_err_tag;
+  // 后台连续测距, read 直接返回滤波后的最新结果
+  err = pdu->ops->start(pdu);
+  if (err) goto print_err_tag;
 
   while (1) {
     uint32_t data = 0;
     err = pdu->ops->read(pdu, &data);
+    if (err == ENODATA) continue;
     if (err) goto print_err_tag;
     uint8_t str[50] = {0};
     snprintf((char *)str, 50, "distance: %" PRIu32 ".%02" PRIu32, data / 100, data % 100);
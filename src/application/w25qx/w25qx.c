@@ -11,8 +11,21 @@
 #include "device_config/spi/spi.h"
 #include "device/w25qx/w25qx.h"
 #include "device_config/w25qx/w25qx.h"
+#include "device_config/timer/timer.h"
+#include "common/timebase/timebase.h"
+
+// 异步操作测试地址, 不与同步读写测试的范围重叠
+#define ASYNC_TEST_ADDR 0x10000
+// 读取速度测试, 每次读取的长度超过一次 DMA 的上限(0xFFFF), 缓冲放在外部 SRAM
+#define BENCH_BLOCK_SIZE 0x20000
+#define BENCH_TOTAL_SIZE 0x100000
 
 static errno_t init(void);
+static void async_done(void *arg, errno_t err);
+
+static volatile bool async_finished = false;
+static volatile errno_t async_err = ESUCCESS;
+static uint8_t __attribute__((section(".fmc_sram"))) bench_buffer[BENCH_BLOCK_SIZE];
 
 void w25q64_test() {
   errno_t err = init();
@@ -45,6 +58,50 @@ void w25q64_test() {
   printf("read success\r\n");
   printf("read content: %s\r\n", g_r_data);
 
+  // 异步擦除和编程期间主循环继续运行
+  uint32_t idle_loops = 0;
+  async_finished = false;
+  err = pw->ops->erase_async(pw, ASYNC_TEST_ADDR, 2, async_done, NULL);
+  if (err) {
+    printf("erase_async fail: %d\r\n", err);
+    return;
+  }
+  while (async_finished == false) ++idle_loops;
+  printf("erase_async done: %d, idle loops: %lu\r\n", async_err, (unsigned long)idle_loops);
+
+  static const uint8_t async_data[] = "async program across page boundary";
+  idle_loops = 0;
+  async_finished = false;
+  err = pw->ops->program_async(pw, ASYNC_TEST_ADDR + 0xF0, async_data, sizeof(async_data), async_done, NULL);
+  if (err) {
+    printf("program_async fail: %d\r\n", err);
+    return;
+  }
+  while (async_finished == false) ++idle_loops;
+  printf("program_async done: %d, idle loops: %lu\r\n", async_err, (unsigned long)idle_loops);
+
+  err = pw->ops->read(pw, ASYNC_TEST_ADDR + 0xF0, g_r_data, sizeof(async_data));
+  if (err) {
+    printf("read fail: %d\r\n", err);
+    return;
+  }
+  printf("read content: %s\r\n", g_r_data);
+
+  err = timebase_init();
+  if (err) return;
+  const uint32_t begin_us = now_us();
+  for (uint32_t addr = 0; addr < BENCH_TOTAL_SIZE; addr += BENCH_BLOCK_SIZE) {
+    err = pw->ops->read(pw, addr, bench_buffer, BENCH_BLOCK_SIZE);
+    if (err) {
+      printf("bench read fail: %d\r\n", err);
+      return;
+    }
+  }
+  const uint32_t elapsed_us = timebase_elapsed_us(begin_us);
+  // 字节数 / 微秒 即为 MB/s, 保留两位小数
+  const uint32_t kb_per_s = (uint32_t)((uint64_t)BENCH_TOTAL_SIZE * 1000 / elapsed_us);
+  printf("read %u bytes in %lu us, %lu.%02lu MB/s\r\n", BENCH_TOTAL_SIZE, (unsigned long)elapsed_us, (unsigned long)(kb_per_s / 1000), (unsigned long)(kb_per_s % 1000 / 10));
+
   while (1) {
   
   }
@@ -61,6 +118,10 @@ static errno_t init(void) {
   err = Device_config_USART_register();
   if (err) return err;
 
+  // 异步操作使用软件定时器查询状态
+  err = Device_config_timer_register();
+  if (err) goto print_err_tag;
+
   err = Device_GPIO_module_init();
   if (err) goto print_err_tag;
 
@@ -85,3 +146,8 @@ static errno_t init(void) {
   printf("w25q64 test err\r\nerr: %d", err);
   return err;
 }
+
+static void async_done(void *arg, errno_t err) {
+  async_err = err;
+  async_finished = true;
+}
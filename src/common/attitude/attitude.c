@@ -0,0 +1,176 @@
+#include "attitude.h"
+#include <stddef.h>
+
+// 圆周率, Q29
+#define PI_Q29 1686629713LL
+// 180 度, Q32
+#define HALF_TURN ((int64_t)180 << 32)
+// 加速度模长在 0.9g ~ 1.1g 之间时才用于修正, 以平方比较, 单位为 1/100
+#define ACCEL_NORM_MIN 81
+#define ACCEL_NORM_MAX 121
+
+static bool accel_valid(const Attitude *const pa, const int16_t accel[ATTITUDE_AXIS_COUNT]);
+static void normalize(int32_t v[ATTITUDE_AXIS_COUNT]);
+static int64_t wrap_heading(int64_t heading);
+
+errno_t attitude_init(Attitude *const pa, const Attitude_param *const param, uint32_t sample_period_us, q16_t gyro_lsb_per_dps, int32_t accel_lsb_per_g) {
+  if (pa == NULL || param == NULL) return EINVAL;
+  if (sample_period_us == 0 || sample_period_us > 1000000 || gyro_lsb_per_dps <= 0) return EINVAL;
+  if (accel_lsb_per_g <= 0 || (accel_lsb_per_g & (accel_lsb_per_g - 1)) != 0 || accel_lsb_per_g > (1 << 30)) return EINVAL;
+  if (param->calibration_samples == 0 || param->accel_shift > 30 || param->bias_shift > 30) return EINVAL;
+
+  pa->param = param;
+
+  // 只在初始化时做除法: 2^48 * 周期 / 1000000 / 灵敏度, 其中 1000000 = 15625 * 2^6
+  pa->heading_gain = ((int64_t)1 << 42) * sample_period_us / 15625 / gyro_lsb_per_dps;
+  // 乘以 pi / 180 * 2^14, 由 Q32 度换算为 Q30 弧度, 右移位数由 16 变为 32
+  pa->rotate_gain = pa->heading_gain * PI_Q29 / 180 >> 15;
+  if (pa->heading_gain == 0 || pa->rotate_gain == 0) return EINVAL;
+
+  pa->gyro_lsb_per_dps = gyro_lsb_per_dps;
+  pa->still_rate = (int64_t)param->still_dps * gyro_lsb_per_dps >> 16;
+  pa->accel_lsb_per_g_square = (int64_t)accel_lsb_per_g * accel_lsb_per_g;
+  pa->accel_to_q30_shift = 30 - __builtin_ctz(accel_lsb_per_g);
+
+  attitude_reset(pa);
+
+  return ESUCCESS;
+}
+
+void attitude_reset(Attitude *const pa) {
+  for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) {
+    pa->up[i] = 0;
+    pa->bias[i] = 0;
+    pa->calibration_sum[i] = 0;
+    pa->calibration_accel_sum[i] = 0;
+  }
+  pa->up[2] = 1 << 30;
+  pa->calibration_count = 0;
+  pa->still_count = 0;
+  pa->ready = false;
+  pa->heading = 0;
+  pa->yaw_rate = 0;
+}
+
+void attitude_set_heading(Attitude *const pa, q16_t heading) {
+  pa->heading = wrap_heading((int64_t)heading << 16);
+}
+
+/**
+ * @brief 输入一个采样
+ * 标定阶段累加角速度和加速度, 结束后以平均值作为零偏和初始重力方向
+ * 之后每个采样: 重力方向按角速度旋转 up += up x angle, 加速度有效时向加速度方向修正, 再归一化
+ * 航向角速度为 up . rate, 积分得到航向; 连续静止时以一阶低通跟踪零偏, 抵消温漂
+ * @param accel 加速度原始值
+ * @param gyro 角速度原始值
+ */
+void attitude_update(Attitude *const pa, const int16_t accel[ATTITUDE_AXIS_COUNT], const int16_t gyro[ATTITUDE_AXIS_COUNT]) {
+  const Attitude_param *const param = pa->param;
+  const bool accel_ok = accel_valid(pa, accel);
+
+  if (pa->ready == false) {
+    // 标定期间被移动(加速度异常)时重新开始
+    if (accel_ok == false) {
+      pa->calibration_count = 0;
+      for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) {
+        pa->calibration_sum[i] = 0;
+        pa->calibration_accel_sum[i] = 0;
+      }
+      return;
+    }
+
+    for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) {
+      pa->calibration_sum[i] += gyro[i];
+      pa->calibration_accel_sum[i] += accel[i];
+    }
+    if (++pa->calibration_count < param->calibration_samples) return;
+
+    for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) {
+      pa->bias[i] = (int32_t)((pa->calibration_sum[i] << 16) / pa->calibration_count);
+      pa->up[i] = (int32_t)((pa->calibration_accel_sum[i] << pa->accel_to_q30_shift) / pa->calibration_count);
+    }
+    // 模长在 0.9 ~ 1.1 之间, 几次迭代即可收敛
+    for (uint8_t i = 0; i < 4; ++i) normalize(pa->up);
+    pa->ready = true;
+    return;
+  }
+
+  // 减去零偏后的角速度, Q16 LSB
+  int64_t rate[ATTITUDE_AXIS_COUNT] = {0};
+  int64_t rate_max = 0;
+  for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) {
+    rate[i] = ((int64_t)gyro[i] << 16) - pa->bias[i];
+    const int64_t rate_abs = rate[i] < 0 ? -rate[i] : rate[i];
+    if (rate_abs > rate_max) rate_max = rate_abs;
+  }
+
+  // 本采样周期内的旋转角度, Q30 弧度
+  int64_t angle[ATTITUDE_AXIS_COUNT] = {0};
+  for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) angle[i] = rate[i] * pa->rotate_gain >> 32;
+
+  const int64_t u0 = pa->up[0], u1 = pa->up[1], u2 = pa->up[2];
+  pa->up[0] = (int32_t)(u0 + ((u1 * angle[2] - u2 * angle[1]) >> 30));
+  pa->up[1] = (int32_t)(u1 + ((u2 * angle[0] - u0 * angle[2]) >> 30));
+  pa->up[2] = (int32_t)(u2 + ((u0 * angle[1] - u1 * angle[0]) >> 30));
+
+  if (accel_ok) {
+    for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) {
+      const int64_t measure = (int64_t)accel[i] << pa->accel_to_q30_shift;
+      pa->up[i] += (int32_t)((measure - pa->up[i]) >> param->accel_shift);
+    }
+  }
+  normalize(pa->up);
+
+  const int64_t yaw_rate = ((int64_t)pa->up[0] * rate[0] + (int64_t)pa->up[1] * rate[1] + (int64_t)pa->up[2] * rate[2]) >> 30;
+  pa->yaw_rate = yaw_rate > INT32_MAX ? INT32_MAX : (yaw_rate < INT32_MIN ? INT32_MIN : (int32_t)yaw_rate);
+  pa->heading = wrap_heading(pa->heading + (yaw_rate * pa->heading_gain >> 16));
+
+  if (rate_max < pa->still_rate && accel_ok) {
+    if (pa->still_count < param->still_samples) {
+      ++pa->still_count;
+    } else {
+      for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) pa->bias[i] += (int32_t)(rate[i] >> param->bias_shift);
+    }
+  } else {
+    pa->still_count = 0;
+  }
+}
+
+bool attitude_ready(const Attitude *const pa) {
+  return pa->ready;
+}
+
+bool attitude_still(const Attitude *const pa) {
+  return pa->ready && pa->still_count >= pa->param->still_samples;
+}
+
+q16_t attitude_get_heading(const Attitude *const pa) {
+  return (q16_t)(pa->heading >> 16);
+}
+
+q16_t attitude_get_yaw_rate(const Attitude *const pa) {
+  return (q16_t)(((int64_t)pa->yaw_rate << 16) / pa->gyro_lsb_per_dps);
+}
+
+q16_t attitude_heading_diff(q16_t target, q16_t heading) {
+  return (q16_t)(wrap_heading(((int64_t)target - heading) << 16) >> 16);
+}
+
+static bool accel_valid(const Attitude *const pa, const int16_t accel[ATTITUDE_AXIS_COUNT]) {
+  const int64_t norm_square = (int64_t)accel[0] * accel[0] + (int64_t)accel[1] * accel[1] + (int64_t)accel[2] * accel[2];
+  return norm_square * 100 >= pa->accel_lsb_per_g_square * ACCEL_NORM_MIN
+    && norm_square * 100 <= pa->accel_lsb_per_g_square * ACCEL_NORM_MAX;
+}
+
+// 牛顿迭代一步 v = v * (3 - |v|^2) / 2, 模长接近 1 时不需要开方
+static void normalize(int32_t v[ATTITUDE_AXIS_COUNT]) {
+  const int64_t norm_square = ((int64_t)v[0] * v[0] + (int64_t)v[1] * v[1] + (int64_t)v[2] * v[2]) >> 30;
+  const int64_t factor = ((int64_t)3 << 30) - norm_square;
+  for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) v[i] = (int32_t)((int64_t)v[i] * factor >> 31);
+}
+
+static int64_t wrap_heading(int64_t heading) {
+  while (heading >= HALF_TURN) heading -= 2 * HALF_TURN;
+  while (heading < -HALF_TURN) heading += 2 * HALF_TURN;
+  return heading;
+}
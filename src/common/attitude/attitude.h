@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/errno/errno.h"
+#include "common/pid/pid.h"
+
+#define ATTITUDE_AXIS_COUNT 3
+
+/**
+ * @brief 姿态融合参数
+ * 加速度修正和零偏跟踪都是一阶低通, 系数为 1 / 2^shift, 时间常数约为 2^shift 个采样周期
+ */
+typedef struct {
+  uint8_t accel_shift; // 加速度修正重力方向的系数
+  uint8_t bias_shift; // 静止时零偏跟踪的系数
+  q16_t still_dps; // 各轴角速度(已减去零偏)都小于该值时认为静止, 单位为度/秒
+  uint16_t still_samples; // 连续静止这么多个采样后开始跟踪零偏
+  uint16_t calibration_samples; // 启动后取平均值作为初始零偏的采样数, 期间需要保持静止
+} Attitude_param;
+
+/**
+ * @brief 航向融合
+ * 小车没有磁力计, 航向由陀螺仪积分得到, 加速度计只用于估计重力方向:
+ * 重力方向(机体坐标系中的单位向量)按角速度旋转, 再以加速度计的测量值做互补修正
+ * 航向角速度为角速度在重力方向上的投影, 传感器倾斜安装或车身倾斜时不需要额外标定
+ * 全部为定点运算, 不调用三角函数和开方
+ */
+typedef struct {
+  const Attitude_param *param;
+  // 初始化时换算的系数, 角速度为 Q16 LSB
+  int64_t heading_gain; // 乘以角速度后右移 16 位, 得到每个采样的航向变化, Q32 度
+  int64_t rotate_gain; // 乘以角速度后右移 32 位, 得到每个采样的旋转角度, Q30 弧度
+  q16_t gyro_lsb_per_dps;
+  int64_t still_rate; // 静止阈值, Q16 LSB
+  int64_t accel_lsb_per_g_square;
+  uint8_t accel_to_q30_shift;
+  // 重力方向, Q30
+  int32_t up[ATTITUDE_AXIS_COUNT];
+  // 零偏, Q16 LSB
+  int32_t bias[ATTITUDE_AXIS_COUNT];
+  int64_t calibration_sum[ATTITUDE_AXIS_COUNT];
+  int64_t calibration_accel_sum[ATTITUDE_AXIS_COUNT];
+  uint16_t calibration_count;
+  uint16_t still_count;
+  bool ready;
+  // 航向, Q32 度, 范围 [-180, 180)
+  int64_t heading;
+  // 航向角速度, Q16 LSB
+  int32_t yaw_rate;
+} Attitude;
+
+/**
+ * @brief 初始化
+ * @param sample_period_us 采样周期
+ * @param gyro_lsb_per_dps 陀螺仪灵敏度, Q16
+ * @param accel_lsb_per_g 加速度计灵敏度, 必须是 2 的幂
+ */
+errno_t attitude_init(Attitude *const pa, const Attitude_param *const param, uint32_t sample_period_us, q16_t gyro_lsb_per_dps, int32_t accel_lsb_per_g);
+// 重新标定零偏, 航向清零
+void attitude_reset(Attitude *const pa);
+// 设置当前航向, Q16 度
+void attitude_set_heading(Attitude *const pa, q16_t heading);
+// 输入一个采样, 均为传感器原始值
+void attitude_update(Attitude *const pa, const int16_t accel[ATTITUDE_AXIS_COUNT], const int16_t gyro[ATTITUDE_AXIS_COUNT]);
+bool attitude_ready(const Attitude *const pa);
+bool attitude_still(const Attitude *const pa);
+// 航向, Q16 度, 逆时针为正, 范围 [-180, 180)
+q16_t attitude_get_heading(const Attitude *const pa);
+// 航向角速度, Q16 度/秒, 逆时针为正
+q16_t attitude_get_yaw_rate(const Attitude *const pa);
+// 航向差 target - heading, 归一化到 [-180, 180), Q16 度
+q16_t attitude_heading_diff(q16_t target, q16_t heading);
@@ -0,0 +1,41 @@
+#include "base64.h"
+#include <stdlib.h>
+
+// 返回字符对应的 6 位值, 非法字符返回 -1
+static int8_t decode_char(char c);
+
+errno_t base64_decode(const char *str, uint32_t str_len, uint8_t *data, uint32_t data_size, uint32_t *rt_len_ptr) {
+  if (str == NULL || data == NULL || rt_len_ptr == NULL) return EINVAL;
+  if (str_len % 4 != 0) return EBADMSG;
+
+  uint32_t len = 0;
+  for (uint32_t i = 0; i < str_len; i += 4) {
+    // 只有最后一组可以有填充
+    const uint8_t pad = (str[i + 3] == '=') + (str[i + 2] == '=');
+    if (pad > 0 && i + 4 != str_len) return EBADMSG;
+    if (pad == 1 && str[i + 2] == '=') return EBADMSG;
+
+    uint32_t group = 0;
+    for (uint8_t j = 0; j < 4 - pad; ++j) {
+      const int8_t value = decode_char(str[i + j]);
+      if (value < 0) return EBADMSG;
+      group |= (uint32_t)value << (18 - j * 6);
+    }
+
+    const uint8_t count = 3 - pad;
+    if (data_size - len < count) return EOVERFLOW;
+    for (uint8_t j = 0; j < count; ++j) data[len++] = group >> (16 - j * 8);
+  }
+
+  *rt_len_ptr = len;
+  return ESUCCESS;
+}
+
+static int8_t decode_char(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include <stdint.h>
+
+/**
+ * @brief 解码 Base64 (RFC 4648 标准字母表, 带 = 填充)
+ * 用于通过文本通道(如 AT 指令)传输二进制数据, 编码后不含 \r \n
+ * @param str 编码后的字符串, 长度必须是 4 的倍数
+ * @param str_len
+ * @param data 输出缓冲
+ * @param data_size 输出缓冲大小, 不足时返回 EOVERFLOW
+ * @param rt_len_ptr 解码后的字节数
+ * @return errno_t 含有非法字符时返回 EBADMSG
+ */
+errno_t base64_decode(const char *str, uint32_t str_len, uint8_t *data, uint32_t data_size, uint32_t *rt_len_ptr);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief CRC-32 (IEEE 802.3, 与 zlib 相同)
+ * 可以分段计算, 第一段传入 0, 之后传入上一段的结果
+ * @param crc 上一段的结果
+ * @param data 
+ * @param len 
+ * @return uint32_t 
+ */
+uint32_t crc32(uint32_t crc, const void *data, uint32_t len);
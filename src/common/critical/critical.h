@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include "stm32f4xx_hal.h"
+
+/**
+ * @brief 关中断进入临界区, 返回进入前的 PRIMASK
+ * 可以嵌套, 退出时只有进入前中断是打开的才重新打开
+ * @return uint32_t 
+ */
+static inline uint32_t enter_critical(void) {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void exit_critical(uint32_t primask) {
+  if (!primask) __enable_irq();
+}
@@ -0,0 +1,87 @@
+#include "pid.h"
+#include <stddef.h>
+
+static int64_t clamp(int64_t value, int64_t min, int64_t max);
+
+errno_t pid_init(Pid *const pp, const Pid_param *const param) {
+  if (pp == NULL || param == NULL) return EINVAL;
+  if (param->out_min > param->out_max) return EINVAL;
+
+  pp->param = param;
+  pp->out_min = param->out_min;
+  pp->out_max = param->out_max;
+  pid_reset(pp);
+
+  return ESUCCESS;
+}
+
+void pid_reset(Pid *const pp) {
+  pp->integral = 0;
+  pp->last_measure = 0;
+  pp->last_target = 0;
+  pp->output = 0;
+}
+
+/**
+ * @brief 设置当前的输出范围, 超出参数中范围的部分按参数中的范围
+ * 执行机构的输出被外部限制时(例如电源管理限制占空比)需同步设置, 否则输出到不了饱和值, 积分项会一直累加
+ * @param out_min
+ * @param out_max
+ * @return errno_t
+ */
+errno_t pid_set_output_limit(Pid *const pp, int32_t out_min, int32_t out_max) {
+  if (pp == NULL || pp->param == NULL || out_min > out_max) return EINVAL;
+
+  pp->out_min = (int32_t)clamp(out_min, pp->param->out_min, pp->param->out_max);
+  pp->out_max = (int32_t)clamp(out_max, pp->param->out_min, pp->param->out_max);
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 执行一次 PID 运算, 需以固定周期调用
+ * 微分项作用于测量值, 避免目标值突变时的微分冲击
+ * 抗积分饱和: 积分项限制在当前的输出范围内, 且输出饱和时不再向饱和方向积分
+ * @param target 目标值
+ * @param measure 测量值
+ * @param rt_output_ptr 返回限幅后的输出
+ */
+errno_t pid_update(Pid *const pp, int32_t target, int32_t measure, int32_t *rt_output_ptr) {
+  if (pp == NULL || pp->param == NULL || rt_output_ptr == NULL) return EINVAL;
+
+  const Pid_param *const param = pp->param;
+  const int64_t out_min = (int64_t)pp->out_min << Q16_SHIFT;
+  const int64_t out_max = (int64_t)pp->out_max << Q16_SHIFT;
+  const int32_t error = target - measure;
+
+  // 前馈
+  int64_t ff = (int64_t)param->kff * target;
+  if (target > 0) ff += (int64_t)param->ff_offset << Q16_SHIFT;
+  else if (target < 0) ff -= (int64_t)param->ff_offset << Q16_SHIFT;
+  ff += (int64_t)param->kaff * (target - pp->last_target);
+  pp->last_target = target;
+
+  const int64_t p = (int64_t)param->kp * error;
+  const int64_t d = -(int64_t)param->kd * (measure - pp->last_measure);
+  pp->last_measure = measure;
+
+  // 条件积分: 上次输出已饱和且误差仍推向饱和方向时, 不再累加
+  const bool saturated_high = pp->output >= pp->out_max && error > 0;
+  const bool saturated_low = pp->output <= pp->out_min && error < 0;
+  if (!saturated_high && !saturated_low) {
+    pp->integral = clamp(pp->integral + (int64_t)param->ki * error, out_min, out_max);
+  }
+
+  const int64_t sum = clamp(ff + p + pp->integral + d, out_min, out_max);
+  pp->output = (int32_t)(sum >> Q16_SHIFT);
+
+  *rt_output_ptr = pp->output;
+
+  return ESUCCESS;
+}
+
+static int64_t clamp(int64_t value, int64_t min, int64_t max) {
+  if (value < min) return min;
+  if (value > max) return max;
+  return value;
+}
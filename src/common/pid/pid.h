@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/errno/errno.h"
+
+// Q16.16 定点数
+typedef int32_t q16_t;
+
+#define Q16_SHIFT 16
+#define Q16_ONE ((q16_t)1 << Q16_SHIFT)
+// 用于常量初始化, 例如 Q16_FROM_FLOAT(0.5)
+#define Q16_FROM_FLOAT(x) ((q16_t)((x) * Q16_ONE))
+
+/**
+ * @brief PID 参数, 增益均为 Q16.16 定点数
+ * ki 为每次更新的积分增益(已包含采样周期), kd 为每次更新的微分增益
+ */
+typedef struct {
+  q16_t kp;
+  q16_t ki;
+  q16_t kd;
+  q16_t kff; // 前馈增益, 输出 += kff * 目标值
+  q16_t kaff; // 目标变化率前馈, 输出 += kaff * 本次与上次目标值之差, 补偿跟随斜坡时的惯性
+  int32_t ff_offset; // 前馈偏置(克服静摩擦), 目标值非 0 时按目标值符号叠加
+  int32_t out_min;
+  int32_t out_max;
+} Pid_param;
+
+typedef struct {
+  const Pid_param *param;
+  int64_t integral; // Q16.16, 已限制在输出范围内
+  int32_t last_measure;
+  int32_t last_target;
+  int32_t output;
+  // 当前的输出范围, 初始化为参数中的范围, 执行机构的实际上限变化时由 pid_set_output_limit 收窄
+  int32_t out_min;
+  int32_t out_max;
+} Pid;
+
+errno_t pid_init(Pid *const pp, const Pid_param *const param);
+void pid_reset(Pid *const pp);
+errno_t pid_set_output_limit(Pid *const pp, int32_t out_min, int32_t out_max);
+errno_t pid_update(Pid *const pp, int32_t target, int32_t measure, int32_t *rt_output_ptr);
@@ -0,0 +1,229 @@
+#include "timebase.h"
+#include "common/critical/critical.h"
+#include <stdlib.h>
+#include "stm32f4xx_hal.h"
+#include "device/timer/timer.h"
+
+#define WHEEL_SLOT_MASK (TIMEBASE_WHEEL_SLOT_NUM - 1)
+
+// 内部方法
+// 把定时器挂到对应槽位, 调用方需保证处于临界区
+static void wheel_insert(Timebase_timer *const pt);
+// 把定时器从槽位中摘除, 调用方需保证处于临界区
+static void wheel_remove(Timebase_timer *const pt);
+// 处理某一个节拍对应槽位中的定时器
+static void wheel_process(uint32_t tick);
+// 推进时间轮
+static void timebase_tick(void);
+
+// TIM2 计数寄存器(32 位), 初始化后以 1MHz 自由运行, 不再被任何模块重新配置
+static volatile uint32_t *count_register = NULL;
+
+static Timebase_timer *wheel_slots[TIMEBASE_WHEEL_SLOT_NUM] = {0};
+// 正在处理的槽位中剩余的定时器
+static Timebase_timer *processing_list = NULL;
+// 时间轮已经处理到的节拍
+static volatile uint32_t wheel_tick = 0;
+
+/**
+ * @brief 初始化时间基准
+ * 使用 TIM2(计数寄存器 32 位), 每微秒计数加 1, 计满 0xFFFFFFFF 后自然回绕(约 71 分钟)
+ * 只在第一次调用时配置定时器, 之后重复调用直接返回, 需要先注册 timer 模块
+ * @return 错误信息
+ */
+errno_t timebase_init(void) {
+  if (count_register != NULL) return ESUCCESS;
+
+  Device_timer *pdt = NULL;
+  errno_t err = Device_timer_find(&pdt, DEVICE_TIMER_TIM2);
+  if (err) return err;
+
+  bool running = false;
+  err = pdt->ops->is_running(pdt, &running);
+  if (err) return err;
+  if (running) {
+    err = pdt->ops->stop(pdt);
+    if (err) return err;
+  }
+
+  err = pdt->ops->set_time_for_count_incr(pdt, 1);
+  if (err) return err;
+
+  // TIM2 和 TIM5 才有 32 位寄存器
+  err = pdt->ops->set_auto_reload_register(pdt, 0xFFFFFFFF);
+  if (err) return err;
+
+  // 不开启溢出中断, 读取时间只需要读一次寄存器
+  err = pdt->ops->start(pdt, DEVICE_TIMER_START_MODE_NO_IT);
+  if (err) return err;
+
+  count_register = &((TIM_HandleTypeDef *)pdt->instance)->Instance->CNT;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 获取单调递增的微秒时间, 32 位回绕, 比较时间请使用无符号减法
+ * 未初始化时返回 0
+ */
+uint32_t now_us(void) {
+  if (count_register == NULL) return 0;
+  return *count_register;
+}
+
+/**
+ * @brief 获取毫秒时间(SysTick), 32 位回绕
+ */
+uint32_t now_ms(void) {
+  return HAL_GetTick();
+}
+
+/**
+ * @brief 计算从 begin_us 到现在经过的微秒数, 回绕时结果依然正确
+ */
+uint32_t timebase_elapsed_us(uint32_t begin_us) {
+  return now_us() - begin_us;
+}
+
+/**
+ * @brief 设置截止时间
+ * @param rt_deadline_ptr 返回截止时间点
+ * @param timeout_us 从现在开始的超时时间, 不能超过 0x7FFFFFFF
+ */
+void timebase_deadline_set(uint32_t *rt_deadline_ptr, uint32_t timeout_us) {
+  *rt_deadline_ptr = now_us() + timeout_us;
+}
+
+/**
+ * @brief 判断截止时间是否已到
+ */
+bool timebase_deadline_expired(uint32_t deadline) {
+  return (int32_t)(now_us() - deadline) >= 0;
+}
+
+/**
+ * @brief 启动软件定时器
+ * 回调在 SysTick 中断中执行, 不要在回调里做耗时操作
+ * 如果定时器已经在运行, 会先停止再以新参数启动
+ * @param pt 定时器
+ * @param delay_ms 第一次到期的延时, 最小为 1
+ * @param period_ms 之后的周期, 为 0 表示单次定时器
+ * @param callback 到期回调
+ * @param arg 回调参数
+ * @return 错误信息
+ */
+errno_t timebase_timer_start(Timebase_timer *const pt, uint32_t delay_ms, uint32_t period_ms, Timebase_timer_callback *callback, void *arg) {
+  if (pt == NULL || callback == NULL || count_register == NULL) return EINVAL;
+  if (delay_ms == 0) delay_ms = 1;
+
+  const uint32_t primask = enter_critical();
+
+  if (pt->active) wheel_remove(pt);
+
+  pt->callback = callback;
+  pt->arg = arg;
+  pt->period_ms = period_ms;
+  pt->expire_tick = wheel_tick + delay_ms;
+  wheel_insert(pt);
+
+  exit_critical(primask);
+
+  return ESUCCESS;
+}
+
+errno_t timebase_timer_stop(Timebase_timer *const pt) {
+  if (pt == NULL) return EINVAL;
+
+  const uint32_t primask = enter_critical();
+  if (pt->active) wheel_remove(pt);
+  exit_critical(primask);
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 覆盖 HAL 的弱定义, SysTick 中断每毫秒调用一次
+ * 在原有节拍计数的基础上推进软件定时器轮
+ */
+void HAL_IncTick(void) {
+  uwTick += uwTickFreq;
+  timebase_tick();
+}
+
+/**
+ * @brief 推进时间轮, 如果中断被屏蔽导致漏掉了节拍, 会依次补齐
+ */
+static void timebase_tick(void) {
+  const uint32_t tick = HAL_GetTick();
+
+  // 时间基准初始化之前不会有定时器, 只同步节拍
+  if (count_register == NULL) {
+    wheel_tick = tick;
+    return;
+  }
+
+  while (wheel_tick != tick) {
+    ++wheel_tick;
+    wheel_process(wheel_tick);
+  }
+}
+
+static void wheel_process(uint32_t tick) {
+  uint32_t primask = enter_critical();
+
+  // 先把整个槽位摘下来, 避免回调里重新启动定时器时修改正在遍历的链表
+  processing_list = wheel_slots[tick & WHEEL_SLOT_MASK];
+  wheel_slots[tick & WHEEL_SLOT_MASK] = NULL;
+
+  while (processing_list != NULL) {
+    Timebase_timer *pt = processing_list;
+    processing_list = pt->next;
+    pt->next = NULL;
+
+    if (pt->expire_tick != tick) {
+      // 还没到期(需要再转若干圈), 放回原槽位
+      wheel_insert(pt);
+      continue;
+    }
+
+    pt->active = false;
+    if (pt->period_ms != 0) {
+      pt->expire_tick = tick + pt->period_ms;
+      wheel_insert(pt);
+    }
+
+    // 回调期间允许其他中断以及在回调中启停定时器
+    exit_critical(primask);
+    pt->callback(pt->arg);
+    primask = enter_critical();
+  }
+
+  exit_critical(primask);
+}
+
+static void wheel_insert(Timebase_timer *const pt) {
+  Timebase_timer **slot = &wheel_slots[pt->expire_tick & WHEEL_SLOT_MASK];
+  pt->next = *slot;
+  *slot = pt;
+  pt->active = true;
+}
+
+static void wheel_remove(Timebase_timer *const pt) {
+  Timebase_timer **pp = &wheel_slots[pt->expire_tick & WHEEL_SLOT_MASK];
+
+  // 定时器可能在槽位中, 也可能在正在处理的链表中
+  for (uint8_t i = 0; i < 2; i++) {
+    while (*pp != NULL) {
+      if (*pp == pt) {
+        *pp = pt->next;
+        pt->next = NULL;
+        pt->active = false;
+        return;
+      }
+      pp = &(*pp)->next;
+    }
+    pp = &processing_list;
+  }
+
+  pt->active = false;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/errno/errno.h"
+
+// 软件定时器轮的槽位数量, 必须是 2 的幂
+#define TIMEBASE_WHEEL_SLOT_NUM 32
+
+typedef void Timebase_timer_callback(void *arg);
+
+/**
+ * @brief 软件定时器
+ * 由调用方分配内存(一般为静态变量), 时间轮只负责链接和调度
+ */
+typedef struct Timebase_timer {
+  Timebase_timer_callback *callback;
+  void *arg;
+  uint32_t period_ms; // 周期, 为 0 表示单次定时器
+  uint32_t expire_tick; // 到期时的节拍数
+  volatile bool active;
+  struct Timebase_timer *next;
+} Timebase_timer;
+
+// 时间基准
+errno_t timebase_init(void);
+uint32_t now_us(void);
+uint32_t now_ms(void);
+
+// 超时判断
+uint32_t timebase_elapsed_us(uint32_t begin_us);
+void timebase_deadline_set(uint32_t *rt_deadline_ptr, uint32_t timeout_us);
+bool timebase_deadline_expired(uint32_t deadline);
+
+// 软件定时器轮
+errno_t timebase_timer_start(Timebase_timer *const pt, uint32_t delay_ms, uint32_t period_ms, Timebase_timer_callback *callback, void *arg);
+errno_t timebase_timer_stop(Timebase_timer *const pt);
@@ -0,0 +1,229 @@
+#include "trajectory.h"
+#include <stddef.h>
+
+#define Q16_SHIFT 16
+
+static int64_t clamp(int64_t value, int64_t min, int64_t max);
+static uint64_t isqrt(uint64_t value);
+static int64_t stop_velocity(const Trajectory *const pt, int64_t remaining);
+static int64_t s_curve_acceleration(const Trajectory *const pt, int64_t remaining);
+static int64_t brake_distance(const Trajectory *const pt, int64_t velocity, int64_t acceleration);
+static int64_t ramp_distance(const Trajectory *const pt, int64_t velocity, int64_t acceleration, int64_t delta, bool up);
+
+// S 形曲线换算后的速度, 加速度, 加加速度和一次加速度爬升带来的速度变化都不能超过该值(Q16, 即每周期 4096),
+// 保证刹车距离计算中的乘积不溢出
+#define S_CURVE_LIMIT ((int64_t)1 << 28)
+
+errno_t trajectory_init(Trajectory *const pt, const Trajectory_param *const param, int32_t position) {
+  if (pt == NULL || param == NULL) return EINVAL;
+  if (param->max_velocity <= 0 || param->max_acceleration <= 0 || param->max_jerk < 0 || param->period_us == 0) return EINVAL;
+
+  pt->param = param;
+
+  // 换算为每个更新周期的变化量, 只在初始化时做除法
+  const int64_t period_us = param->period_us;
+  pt->max_velocity = ((int64_t)param->max_velocity << Q16_SHIFT) * period_us / 1000000;
+  pt->max_acceleration = ((int64_t)param->max_acceleration << Q16_SHIFT) * period_us / 1000000 * period_us / 1000000;
+  pt->max_jerk = ((int64_t)param->max_jerk << Q16_SHIFT) * period_us / 1000000 * period_us / 1000000 * period_us / 1000000;
+  if (pt->max_velocity == 0 || pt->max_acceleration == 0) return EINVAL;
+  // 加加速度太小无法表示时取最小值
+  if (param->max_jerk != 0 && pt->max_jerk == 0) pt->max_jerk = 1;
+  if (pt->max_jerk != 0) {
+    if (pt->max_velocity > S_CURVE_LIMIT || pt->max_acceleration > S_CURVE_LIMIT || pt->max_jerk > S_CURVE_LIMIT) return EINVAL;
+    if (pt->max_acceleration * pt->max_acceleration / pt->max_jerk > S_CURVE_LIMIT) return EINVAL;
+  }
+
+  trajectory_reset(pt, position);
+
+  return ESUCCESS;
+}
+
+void trajectory_reset(Trajectory *const pt, int32_t position) {
+  pt->target = position;
+  pt->position = (int64_t)position << Q16_SHIFT;
+  pt->velocity = 0;
+  pt->acceleration = 0;
+}
+
+void trajectory_set_target(Trajectory *const pt, int32_t target) {
+  pt->target = target;
+}
+
+/**
+ * @brief 前进一个更新周期
+ * 梯形曲线: 期望速度取最大速度和"以最大减速度刚好停在目标位置"的速度中较小者, 按最大加速度趋近
+ * S 形曲线: 每个周期加速度最多变化一个加加速度, 取仍能在目标位置前停下的最大加速度, 见 s_curve_acceleration
+ * 到达或越过目标位置且速度足够小(梯形为一个周期的加速度, S 形为一个周期的加加速度)时直接停在目标位置
+ * @return int32_t 新的位置
+ */
+int32_t trajectory_step(Trajectory *const pt) {
+  const int64_t target = (int64_t)pt->target << Q16_SHIFT;
+  const int64_t remaining = target - pt->position;
+
+  if (remaining == 0 && pt->velocity == 0) {
+    pt->acceleration = 0;
+    return pt->target;
+  }
+
+  if (pt->max_jerk == 0) {
+    int64_t velocity = stop_velocity(pt, remaining);
+    if (velocity > pt->max_velocity) velocity = pt->max_velocity;
+    if (remaining < 0) velocity = -velocity;
+    pt->velocity += clamp(velocity - pt->velocity, -pt->max_acceleration, pt->max_acceleration);
+  } else {
+    pt->acceleration = s_curve_acceleration(pt, remaining);
+    pt->velocity = clamp(pt->velocity + pt->acceleration, -pt->max_velocity, pt->max_velocity);
+  }
+
+  pt->position += pt->velocity;
+
+  // 越过目标位置, 或离目标位置不足一个周期的行程且可以在一个周期内停下
+  const int64_t left = target - pt->position;
+  const bool crossed = (remaining > 0 && left <= 0) || (remaining < 0 && left >= 0);
+  const int64_t abs_left = left < 0 ? -left : left;
+  const int64_t abs_velocity = pt->velocity < 0 ? -pt->velocity : pt->velocity;
+  bool stop = false;
+  if (pt->max_jerk == 0) {
+    stop = abs_left <= abs_velocity && abs_velocity <= pt->max_acceleration;
+  } else {
+    // S 形曲线按连续时间估计刹车距离, 最后可能差一点点到不了, 允许多差一个加加速度的行程
+    const int64_t abs_acceleration = pt->acceleration < 0 ? -pt->acceleration : pt->acceleration;
+    stop = abs_left <= abs_velocity + pt->max_jerk && abs_velocity <= pt->max_jerk && abs_acceleration <= pt->max_jerk;
+  }
+  if (crossed || stop) {
+    trajectory_reset(pt, pt->target);
+  }
+
+  // 四舍五入
+  return (int32_t)((pt->position + (1 << (Q16_SHIFT - 1))) >> Q16_SHIFT);
+}
+
+bool trajectory_done(const Trajectory *const pt) {
+  return pt->velocity == 0 && pt->position == ((int64_t)pt->target << Q16_SHIFT);
+}
+
+/**
+ * @brief 计算在剩余距离内能刚好停下的最大速度
+ * 每个周期先更新速度再前进, 以速度 v 每周期减 a 停下共走过 (v^2 + a * v) / (2 * a),
+ * 反解得 v = sqrt(2 * a * d + a^2 / 4) - a / 2, 按连续时间的 sqrt(2 * a * d) 计算会在到达目标时还剩一截速度
+ */
+static int64_t stop_velocity(const Trajectory *const pt, int64_t remaining) {
+  const uint64_t distance = (uint64_t)(remaining < 0 ? -remaining : remaining);
+  const uint64_t acceleration = (uint64_t)pt->max_acceleration;
+  const uint64_t offset = acceleration * acceleration / 4;
+
+  // Q16 * Q16 = Q32, 开方后为 Q16, 乘积溢出时说明离目标很远, 直接取最大速度
+  if (acceleration == 0 || distance > (UINT64_MAX - offset) / 2 / acceleration) return pt->max_velocity;
+  return (int64_t)isqrt(2 * distance * acceleration + offset) - (int64_t)(acceleration / 2);
+}
+
+/**
+ * @brief S 形曲线下一个周期的加速度
+ * 以朝向目标为正方向, 期望加速度为最大加速度, 接近最大速度时提前减小, 使加速度降到 0 时正好到达最大速度
+ * 走完下一个周期后刹车距离仍不超过剩余距离时按最大加加速度趋近期望加速度,
+ * 否则在 [a - j, 期望] 中二分查找满足条件的最大加速度, a - j 也不满足时已经来不及, 按最大加加速度减小加速度
+ * @param remaining 目标位置减当前位置
+ * @return int64_t 带方向的加速度
+ */
+static int64_t s_curve_acceleration(const Trajectory *const pt, int64_t remaining) {
+  const int64_t sign = remaining < 0 ? -1 : 1;
+  const int64_t distance = remaining * sign;
+  const int64_t velocity = pt->velocity * sign;
+  const int64_t acceleration = pt->acceleration * sign;
+  const int64_t jerk = pt->max_jerk;
+
+  // 以加加速度 j 把加速度 a 降到 0 时速度还会增加 a^2 / (2 * j), 离最大速度还差 dv 时 a 最大为 sqrt(j^2 + 2 * j * dv) - j
+  const int64_t room = pt->max_velocity - velocity;
+  int64_t desired = pt->max_acceleration;
+  if (room <= 0) {
+    desired = room;
+  } else {
+    const int64_t limit = (int64_t)isqrt((uint64_t)(jerk * jerk + 2 * jerk * room)) - jerk;
+    if (limit < desired) desired = limit;
+  }
+
+  const int64_t low = acceleration - jerk < -pt->max_acceleration ? -pt->max_acceleration : acceleration - jerk;
+  const int64_t high = acceleration + jerk > pt->max_acceleration ? pt->max_acceleration : acceleration + jerk;
+  int64_t next = clamp(desired, low, high);
+  if (distance - (velocity + next) >= brake_distance(pt, velocity + next, next)) return next * sign;
+  if (distance - (velocity + low) < brake_distance(pt, velocity + low, low)) return low * sign;
+
+  int64_t lo = low, hi = next;
+  for (uint8_t i = 0; i < 6; ++i) {
+    const int64_t mid = (lo + hi) / 2;
+    if (distance - (velocity + mid) >= brake_distance(pt, velocity + mid, mid)) lo = mid;
+    else hi = mid;
+  }
+  return lo * sign;
+}
+
+/**
+ * @brief S 形曲线从速度 v, 加速度 a 刹车到速度和加速度都为 0 走过的最短距离, 按连续时间计算
+ * 以最大加加速度把加速度降到 -ap, 需要时保持最大减速度一段时间, 再以最大加加速度把加速度升到 0,
+ * 速度变化 (a^2 - ap^2) / (2 * j) - ap^2 / (2 * j) = -v, 得 ap = sqrt(j * v + a^2 / 2)
+ * 当前的减速度已经大于 ap 时, 即使马上减小减速度也会在加速度回到 0 之前停下, 按速度降到 0 的位置计算
+ * 正在远离目标时返回 0
+ */
+static int64_t brake_distance(const Trajectory *const pt, int64_t velocity, int64_t acceleration) {
+  if (velocity <= 0 && acceleration <= 0) return 0;
+
+  const int64_t jerk = pt->max_jerk;
+  const int64_t peak_square = jerk * velocity + acceleration * acceleration / 2;
+  if (peak_square < 0) return 0;
+
+  if (acceleration < 0 && acceleration * acceleration > peak_square) {
+    const int64_t delta = -acceleration - (int64_t)isqrt((uint64_t)(acceleration * acceleration - 2 * jerk * velocity));
+    return ramp_distance(pt, velocity, acceleration, delta, true);
+  }
+
+  const bool hold = peak_square > pt->max_acceleration * pt->max_acceleration;
+  const int64_t peak = hold ? pt->max_acceleration : (int64_t)isqrt((uint64_t)peak_square);
+
+  int64_t distance = ramp_distance(pt, velocity, acceleration, acceleration + peak, false);
+  if (hold) {
+    // 保持最大减速度, 从 v1 减到 v2 = ap^2 / (2 * j)
+    const int64_t from = velocity + (acceleration * acceleration - peak * peak) / (2 * jerk);
+    const int64_t to = peak * peak / (2 * jerk);
+    distance += (from * from - to * to) / (2 * pt->max_acceleration);
+  }
+  // 加速度从 -ap 升到 0, 速度从 ap^2 / (2 * j) 降到 0, 走过 ap^3 / (6 * j^2)
+  distance += peak * peak / jerk * peak / jerk / 6;
+
+  return distance;
+}
+
+/**
+ * @brief 以最大加加速度使加速度从 a 变化 delta(up 为增加, 否则为减小), 期间走过的距离
+ * 用时 t = delta / j, 距离 v * t + a * t^2 / 2 +- j * t^3 / 6
+ */
+static int64_t ramp_distance(const Trajectory *const pt, int64_t velocity, int64_t acceleration, int64_t delta, bool up) {
+  const int64_t jerk = pt->max_jerk;
+  const int64_t cubic = delta * delta / (6 * jerk);
+  return delta * (velocity + acceleration * delta / (2 * jerk) + (up ? cubic : -cubic)) / jerk;
+}
+
+static int64_t clamp(int64_t value, int64_t min, int64_t max) {
+  if (value < min) return min;
+  if (value > max) return max;
+  return value;
+}
+
+// 逐位计算整数平方根
+static uint64_t isqrt(uint64_t value) {
+  uint64_t result = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+
+  while (bit > value) bit >>= 2;
+
+  while (bit != 0) {
+    if (value >= result + bit) {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/errno/errno.h"
+
+/**
+ * @brief 运动曲线参数
+ * 位置单位由调用方决定, 速度为每秒位置变化量, 加速度为每秒速度变化量
+ * max_jerk 为 0 时生成梯形速度曲线, 否则限制加速度变化率, 生成 S 形曲线
+ * S 形曲线换算为每周期的速度, 加速度, 加加速度以及 max_acceleration^2 / max_jerk 都不能超过 4096, 否则初始化失败
+ */
+typedef struct {
+  int32_t max_velocity;
+  int32_t max_acceleration;
+  int32_t max_jerk;
+  uint32_t period_us; // 更新周期
+} Trajectory_param;
+
+/**
+ * @brief 运动曲线生成器
+ * 以固定周期调用 trajectory_step, 位置从当前位置按速度/加速度限制趋近目标位置
+ * 目标位置可以在运动过程中随时修改
+ */
+typedef struct {
+  const Trajectory_param *param;
+  int32_t target;
+  // 以下均为 Q16.16 定点数, 速度和加速度以更新周期为时间单位
+  int64_t position;
+  int64_t velocity;
+  int64_t acceleration;
+  int64_t max_velocity;
+  int64_t max_acceleration;
+  int64_t max_jerk;
+} Trajectory;
+
+errno_t trajectory_init(Trajectory *const pt, const Trajectory_param *const param, int32_t position);
+// 立即停在指定位置, 速度和加速度清零
+void trajectory_reset(Trajectory *const pt, int32_t position);
+void trajectory_set_target(Trajectory *const pt, int32_t target);
+// 前进一个更新周期, 返回新的位置
+int32_t trajectory_step(Trajectory *const pt);
+bool trajectory_done(const Trajectory *const pt);
@@ -5,17 +5,45 @@
 
 static errno_t init(Device_ADC *const pd);
 static errno_t read(Device_ADC *const pd, uint16_t *rt_data, uint32_t len);
+static errno_t read_latest(Device_ADC *const pd, uint16_t *rt_value);
+
+// 内部方法 - 按当前扫描序列重新启动扫描
+static errno_t restart_scan(void);
 
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
 static const Device_ADC_ops device_ops = {
   .init = init,
   .read = read,
+  .read_latest = read_latest,
 };
 
 static List *list = NULL;
 static const Driver_ADC_ops *driver_ops = NULL;
 
+// 过采样倍数, 即每个通道每半个 DMA 缓冲区的采样数
+#define OVERSAMPLE_NUM 32
+#define OVERSAMPLE_SHIFT 5
+// 指数平滑系数为 1 / 2^EMA_SHIFT
+#define EMA_SHIFT 3
+// 平滑值多保留的小数位数
+#define EMA_FRACTION_SHIFT 4
+
+// 扫描序列, 下标为转换顺序, 所有通道共用同一个 ADC
+static Device_ADC *scan_devices[DEVICE_ADC_COUNT] = {0};
+static uint8_t scan_count = 0;
+// DMA 循环缓冲区, 每个转换序列占 scan_count 个元素
+static uint16_t dma_buffer[2 * OVERSAMPLE_NUM * DEVICE_ADC_COUNT] = {0};
+
+// 过采样结果
+static volatile uint16_t histories[DEVICE_ADC_COUNT][DEVICE_ADC_HISTORY_SIZE] = {0};
+static volatile uint8_t history_heads[DEVICE_ADC_COUNT] = {0};
+static volatile uint8_t history_counts[DEVICE_ADC_COUNT] = {0};
+// 每写入一次过采样结果加 1, 用于读取时检查是否被中断打断
+static volatile uint32_t history_seqs[DEVICE_ADC_COUNT] = {0};
+// 指数平滑结果, 多保留 EMA_FRACTION_SHIFT 位小数
+static volatile uint32_t emas[DEVICE_ADC_COUNT] = {0};
+
 errno_t Device_ADC_module_init(void) {
   if (driver_ops == NULL) {
     errno_t err = Driver_ADC_get_ops(&driver_ops);
@@ -45,37 +73,127 @@ static inline uint8_t match_device_by_name(const void *const name, const void *c
   return (((Device_ADC *)pd)->name == *(Device_ADC_name *)name);
 }
 
-static errno_t init(Device_ADC *const pd) {
-  if (pd == NULL) return EINVAL;
+/**
+ * @brief DMA 半传输/传输完成时处理刚填满的半个缓冲区
+ * 每个通道的 OVERSAMPLE_NUM 个采样取平均作为一个过采样结果, 存入历史并更新指数平滑值
+ * @param instance ADC 句柄
+ * @param half true 为前半个缓冲区, false 为后半个缓冲区
+ * @return errno_t 
+ */
+errno_t Device_ADC_scan_callback(const void *const instance, bool half) {
+  if (scan_count == 0 || scan_devices[0]->instance != instance) return EINVAL;
+
+  const uint16_t *const buffer = half ? dma_buffer : dma_buffer + OVERSAMPLE_NUM * scan_count;
+
+  for (uint8_t rank = 0; rank < scan_count; ++rank) {
+    const Device_ADC_name name = scan_devices[rank]->name;
+
+    uint32_t sum = 0;
+    for (uint32_t i = rank; i < OVERSAMPLE_NUM * scan_count; i += scan_count) {
+      sum += buffer[i];
+    }
+    const uint16_t value = (uint16_t)((sum + (1 << (OVERSAMPLE_SHIFT - 1))) >> OVERSAMPLE_SHIFT);
+
+    // 写入历史前后序号各加 1, 读取时序号为奇数或前后不一致说明正在写入
+    ++history_seqs[name];
+    const uint8_t head = history_heads[name];
+    histories[name][head] = value;
+    history_heads[name] = (head + 1) % DEVICE_ADC_HISTORY_SIZE;
+    if (history_counts[name] < DEVICE_ADC_HISTORY_SIZE) ++history_counts[name];
+    ++history_seqs[name];
+
+    const uint32_t scaled = (uint32_t)value << EMA_FRACTION_SHIFT;
+    if (history_counts[name] == 1) {
+      emas[name] = scaled;
+    } else {
+      const int32_t diff = (int32_t)scaled - (int32_t)emas[name];
+      emas[name] = (uint32_t)((int32_t)emas[name] + (diff >> EMA_SHIFT));
+    }
+  }
 
   return ESUCCESS;
 }
 
-static errno_t read(Device_ADC *const pd, uint16_t *rt_data, uint32_t len) {
-  if (pd == NULL || rt_data == NULL || len == 0) return EINVAL;
-
-  errno_t err = ESUCCESS;
+/**
+ * @brief ADC 错误(溢出或 DMA 错误)时重启扫描
+ * 溢出后 ADC 不再发出 DMA 请求, 不重启则历史和平滑值会一直停在旧值
+ * @param instance ADC 句柄
+ * @return errno_t 
+ */
+errno_t Device_ADC_error_callback(const void *const instance) {
+  if (scan_count == 0 || scan_devices[0]->instance != instance) return EINVAL;
 
-  Device_ADC_channel_config config = {
-    .channel = pd->channel,
-    .sampling_time = pd->sampling_time,
-    .rank = 1,
-  };
-  err = driver_ops->config_channel(pd, &config);
+  errno_t err = driver_ops->stop_scan(scan_devices[0]);
   if (err) return err;
 
-  err = driver_ops->start(pd);
-  if (err) return err;
+  return restart_scan();
+}
 
-  for (uint32_t i = 0; i < len; ++i) {
-    err = driver_ops->poll(pd, 100);
-    if (err) return err;
-    err = driver_ops->get_value(pd, rt_data + i);
+static errno_t init(Device_ADC *const pd) {
+  if (pd == NULL || driver_ops == NULL) return EINVAL;
+
+  for (uint8_t i = 0; i < scan_count; ++i) {
+    if (scan_devices[i] == pd) return ESUCCESS;
+  }
+  if (scan_count >= DEVICE_ADC_COUNT) return ENOMEM;
+  // 所有通道共用同一个 ADC 和 DMA 缓冲区
+  if (scan_count > 0 && scan_devices[0]->instance != pd->instance) return EINVAL;
+
+  // 扫描序列改变后缓冲区布局也会改变, 先停止扫描
+  if (scan_count > 0) {
+    errno_t err = driver_ops->stop_scan(scan_devices[0]);
     if (err) return err;
   }
 
-  err = driver_ops->stop(pd);
-  if (err) return err;
+  history_heads[pd->name] = 0;
+  history_counts[pd->name] = 0;
+  emas[pd->name] = 0;
+  scan_devices[scan_count++] = pd;
+
+  return restart_scan();
+}
+
+static errno_t read(Device_ADC *const pd, uint16_t *rt_data, uint32_t len) {
+  if (pd == NULL || rt_data == NULL || len == 0 || len > DEVICE_ADC_HISTORY_SIZE) return EINVAL;
+
+  // 复制过程中被 DMA 中断写入时重新复制
+  uint32_t seq = 0;
+  do {
+    seq = history_seqs[pd->name];
+    if (seq & 1) continue;
+
+    if (history_counts[pd->name] < len) return ENODATA;
+
+    uint8_t index = (history_heads[pd->name] + DEVICE_ADC_HISTORY_SIZE - len) % DEVICE_ADC_HISTORY_SIZE;
+    for (uint32_t i = 0; i < len; ++i) {
+      rt_data[i] = histories[pd->name][index];
+      index = (index + 1) % DEVICE_ADC_HISTORY_SIZE;
+    }
+  } while (seq != history_seqs[pd->name] || (seq & 1));
 
   return ESUCCESS;
 }
+
+static errno_t read_latest(Device_ADC *const pd, uint16_t *rt_value) {
+  if (pd == NULL || rt_value == NULL) return EINVAL;
+  if (history_counts[pd->name] == 0) return ENODATA;
+
+  *rt_value = (uint16_t)((emas[pd->name] + (1 << (EMA_FRACTION_SHIFT - 1))) >> EMA_FRACTION_SHIFT);
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 按扫描序列配置通道并启动 DMA 循环采样
+ * 由 trigger 定时器触发每一轮扫描, 采样率与 ADC 时钟和采样时间无关
+ */
+static errno_t restart_scan(void) {
+  Device_ADC_channel_config configs[DEVICE_ADC_COUNT] = {0};
+  for (uint8_t i = 0; i < scan_count; ++i) {
+    configs[i].channel = scan_devices[i]->channel;
+    configs[i].sampling_time = scan_devices[i]->sampling_time;
+    configs[i].rank = i + 1;
+  }
+
+  return driver_ops->start_scan(scan_devices[0], configs, scan_count, dma_buffer, 2 * OVERSAMPLE_NUM * scan_count);
+}
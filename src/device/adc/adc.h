@@ -2,6 +2,7 @@
 
 #include "common/errno/errno.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef enum {
   DEVICE_ADC_LIGHT,
@@ -60,14 +61,23 @@ struct Device_ADC_ops;
 typedef struct Device_ADC {
   const Device_ADC_name name;
   void *const instance;
+  // 触发扫描的定时器, 同一 ADC 的所有通道共用
+  void *const trigger;
   const Device_ADC_channel channel;
   const Device_ADC_sampling_time sampling_time;
   const struct Device_ADC_ops *ops;
 } Device_ADC;
 
+// 每个通道保存的最近过采样结果数量, 即 read 一次最多读取的数量
+#define DEVICE_ADC_HISTORY_SIZE 16
+
 typedef struct Device_ADC_ops {
+  // 将通道加入定时器触发的扫描序列, 之后由 DMA 在后台持续采样
   errno_t (*init)(Device_ADC *const pd);
+  // 读取最近 len 个过采样结果, 按时间先后排列, 不足 len 个时返回 ENODATA
   errno_t (*read)(Device_ADC *const pd, uint16_t *rt_data, uint32_t len);
+  // 读取指数平滑后的最新值
+  errno_t (*read_latest)(Device_ADC *const pd, uint16_t *rt_value);
 } Device_ADC_ops;
 
 typedef struct Driver_ADC_ops {
@@ -76,8 +86,16 @@ typedef struct Driver_ADC_ops {
   errno_t (*stop)(const Device_ADC *const pd);
   errno_t (*poll)(const Device_ADC *const pd, uint32_t timeout_ms);
   errno_t (*get_value)(const Device_ADC *const pd, uint16_t *rt_value);
+  // 以扫描模式启动, 每个 trigger 定时器 CC1 上升沿转换一轮, 结果由 DMA 循环写入 buffer
+  errno_t (*start_scan)(const Device_ADC *const pd, const Device_ADC_channel_config configs[], uint8_t count, uint16_t *buffer, uint32_t len);
+  errno_t (*stop_scan)(const Device_ADC *const pd);
 } Driver_ADC_ops;
 
 errno_t Device_ADC_module_init(void);
 errno_t Device_ADC_register(Device_ADC *const pd);
 errno_t Device_ADC_find(Device_ADC **pd_ptr, const Device_ADC_name name);
+
+// DMA 半传输/传输完成回调处理, half 为 true 表示前半个缓冲区已填满
+errno_t Device_ADC_scan_callback(const void *const instance, bool half);
+// ADC 错误回调处理, 溢出后 DMA 已停止, 在这里重启扫描
+errno_t Device_ADC_error_callback(const void *const instance);
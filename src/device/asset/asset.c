@@ -0,0 +1,531 @@
+#include "asset.h"
+#include "common/list/list.h"
+#include "common/crc/crc.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 对象方法
+static errno_t init(Device_asset *const pd);
+static errno_t find(Device_asset *const pd, const char *name, Device_asset_entry *rt_entry_ptr);
+static errno_t draw_image(Device_asset *const pd, const char *name, uint16_t y, uint16_t x);
+static errno_t draw_text(Device_asset *const pd, const char *font, const char *str, uint16_t y, uint16_t x, color_t color, color_t background);
+
+// 内部方法 - 未压缩的图片, flash 读完一段后在中断中提交屏幕写入和下一段读取
+static errno_t stream_raw(Device_asset *const pd, const Device_asset_entry *const pe);
+static void raw_read_done(void *arg, errno_t err);
+// 内部方法 - 行程编码的图片, 在主循环中解码, 解码时 SPI 在后台读取下一段和写入上一段
+static errno_t stream_rle(Device_asset *const pd, const Device_asset_entry *const pe);
+static void read_done(void *arg, errno_t err);
+static void write_done(void *arg, errno_t err);
+// 内部方法 - 读取 [addr, end) 的下一段到 buffer
+static errno_t read_chunk(Device_asset *const pd, uint8_t *buffer, uint8_t index, Device_W25QX_callback *callback);
+// 内部方法 - 像素输出缓冲, 写满一个缓冲后提交屏幕写入并切换到另一个缓冲
+static errno_t output_pixel(Device_asset *const pd, color_t color);
+static errno_t output_flush(Device_asset *const pd);
+static errno_t wait_read(Device_asset *const pd);
+static errno_t wait_write(Device_asset *const pd);
+static void record_err(Device_asset *const pd, errno_t err);
+// 内部方法 - 等待 flash 上次的编程/擦除完成
+static errno_t wait_flash_idle(Device_asset *const pd);
+// 内部方法 - 在字体的码点表中二分查找
+static errno_t glyph_find(Device_asset *const pd, const Device_asset_entry *const pe, uint32_t codepoint, uint16_t *rt_index_ptr);
+// 内部方法 - 取出下一个 UTF-8 字符, 非法编码返回 0xFFFD
+static uint32_t utf8_next(const char **str_ptr);
+// 内部方法 - 查找设备
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
+
+static const Device_asset_ops device_ops = {
+  .init = init,
+  .find = find,
+  .draw_image = draw_image,
+  .draw_text = draw_text,
+};
+
+_Static_assert(sizeof(Device_asset_header) == 32, "header size");
+_Static_assert(sizeof(Device_asset_entry) == 32, "entry size");
+_Static_assert(DEVICE_ASSET_CHUNK_SIZE % 2 == 0, "chunk must hold whole pixels");
+
+// 行程编码包头最高位为 1 时后面是 1 个像素, 重复 (低 7 位 + 1) 次; 为 0 时后面是 (低 7 位 + 1) 个原样的像素
+#define RLE_REPEAT 0x80
+#define RLE_COUNT_MASK 0x7F
+// 字体中没有的字符用这个字符代替
+#define GLYPH_FALLBACK '?'
+#define CODEPOINT_INVALID 0xFFFD
+
+// 流式传输状态, reading/writing 由主循环置位, 在传输完成中断中清除
+typedef struct {
+  volatile bool reading;
+  volatile bool writing;
+  volatile errno_t err; // 中断中发生的第一个错误
+  uint32_t addr; // 下一段读取的 flash 地址
+  uint32_t end;
+  uint8_t index; // 未压缩图片正在读取的缓冲
+  uint32_t lens[2];
+  bool first; // 下一次屏幕写入是否从区域起点开始
+  uint8_t out_index;
+  uint32_t out_len;
+} Stream_state;
+
+static List *list = NULL;
+
+static Device_asset_header headers[DEVICE_ASSET_COUNT] = {0};
+static bool valids[DEVICE_ASSET_COUNT] = {0};
+static Stream_state streams[DEVICE_ASSET_COUNT] = {0};
+// 压缩数据的读取缓冲和像素的输出缓冲, 未压缩的图片直接读到输出缓冲
+static uint8_t input_buffers[DEVICE_ASSET_COUNT][2][DEVICE_ASSET_CHUNK_SIZE] = {0};
+static uint8_t output_buffers[DEVICE_ASSET_COUNT][2][DEVICE_ASSET_CHUNK_SIZE] = {0};
+static uint8_t glyph_buffer[DEVICE_ASSET_GLYPH_MAX] = {0};
+
+errno_t Device_asset_module_init(void) {
+  if (list == NULL) {
+    errno_t err = list_create(&list);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+errno_t Device_asset_register(Device_asset *const pd) {
+  if (pd == NULL || list == NULL) return EINVAL;
+  pd->ops = &device_ops;
+  list->ops->head_insert(list, pd);
+  return ESUCCESS;
+}
+
+errno_t Device_asset_find(Device_asset **pd_ptr, const Device_asset_name name) {
+  if (list == NULL) return EINVAL;
+
+  errno_t err = list->ops->find(list, pd_ptr, &name, match_device_by_name);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t init(Device_asset *const pd) {
+  if (pd == NULL || pd->flash == NULL || pd->display == NULL) return EINVAL;
+
+  errno_t err = ESUCCESS;
+  Device_asset_header *const ph = &headers[pd->name];
+
+  valids[pd->name] = false;
+
+  err = pd->flash->ops->init(pd->flash);
+  if (err) return err;
+
+  err = pd->flash->ops->read(pd->flash, pd->base_addr, (uint8_t *)ph, sizeof(Device_asset_header));
+  if (err) return err;
+
+  if (ph->magic != DEVICE_ASSET_MAGIC) return ENOENT;
+  if (ph->version != DEVICE_ASSET_VERSION) return EBADMSG;
+  if (ph->size > pd->region_size) return EBADMSG;
+  if (sizeof(Device_asset_header) + (uint32_t)ph->count * sizeof(Device_asset_entry) > ph->size) return EBADMSG;
+
+  // 逐项读出索引计算 CRC
+  uint32_t crc = 0;
+  for (uint16_t i = 0; i < ph->count; ++i) {
+    Device_asset_entry entry;
+    const uint32_t addr = pd->base_addr + sizeof(Device_asset_header) + (uint32_t)i * sizeof(Device_asset_entry);
+    err = pd->flash->ops->read(pd->flash, addr, (uint8_t *)&entry, sizeof(Device_asset_entry));
+    if (err) return err;
+    crc = crc32(crc, &entry, sizeof(Device_asset_entry));
+  }
+  if (crc != ph->index_crc) return EBADMSG;
+
+  valids[pd->name] = true;
+
+  return ESUCCESS;
+}
+
+static errno_t find(Device_asset *const pd, const char *name, Device_asset_entry *rt_entry_ptr) {
+  if (pd == NULL || name == NULL || rt_entry_ptr == NULL) return EINVAL;
+  if (strlen(name) > DEVICE_ASSET_NAME_LEN) return EINVAL;
+  if (!valids[pd->name]) return ENOENT;
+
+  const Device_asset_header *const ph = &headers[pd->name];
+  errno_t err = ESUCCESS;
+
+  for (uint16_t i = 0; i < ph->count; ++i) {
+    const uint32_t addr = pd->base_addr + sizeof(Device_asset_header) + (uint32_t)i * sizeof(Device_asset_entry);
+    err = pd->flash->ops->read(pd->flash, addr, (uint8_t *)rt_entry_ptr, sizeof(Device_asset_entry));
+    if (err) return err;
+
+    if (strncmp(rt_entry_ptr->name, name, DEVICE_ASSET_NAME_LEN) != 0) continue;
+    if (rt_entry_ptr->offset > ph->size || rt_entry_ptr->size > ph->size - rt_entry_ptr->offset) return EBADMSG;
+    return ESUCCESS;
+  }
+
+  return ENOENT;
+}
+
+static errno_t draw_image(Device_asset *const pd, const char *name, uint16_t y, uint16_t x) {
+  if (pd == NULL || name == NULL) return EINVAL;
+
+  errno_t err = ESUCCESS;
+  Device_asset_entry entry;
+
+  err = find(pd, name, &entry);
+  if (err) return err;
+
+  if (entry.type != DEVICE_ASSET_TYPE_IMAGE_RGB565 && entry.type != DEVICE_ASSET_TYPE_IMAGE_RLE) return EINVAL;
+  if (entry.width == 0 || entry.height == 0 || entry.size == 0) return EBADMSG;
+  if (entry.type == DEVICE_ASSET_TYPE_IMAGE_RGB565 && entry.size != (uint32_t)entry.width * entry.height * 2) return EBADMSG;
+  if ((uint32_t)y + entry.height > pd->display->screen_height || (uint32_t)x + entry.width > pd->display->screen_width) return EINVAL;
+
+  err = wait_flash_idle(pd);
+  if (err) return err;
+
+  err = pd->display->ops->set_area(pd->display, y, x, y + entry.height - 1, x + entry.width - 1);
+  if (err) return err;
+
+  if (entry.type == DEVICE_ASSET_TYPE_IMAGE_RGB565) return stream_raw(pd, &entry);
+  return stream_rle(pd, &entry);
+}
+
+static errno_t draw_text(Device_asset *const pd, const char *font, const char *str, uint16_t y, uint16_t x, color_t color, color_t background) {
+  if (pd == NULL || font == NULL || str == NULL) return EINVAL;
+
+  errno_t err = ESUCCESS;
+  Device_asset_entry entry;
+  Stream_state *const ps = &streams[pd->name];
+
+  err = find(pd, font, &entry);
+  if (err) return err;
+
+  if (entry.type != DEVICE_ASSET_TYPE_FONT) return EINVAL;
+  const uint16_t width = entry.width, height = entry.height;
+  const uint16_t stride = (width + 7) / 8;
+  const uint32_t glyph_size = (uint32_t)stride * height;
+  if (width == 0 || height == 0 || glyph_size > DEVICE_ASSET_GLYPH_MAX) return EBADMSG;
+  if (entry.size < (uint32_t)entry.glyph_count * (4 + glyph_size)) return EBADMSG;
+  const uint32_t glyph_base = pd->base_addr + entry.offset + (uint32_t)entry.glyph_count * 4;
+
+  err = wait_flash_idle(pd);
+  if (err) return err;
+
+  memset(ps, 0, sizeof(Stream_state));
+
+  uint16_t cur_y = y, cur_x = x;
+  while (*str) {
+    const uint32_t codepoint = utf8_next(&str);
+    if (codepoint == '\r') continue;
+    if (codepoint == '\n' || (uint32_t)cur_x + width > pd->display->screen_width) {
+      cur_x = x;
+      cur_y += height;
+    }
+    if ((uint32_t)cur_y + height > pd->display->screen_height) break;
+    if (codepoint == '\n') continue;
+
+    uint16_t index = 0;
+    err = glyph_find(pd, &entry, codepoint, &index);
+    if (err == ENOENT) err = glyph_find(pd, &entry, GLYPH_FALLBACK, &index);
+    if (err == ENOENT) continue;
+    if (err) goto wait_tag;
+
+    // 同步读取会等待上一个字的屏幕写入完成
+    err = pd->flash->ops->read(pd->flash, glyph_base + (uint32_t)index * glyph_size, glyph_buffer, glyph_size);
+    if (err) goto wait_tag;
+
+    err = wait_write(pd);
+    if (err) goto wait_tag;
+    err = pd->display->ops->set_area(pd->display, cur_y, cur_x, cur_y + height - 1, cur_x + width - 1);
+    if (err) goto wait_tag;
+    ps->first = true;
+
+    for (uint16_t row = 0; row < height; ++row) {
+      const uint8_t *const line = glyph_buffer + row * stride;
+      for (uint16_t col = 0; col < width; ++col) {
+        err = output_pixel(pd, (line[col / 8] & (0x80 >> (col % 8))) ? color : background);
+        if (err) goto wait_tag;
+      }
+    }
+    err = output_flush(pd);
+    if (err) goto wait_tag;
+
+    cur_x += width;
+  }
+
+  return wait_write(pd);
+
+  wait_tag:
+  while (ps->writing);
+  return err;
+}
+
+/**
+ * @brief 两个缓冲轮流: 读完第 k 段后提交第 k 段的屏幕写入和第 k + 1 段的读取
+ * 两者都是低优先级排队传输, 按提交顺序执行, 读第 k + 1 段时第 k - 1 段的写入已经完成, 缓冲可以复用
+ * @param pd
+ * @param pe
+ * @return errno_t
+ */
+static errno_t stream_raw(Device_asset *const pd, const Device_asset_entry *const pe) {
+  Stream_state *const ps = &streams[pd->name];
+
+  memset(ps, 0, sizeof(Stream_state));
+  ps->addr = pd->base_addr + pe->offset;
+  ps->end = ps->addr + pe->size;
+  ps->first = true;
+
+  errno_t err = read_chunk(pd, output_buffers[pd->name][0], 0, raw_read_done);
+  if (err) return err;
+
+  while (ps->reading || ps->writing);
+
+  return ps->err;
+}
+
+static void raw_read_done(void *arg, errno_t err) {
+  Device_asset *const pd = arg;
+  Stream_state *const ps = &streams[pd->name];
+  const uint8_t index = ps->index;
+
+  ps->reading = false;
+  if (err) {
+    record_err(pd, err);
+    return;
+  }
+  if (ps->err) return;
+
+  ps->writing = true;
+  err = pd->display->ops->write_area_async(pd->display, output_buffers[pd->name][index], ps->lens[index], ps->first, write_done, pd);
+  if (err) {
+    ps->writing = false;
+    record_err(pd, err);
+    return;
+  }
+  ps->first = false;
+
+  if (ps->addr < ps->end) {
+    ps->index = index ^ 1;
+    err = read_chunk(pd, output_buffers[pd->name][ps->index], ps->index, raw_read_done);
+    if (err) record_err(pd, err);
+  }
+}
+
+static errno_t stream_rle(Device_asset *const pd, const Device_asset_entry *const pe) {
+  Stream_state *const ps = &streams[pd->name];
+  errno_t err = ESUCCESS;
+
+  memset(ps, 0, sizeof(Stream_state));
+  ps->addr = pd->base_addr + pe->offset;
+  ps->end = ps->addr + pe->size;
+  ps->first = true;
+
+  // 解码状态, 数据包可能跨越两段
+  const uint32_t total = (uint32_t)pe->width * pe->height;
+  uint32_t pixels = 0;
+  uint8_t count = 0;
+  bool repeat = false;
+  uint8_t pixel[2] = {0};
+  uint8_t pixel_len = 0;
+
+  uint8_t index = 0;
+  err = read_chunk(pd, input_buffers[pd->name][index], index, read_done);
+  if (err) return err;
+
+  bool more = true;
+  while (more) {
+    err = wait_read(pd);
+    if (err) goto wait_tag;
+
+    const uint8_t *const in = input_buffers[pd->name][index];
+    const uint32_t in_len = ps->lens[index];
+
+    more = ps->addr < ps->end;
+    if (more) {
+      err = read_chunk(pd, input_buffers[pd->name][index ^ 1], index ^ 1, read_done);
+      if (err) goto wait_tag;
+    }
+
+    for (uint32_t i = 0; i < in_len; ++i) {
+      if (count == 0) {
+        repeat = (in[i] & RLE_REPEAT) != 0;
+        count = (in[i] & RLE_COUNT_MASK) + 1;
+        continue;
+      }
+
+      pixel[pixel_len++] = in[i];
+      if (pixel_len < 2) continue;
+      pixel_len = 0;
+
+      const uint8_t n = repeat ? count : 1;
+      count -= n;
+      if (pixels + n > total) {
+        err = EBADMSG;
+        goto wait_tag;
+      }
+      pixels += n;
+      for (uint8_t j = 0; j < n; ++j) {
+        err = output_pixel(pd, (color_t)(pixel[0] << 8 | pixel[1]));
+        if (err) goto wait_tag;
+      }
+    }
+
+    index ^= 1;
+  }
+
+  err = output_flush(pd);
+  if (err) goto wait_tag;
+  err = wait_write(pd);
+  if (err) return err;
+
+  if (pixels != total || count != 0) return EBADMSG;
+
+  return ESUCCESS;
+
+  wait_tag:
+  while (ps->reading || ps->writing);
+  return err;
+}
+
+static void read_done(void *arg, errno_t err) {
+  Device_asset *const pd = arg;
+  streams[pd->name].reading = false;
+  if (err) record_err(pd, err);
+}
+
+static void write_done(void *arg, errno_t err) {
+  Device_asset *const pd = arg;
+  streams[pd->name].writing = false;
+  if (err) record_err(pd, err);
+}
+
+static errno_t read_chunk(Device_asset *const pd, uint8_t *buffer, uint8_t index, Device_W25QX_callback *callback) {
+  Stream_state *const ps = &streams[pd->name];
+  const uint32_t len = ps->end - ps->addr > DEVICE_ASSET_CHUNK_SIZE ? DEVICE_ASSET_CHUNK_SIZE : ps->end - ps->addr;
+
+  const uint32_t addr = ps->addr;
+
+  // 完成中断可能在提交返回之前发生, 先更新状态
+  ps->lens[index] = len;
+  ps->addr += len;
+  ps->reading = true;
+  errno_t err = pd->flash->ops->read_async(pd->flash, addr, buffer, len, callback, pd);
+  if (err) {
+    ps->addr = addr;
+    ps->reading = false;
+    return err;
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t output_pixel(Device_asset *const pd, color_t color) {
+  Stream_state *const ps = &streams[pd->name];
+  uint8_t *const out = output_buffers[pd->name][ps->out_index];
+
+  out[ps->out_len++] = (uint8_t)(color >> 8);
+  out[ps->out_len++] = (uint8_t)color;
+  if (ps->out_len == DEVICE_ASSET_CHUNK_SIZE) return output_flush(pd);
+
+  return ESUCCESS;
+}
+
+// 等待上一个缓冲写完后提交当前缓冲, 之后填充上一个缓冲
+static errno_t output_flush(Device_asset *const pd) {
+  Stream_state *const ps = &streams[pd->name];
+  if (ps->out_len == 0) return ESUCCESS;
+
+  errno_t err = wait_write(pd);
+  if (err) return err;
+
+  ps->writing = true;
+  err = pd->display->ops->write_area_async(pd->display, output_buffers[pd->name][ps->out_index], ps->out_len, ps->first, write_done, pd);
+  if (err) {
+    ps->writing = false;
+    return err;
+  }
+
+  ps->first = false;
+  ps->out_index ^= 1;
+  ps->out_len = 0;
+
+  return ESUCCESS;
+}
+
+static errno_t wait_read(Device_asset *const pd) {
+  while (streams[pd->name].reading);
+  return streams[pd->name].err;
+}
+
+static errno_t wait_write(Device_asset *const pd) {
+  while (streams[pd->name].writing);
+  return streams[pd->name].err;
+}
+
+static void record_err(Device_asset *const pd, errno_t err) {
+  if (streams[pd->name].err == ESUCCESS) streams[pd->name].err = err;
+}
+
+static errno_t wait_flash_idle(Device_asset *const pd) {
+  bool busy = true;
+
+  while (busy) {
+    errno_t err = pd->flash->ops->is_busy(pd->flash, &busy);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t glyph_find(Device_asset *const pd, const Device_asset_entry *const pe, uint32_t codepoint, uint16_t *rt_index_ptr) {
+  const uint32_t table = pd->base_addr + pe->offset;
+  uint32_t low = 0, high = pe->glyph_count;
+
+  while (low < high) {
+    const uint32_t mid = (low + high) / 2;
+    uint32_t value = 0;
+    errno_t err = pd->flash->ops->read(pd->flash, table + mid * 4, (uint8_t *)&value, 4);
+    if (err) return err;
+
+    if (value == codepoint) {
+      *rt_index_ptr = (uint16_t)mid;
+      return ESUCCESS;
+    }
+    if (value < codepoint) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return ENOENT;
+}
+
+static uint32_t utf8_next(const char **str_ptr) {
+  const uint8_t *const s = (const uint8_t *)*str_ptr;
+  uint32_t codepoint = s[0];
+  uint8_t extra = 0;
+
+  if (codepoint < 0x80) {
+    extra = 0;
+  } else if ((codepoint & 0xE0) == 0xC0) {
+    codepoint &= 0x1F;
+    extra = 1;
+  } else if ((codepoint & 0xF0) == 0xE0) {
+    codepoint &= 0x0F;
+    extra = 2;
+  } else if ((codepoint & 0xF8) == 0xF0) {
+    codepoint &= 0x07;
+    extra = 3;
+  } else {
+    *str_ptr += 1;
+    return CODEPOINT_INVALID;
+  }
+
+  for (uint8_t i = 1; i <= extra; ++i) {
+    // 后续字节不完整时只跳过已检查的部分, 结尾的 0 不会被跳过
+    if ((s[i] & 0xC0) != 0x80) {
+      *str_ptr += i;
+      return CODEPOINT_INVALID;
+    }
+    codepoint = codepoint << 6 | (s[i] & 0x3F);
+  }
+
+  *str_ptr += 1 + extra;
+  return codepoint;
+}
+
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
+  return ((Device_asset *)pd)->name == *((Device_asset_name *)name);
+}
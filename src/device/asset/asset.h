@@ -0,0 +1,91 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/w25qx/w25qx.h"
+#include "device/st7789v2/st7789v2.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// 资源包标识 "AST1", 由 tools/asset 生成
+#define DEVICE_ASSET_MAGIC 0x31545341u
+#define DEVICE_ASSET_VERSION 1
+#define DEVICE_ASSET_NAME_LEN 16
+// 流式传输的缓冲大小, flash 读取和屏幕写入各两个缓冲轮流使用
+#define DEVICE_ASSET_CHUNK_SIZE 512
+// 字形最大字节数, 即最大 32x32 点阵
+#define DEVICE_ASSET_GLYPH_MAX 128
+
+typedef enum {
+  DEVICE_ASSET_1,
+  DEVICE_ASSET_COUNT,
+} Device_asset_name;
+
+typedef enum {
+  DEVICE_ASSET_TYPE_IMAGE_RGB565 = 1, // 像素按行排列, 每个像素 2 字节, 高字节在前
+  DEVICE_ASSET_TYPE_IMAGE_RLE = 2, // RGB565 行程编码, 见 asset.c
+  DEVICE_ASSET_TYPE_FONT = 3, // 等宽点阵字体, 码点表 + 字形
+} Device_asset_type;
+
+/**
+ * @brief 资源包头, 位于存储区起始地址, 32 字节
+ * 之后是 count 个索引项, index_crc 覆盖所有索引项
+ */
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint32_t size; // 整个资源包的字节数
+  uint32_t index_crc;
+  uint32_t reserved[4];
+} Device_asset_header;
+
+/**
+ * @brief 资源索引项, 32 字节, offset 相对存储区起始地址
+ * 字体数据为 glyph_count 个递增的 uint32 码点, 之后是同样顺序的字形,
+ * 每个字形 height 行, 每行 (width + 7) / 8 字节, 高位在左
+ */
+typedef struct {
+  char name[DEVICE_ASSET_NAME_LEN]; // 不足时补 0
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t width;
+  uint16_t height;
+  uint16_t glyph_count;
+  uint32_t offset;
+  uint32_t size;
+} Device_asset_entry;
+
+struct Device_asset;
+struct Device_asset_ops;
+
+/**
+ * @brief flash 中的图片和字体资源
+ * 绘制时 flash 读取和屏幕写入都是 SPI 排队传输, 通过两个小缓冲轮流进行, 不需要整幅图片的内存
+ */
+typedef struct Device_asset {
+  const Device_asset_name name;
+  const uint32_t base_addr; // 存储区起始地址
+  const uint32_t region_size; // 存储区大小, 资源包不能超过
+  const Device_W25QX *flash;
+  Device_ST7789V2 *display;
+  const struct Device_asset_ops *ops;
+} Device_asset;
+
+typedef struct Device_asset_ops {
+  // 初始化 flash 并检查资源包, 资源包不存在时返回 ENOENT, 索引损坏时返回 EBADMSG
+  errno_t (*init)(Device_asset *const pd);
+  // 按名称查找资源, 不存在时返回 ENOENT
+  errno_t (*find)(Device_asset *const pd, const char *name, Device_asset_entry *rt_entry_ptr);
+  // 在屏幕 (y, x) 处绘制图片, 图片需要完整位于屏幕内, 绘制完成后返回
+  errno_t (*draw_image)(Device_asset *const pd, const char *name, uint16_t y, uint16_t x);
+  /**
+   * 用字体资源绘制 UTF-8 字符串, 遇到 \n 或行尾时换到下一行, 超出屏幕底部的部分不绘制
+   * 字体中没有的字符用 '?' 代替, '?' 也没有时跳过
+   */
+  errno_t (*draw_text)(Device_asset *const pd, const char *font, const char *str, uint16_t y, uint16_t x, color_t color, color_t background);
+} Device_asset_ops;
+
+// 全局方法
+errno_t Device_asset_module_init(void);
+errno_t Device_asset_register(Device_asset *const pd);
+errno_t Device_asset_find(Device_asset **pd_ptr, const Device_asset_name name);
@@ -1,12 +1,22 @@
 #include "at24c02.h"
 #include "common/list/list.h"
-#include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 static errno_t init(const Device_AT24C02 *const pd);
 static errno_t read(const Device_AT24C02 *const pd, uint16_t addr, uint8_t *rt_data, uint16_t len);
 static errno_t write(const Device_AT24C02 *const pd, uint16_t addr, uint8_t *data, uint16_t len);
+static errno_t poll(const Device_AT24C02 *const pd);
+static errno_t flush(const Device_AT24C02 *const pd);
+static errno_t get_page_writes(const Device_AT24C02 *const pd, uint8_t page, uint32_t *rt_count_ptr);
+
+// 内部方法 - 排队传输完成回调, 在中断中执行
+static void page_write_done(Device_I2C_transaction *pt, errno_t err);
+static void probe_done(Device_I2C_transaction *pt, errno_t err);
+// 内部方法 - 把累计的写回次数保存到 kv
+static errno_t save_page_writes(const Device_AT24C02 *const pd);
 
 // 内部方法 - 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
@@ -15,10 +25,48 @@ static const Device_AT24C02_ops device_ops = {
   .init = init,
   .read = read,
   .write = write,
+  .poll = poll,
+  .flush = flush,
+  .get_page_writes = get_page_writes,
 };
 
+// 写回的状态, SENDING 和 PROBING 由传输完成回调切换到下一个状态
+typedef enum {
+  FLUSH_IDLE,
+  FLUSH_SENDING, // 正在通过 DMA 发送一页
+  FLUSH_SENT, // 发送完成
+  FLUSH_PROGRAMMING, // 等待芯片内部写入完成
+  FLUSH_PROBING, // 正在查询应答
+  FLUSH_FAILED,
+} Flush_state;
+
+// 页写入时间最长 5 毫秒, 超过该时间仍无应答时认为写入失败
+#define PROGRAM_TIMEOUT_MS 20
+// 后台保存写回次数的最短间隔, 每次保存都会写一条 kv 记录, 不能太频繁
+#define PAGE_WRITES_SAVE_INTERVAL_MS (10 * 60 * 1000)
+
 static List *list = NULL;
 
+static uint8_t caches[DEVICE_AT24C02_COUNT][DEVICE_AT24C02_SIZE_MAX] = {0};
+// 内容有变化、等待写回的页, 第 i 位对应第 i 页
+static uint32_t dirty_pages[DEVICE_AT24C02_COUNT] = {0};
+static volatile Flush_state flush_states[DEVICE_AT24C02_COUNT] = {0};
+static volatile errno_t flush_errs[DEVICE_AT24C02_COUNT] = {0};
+static uint8_t flush_pages[DEVICE_AT24C02_COUNT] = {0};
+static uint32_t program_start_ms[DEVICE_AT24C02_COUNT] = {0};
+static uint32_t probe_ms[DEVICE_AT24C02_COUNT] = {0};
+// 发送缓冲, DMA 发送期间保持不变, 缓存可以继续修改
+static uint8_t send_bufs[DEVICE_AT24C02_COUNT][DEVICE_AT24C02_PAGE_SIZE_MAX] = {0};
+// 页写入和应答查询的排队传输, 查询只发送一个字节的地址, 不写入数据
+static Device_I2C_transaction page_transactions[DEVICE_AT24C02_COUNT] = {0};
+static Device_I2C_transaction probe_transactions[DEVICE_AT24C02_COUNT] = {0};
+static uint8_t probe_bufs[DEVICE_AT24C02_COUNT] = {0};
+// 每一页累计写回的次数, 初始化时从 kv 读取; 不保存到芯片本身, 否则每次写回都要多写一页计数
+static uint32_t page_writes[DEVICE_AT24C02_COUNT][DEVICE_AT24C02_PAGE_COUNT_MAX] = {0};
+// 上次保存之后是否有新的写回, 以及上次保存的时间
+static bool page_writes_changeds[DEVICE_AT24C02_COUNT] = {0};
+static uint32_t page_writes_saved_ms[DEVICE_AT24C02_COUNT] = {0};
+
 errno_t Device_AT24C02_module_init(void) {
   if (list == NULL) {
     errno_t err = list_create(&list);
@@ -46,89 +94,232 @@ errno_t Device_AT24C02_find(const Device_AT24C02 **pd_ptr, const Device_AT24C02_
 
 static errno_t init(const Device_AT24C02 *const pd) {
   if (pd == NULL) return EINVAL;
+  if (pd->size > DEVICE_AT24C02_SIZE_MAX || pd->page_size > DEVICE_AT24C02_PAGE_SIZE_MAX || pd->page_count > DEVICE_AT24C02_PAGE_COUNT_MAX) return EINVAL;
 
-  errno_t err = pd->i2c->ops->init(pd->i2c);
+  errno_t err = timebase_init();
   if (err) return err;
 
-  return ESUCCESS;
-}
+  err = pd->i2c->ops->init(pd->i2c);
+  if (err) return err;
 
-static errno_t read(const Device_AT24C02 *const pd, uint16_t addr, uint8_t *rt_data, uint16_t len) {
-  if (pd == NULL) return EINVAL;
+  dirty_pages[pd->name] = 0;
+  flush_states[pd->name] = FLUSH_IDLE;
 
-  errno_t err = ESUCCESS;
+  // 读取累计的写回次数, 没有记录或页数不同时从 0 开始
+  memset(page_writes[pd->name], 0, sizeof(page_writes[pd->name]));
+  page_writes_changeds[pd->name] = false;
+  page_writes_saved_ms[pd->name] = now_ms();
+  if (pd->kv != NULL) {
+    err = pd->kv->ops->init(pd->kv);
+    if (err) return err;
+
+    uint16_t len = 0;
+    err = pd->kv->ops->get(pd->kv, pd->page_writes_key, page_writes[pd->name], sizeof(page_writes[pd->name]), &len);
+    if (err && err != ENOENT && err != EFBIG) return err;
+    if (err || len != pd->page_count * sizeof(uint32_t)) memset(page_writes[pd->name], 0, sizeof(page_writes[pd->name]));
+  }
 
   // at24c 系列大于 2k bit 的产品低 8 位使用 i2c 发送, 高位地址使用引脚控制, 这里暂时只兼容小于等于 2k bit 的产品, 不处理高位地址
-  uint8_t lowAddr = (uint8_t)addr;
-  err = pd->i2c->ops->transmit(pd->i2c, pd->addr, &lowAddr, 1);
+  // 组合传输, 发送地址后用重复起始条件接着读取
+  Device_I2C_transaction transaction = {
+    .slave_addr = pd->addr,
+    .direction = DEVICE_I2C_READ,
+    .reg = 0,
+    .reg_len = 1,
+    .data = caches[pd->name],
+    .len = pd->size,
+    .priority = DEVICE_I2C_PRIORITY_LOW,
+  };
+  err = pd->i2c->ops->transfer(pd->i2c, &transaction);
   if (err) return err;
 
-  err = pd->i2c->ops->receive(pd->i2c, pd->addr, rt_data, len);
-  if (err) return err;
+  page_transactions[pd->name] = (Device_I2C_transaction){
+    .slave_addr = pd->addr,
+    .direction = DEVICE_I2C_WRITE,
+    .reg_len = 1,
+    .data = send_bufs[pd->name],
+    .len = pd->page_size,
+    .priority = DEVICE_I2C_PRIORITY_LOW,
+    .callback = page_write_done,
+    .arg = (void *)pd,
+  };
+  probe_transactions[pd->name] = (Device_I2C_transaction){
+    .slave_addr = pd->addr,
+    .direction = DEVICE_I2C_WRITE,
+    .data = &probe_bufs[pd->name],
+    .len = 1,
+    .priority = DEVICE_I2C_PRIORITY_LOW,
+    .callback = probe_done,
+    .arg = (void *)pd,
+  };
+
+  return ESUCCESS;
+}
+
+static errno_t read(const Device_AT24C02 *const pd, uint16_t addr, uint8_t *rt_data, uint16_t len) {
+  if (pd == NULL || rt_data == NULL) return EINVAL;
+  if (addr > pd->size || pd->size - addr < len) return EINVAL;
+
+  memcpy(rt_data, caches[pd->name] + addr, len);
 
   return ESUCCESS;
 }
 
+/**
+ * @brief 写入缓存
+ * 只标记内容真正变化的页, 多次小写入合并为一次页写入, 重复写入相同的参数不消耗寿命
+ * @param pd
+ * @param addr
+ * @param data
+ * @param len
+ * @return errno_t
+ */
 static errno_t write(const Device_AT24C02 *const pd, uint16_t addr, uint8_t *data, uint16_t len) {
   if (pd == NULL || data == NULL || len == 0) return EINVAL;
   // 计算从此地址开始的剩余字节数, 如果剩余字节数小于数据长度, 返回参数错误
-  if (pd->size - addr < len) return EINVAL;
+  if (addr > pd->size || pd->size - addr < len) return EINVAL;
+
+  uint8_t *const cache = caches[pd->name];
+  for (uint16_t i = 0; i < len; ++i) {
+    if (cache[addr + i] == data[i]) continue;
+    cache[addr + i] = data[i];
+    dirty_pages[pd->name] |= 1u << ((addr + i) / pd->page_size);
+  }
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 后台写回
+ * 页写入和应答查询都是排队传输, 由回调切换状态; 写入一页期间芯片不响应地址, 每毫秒最多查询一次应答
+ * @param pd
+ * @return errno_t
+ */
+static errno_t poll(const Device_AT24C02 *const pd) {
+  if (pd == NULL) return EINVAL;
 
   errno_t err = ESUCCESS;
+  const uint32_t now = now_ms();
 
-  // 先不考虑页大小为 16 字节的情况
-  uint8_t send_buf[9] = {0};
+  switch (flush_states[pd->name]) {
+    case FLUSH_IDLE: {
+      const uint32_t dirty = dirty_pages[pd->name];
+      if (dirty == 0) {
+        if (page_writes_changeds[pd->name] && now - page_writes_saved_ms[pd->name] >= PAGE_WRITES_SAVE_INTERVAL_MS) return save_page_writes(pd);
+        return ESUCCESS;
+      }
 
-  // 本次发送字节数, 初次获取当前页剩余字节数, 后面为页字节数
-  const uint8_t first_page_remain = pd->page_size - (addr % pd->page_size);
-  uint8_t cur_len = 0;
-  if (len > first_page_remain) {
-    cur_len = first_page_remain;
-    len -= cur_len;
-  } else {
-    cur_len = len;
-    len = 0;
+      const uint8_t page = __builtin_ctz(dirty);
+      const uint16_t page_addr = page * pd->page_size;
+      memcpy(send_bufs[pd->name], caches[pd->name] + page_addr, pd->page_size);
+
+      // 发送前清除标记, 发送期间再次修改的页会重新标记
+      dirty_pages[pd->name] &= ~(1u << page);
+      flush_pages[pd->name] = page;
+      flush_states[pd->name] = FLUSH_SENDING;
+      page_transactions[pd->name].reg = page_addr;
+      err = pd->i2c->ops->submit(pd->i2c, &page_transactions[pd->name]);
+      if (err) {
+        dirty_pages[pd->name] |= 1u << page;
+        flush_states[pd->name] = FLUSH_IDLE;
+        return err;
+      }
+
+      ++page_writes[pd->name][page];
+      page_writes_changeds[pd->name] = true;
+      return ESUCCESS;
+    }
+    case FLUSH_SENDING:
+    case FLUSH_PROBING:
+      return ESUCCESS;
+    case FLUSH_SENT: {
+      program_start_ms[pd->name] = now;
+      probe_ms[pd->name] = now;
+      flush_states[pd->name] = FLUSH_PROGRAMMING;
+      return ESUCCESS;
+    }
+    case FLUSH_PROGRAMMING: {
+      if (now == probe_ms[pd->name]) return ESUCCESS;
+      probe_ms[pd->name] = now;
+
+      if (now - program_start_ms[pd->name] > PROGRAM_TIMEOUT_MS) {
+        flush_errs[pd->name] = ETIMEDOUT;
+        flush_states[pd->name] = FLUSH_FAILED;
+        return ESUCCESS;
+      }
+
+      // 查询时写入的地址字节只设置芯片的地址指针
+      probe_bufs[pd->name] = flush_pages[pd->name] * pd->page_size;
+      flush_states[pd->name] = FLUSH_PROBING;
+      err = pd->i2c->ops->submit(pd->i2c, &probe_transactions[pd->name]);
+      if (err) flush_states[pd->name] = FLUSH_PROGRAMMING;
+      return err;
+    }
+    case FLUSH_FAILED: {
+      // 重新写入这一页
+      dirty_pages[pd->name] |= 1u << flush_pages[pd->name];
+      flush_states[pd->name] = FLUSH_IDLE;
+      return flush_errs[pd->name];
+    }
   }
 
-  send_buf[0] = addr;
-  memcpy(send_buf + 1, data, cur_len);
-  err = pd->i2c->ops->transmit(pd->i2c, pd->addr, send_buf, cur_len + 1);
-  if (err) return err;
+  return ESUCCESS;
+}
+
+static errno_t flush(const Device_AT24C02 *const pd) {
+  if (pd == NULL) return EINVAL;
 
-  // 等待写入完成
-  while (pd->i2c->ops->is_device_ready(pd->i2c, pd->addr, 10, 1) != ESUCCESS) {
-    err = delay_ms(1);
+  while (dirty_pages[pd->name] != 0 || flush_states[pd->name] != FLUSH_IDLE) {
+    errno_t err = poll(pd);
     if (err) return err;
   }
 
-  while (len) {
-    addr += cur_len;
-    data += cur_len;
-    if (len > pd->page_size) {
-      cur_len = pd->page_size;
-      len -= pd->page_size;
-    } else {
-      cur_len = len;
-      len = 0;
-    }
+  if (page_writes_changeds[pd->name]) return save_page_writes(pd);
 
-    send_buf[0] = addr;
-    memcpy(send_buf + 1, data, cur_len);
-    err = pd->i2c->ops->transmit(pd->i2c, pd->addr, send_buf, cur_len + 1);
-    if (err) {
-      return err;
-    }
+  return ESUCCESS;
+}
 
-    // 等待写入完成
-    while (pd->i2c->ops->is_device_ready(pd->i2c, pd->addr, 10, 1) != ESUCCESS) {
-      err = delay_ms(1);
-      if (err) return err;
-    }
+static errno_t get_page_writes(const Device_AT24C02 *const pd, uint8_t page, uint32_t *rt_count_ptr) {
+  if (pd == NULL || rt_count_ptr == NULL || page >= pd->page_count) return EINVAL;
+  *rt_count_ptr = page_writes[pd->name][page];
+  return ESUCCESS;
+}
+
+// kv 写入 flash 是阻塞的, 只在主循环中调用
+static errno_t save_page_writes(const Device_AT24C02 *const pd) {
+  if (pd->kv == NULL) {
+    page_writes_changeds[pd->name] = false;
+    return ESUCCESS;
   }
 
+  // 失败时也等下一个间隔再保存
+  page_writes_saved_ms[pd->name] = now_ms();
+  errno_t err = pd->kv->ops->set(pd->kv, pd->page_writes_key, page_writes[pd->name], pd->page_count * sizeof(uint32_t));
+  if (err) return err;
+
+  page_writes_changeds[pd->name] = false;
   return ESUCCESS;
 }
 
+static void page_write_done(Device_I2C_transaction *pt, errno_t err) {
+  const Device_AT24C02 *const pd = pt->arg;
+  flush_errs[pd->name] = err;
+  flush_states[pd->name] = err ? FLUSH_FAILED : FLUSH_SENT;
+}
+
+// 写入期间芯片不应答(ENXIO), 下一毫秒再查询
+static void probe_done(Device_I2C_transaction *pt, errno_t err) {
+  const Device_AT24C02 *const pd = pt->arg;
+  flush_errs[pd->name] = err;
+  if (err == ESUCCESS) {
+    flush_states[pd->name] = FLUSH_IDLE;
+  } else if (err == ENXIO) {
+    flush_states[pd->name] = FLUSH_PROGRAMMING;
+  } else {
+    flush_states[pd->name] = FLUSH_FAILED;
+  }
+}
+
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
   return ((Device_AT24C02 *)pd)->name == *((Device_AT24C02_name *)name);
 }
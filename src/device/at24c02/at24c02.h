@@ -3,6 +3,12 @@
 #include <stdint.h>
 #include "common/errno/errno.h"
 #include "device/i2c/i2c.h"
+#include "device/kv/kv.h"
+
+// 缓存的最大容量和页数, 即 AT24C02 的 256 字节, 32 页
+#define DEVICE_AT24C02_SIZE_MAX 0x100
+#define DEVICE_AT24C02_PAGE_SIZE_MAX 0x10
+#define DEVICE_AT24C02_PAGE_COUNT_MAX 0x20
 
 typedef enum {
   DEVICE_AT24C02_1,
@@ -12,6 +18,12 @@ typedef enum {
 struct Device_AT24C02;
 struct Device_AT24C02_ops;
 
+/**
+ * @brief AT24C02 EEPROM
+ * 初始化时把全部内容读入内存缓存, 读取直接使用缓存
+ * 写入只修改缓存并标记内容有变化的页, 由 poll 在后台逐页写回: DMA 发送一页后用单次应答查询等待写入完成
+ * kv 不为 NULL 时每一页累计的写回次数保存在 kv 的 page_writes_key 中, 跨上电累计
+ */
 typedef struct Device_AT24C02 {
   const Device_AT24C02_name name;
   const uint8_t addr;
@@ -19,13 +31,24 @@ typedef struct Device_AT24C02 {
   const uint8_t page_count;
   const uint16_t size;
   Device_I2C *i2c;
+  Device_KV *kv; // 保存写回次数, 为 NULL 时只统计本次上电
+  const kv_key_t page_writes_key;
   const struct Device_AT24C02_ops *ops;
 } Device_AT24C02;
 
 typedef struct Device_AT24C02_ops {
+  // 初始化 I2C 并读取全部内容到缓存, 有 kv 时同时初始化 kv 并读取累计的写回次数
   errno_t (*init)(const Device_AT24C02 *const pd);
   errno_t (*read)(const Device_AT24C02 *const pd, uint16_t addr, uint8_t *rt_data, uint16_t len);
+  // 写入缓存后立即返回, 与缓存相同的字节不写回, 需要在主循环中调用 poll
   errno_t (*write)(const Device_AT24C02 *const pd, uint16_t addr, uint8_t *data, uint16_t len);
+  // 在主循环中调用, 每次最多发出一页写入或一次应答查询后立即返回
+  errno_t (*poll)(const Device_AT24C02 *const pd);
+  // 等待所有修改写回, 并保存累计的写回次数, 用于掉电或复位之前
+  errno_t (*flush)(const Device_AT24C02 *const pd);
+  // 每一页累计写回的次数, 用来估计磨损, 芯片每页的写入寿命约 100 万次
+  // 次数由 flush 和 poll(每 10 分钟最多一次)保存, 两次保存之间掉电时丢失这段时间的计数, 实际次数只会更多
+  errno_t (*get_page_writes)(const Device_AT24C02 *const pd, uint8_t page, uint32_t *rt_count_ptr);
 } Device_AT24C02_ops;
 
 errno_t Device_AT24C02_module_init(void);
@@ -1,30 +1,71 @@
 #include "dht11.h"
 #include "common/list/list.h"
-#include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
+#include "common/critical/critical.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 
-#define NUM_IS_VALUE(num, value, margin) ((uint32_t)num >= (uint32_t)value - (uint32_t)margin && (uint32_t)num <= (uint32_t)value + (uint32_t)margin)
-
+// 起始信号低电平时长(毫秒), 手册要求至少 18 毫秒
+#define START_LOW_MS 20
+// 释放总线后等待响应完成的超时时间(毫秒), 完整响应约 4~5 毫秒
+#define RESPONSE_TIMEOUT_MS 10
+// 响应中需要捕获的下降沿数量: 响应开始 1 个 + 响应结束 1 个 + 40 个数据位
+#define EDGE_NUM 42
+// 相邻下降沿间隔大于该值(微秒)表示数据位为 1
+// 0: 50 微秒低电平 + 26~28 微秒高电平, 1: 50 微秒低电平 + 70 微秒高电平
+#define BIT_1_THRESHOLD_US 100
+
+typedef enum {
+  STATE_IDLE,
+  STATE_START, // 正在输出起始信号
+  STATE_RESPONSE, // 正在接收响应
+} DHT11_state;
 
 // 对象方法
 static errno_t init(Device_DHT11 *const pd);
-static errno_t read(Device_DHT11 *const pd, uint8_t rt_data[4]);
+static errno_t measure(Device_DHT11 *const pd);
+static errno_t read(Device_DHT11 *const pd, uint8_t rt_data[4], uint32_t *rt_age_ms_ptr);
+static errno_t set_complete_callback(Device_DHT11 *const pd, Device_DHT11_complete_callback *callback);
+static errno_t get_stats(Device_DHT11 *const pd, Device_DHT11_stats *rt_stats_ptr);
 
 // 内部方法
-// 等待引脚到达某个值
-static errno_t wait_until_pin_is(Device_DHT11 *const pd, const Pin_value target, const uint16_t timeout_us, uint16_t *rt_time_taken_ptr);
+// 起始信号结束, 释放总线开始接收响应
+static void start_done_callback(void *arg);
+// 接收响应超时
+static void response_timeout_callback(void *arg);
+// 结束一次测量, 归还中断线, 更新缓存并通知
+static void finish(Device_DHT11 *const pd, errno_t result);
+// 归还中断线, 记录借用的时长
+static void release_line(Device_DHT11 *const pd);
 // 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
 static const Device_DHT11_ops device_ops = {
   .init = init,
+  .measure = measure,
   .read = read,
+  .set_complete_callback = set_complete_callback,
+  .get_stats = get_stats,
 };
 
 static List *list = NULL;
 
+static volatile DHT11_state states[DEVICE_DHT11_COUNT] = {0};
+static Timebase_timer timers[DEVICE_DHT11_COUNT] = {0};
+// 已捕获的下降沿数量及上一个下降沿的时间戳
+static volatile uint8_t edge_counts[DEVICE_DHT11_COUNT] = {0};
+static volatile uint32_t last_edge_us[DEVICE_DHT11_COUNT] = {0};
+// 正在接收的 5 个字节
+static uint8_t recv_bytes[DEVICE_DHT11_COUNT][5] = {0};
+// 缓存的最近一次有效结果
+static volatile uint8_t cached_data[DEVICE_DHT11_COUNT][4] = {0};
+static volatile uint32_t cached_ms[DEVICE_DHT11_COUNT] = {0};
+static volatile bool cached[DEVICE_DHT11_COUNT] = {0};
+static Device_DHT11_stats stats[DEVICE_DHT11_COUNT] = {0};
+// 借用中断线的时刻
+static uint32_t borrow_us[DEVICE_DHT11_COUNT] = {0};
+
 errno_t Device_DHT11_module_init(void) {
   if (list == NULL) {
     errno_t err = list_create(&list);
@@ -50,132 +91,203 @@ errno_t Device_DHT11_find(Device_DHT11 **pd_ptr, const Device_DHT11_name name) {
   return ESUCCESS;
 }
 
+/**
+ * @brief 数据引脚外部中断回调(下降沿)
+ * 用相邻下降沿的间隔区分 0 和 1, 每来一个沿解码一位
+ */
+errno_t Device_DHT11_in_EXTI_callback(Device_DHT11 *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  const Device_DHT11_name name = pd->name;
+  if (states[name] != STATE_RESPONSE) return ESUCCESS;
+
+  const uint32_t now = now_us();
+  const uint32_t diff = now - last_edge_us[name];
+  last_edge_us[name] = now;
+
+  const uint8_t edge_idx = edge_counts[name]++;
+
+  // 前两个沿是响应信号, 不携带数据
+  if (edge_idx < 2) return ESUCCESS;
+
+  // 一次完整的数据传输为40bit, 高位先出
+  const uint8_t bit_idx = edge_idx - 2;
+  if (diff > BIT_1_THRESHOLD_US) {
+    recv_bytes[name][bit_idx / 8] |= 1 << (7 - bit_idx % 8);
+  }
+
+  if (edge_counts[name] < EDGE_NUM) return ESUCCESS;
+
+  // 数据格式:
+  // 8bit湿度整数数据 + 8bit湿度小数数据 + 8bit温度整数数据 + 8bit温度小数数据 + 8bit校验和
+  // 校验和数据应等于前 4 个字节之和的末8位
+  const uint8_t *const bytes = recv_bytes[name];
+  const uint8_t sum = (uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]);
+  if (sum != bytes[4]) {
+    finish(pd, EIO);
+    return ESUCCESS;
+  }
+
+  for (uint8_t i = 0; i < 4; i++) {
+    cached_data[name][i] = bytes[i];
+  }
+  cached_ms[name] = now_ms();
+  cached[name] = true;
+
+  finish(pd, ESUCCESS);
+
+  return ESUCCESS;
+}
+
 static errno_t init(Device_DHT11 *const pd) {
   if (pd == NULL) return EINVAL;
 
   errno_t err = ESUCCESS;
 
-  err = pd->timer->ops->init(pd->timer);
-  if (err) return err;
-  
-  // 计时单位为 1 微秒
-  err = pd->timer->ops->set_time_for_count_incr(pd->timer, 1);
-  if (err) return err;
-  // 溢出值设置为最大(为了保持兼容, 设置 0xFFFF)
-  err = pd->timer->ops->set_auto_reload_register(pd->timer, 0xFFFF);
-  if (err) return err;
-  
-  err = pd->timer->ops->start(pd->timer, DEVICE_TIMER_START_MODE_NO_IT);
+  err = timebase_init();
   if (err) return err;
 
   err = pd->in->ops->init(pd->in);
   if (err) return err;
 
+  // 空闲时释放总线
+  err = pd->in->ops->write(pd->in, PIN_VALUE_1);
+  if (err) return err;
+
+  states[pd->name] = STATE_IDLE;
+
   return ESUCCESS;
 }
 
-static errno_t read(Device_DHT11 *const pd, uint8_t rt_data[4]) {
+/**
+ * @brief 发起一次异步测量
+ * 拉低总线后由软件定时器在 START_LOW_MS 毫秒后释放, 响应由外部中断逐位解码, 期间不占用 CPU
+ * 两次测量间隔不要小于 1 秒
+ * @return 正在测量时返回 EBUSY
+ */
+static errno_t measure(Device_DHT11 *const pd) {
   if (pd == NULL) return EINVAL;
+  if (states[pd->name] != STATE_IDLE) return EBUSY;
 
   errno_t err = ESUCCESS;
 
+  states[pd->name] = STATE_START;
+
   err = pd->in->ops->write(pd->in, PIN_VALUE_0);
-  if (err) return err;
-  err = delay_ms(20);
-  if (err) return err;
-  err = pd->in->ops->write(pd->in, PIN_VALUE_1);
-  if (err) return err;
+  if (err) goto reset_state_tag;
 
-  err = wait_until_pin_is(pd, PIN_VALUE_0, 100, NULL);
-  if (err) return err;
-  err = wait_until_pin_is(pd, PIN_VALUE_1, 100, NULL);
-  if (err) return err;
-  err = wait_until_pin_is(pd, PIN_VALUE_0, 100, NULL);
-  if (err) return err;
+  err = timebase_timer_start(&timers[pd->name], START_LOW_MS, 0, start_done_callback, pd);
+  if (err) goto release_bus_tag;
 
-  // 一次完整的数据传输为40bit, 高位先出。
-  // 数据格式:
-  // 8bit湿度整数数据 + 8bit湿度小数数据 + 8bit温度整数数据 + 8bit温度小数数据 + 8bit校验和
-  uint8_t bytes[5] = {0};
-
-  for (uint8_t byte_idx = 0; byte_idx < 5; byte_idx++) {
-    for (uint8_t bit_idx = 0; bit_idx < 8; bit_idx++) {
-      err = wait_until_pin_is(pd, PIN_VALUE_1, 100, NULL);
-      if (err) 
-        return err;
-
-      uint16_t time_taken = 0;
-
-      err = wait_until_pin_is(pd, PIN_VALUE_0, 100, &time_taken);
-      if (err)
-        return err;
-
-      if (time_taken < 50) {
-        // 高电平时长为 26 - 28 微秒时表示 0
-      } else {
-        // 高电平时长为 70 微秒时表示 1, 先发高位
-        bytes[byte_idx] |= 1 << (7 - bit_idx);
-      }
-    }
-  }
+  return ESUCCESS;
 
-  // 等待设备释放总线
-  err = wait_until_pin_is(pd, PIN_VALUE_1, 60, NULL);
-  if (err)
-    return err;
+  release_bus_tag:
+  pd->in->ops->write(pd->in, PIN_VALUE_1);
+  reset_state_tag:
+  states[pd->name] = STATE_IDLE;
+  return err;
+}
 
-  // 校验和数据应等于 8bit湿度整数数据 + 8bit湿度小数数据 + 8bit温度整数数据 + 8bit温度小数数据 所得结果的末8位
-  uint8_t sum = (uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]);
-  if (sum != bytes[4])
-    return EIO;
+/**
+ * @brief 读取缓存的最近一次有效结果, 不会阻塞
+ * @param rt_data 湿度整数, 湿度小数, 温度整数, 温度小数
+ * @param rt_age_ms_ptr 返回该结果距今的毫秒数, 传 NULL 不返回
+ * @return 还没有有效结果时返回 ENODATA
+ */
+static errno_t read(Device_DHT11 *const pd, uint8_t rt_data[4], uint32_t *rt_age_ms_ptr) {
+  if (pd == NULL || rt_data == NULL) return EINVAL;
+  if (!cached[pd->name]) return ENODATA;
 
   for (uint8_t i = 0; i < 4; i++) {
-    rt_data[i] = bytes[i];
+    rt_data[i] = cached_data[pd->name][i];
+  }
+
+  if (rt_age_ms_ptr != NULL) {
+    *rt_age_ms_ptr = now_ms() - cached_ms[pd->name];
   }
 
   return ESUCCESS;
 }
 
-/**
- * @brief 等待引脚到达指定状态
- * 
- * @param pd 设备对象
- * @param target 需要到达的状态
- * @param timeout_us 超时时长
- * @param rt_time_taken_ptr 接收返回的实际用时时长, 传 NULL 不返回
- * @return errno_t 返回的错误码
- */
-static errno_t wait_until_pin_is(Device_DHT11 *const pd, const Pin_value target, const uint16_t timeout_us, uint16_t *rt_time_taken_ptr) {
-  uint32_t first_tick32 = 0;
-  errno_t err = pd->timer->ops->get_register_count(pd->timer, &first_tick32);
-  if (err) return err;
-  uint16_t first_tick = (uint16_t)first_tick32;
+static errno_t set_complete_callback(Device_DHT11 *const pd, Device_DHT11_complete_callback *callback) {
+  if (pd == NULL) return EINVAL;
+  pd->complete_callback = callback;
+  return ESUCCESS;
+}
 
-  Pin_value pv = PIN_VALUE_1;
-  uint16_t tick = first_tick;
+static errno_t get_stats(Device_DHT11 *const pd, Device_DHT11_stats *rt_stats_ptr) {
+  if (pd == NULL || rt_stats_ptr == NULL) return EINVAL;
 
-  for (;;) {
-    err = pd->in->ops->read(pd->in, &pv);
-    if (err) return err;
+  const uint32_t primask = enter_critical();
+  *rt_stats_ptr = stats[pd->name];
+  exit_critical(primask);
 
-    uint32_t tick32 = 0;
-    err = pd->timer->ops->get_register_count(pd->timer, &tick32);
-    if (err) return err;
-    tick = (uint16_t)tick32;
+  return ESUCCESS;
+}
 
-    uint16_t diff = (uint16_t)(tick - first_tick);
+static void start_done_callback(void *arg) {
+  Device_DHT11 *const pd = (Device_DHT11 *)arg;
+  errno_t err = ESUCCESS;
 
-    if (pv == target) {
-      if (rt_time_taken_ptr != NULL) {
-        *rt_time_taken_ptr = diff;
-      }
-      return ESUCCESS;
-    }
+  memset(recv_bytes[pd->name], 0, sizeof(recv_bytes[pd->name]));
+  edge_counts[pd->name] = 0;
 
-    if (diff >= timeout_us) break;
-  }
+  // 数据引脚的中断线可能和其他引脚共用, 测量期间借用, 结束后归还
+  err = pd->in->ops->save_EXTI_handle(pd->in);
+  if (err) goto err_tag;
+  borrow_us[pd->name] = now_us();
+  ++stats[pd->name].borrows;
+  if (pd->borrow_callback != NULL) pd->borrow_callback(true);
+
+  err = pd->in->ops->set_EXTI_handle(pd->in, DEVICE_GPIO_EXTI_TRIGGER_FALLING, pd->in_EXTI_callback);
+  if (err) goto restore_tag;
+
+  err = timebase_timer_start(&timers[pd->name], RESPONSE_TIMEOUT_MS, 0, response_timeout_callback, pd);
+  if (err) goto restore_tag;
+
+  states[pd->name] = STATE_RESPONSE;
+  last_edge_us[pd->name] = now_us();
+  ++stats[pd->name].measures;
+
+  // 释放总线, 等待设备响应
+  err = pd->in->ops->write(pd->in, PIN_VALUE_1);
+  if (err) goto restore_tag;
+
+  return;
+
+  restore_tag:
+  release_line(pd);
+  err_tag:
+  pd->in->ops->write(pd->in, PIN_VALUE_1);
+  states[pd->name] = STATE_IDLE;
+  ++stats[pd->name].errors;
+  if (pd->complete_callback != NULL) pd->complete_callback(pd, err);
+}
+
+static void response_timeout_callback(void *arg) {
+  Device_DHT11 *const pd = (Device_DHT11 *)arg;
+  if (states[pd->name] != STATE_RESPONSE) return;
+  finish(pd, ETIMEDOUT);
+}
+
+static void finish(Device_DHT11 *const pd, errno_t result) {
+  states[pd->name] = STATE_IDLE;
+  timebase_timer_stop(&timers[pd->name]);
+  release_line(pd);
+  if (result) ++stats[pd->name].errors;
+
+  if (pd->complete_callback != NULL) pd->complete_callback(pd, result);
+}
+
+static void release_line(Device_DHT11 *const pd) {
+  pd->in->ops->restore_EXTI_handle(pd->in);
+  if (pd->borrow_callback != NULL) pd->borrow_callback(false);
 
-  return ETIMEDOUT;
+  Device_DHT11_stats *const ps = &stats[pd->name];
+  const uint32_t borrowed_us = now_us() - borrow_us[pd->name];
+  ps->borrowed_us_last = borrowed_us;
+  if (borrowed_us > ps->borrowed_us_max) ps->borrowed_us_max = borrowed_us;
+  ps->borrowed_us_total += borrowed_us;
 }
 
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
@@ -2,7 +2,6 @@
 
 #include "common/errno/errno.h"
 #include "device/gpio/gpio.h"
-#include "device/timer/timer.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -11,22 +10,47 @@ typedef enum {
   DEVICE_DHT11_COUNT,
 } Device_DHT11_name;
 
+typedef struct {
+  uint32_t measures; // 开始接收响应的次数
+  uint32_t errors; // 测量失败的次数, 包括校验失败, 超时和借用中断线失败
+  // 接收响应期间借用了数据引脚的中断线, 共用该中断线的设备在这段时间内收不到中断
+  uint32_t borrows;
+  uint32_t borrowed_us_last;
+  uint32_t borrowed_us_max;
+  uint32_t borrowed_us_total;
+} Device_DHT11_stats;
+
 struct Device_DHT11;
 struct Device_DHT11_ops;
 
+// 一次测量结束后的回调, result 为本次测量结果的错误码, 在中断中执行
+typedef void Device_DHT11_complete_callback(struct Device_DHT11 *const pd, errno_t result);
+
 typedef struct Device_DHT11 {
   const Device_DHT11_name name;
   Device_GPIO *in;
-  Device_timer *timer;
+  // 数据引脚的中断线回调, 测量期间借用中断线时使用
+  void (*in_EXTI_callback)(void);
+  // 借出(borrowed 为 true)和归还中断线时通知共用该中断线的设备, 在中断中执行, 可以为 NULL
+  void (*borrow_callback)(bool borrowed);
+  Device_DHT11_complete_callback *complete_callback;
   const struct Device_DHT11_ops *ops;
 } Device_DHT11;
 
 typedef struct Device_DHT11_ops {
   errno_t (*init)(Device_DHT11 *const pd);
-  errno_t (*read)(Device_DHT11 *const pd, uint8_t rt_data[4]);
+  // 发起一次异步测量, 立即返回, 结束后更新缓存并执行完成回调
+  errno_t (*measure)(Device_DHT11 *const pd);
+  // 读取缓存的最近一次有效结果, 以及该结果距今的毫秒数(传 NULL 不返回)
+  errno_t (*read)(Device_DHT11 *const pd, uint8_t rt_data[4], uint32_t *rt_age_ms_ptr);
+  errno_t (*set_complete_callback)(Device_DHT11 *const pd, Device_DHT11_complete_callback *callback);
+  errno_t (*get_stats)(Device_DHT11 *const pd, Device_DHT11_stats *rt_stats_ptr);
 } Device_DHT11_ops;
 
 // 全局方法
 errno_t Device_DHT11_module_init(void);
 errno_t Device_DHT11_register(Device_DHT11 *const pd);
 errno_t Device_DHT11_find(Device_DHT11 **pd_ptr, const Device_DHT11_name name);
+
+// 数据引脚外部中断回调处理
+errno_t Device_DHT11_in_EXTI_callback(Device_DHT11 *const pd);
@@ -8,6 +8,8 @@ static errno_t init(const Device_GPIO *const pd);
 static errno_t read(const Device_GPIO *const pd, Pin_value *value_ptr);
 static errno_t write(const Device_GPIO *const pd, const Pin_value value);
 static errno_t set_EXTI_handle(const Device_GPIO *const pd, Device_GPIO_EXTI_trigger trigger, void (*callback)(void));
+static errno_t save_EXTI_handle(const Device_GPIO *const pd);
+static errno_t restore_EXTI_handle(const Device_GPIO *const pd);
 
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
@@ -16,6 +18,8 @@ static const Device_GPIO_ops device_ops = {
   .read = read,
   .write = write,
   .set_EXTI_handle = set_EXTI_handle,
+  .save_EXTI_handle = save_EXTI_handle,
+  .restore_EXTI_handle = restore_EXTI_handle,
 };
 
 static const Driver_GPIO_ops *driver_ops = NULL;
@@ -54,6 +58,81 @@ errno_t Device_GPIO_EXTI_callback(Device_GPIO *pd) {
   return ESUCCESS;
 }
 
+/**
+ * @brief 根据引脚列表生成总线的分段表
+ * 
+ * @param pb 
+ * @param pins 引脚列表, 第 i 个引脚对应总线的第 i 位
+ * @param pin_count 引脚数量
+ * @return errno_t 
+ */
+errno_t Device_GPIO_bus_init(Device_GPIO_bus *const pb, Device_GPIO *const pins[], const uint8_t pin_count) {
+  if (pb == NULL || pins == NULL || pin_count == 0 || pin_count > DEVICE_GPIO_BUS_WIDTH_MAX) return EINVAL;
+
+  pb->width = pin_count;
+  pb->segment_count = 0;
+
+  for (uint8_t i = 0; i < pin_count; ++i) {
+    const Device_GPIO *const pd = pins[i];
+    if (pd == NULL || pd->pin == 0) return EINVAL;
+
+    const int8_t pin_index = (int8_t)__builtin_ctz(pd->pin);
+    const int8_t shift = (int8_t)i - pin_index;
+
+    // 查找可以合并的段
+    Device_GPIO_bus_segment *ps = NULL;
+    for (uint8_t j = 0; j < pb->segment_count; ++j) {
+      if (pb->segments[j].port == pd->port && pb->segments[j].shift == shift) {
+        ps = &pb->segments[j];
+        break;
+      }
+    }
+    if (ps == NULL) {
+      // 新段插在同端口的段之后, 使同一端口的段相邻, 读取时端口只读一次
+      uint8_t pos = pb->segment_count;
+      for (uint8_t j = 0; j < pb->segment_count; ++j) {
+        if (pb->segments[j].port == pd->port) pos = j + 1;
+      }
+      for (uint8_t j = pb->segment_count; j > pos; --j) {
+        pb->segments[j] = pb->segments[j - 1];
+      }
+      ++pb->segment_count;
+      ps = &pb->segments[pos];
+      ps->port = pd->port;
+      ps->mask = 0;
+      ps->shift = shift;
+    }
+    ps->mask |= pd->pin;
+  }
+
+  return ESUCCESS;
+}
+
+errno_t Device_GPIO_bus_read(const Device_GPIO_bus *const pb, uint32_t *rt_value_ptr) {
+  if (pb == NULL || rt_value_ptr == NULL || driver_ops == NULL) return EINVAL;
+
+  errno_t err = ESUCCESS;
+  uint32_t value = 0;
+  // 同一个端口只读取一次, 保证同一端口上的引脚是同一时刻的值
+  void *last_port = NULL;
+  uint16_t port_value = 0;
+
+  for (uint8_t i = 0; i < pb->segment_count; ++i) {
+    const Device_GPIO_bus_segment *const ps = &pb->segments[i];
+    if (ps->port != last_port) {
+      err = driver_ops->read_port(ps->port, &port_value);
+      if (err) return err;
+      last_port = ps->port;
+    }
+
+    const uint32_t bits = port_value & ps->mask;
+    value |= ps->shift >= 0 ? bits << ps->shift : bits >> -ps->shift;
+  }
+
+  *rt_value_ptr = value;
+  return ESUCCESS;
+}
+
 static errno_t init(const Device_GPIO *const pd) {
   if (pd == NULL) return EINVAL;
 
@@ -74,6 +153,14 @@ static errno_t set_EXTI_handle(const Device_GPIO *const pd, Device_GPIO_EXTI_tri
   return driver_ops->set_EXTI_handle(pd, trigger, callback);
 }
 
+static errno_t save_EXTI_handle(const Device_GPIO *const pd) {
+  return driver_ops->save_EXTI_handle(pd);
+}
+
+static errno_t restore_EXTI_handle(const Device_GPIO *const pd) {
+  return driver_ops->restore_EXTI_handle(pd);
+}
+
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
   return ((Device_GPIO *)pd)->name == *((Device_GPIO_name *)name);
 }
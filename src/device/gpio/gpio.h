@@ -38,17 +38,47 @@ typedef struct Device_GPIO {
   const struct Device_GPIO_ops *ops;
 } Device_GPIO;
 
+// GPIO 总线最多包含的引脚数量
+#define DEVICE_GPIO_BUS_WIDTH_MAX 16
+
+/**
+ * @brief GPIO 总线的一段
+ * 同一个端口上, 在总线中的位号与引脚号差值相同的引脚合并为一段, 读取时只需一次与运算和一次移位
+ */
+typedef struct {
+  void *port;
+  uint16_t mask;
+  int8_t shift; // 总线位号 - 引脚号, 正数左移, 负数右移
+} Device_GPIO_bus_segment;
+
+/**
+ * @brief GPIO 总线
+ * 将若干个引脚的值组合为一个整数, 第 i 个引脚对应第 i 位, 每个端口只读取一次输入寄存器
+ */
+typedef struct Device_GPIO_bus {
+  uint8_t width;
+  uint8_t segment_count;
+  Device_GPIO_bus_segment segments[DEVICE_GPIO_BUS_WIDTH_MAX];
+} Device_GPIO_bus;
+
 typedef struct Device_GPIO_ops {
   errno_t (*init)(const Device_GPIO *const pd);
   errno_t (*read)(const Device_GPIO *const pd, Pin_value *value_ptr);
   errno_t (*write)(const Device_GPIO *const pd, const Pin_value value);
   errno_t (*set_EXTI_handle)(const Device_GPIO *const pd, Device_GPIO_EXTI_trigger trigger, void (*callback)(void));
+  // 同一条中断线被多个引脚分时使用时, 借用前保存原配置, 用完后恢复
+  errno_t (*save_EXTI_handle)(const Device_GPIO *const pd);
+  errno_t (*restore_EXTI_handle)(const Device_GPIO *const pd);
 } Device_GPIO_ops;
 
 typedef struct Driver_GPIO_ops {
   errno_t (*read)(const Device_GPIO *const pd, Pin_value *value_ptr);
+  // 读取整个端口的输入寄存器
+  errno_t (*read_port)(void *const port, uint16_t *rt_value_ptr);
   errno_t (*write)(const Device_GPIO *const pd, const Pin_value value);
   errno_t (*set_EXTI_handle)(const Device_GPIO *const pd, Device_GPIO_EXTI_trigger trigger, void (*callback)(void));
+  errno_t (*save_EXTI_handle)(const Device_GPIO *const pd);
+  errno_t (*restore_EXTI_handle)(const Device_GPIO *const pd);
 } Driver_GPIO_ops;
 
 errno_t Device_GPIO_module_init(void);
@@ -56,3 +86,7 @@ errno_t Device_GPIO_register(Device_GPIO *const pd);
 errno_t Device_GPIO_find(Device_GPIO **pd_ptr, const Device_GPIO_name name);
 
 errno_t Device_GPIO_EXTI_callback(Device_GPIO *pd);
+
+// GPIO 总线
+errno_t Device_GPIO_bus_init(Device_GPIO_bus *const pb, Device_GPIO *const pins[], const uint8_t pin_count);
+errno_t Device_GPIO_bus_read(const Device_GPIO_bus *const pb, uint32_t *rt_value_ptr);
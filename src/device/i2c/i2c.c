@@ -1,15 +1,34 @@
 #include "i2c.h"
 #include "common/list/list.h"
-#include "common/ring_buffer/ring_buffer.h"
+#include "common/timebase/timebase.h"
+#include "common/critical/critical.h"
 #include "driver/i2c/i2c.h"
 #include <stdlib.h>
 
 #define MAX_MSG_LEN 0xFFFF
+// 传输超时时间, 400kHz 下每毫秒约 44 字节, 另外留出从机拉住时钟的时间
+#define TIMEOUT_MS(len) (5 + (len) / 16)
+
+// 同步传输的完成标志, 放在调用方的栈上
+typedef struct {
+  volatile bool done;
+  volatile errno_t err;
+} Sync_state;
 
 static errno_t init(Device_I2C *const pd);
 static errno_t is_device_ready(const Device_I2C *const pd, uint16_t slave_addr, uint32_t trial_num, uint32_t timeout);
 static errno_t receive(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *data, uint32_t len);
 static errno_t transmit(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint32_t len);
+static errno_t transfer(const Device_I2C *const pd, Device_I2C_transaction *const pt);
+static errno_t submit(const Device_I2C *const pd, Device_I2C_transaction *const pt);
+static errno_t is_busy(const Device_I2C *const pd, bool *rt_busy_ptr);
+
+// 内部方法 - 排队传输
+static void queue_run(const Device_I2C *const pd);
+static errno_t transaction_start(const Device_I2C *const pd, Device_I2C_transaction *const pt);
+static void transaction_finish(const Device_I2C *const pd, errno_t err);
+static void transaction_timeout(void *arg);
+static void sync_done(Device_I2C_transaction *pt, errno_t err);
 
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
@@ -18,12 +37,24 @@ static const Device_I2C_ops device_ops = {
   .is_device_ready = is_device_ready,
   .receive = receive,
   .transmit = transmit,
+  .transfer = transfer,
+  .submit = submit,
+  .is_busy = is_busy,
 };
 
 static List *list = NULL;
 static const Driver_I2C_ops *driver_ops = NULL;
-static volatile uint8_t receiving[DEVICE_I2C_COUNT] = {0};
-static volatile uint8_t transmitting[DEVICE_I2C_COUNT] = {0};
+static volatile uint8_t lockeds[DEVICE_I2C_COUNT] = {0};
+// 每个优先级一个先进先出队列, 以及正在执行的排队传输
+static Device_I2C_transaction *queue_heads[DEVICE_I2C_COUNT][DEVICE_I2C_PRIORITY_COUNT] = {0};
+static Device_I2C_transaction *queue_tails[DEVICE_I2C_COUNT][DEVICE_I2C_PRIORITY_COUNT] = {0};
+static Device_I2C_transaction *volatile currents[DEVICE_I2C_COUNT] = {0};
+// 完成中断和超时定时器可能同时结束同一个传输, 先置位的一方负责结束
+static volatile uint8_t finishings[DEVICE_I2C_COUNT] = {0};
+static Timebase_timer timeout_timers[DEVICE_I2C_COUNT] = {0};
+// 多字节寄存器传输分两段: 先用中断发送寄存器地址(高字节在前), 发送完成中断中再开始 DMA 数据段
+static uint8_t reg_bufs[DEVICE_I2C_COUNT][2] = {0};
+static volatile uint8_t reg_phases[DEVICE_I2C_COUNT] = {0};
 
 errno_t Device_I2C_module_init(void) {
   if (driver_ops == NULL) {
@@ -51,12 +82,31 @@ errno_t Device_I2C_find(Device_I2C **pd_ptr, const Device_I2C_name name) {
 }
 
 errno_t Device_I2C_MasterTxCpltCallback(const Device_I2C *const pd) {
-  transmitting[pd->name] = 0;
+  if (reg_phases[pd->name] == 0) {
+    transaction_finish(pd, ESUCCESS);
+    return ESUCCESS;
+  }
+
+  // 寄存器地址已发送, 没有停止条件, 接着开始数据段: 写入时直接继续发送, 读取时产生重复起始条件
+  reg_phases[pd->name] = 0;
+  Device_I2C_transaction *const pt = currents[pd->name];
+  if (pt == NULL) return ESUCCESS;
+  errno_t err = pt->direction == DEVICE_I2C_WRITE
+    ? driver_ops->seq_transmit_DMA(pd, pt->slave_addr, pt->data, pt->len, DEVICE_I2C_FRAME_LAST)
+    : driver_ops->seq_receive_DMA(pd, pt->slave_addr, pt->data, pt->len, DEVICE_I2C_FRAME_LAST);
+  if (err) transaction_finish(pd, err);
   return ESUCCESS;
 }
 
 errno_t Device_I2C_MasterRxCpltCallback(const Device_I2C *const pd) {
-  receiving[pd->name] = 0;
+  transaction_finish(pd, ESUCCESS);
+  return ESUCCESS;
+}
+
+errno_t Device_I2C_ErrorCallback(const Device_I2C *const pd) {
+  errno_t err = EIO;
+  driver_ops->get_error(pd, &err);
+  transaction_finish(pd, err == ESUCCESS ? EIO : err);
   return ESUCCESS;
 }
 
@@ -67,50 +117,57 @@ static inline uint8_t match_device_by_name(const void *const name, const void *c
 static errno_t init(Device_I2C *const pd) {
   if (pd == NULL) return EINVAL;
 
-  return driver_ops->get_own_addr(pd, &pd->own_addr);
+  errno_t err = timebase_init();
+  if (err) return err;
 
-  return ESUCCESS;
+  return driver_ops->get_own_addr(pd, &pd->own_addr);
 }
 
+/**
+ * @brief 查询从机是否应答
+ * HAL 的查询是阻塞的, 需要等待排队传输结束并暂停队列, 查询期间提交的传输在结束后开始
+ * @param pd
+ * @param slave_addr
+ * @param trial_num
+ * @param timeout
+ * @return errno_t
+ */
 static errno_t is_device_ready(const Device_I2C *const pd, uint16_t slave_addr, uint32_t trial_num, uint32_t timeout) {
   if (pd == NULL) return EINVAL;
 
+  while (1) {
+    const uint32_t primask = enter_critical();
+    if (lockeds[pd->name] == 0 && currents[pd->name] == NULL) {
+      lockeds[pd->name] = 1;
+      exit_critical(primask);
+      break;
+    }
+    exit_critical(primask);
+  }
+
   errno_t err = driver_ops->is_device_ready(pd, slave_addr, trial_num, timeout);
-  if (err) return err;
 
-  return ESUCCESS;
+  lockeds[pd->name] = 0;
+  queue_run(pd);
+
+  return err;
 }
 
 static errno_t transmit(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint32_t len) {
   if (pd == NULL || data == NULL || len == 0) return EINVAL;
 
-  uint32_t cur_idx = 0;
-  uint32_t cur_len = 0;
-
-  do {
-    if (len > MAX_MSG_LEN) {
-      cur_len = MAX_MSG_LEN;
-      len -= MAX_MSG_LEN;
-    } else {
-      cur_len = len;
-      len = 0;
-    }
-
-    transmitting[pd->name] = 1;
-    errno_t err = ESUCCESS;
-    if (cur_len == 1) {
-      err = driver_ops->master_transmit_IT(pd, slave_addr, data + cur_idx, cur_len);
-    } else {
-      err = driver_ops->master_transmit_DMA(pd, slave_addr, data + cur_idx, cur_len);
-    }
-    if (err) {
-      transmitting[pd->name] = 0;
-      return err;
-    }
-    while (transmitting[pd->name]);
+  Device_I2C_transaction transaction = {
+    .slave_addr = slave_addr,
+    .direction = DEVICE_I2C_WRITE,
+    .priority = DEVICE_I2C_PRIORITY_LOW,
+  };
 
-    cur_idx += cur_len;
-  } while (len > 0);
+  for (uint32_t idx = 0; idx < len; idx += MAX_MSG_LEN) {
+    transaction.data = data + idx;
+    transaction.len = len - idx > MAX_MSG_LEN ? MAX_MSG_LEN : len - idx;
+    errno_t err = transfer(pd, &transaction);
+    if (err) return err;
+  }
 
   return ESUCCESS;
 }
@@ -118,33 +175,181 @@ static errno_t transmit(const Device_I2C *const pd, uint16_t slave_addr, uint8_t
 static errno_t receive(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *data, uint32_t len) {
   if (pd == NULL || data == NULL || len == 0) return EINVAL;
 
-  uint32_t cur_idx = 0;
-  uint32_t cur_len = 0;
+  Device_I2C_transaction transaction = {
+    .slave_addr = slave_addr,
+    .direction = DEVICE_I2C_READ,
+    .priority = DEVICE_I2C_PRIORITY_LOW,
+  };
 
-  do {
-    if (len > MAX_MSG_LEN) {
-      cur_len = MAX_MSG_LEN;
-      len -= MAX_MSG_LEN;
-    } else {
-      cur_len = len;
-      len = 0;
+  for (uint32_t idx = 0; idx < len; idx += MAX_MSG_LEN) {
+    transaction.data = data + idx;
+    transaction.len = len - idx > MAX_MSG_LEN ? MAX_MSG_LEN : len - idx;
+    errno_t err = transfer(pd, &transaction);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+// 排队后等待完成, 会覆盖 pt 的 callback 和 arg
+static errno_t transfer(const Device_I2C *const pd, Device_I2C_transaction *const pt) {
+  if (pd == NULL || pt == NULL) return EINVAL;
+
+  Sync_state state = { .done = false, .err = ESUCCESS };
+  pt->callback = sync_done;
+  pt->arg = &state;
+
+  errno_t err = submit(pd, pt);
+  if (err) return err;
+  while (!state.done);
+
+  return state.err;
+}
+
+static errno_t submit(const Device_I2C *const pd, Device_I2C_transaction *const pt) {
+  if (pd == NULL || pt == NULL || pt->priority >= DEVICE_I2C_PRIORITY_COUNT || pt->reg_len > 2) return EINVAL;
+  if (pt->data == NULL || pt->len == 0) return EINVAL;
+
+  pt->next = NULL;
+
+  const uint32_t primask = enter_critical();
+  if (queue_tails[pd->name][pt->priority] == NULL) {
+    queue_heads[pd->name][pt->priority] = pt;
+  } else {
+    queue_tails[pd->name][pt->priority]->next = pt;
+  }
+  queue_tails[pd->name][pt->priority] = pt;
+  exit_critical(primask);
+
+  queue_run(pd);
+
+  return ESUCCESS;
+}
+
+static errno_t is_busy(const Device_I2C *const pd, bool *rt_busy_ptr) {
+  if (pd == NULL || rt_busy_ptr == NULL) return EINVAL;
+
+  bool busy = currents[pd->name] != NULL;
+  for (Device_I2C_priority priority = 0; priority < DEVICE_I2C_PRIORITY_COUNT; ++priority) {
+    if (queue_heads[pd->name][priority] != NULL) busy = true;
+  }
+  *rt_busy_ptr = busy;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 总线空闲且没有被占用时, 取出优先级最高的排队传输并开始
+ * 在提交, 查询结束和上一个传输结束(中断)时调用
+ * @param pd
+ */
+static void queue_run(const Device_I2C *const pd) {
+  while (1) {
+    Device_I2C_transaction *pt = NULL;
+
+    const uint32_t primask = enter_critical();
+    if (lockeds[pd->name] == 0 && currents[pd->name] == NULL) {
+      for (Device_I2C_priority priority = 0; priority < DEVICE_I2C_PRIORITY_COUNT; ++priority) {
+        pt = queue_heads[pd->name][priority];
+        if (pt == NULL) continue;
+        queue_heads[pd->name][priority] = pt->next;
+        if (pt->next == NULL) queue_tails[pd->name][priority] = NULL;
+        pt->next = NULL;
+        break;
+      }
+      currents[pd->name] = pt;
     }
+    exit_critical(primask);
 
-    receiving[pd->name] = 1;
-    errno_t err = ESUCCESS;
-    if (cur_len == 1) {
-      err = driver_ops->master_receive_IT(pd, slave_addr, data + cur_idx, cur_len);
-    } else {
-      err = driver_ops->master_receive_DMA(pd, slave_addr, data + cur_idx, cur_len);
+    if (pt == NULL) return;
+
+    errno_t err = transaction_start(pd, pt);
+    if (err == ESUCCESS) return;
+
+    // 没有开始的传输直接结束, 继续下一个
+    timebase_timer_stop(&timeout_timers[pd->name]);
+    currents[pd->name] = NULL;
+    if (pt->callback != NULL) pt->callback(pt, err);
+  }
+}
+
+/**
+ * @brief 开始一个排队传输, 可能在中断中执行, 只调用中断或 DMA 方式的 HAL 函数
+ * 单字节用中断传输, 多字节用 DMA; 带寄存器地址的多字节传输先用中断发送地址, 见 Device_I2C_MasterTxCpltCallback
+ * HAL 的 Mem_*_DMA 以查询方式发送地址, 依赖 SysTick 计时, 在优先级更高的中断中调用会一直等待, 这里不使用
+ * @param pd
+ * @param pt
+ * @return errno_t
+ */
+static errno_t transaction_start(const Device_I2C *const pd, Device_I2C_transaction *const pt) {
+  errno_t err = timebase_timer_start(&timeout_timers[pd->name], TIMEOUT_MS(pt->len), 0, transaction_timeout, (void *)pd);
+  if (err) return err;
+
+  const bool use_dma = pt->len > 1;
+  if (pt->reg_len > 0) {
+    if (use_dma == false) {
+      return pt->direction == DEVICE_I2C_WRITE
+        ? driver_ops->mem_write_IT(pd, pt->slave_addr, pt->reg, pt->reg_len, pt->data, pt->len)
+        : driver_ops->mem_read_IT(pd, pt->slave_addr, pt->reg, pt->reg_len, pt->data, pt->len);
     }
-    if (err) {
-      receiving[pd->name] = 0;
-      return err;
+
+    uint8_t *const reg_buf = reg_bufs[pd->name];
+    if (pt->reg_len == 1) {
+      reg_buf[0] = (uint8_t)pt->reg;
+    } else {
+      reg_buf[0] = (uint8_t)(pt->reg >> 8);
+      reg_buf[1] = (uint8_t)pt->reg;
     }
-    while (receiving[pd->name]);
+    reg_phases[pd->name] = 1;
+    err = driver_ops->seq_transmit_IT(pd, pt->slave_addr, reg_buf, pt->reg_len > 1 ? 2 : 1, DEVICE_I2C_FRAME_FIRST);
+    if (err) reg_phases[pd->name] = 0;
+    return err;
+  }
 
-    cur_idx += cur_len;
-  } while (len > 0);
+  if (pt->direction == DEVICE_I2C_WRITE) {
+    return use_dma
+      ? driver_ops->master_transmit_DMA(pd, pt->slave_addr, pt->data, pt->len)
+      : driver_ops->master_transmit_IT(pd, pt->slave_addr, pt->data, pt->len);
+  }
+  return use_dma
+    ? driver_ops->master_receive_DMA(pd, pt->slave_addr, pt->data, pt->len)
+    : driver_ops->master_receive_IT(pd, pt->slave_addr, pt->data, pt->len);
+}
 
-  return ESUCCESS;
+/**
+ * @brief 结束正在执行的传输, 回调后开始下一个
+ * 无应答时 HAL 已经发出停止条件, 其他错误和超时时外设状态不确定, 先恢复总线再开始下一个
+ * @param pd
+ * @param err
+ */
+static void transaction_finish(const Device_I2C *const pd, errno_t err) {
+  const uint32_t primask = enter_critical();
+  Device_I2C_transaction *const pt = currents[pd->name];
+  if (pt == NULL || finishings[pd->name]) {
+    exit_critical(primask);
+    return;
+  }
+  finishings[pd->name] = 1;
+  exit_critical(primask);
+
+  timebase_timer_stop(&timeout_timers[pd->name]);
+  reg_phases[pd->name] = 0;
+  if (err != ESUCCESS && err != ENXIO) driver_ops->recover(pd);
+
+  currents[pd->name] = NULL;
+  finishings[pd->name] = 0;
+  if (pt->callback != NULL) pt->callback(pt, err);
+
+  queue_run(pd);
+}
+
+// 在 SysTick 中断中执行, 完成中断没有到来, 例如从机一直拉住时钟
+static void transaction_timeout(void *arg) {
+  transaction_finish((const Device_I2C *)arg, ETIMEDOUT);
+}
+
+static void sync_done(Device_I2C_transaction *pt, errno_t err) {
+  Sync_state *const ps = pt->arg;
+  ps->err = err;
+  ps->done = true;
 }
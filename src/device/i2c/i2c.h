@@ -2,27 +2,84 @@
 
 #include "common/errno/errno.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef enum {
   DEVICE_I2C_1,
   DEVICE_I2C_COUNT,
 } Device_I2C_name;
 
+// 排队传输的优先级, 高优先级的传输先执行, 同一优先级按提交顺序执行
+typedef enum {
+  DEVICE_I2C_PRIORITY_HIGH,
+  DEVICE_I2C_PRIORITY_LOW,
+  DEVICE_I2C_PRIORITY_COUNT,
+} Device_I2C_priority;
+
+typedef enum {
+  DEVICE_I2C_WRITE,
+  DEVICE_I2C_READ,
+} Device_I2C_direction;
+
+struct Device_I2C_transaction;
+/**
+ * 传输完成回调, 在 I2C/DMA 中断或 SysTick 中断(超时)中执行, 可以在回调中提交新的传输
+ * 从机无应答时 err 为 ENXIO, 超时为 ETIMEDOUT, 总线错误为 EIO
+ */
+typedef void Device_I2C_transaction_callback(struct Device_I2C_transaction *pt, errno_t err);
+
+/**
+ * @brief 排队执行的一次传输
+ * reg_len 为 0 时为普通的发送或接收
+ * reg_len 为 1 或 2 时先发送寄存器地址 reg, 写入时接着发送数据; 读取时用重复起始条件接着读取, 中间没有停止条件
+ * 由调用方分配内存(一般为静态变量), 回调之前不能修改
+ */
+typedef struct Device_I2C_transaction {
+  uint16_t slave_addr;
+  Device_I2C_direction direction;
+  uint16_t reg;
+  uint8_t reg_len;
+  uint8_t *data;
+  uint16_t len;
+  Device_I2C_priority priority;
+  Device_I2C_transaction_callback *callback;
+  void *arg;
+  // 以下由 I2C 设备使用
+  struct Device_I2C_transaction *next;
+} Device_I2C_transaction;
+
+// 分段传输中一段的位置, FIRST 结束时不产生停止条件, LAST 在方向不变时接着发送, 方向改变时产生重复起始条件
+typedef enum {
+  DEVICE_I2C_FRAME_FIRST,
+  DEVICE_I2C_FRAME_LAST,
+} Device_I2C_frame;
+
 struct Device_I2C;
 struct Device_I2C_ops;
 
 typedef struct Device_I2C {
   const Device_I2C_name name;
   void *const instance;
+  // 总线恢复时用 GPIO 产生时钟
+  void *const scl_port;
+  const uint16_t scl_pin;
+  void *const sda_port;
+  const uint16_t sda_pin;
   uint16_t own_addr;
   const struct Device_I2C_ops *ops;
 } Device_I2C;
 
 typedef struct Device_I2C_ops {
   errno_t (*init)(Device_I2C *const pd);
+  // 等待排队传输结束后占用总线查询, 只能在主循环中调用
   errno_t (*is_device_ready)(const Device_I2C *const pd, uint16_t slave_addr, uint32_t trial_num, uint32_t timeout);
+  // 以下为排队传输的同步版本, 等待完成后返回, 只能在主循环中调用
   errno_t (*transmit)(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint32_t len);
   errno_t (*receive)(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *rt_data, uint32_t len);
+  errno_t (*transfer)(const Device_I2C *const pd, Device_I2C_transaction *const pt);
+  // 提交排队传输后立即返回, 总线空闲时立即开始, 前一个传输在中断中结束时接着开始下一个
+  errno_t (*submit)(const Device_I2C *const pd, Device_I2C_transaction *const pt);
+  errno_t (*is_busy)(const Device_I2C *const pd, bool *rt_busy_ptr);
 } Device_I2C_ops;
 
 typedef struct Driver_I2C_ops {
@@ -34,11 +91,27 @@ typedef struct Driver_I2C_ops {
   errno_t (*master_transmit_IT)(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len);
   errno_t (*master_receive_DMA)(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *rt_data, uint16_t len);
   errno_t (*master_transmit_DMA)(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len);
+  // 先发送寄存器地址的组合传输, 全部由中断驱动
+  errno_t (*mem_read_IT)(const Device_I2C *const pd, uint16_t slave_addr, uint16_t reg, uint8_t reg_len, uint8_t *rt_data, uint16_t len);
+  errno_t (*mem_write_IT)(const Device_I2C *const pd, uint16_t slave_addr, uint16_t reg, uint8_t reg_len, uint8_t *const data, uint16_t len);
+  /**
+   * 分段传输, 用于寄存器地址之后的 DMA 传输: 先用中断发送地址(FIRST), 完成回调中再开始 DMA 段(LAST)
+   * HAL 的 Mem_*_DMA 用查询方式发送地址, 超时依赖 SysTick, 不能在中断中调用
+   */
+  errno_t (*seq_transmit_IT)(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len, Device_I2C_frame frame);
+  errno_t (*seq_transmit_DMA)(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len, Device_I2C_frame frame);
+  errno_t (*seq_receive_DMA)(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *rt_data, uint16_t len, Device_I2C_frame frame);
+  // 读取上一次传输的错误, 无应答为 ENXIO
+  errno_t (*get_error)(const Device_I2C *const pd, errno_t *rt_err_ptr);
+  // 复位外设, 并用 GPIO 产生时钟释放被从机拉住的 SDA
+  errno_t (*recover)(const Device_I2C *const pd);
 } Driver_I2C_ops;
 
 errno_t Device_I2C_module_init(void);
 errno_t Device_I2C_register(Device_I2C *const pd);
 errno_t Device_I2C_find(Device_I2C **pd_ptr, const Device_I2C_name name);
 
+// 发送/接收/组合传输完成和出错时在中断中调用
 errno_t Device_I2C_MasterTxCpltCallback(const Device_I2C *const pd);
 errno_t Device_I2C_MasterRxCpltCallback(const Device_I2C *const pd);
+errno_t Device_I2C_ErrorCallback(const Device_I2C *const pd);
@@ -1,6 +1,6 @@
 #include "irda.h"
 #include "common/list/list.h"
-#include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
 #include "common/ring_buffer/ring_buffer.h"
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +8,11 @@
 
 #define NUM_IS_VALUE(num, value, margin) ((uint32_t)num >= (uint32_t)value - (uint32_t)margin && (uint32_t)num <= (uint32_t)value + (uint32_t)margin)
 
+// 命令队列长度(字节)
+#define CMD_QUEUE_SIZE 0x10
+// read 等待命令的超时时间(毫秒)
+#define READ_TIMEOUT_MS 1000
+
 typedef enum {
   STATE_IDLE,
   STATE_LEADER_FIRST,
@@ -15,24 +20,36 @@ typedef enum {
   STATE_DATA,
 } IRDA_state;
 
+// 各段电平持续时间, 单位为微秒
 typedef enum {
-  CODE_LEADER_FIRST = 900,
-  CODE_LEADER_SECOND = 450,
-  CODE_LEADER_REPEAT_SECOND = 225,
-  CODE_DATA_FIRST = 56,
-  CODE_DATA_0_SECOND = 56,
-  CODE_DATA_1_SECOND = 169
+  CODE_LEADER_FIRST = 9000,
+  CODE_LEADER_SECOND = 4500,
+  CODE_LEADER_REPEAT_SECOND = 2250,
+  CODE_DATA_FIRST = 560,
+  CODE_DATA_0_SECOND = 560,
+  CODE_DATA_1_SECOND = 1690
 } IRDA_code;
 
+/**
+ * @brief 解码器状态, 只在外部中断回调中修改
+ */
+typedef struct {
+  IRDA_state state;
+  uint32_t last_edge_us; // 上一个跳变沿的时间戳
+  uint32_t data; // 已收到的数据位, 低位先收
+  uint8_t bit_idx; // 已收到的数据位数量
+  bool second_half; // 当前是否处于数据位的后半部分
+} IRDA_decoder;
+
 // 对象方法
 static errno_t init(Device_IRDA *const pd);
 static errno_t read(Device_IRDA *const pd, Device_IRDA_cmd *rt_cmd_ptr);
 
 // 内部方法
-// 解码
-static errno_t decode(Device_IRDA *const pd, Device_IRDA_cmd *rt_cmd_ptr);
-// 读取 tick
-static errno_t read_tick(Device_IRDA *const pd, uint32_t *rt_tick_ptr, uint32_t timeout);
+// 根据两次跳变沿之间的时间推进解码状态机
+static errno_t decode_edge(Device_IRDA *const pd, uint32_t diff);
+// 解码出一帧完整数据后校验并写入命令队列
+static errno_t decode_frame(Device_IRDA *const pd, uint32_t data);
 // 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
@@ -42,7 +59,9 @@ static const Device_IRDA_ops device_ops = {
 };
 
 static List *list = NULL;
-static Ring_buffer *ring_buffers[DEVICE_IRDA_COUNT] = {0};
+// 已解码的命令队列, 在中断中写入, 在 read 中读出
+static Ring_buffer *cmd_queues[DEVICE_IRDA_COUNT] = {0};
+static IRDA_decoder decoders[DEVICE_IRDA_COUNT] = {0};
 static Device_IRDA_cmd last_cmds[DEVICE_IRDA_COUNT] = {0};
 
 errno_t Device_IRDA_module_init(void) {
@@ -70,24 +89,22 @@ errno_t Device_IRDA_find(Device_IRDA **pd_ptr, const Device_IRDA_name name) {
   return ESUCCESS;
 }
 
-// 外部中断回调
+/**
+ * @brief 外部中断回调
+ * 用 timebase 的微秒时间戳测量两次跳变沿的间隔, 在中断中直接增量解码
+ * 不再需要 10 微秒一次的定时器中断来维护计数
+ */
 errno_t Device_IRDA_in_EXTI_callback(Device_IRDA *const pd) {
   if (pd == NULL) return EINVAL;
+  if (cmd_queues[pd->name] == NULL) return EINVAL;
 
-  Ring_buffer *const rb = ring_buffers[pd->name];
-  if (rb == NULL) return EINVAL;
-
-  errno_t err = ESUCCESS;
-
-  uint32_t tick = 0;
-  err = pd->timer->ops->get_count(pd->timer, &tick);
-  if (err) return err;
+  const uint32_t now = now_us();
+  IRDA_decoder *const dec = &decoders[pd->name];
 
-  // 读出的时候也是直接读出4位然后转换指针, 所以这里不用特殊处理大小端
-  err = rb->ops->write(rb, (uint8_t *)&tick, sizeof(uint32_t));
-  if (err) return err;
+  const uint32_t diff = now - dec->last_edge_us;
+  dec->last_edge_us = now;
 
-  return ESUCCESS;
+  return decode_edge(pd, diff);
 }
 
 static errno_t init(Device_IRDA *const pd) {
@@ -95,160 +112,134 @@ static errno_t init(Device_IRDA *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->timer->ops->init(pd->timer);
-  if (err) return err;
-  
-  // 计时单位为10微秒, 因为 irda 信号的最小单位为 10 微秒
-  err = pd->timer->ops->set_period(pd->timer, 10);
-  if (err) return err;
-  
-  err = pd->timer->ops->start(pd->timer, DEVICE_TIMER_START_MODE_IT);
+  err = timebase_init();
   if (err) return err;
 
-  if (ring_buffers[pd->name] == NULL) {
-    err = Ring_buffer_create(&ring_buffers[pd->name], sizeof(uint32_t) * 0x100);
+  if (cmd_queues[pd->name] == NULL) {
+    err = Ring_buffer_create(&cmd_queues[pd->name], CMD_QUEUE_SIZE);
     if (err) return err;
   }
 
+  memset(&decoders[pd->name], 0, sizeof(IRDA_decoder));
+  decoders[pd->name].state = STATE_IDLE;
+
   err = pd->in->ops->init(pd->in);
   if (err) return err;
 
   return ESUCCESS;
 }
 
+/**
+ * @brief 从命令队列中读取一条命令, 队列为空时最多等待 READ_TIMEOUT_MS 毫秒
+ */
 static errno_t read(Device_IRDA *const pd, Device_IRDA_cmd *rt_cmd_ptr) {
   if (pd == NULL || rt_cmd_ptr == NULL) return EINVAL;
-  return decode(pd, rt_cmd_ptr);
-}
-
-static errno_t decode(Device_IRDA *const pd, Device_IRDA_cmd *rt_cmd_ptr) {
-  if (pd == NULL || rt_cmd_ptr == NULL) return EINVAL;
-  Ring_buffer *rb = ring_buffers[pd->name];
+  Ring_buffer *const rb = cmd_queues[pd->name];
   if (rb == NULL) return EINVAL;
 
   errno_t err = ESUCCESS;
+  uint8_t cmd = 0;
+  uint32_t read_len = 0;
+  const uint32_t begin = now_ms();
 
-  IRDA_state state = STATE_IDLE;
-  const uint32_t timeout = 1000;
-  uint32_t cur_tick = 0;
-  uint32_t last_tick = 0;
+  do {
+    err = rb->ops->read(rb, &cmd, &read_len, 1);
+    if (err) return err;
+    if (read_len == 1) {
+      *rt_cmd_ptr = cmd;
+      return ESUCCESS;
+    }
+  } while (now_ms() - begin < READ_TIMEOUT_MS);
 
-  while (true) {
-    switch (state) {
-      // 初始状态
-      case STATE_IDLE: {
-        err = read_tick(pd, &cur_tick, timeout);
-        if (err) return err;
+  return ETIMEDOUT;
+}
 
-        last_tick = cur_tick;
-        state = STATE_LEADER_FIRST;
+static errno_t decode_edge(Device_IRDA *const pd, uint32_t diff) {
+  IRDA_decoder *const dec = &decoders[pd->name];
 
-        break;
+  switch (dec->state) {
+    // 初始状态, 当前沿作为引导码起点
+    case STATE_IDLE: {
+      dec->state = STATE_LEADER_FIRST;
+      return ESUCCESS;
+    }
+    // 处理引导码前半部, 不匹配时把当前沿当作新的起点
+    case STATE_LEADER_FIRST: {
+      if (NUM_IS_VALUE(diff, CODE_LEADER_FIRST, CODE_LEADER_FIRST / 10)) {
+        dec->state = STATE_LEADER_SECOND;
+      }
+      return ESUCCESS;
+    }
+    // 处理引导码后半部
+    case STATE_LEADER_SECOND: {
+      if (NUM_IS_VALUE(diff, CODE_LEADER_SECOND, CODE_LEADER_SECOND / 10)) {
+        dec->state = STATE_DATA;
+        dec->data = 0;
+        dec->bit_idx = 0;
+        dec->second_half = false;
+        return ESUCCESS;
       }
-      // 处理引导码前半部
-      case STATE_LEADER_FIRST: {
-        err = read_tick(pd, &cur_tick, timeout);
-        if (err) return err;
-
-        const uint32_t diff = cur_tick - last_tick;
-        last_tick = cur_tick;
-
-        if (NUM_IS_VALUE(diff, CODE_LEADER_FIRST, CODE_LEADER_FIRST / 10)) {
-          state = STATE_LEADER_SECOND;
-        } else {
-          state = STATE_IDLE;
-        }
 
-        break;
+      if (NUM_IS_VALUE(diff, CODE_LEADER_REPEAT_SECOND, CODE_LEADER_REPEAT_SECOND / 10)) {
+        // 引导码(重复)获取上次命令
+        dec->state = STATE_IDLE;
+        if (last_cmds[pd->name] == DEVICE_IRDA_CMD_NONE) return ESUCCESS;
+        const uint8_t cmd = last_cmds[pd->name];
+        return cmd_queues[pd->name]->ops->write(cmd_queues[pd->name], &cmd, 1);
       }
-      // 处理引导码后半部
-      case STATE_LEADER_SECOND: {
-        err = read_tick(pd, &cur_tick, timeout);
-        if (err) return err;
-
-        const uint32_t diff = cur_tick - last_tick;
-        last_tick = cur_tick;
-
-        if (NUM_IS_VALUE(diff, CODE_LEADER_SECOND, CODE_LEADER_SECOND / 10)) {
-          state = STATE_DATA;
-        } else if (NUM_IS_VALUE(diff, CODE_LEADER_REPEAT_SECOND, CODE_LEADER_REPEAT_SECOND / 10)) {
-          // 引导码(重复)获取上次命令
-          *rt_cmd_ptr = last_cmds[pd->name];
-          return ESUCCESS;
+
+      dec->state = STATE_LEADER_FIRST;
+      return ESUCCESS;
+    }
+    // 处理数据, 每一位由前半部分和后半部分两个电平组成
+    case STATE_DATA: {
+      if (!dec->second_half) {
+        if (NUM_IS_VALUE(diff, CODE_DATA_FIRST, CODE_DATA_FIRST / 5)) {
+          dec->second_half = true;
         } else {
-          state = STATE_IDLE;
+          dec->state = STATE_LEADER_FIRST;
         }
-        
-        break;
+        return ESUCCESS;
       }
-      // 获取及处理数据
-      case STATE_DATA: {
-        // 每次发送 4 个字节数据, 分别是 地址 -> 地址反码 -> 命令 -> 命令反码
-        uint8_t bytes[4] = {0};
-
-        for (uint8_t byte_idx = 0; byte_idx < 4; byte_idx++) {
-          for (uint8_t bit_idx = 0; bit_idx < 8; bit_idx++) {
-            // 每一个数据位的前半部分和后半部分电平持续事件
-            uint32_t diffs[2] = {0};
-
-            for (uint8_t i = 0; i < 2; i++) {
-              err = read_tick(pd, &cur_tick, timeout);
-              if (err) return err;
-  
-              diffs[i] = cur_tick - last_tick;
-              last_tick = cur_tick;
-            }
-
-            if (NUM_IS_VALUE(diffs[0], CODE_DATA_FIRST, CODE_DATA_FIRST / 5)) {
-              if (NUM_IS_VALUE(diffs[1], CODE_DATA_0_SECOND, CODE_DATA_0_SECOND / 5)) {
-                // 该位为 0
-              } else if (NUM_IS_VALUE(diffs[1], CODE_DATA_1_SECOND, CODE_DATA_1_SECOND / 5)) {
-                // 该位为 1
-                bytes[byte_idx] |= (1 << bit_idx);
-              } else {
-                return EIO;
-              }
-            } else {
-              return EIO;
-            }
-          }
-        }
-
-        // 校验反码, 对 uint8_t 变量进行取反操作时, 会自动提升原变量为整型然后再进行取反, 所以需要强制转换一下取反后的类型
-        if (bytes[0] != (uint8_t)~bytes[1]) return EIO;
-        if (bytes[2] != (uint8_t)~bytes[3]) return EIO;
 
-        *rt_cmd_ptr = bytes[2];
-
-        last_cmds[pd->name] = *rt_cmd_ptr;
+      dec->second_half = false;
 
+      if (NUM_IS_VALUE(diff, CODE_DATA_1_SECOND, CODE_DATA_1_SECOND / 5)) {
+        // 该位为 1
+        dec->data |= (1UL << dec->bit_idx);
+      } else if (!NUM_IS_VALUE(diff, CODE_DATA_0_SECOND, CODE_DATA_0_SECOND / 5)) {
+        dec->state = STATE_LEADER_FIRST;
         return ESUCCESS;
       }
-      default: {
-        return EINVAL;
-      }
+
+      if (++dec->bit_idx < 32) return ESUCCESS;
+
+      dec->state = STATE_IDLE;
+      return decode_frame(pd, dec->data);
+    }
+    default: {
+      dec->state = STATE_IDLE;
+      return EINVAL;
     }
   }
 }
 
-static errno_t read_tick(Device_IRDA *const pd, uint32_t *rt_tick_ptr, uint32_t timeout) {
-  Ring_buffer *rb = ring_buffers[pd->name];
-  errno_t err = ESUCCESS;
-  uint32_t cur_tick = 0, read_len = 0;
-
-  while (timeout--) {
-    err = rb->ops->read(rb, (uint8_t *)&cur_tick, &read_len, sizeof(uint32_t));
+static errno_t decode_frame(Device_IRDA *const pd, uint32_t data) {
+  // 每次发送 4 个字节数据, 分别是 地址 -> 地址反码 -> 命令 -> 命令反码
+  const uint8_t bytes[4] = {
+    (uint8_t)(data >> 0),
+    (uint8_t)(data >> 8),
+    (uint8_t)(data >> 16),
+    (uint8_t)(data >> 24),
+  };
 
-    if (err) return err;
-    if (read_len == sizeof(uint32_t)) {
-      *rt_tick_ptr = cur_tick;
-      return ESUCCESS;
-    }
+  // 校验反码, 对 uint8_t 变量进行取反操作时, 会自动提升原变量为整型然后再进行取反, 所以需要强制转换一下取反后的类型
+  if (bytes[0] != (uint8_t)~bytes[1]) return EIO;
+  if (bytes[2] != (uint8_t)~bytes[3]) return EIO;
 
-    delay_ms(1);
-  }
+  last_cmds[pd->name] = bytes[2];
 
-  return ETIMEDOUT;
+  return cmd_queues[pd->name]->ops->write(cmd_queues[pd->name], &bytes[2], 1);
 }
 
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
@@ -2,7 +2,6 @@
 
 #include "common/errno/errno.h"
 #include "device/gpio/gpio.h"
-#include "device/timer/timer.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -25,7 +24,6 @@ struct Device_IRDA_ops;
 typedef struct Device_IRDA {
   const Device_IRDA_name name;
   Device_GPIO *in;
-  Device_timer *timer;
   const struct Device_IRDA_ops *ops;
 } Device_IRDA;
 
@@ -23,6 +23,8 @@ errno_t Device_keyboard_module_init(void) {
 
 errno_t Device_keyboard_register(Device_keyboard *const pd) {
   if (pd == NULL || list == NULL) return EINVAL;
+  errno_t err = Device_GPIO_bus_init(&pd->bus, pd->ins, DEVICE_KEY_COUNT);
+  if (err) return err;
   pd->ops = &device_ops;
   return list->ops->head_insert(list, (const void *)pd);
 }
@@ -39,11 +41,11 @@ errno_t Device_keyboard_find(const Device_keyboard **pd_ptr, Device_keyboard_nam
 errno_t Device_keyboard_in_EXTI_callback(const Device_keyboard *const pd, const Device_key_name key) {
   if (pd == NULL || ring_buffer == NULL) return EINVAL;
 
-  Device_GPIO *const in = pd->ins[key];
-  Pin_value value = PIN_VALUE_0;
-  errno_t err = in->ops->read(in, &value);
+  // 按键按下为低电平
+  uint32_t value = 0;
+  errno_t err = Device_GPIO_bus_read(&pd->bus, &value);
   if (err) return err;
-  if (value == PIN_VALUE_1) return ESUCCESS;
+  if (value & (1 << key)) return ESUCCESS;
 
   err = ring_buffer->ops->write(ring_buffer, (uint8_t *)&key, 1);
   if (err) return err;
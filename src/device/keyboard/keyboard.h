@@ -23,6 +23,7 @@ typedef struct Device_keyboard {
   const Device_keyboard_name name;
   const Device_key_name keys[DEVICE_KEY_COUNT]; // 关联的 KEY
   Device_GPIO *ins[DEVICE_KEY_COUNT]; // 关联的 GPIO 设备, 每个设备的下标需要和对应的 KEY 值相同
+  Device_GPIO_bus bus; // 由 ins 组成的总线, 注册时生成
   const struct Device_keyboard_ops *ops;
 } Device_keyboard;
 
@@ -0,0 +1,484 @@
+#include "kv.h"
+#include "common/list/list.h"
+#include "common/crc/crc.h"
+#include "device/w25qx/config/index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 对象方法
+static errno_t init(Device_KV *const pd);
+static errno_t set(Device_KV *const pd, kv_key_t key, const void *data, uint16_t len);
+static errno_t get(Device_KV *const pd, kv_key_t key, void *rt_data, uint16_t size, uint16_t *rt_len_ptr);
+static errno_t remove(Device_KV *const pd, kv_key_t key);
+static errno_t format(Device_KV *const pd);
+
+// 内部方法 - 挂载, 扫描所有扇区建立索引
+static errno_t mount(Device_KV *const pd);
+static errno_t scan_sector(Device_KV *const pd, uint16_t sector, uint16_t *rt_end_ptr);
+// 内部方法 - 追加记录
+static errno_t append(Device_KV *const pd, kv_key_t key, const void *data, uint16_t len);
+static errno_t ensure_space(Device_KV *const pd, uint32_t record_size);
+static errno_t open_sector(Device_KV *const pd, uint16_t sector);
+static errno_t collect_sector(Device_KV *const pd, uint16_t sector);
+static errno_t copy_record(Device_KV *const pd, uint32_t src_addr, uint32_t dst_addr, uint32_t size);
+// 内部方法 - 索引
+static int16_t index_find(const Device_KV *const pd, kv_key_t key);
+static errno_t index_update(Device_KV *const pd, kv_key_t key, uint16_t len, uint32_t addr);
+// 内部方法 - 查找设备
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
+
+static const Device_KV_ops device_ops = {
+  .init = init,
+  .set = set,
+  .get = get,
+  .remove = remove,
+  .format = format,
+};
+
+// 扇区头, 位于每个扇区开头
+#define SECTOR_MAGIC 0x3253564Bu // "KVS2"
+#define SECTOR_COLLECTED 0x4C4C4F43u // "COLL"
+typedef struct {
+  uint32_t magic;
+  uint32_t seq; // 扇区打开的顺序, 越大越新
+  uint32_t seq_check; // seq 取反, 擦除时掉电只会把部分位变为 1, 两者不会同时保持一致
+  // 最旧扇区的有效记录全部搬到本扇区后写入 SECTOR_COLLECTED, 之后才擦除最旧扇区; 写入时掉电的值不等于该值
+  uint32_t collected;
+} Sector_header;
+
+#define SECTOR_HEADER_VALID(header) ((header).magic == SECTOR_MAGIC && (header).seq == ~(header).seq_check)
+
+// 记录头, 后面紧跟数据, 记录按 4 字节对齐; len 为 0 表示键已删除
+typedef struct {
+  kv_key_t key;
+  uint16_t len;
+  uint32_t crc; // 覆盖 key len 和数据
+} Record_header;
+
+#define RECORD_ALIGN(len) (((uint32_t)(len) + 3) & ~3u)
+#define RECORD_SIZE(len) (sizeof(Record_header) + RECORD_ALIGN(len))
+// 每个扇区可以存放记录的字节数
+#define SECTOR_CAPACITY (W25QX_SECTOR_SIZE - sizeof(Sector_header))
+
+#define SECTOR_ADDR(pd, sector) ((pd)->base_addr + (uint32_t)(sector) * W25QX_SECTOR_SIZE)
+#define NEXT_SECTOR(pd, sector) ((uint16_t)(((sector) + 1) % (pd)->sector_count))
+
+typedef struct {
+  kv_key_t key;
+  uint16_t len;
+  uint32_t addr; // 记录头的地址
+} Index_entry;
+
+static List *list = NULL;
+
+// 内存索引, 每个键只保存最新记录的位置
+static Index_entry indexes[DEVICE_KV_COUNT][DEVICE_KV_KEY_MAX] = {0};
+static uint16_t index_counts[DEVICE_KV_COUNT] = {0};
+// 所有有效记录占用的字节数
+static uint32_t live_bytes[DEVICE_KV_COUNT] = {0};
+// 当前写入的扇区 下一条记录在扇区内的偏移 扇区序号
+static uint16_t head_sectors[DEVICE_KV_COUNT] = {0};
+static uint16_t head_offsets[DEVICE_KV_COUNT] = {0};
+static uint32_t head_seqs[DEVICE_KV_COUNT] = {0};
+// 读取/搬运数据用的缓冲区
+static uint8_t buffer[W25QX_PAGE_SIZE] = {0};
+
+errno_t Device_KV_module_init(void) {
+  if (list == NULL) {
+    errno_t err = list_create(&list);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+errno_t Device_KV_register(Device_KV *const pd) {
+  if (pd == NULL || list == NULL) return EINVAL;
+  pd->ops = &device_ops;
+  list->ops->head_insert(list, pd);
+  return ESUCCESS;
+}
+
+errno_t Device_KV_find(Device_KV **pd_ptr, const Device_KV_name name) {
+  if (list == NULL) return EINVAL;
+
+  errno_t err = list->ops->find(list, pd_ptr, &name, match_device_by_name);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t init(Device_KV *const pd) {
+  if (pd == NULL || pd->flash == NULL) return EINVAL;
+  if (pd->base_addr % W25QX_SECTOR_SIZE != 0 || pd->sector_count < 3) return EINVAL;
+  if (pd->base_addr + (uint32_t)pd->sector_count * W25QX_SECTOR_SIZE > W25QX_SIZE) return EINVAL;
+
+  errno_t err = pd->flash->ops->init(pd->flash);
+  if (err) return err;
+
+  return mount(pd);
+}
+
+static errno_t set(Device_KV *const pd, kv_key_t key, const void *data, uint16_t len) {
+  if (pd == NULL || data == NULL || len == 0 || key == DEVICE_KV_KEY_INVALID) return EINVAL;
+  if (RECORD_SIZE(len) > SECTOR_CAPACITY) return EFBIG;
+
+  const int16_t i = index_find(pd, key);
+  if (i < 0 && index_counts[pd->name] >= DEVICE_KV_KEY_MAX) return ENOMEM;
+
+  // 保留两个扇区的空间用于回收, 保证回收总能腾出空间
+  uint32_t new_live_bytes = live_bytes[pd->name] + RECORD_SIZE(len);
+  if (i >= 0) new_live_bytes -= RECORD_SIZE(indexes[pd->name][i].len);
+  if (new_live_bytes > (uint32_t)(pd->sector_count - 2) * SECTOR_CAPACITY) return ENOSPC;
+
+  return append(pd, key, data, len);
+}
+
+static errno_t get(Device_KV *const pd, kv_key_t key, void *rt_data, uint16_t size, uint16_t *rt_len_ptr) {
+  if (pd == NULL || rt_data == NULL) return EINVAL;
+
+  const int16_t i = index_find(pd, key);
+  if (i < 0) return ENOENT;
+
+  const Index_entry *const pe = &indexes[pd->name][i];
+  if (rt_len_ptr != NULL) *rt_len_ptr = pe->len;
+  if (pe->len > size) return EFBIG;
+
+  return pd->flash->ops->read(pd->flash, pe->addr + sizeof(Record_header), rt_data, pe->len);
+}
+
+static errno_t remove(Device_KV *const pd, kv_key_t key) {
+  if (pd == NULL) return EINVAL;
+  if (index_find(pd, key) < 0) return ENOENT;
+
+  return append(pd, key, NULL, 0);
+}
+
+static errno_t format(Device_KV *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  errno_t err = pd->flash->ops->erase(pd->flash, pd->base_addr, pd->sector_count);
+  if (err) return err;
+
+  index_counts[pd->name] = 0;
+  live_bytes[pd->name] = 0;
+  head_seqs[pd->name] = 0;
+
+  return open_sector(pd, 0);
+}
+
+/**
+ * @brief 扫描所有扇区建立索引
+ * 扇区按打开顺序组成环形, 从当前扇区的下一个扇区开始按环形顺序扫描即为从旧到新, 新记录覆盖旧记录
+ * 上次掉电时如果正在回收扇区: 搬运未完成时撤销回收, 搬运已完成时重新擦除最旧扇区
+ * @param pd
+ * @return errno_t
+ */
+static errno_t mount(Device_KV *const pd) {
+  errno_t err = ESUCCESS;
+  Sector_header header = {0};
+
+  index_counts[pd->name] = 0;
+  live_bytes[pd->name] = 0;
+
+  // 找到序号最大的扇区
+  bool found = false;
+  for (uint16_t sector = 0; sector < pd->sector_count; ++sector) {
+    err = pd->flash->ops->read(pd->flash, SECTOR_ADDR(pd, sector), (uint8_t *)&header, sizeof(header));
+    if (err) return err;
+    if (!SECTOR_HEADER_VALID(header)) continue;
+
+    if (found == false || header.seq > head_seqs[pd->name]) {
+      head_sectors[pd->name] = sector;
+      head_seqs[pd->name] = header.seq;
+      found = true;
+    }
+  }
+  if (found == false) return format(pd);
+
+  // 当前扇区的下一个扇区应当已被回收, 否则是回收时掉电
+  const uint16_t head = head_sectors[pd->name];
+  const uint16_t next = NEXT_SECTOR(pd, head);
+  err = pd->flash->ops->read(pd->flash, SECTOR_ADDR(pd, next), (uint8_t *)&header, sizeof(header));
+  if (err) return err;
+  if (SECTOR_HEADER_VALID(header)) {
+    err = pd->flash->ops->read(pd->flash, SECTOR_ADDR(pd, head), (uint8_t *)&header, sizeof(header));
+    if (err) return err;
+
+    if (header.collected != SECTOR_COLLECTED) {
+      // 搬运未完成, 当前扇区中只有搬运过来的记录(可能不完整), 原记录仍完整地保存在下一个扇区中
+      // 擦除当前扇区后重新挂载, 下次写满时再重新回收
+      err = pd->flash->ops->erase(pd->flash, SECTOR_ADDR(pd, head), 1);
+      if (err) return err;
+      return mount(pd);
+    }
+
+    // 搬运已完成, 擦除下一个扇区时掉电, 其中的记录可能已被部分擦除, 不能再读取, 重新擦除
+    err = pd->flash->ops->erase(pd->flash, SECTOR_ADDR(pd, next), 1);
+    if (err) return err;
+  }
+
+  uint16_t sector = head;
+  do {
+    sector = NEXT_SECTOR(pd, sector);
+
+    err = pd->flash->ops->read(pd->flash, SECTOR_ADDR(pd, sector), (uint8_t *)&header, sizeof(header));
+    if (err) return err;
+    if (!SECTOR_HEADER_VALID(header)) continue;
+
+    uint16_t end = 0;
+    err = scan_sector(pd, sector, &end);
+    if (err) return err;
+    if (sector == head) head_offsets[pd->name] = end;
+  } while (sector != head);
+
+  for (uint16_t i = 0; i < index_counts[pd->name]; ++i) {
+    live_bytes[pd->name] += RECORD_SIZE(indexes[pd->name][i].len);
+  }
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 扫描一个扇区中的记录并更新索引
+ * 遇到空白记录头时结束; 遇到 CRC 错误的记录(写入时掉电)时, 扇区剩余部分不再使用
+ * @param pd
+ * @param sector
+ * @param rt_end_ptr 返回下一条记录可以写入的偏移, 扇区剩余部分不能使用时为扇区大小
+ * @return errno_t
+ */
+static errno_t scan_sector(Device_KV *const pd, uint16_t sector, uint16_t *rt_end_ptr) {
+  errno_t err = ESUCCESS;
+  const uint32_t sector_addr = SECTOR_ADDR(pd, sector);
+  uint32_t offset = sizeof(Sector_header);
+  Record_header header = {0};
+
+  while (offset + sizeof(Record_header) <= W25QX_SECTOR_SIZE) {
+    err = pd->flash->ops->read(pd->flash, sector_addr + offset, (uint8_t *)&header, sizeof(header));
+    if (err) return err;
+
+    if (header.key == DEVICE_KV_KEY_INVALID && header.len == 0xFFFF && header.crc == 0xFFFFFFFF) break;
+    if (header.key == DEVICE_KV_KEY_INVALID || offset + RECORD_SIZE(header.len) > W25QX_SECTOR_SIZE) {
+      offset = W25QX_SECTOR_SIZE;
+      break;
+    }
+
+    uint32_t crc = crc32(0, &header, offsetof(Record_header, crc));
+    for (uint32_t done = 0; done < header.len; ) {
+      const uint32_t cur_len = header.len - done > sizeof(buffer) ? sizeof(buffer) : header.len - done;
+      err = pd->flash->ops->read(pd->flash, sector_addr + offset + sizeof(Record_header) + done, buffer, cur_len);
+      if (err) return err;
+      crc = crc32(crc, buffer, cur_len);
+      done += cur_len;
+    }
+    if (crc != header.crc) {
+      offset = W25QX_SECTOR_SIZE;
+      break;
+    }
+
+    err = index_update(pd, header.key, header.len, sector_addr + offset);
+    if (err) return err;
+
+    offset += RECORD_SIZE(header.len);
+  }
+
+  *rt_end_ptr = offset;
+  return ESUCCESS;
+}
+
+static errno_t append(Device_KV *const pd, kv_key_t key, const void *data, uint16_t len) {
+  errno_t err = ESUCCESS;
+  const uint32_t record_size = RECORD_SIZE(len);
+
+  err = ensure_space(pd, record_size);
+  if (err) return err;
+
+  const uint32_t addr = SECTOR_ADDR(pd, head_sectors[pd->name]) + head_offsets[pd->name];
+
+  Record_header header = {
+    .key = key,
+    .len = len,
+  };
+  header.crc = crc32(0, &header, offsetof(Record_header, crc));
+  if (len) header.crc = crc32(header.crc, data, len);
+
+  // 即使后续写入失败, 这部分空间也已经不能再使用
+  head_offsets[pd->name] += record_size;
+
+  // 先写记录头再写数据, 数据未写完时 CRC 校验失败, 挂载时忽略该记录
+  err = pd->flash->ops->write(pd->flash, addr, (uint8_t *)&header, sizeof(header));
+  if (err) return err;
+  if (len) {
+    err = pd->flash->ops->write(pd->flash, addr + sizeof(header), (uint8_t *)data, len);
+    if (err) return err;
+  }
+
+  const int16_t i = index_find(pd, key);
+  if (i >= 0) live_bytes[pd->name] -= RECORD_SIZE(indexes[pd->name][i].len);
+  err = index_update(pd, key, len, addr);
+  if (err) return err;
+  if (len) live_bytes[pd->name] += record_size;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 保证当前扇区有足够的空间
+ * 当前扇区已满时打开下一个扇区, 并回收再下一个扇区(最旧的扇区), 回收时有效记录搬到新打开的扇区
+ * @param pd
+ * @param record_size
+ * @return errno_t
+ */
+static errno_t ensure_space(Device_KV *const pd, uint32_t record_size) {
+  errno_t err = ESUCCESS;
+
+  for (uint16_t i = 0; i < pd->sector_count; ++i) {
+    if (head_offsets[pd->name] + record_size <= W25QX_SECTOR_SIZE) return ESUCCESS;
+
+    err = open_sector(pd, NEXT_SECTOR(pd, head_sectors[pd->name]));
+    if (err) return err;
+    err = collect_sector(pd, NEXT_SECTOR(pd, head_sectors[pd->name]));
+    if (err) return err;
+  }
+
+  return ENOSPC;
+}
+
+/**
+ * @brief 打开一个空扇区作为当前扇区
+ * 扇区不是全 0xFF(擦除时掉电)时先擦除
+ * @param pd
+ * @param sector
+ * @return errno_t
+ */
+static errno_t open_sector(Device_KV *const pd, uint16_t sector) {
+  errno_t err = ESUCCESS;
+  const uint32_t sector_addr = SECTOR_ADDR(pd, sector);
+
+  // 扇区中还有有效记录时不能打开
+  for (uint16_t i = 0; i < index_counts[pd->name]; ++i) {
+    const uint32_t addr = indexes[pd->name][i].addr;
+    if (addr >= sector_addr && addr < sector_addr + W25QX_SECTOR_SIZE) return ENOSPC;
+  }
+
+  bool blank = true;
+  for (uint32_t offset = 0; offset < W25QX_SECTOR_SIZE && blank; offset += sizeof(buffer)) {
+    err = pd->flash->ops->read(pd->flash, sector_addr + offset, buffer, sizeof(buffer));
+    if (err) return err;
+    for (uint32_t i = 0; i < sizeof(buffer); ++i) {
+      if (buffer[i] != 0xFF) {
+        blank = false;
+        break;
+      }
+    }
+  }
+  if (blank == false) {
+    err = pd->flash->ops->erase(pd->flash, sector_addr, 1);
+    if (err) return err;
+  }
+
+  // collected 保持擦除后的值, 回收完成后再写入
+  Sector_header header = {
+    .magic = SECTOR_MAGIC,
+    .seq = head_seqs[pd->name] + 1,
+    .seq_check = ~(head_seqs[pd->name] + 1),
+    .collected = 0xFFFFFFFF,
+  };
+  err = pd->flash->ops->write(pd->flash, sector_addr, (uint8_t *)&header, sizeof(header));
+  if (err) return err;
+
+  head_sectors[pd->name] = sector;
+  head_offsets[pd->name] = sizeof(Sector_header);
+  head_seqs[pd->name] = header.seq;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 回收扇区
+ * 把扇区中仍在索引中的记录原样搬到当前扇区, 在当前扇区头中标记搬运完成, 然后擦除该扇区
+ * 该扇区是最旧的扇区, 其中的删除记录没有更旧的值需要覆盖, 不需要搬运
+ * @param pd
+ * @param sector
+ * @return errno_t
+ */
+static errno_t collect_sector(Device_KV *const pd, uint16_t sector) {
+  errno_t err = ESUCCESS;
+  const uint32_t sector_addr = SECTOR_ADDR(pd, sector);
+
+  for (uint16_t i = 0; i < index_counts[pd->name]; ++i) {
+    Index_entry *const pe = &indexes[pd->name][i];
+    if (pe->addr < sector_addr || pe->addr >= sector_addr + W25QX_SECTOR_SIZE) continue;
+
+    const uint32_t record_size = RECORD_SIZE(pe->len);
+    if (head_offsets[pd->name] + record_size > W25QX_SECTOR_SIZE) return ENOSPC;
+
+    const uint32_t addr = SECTOR_ADDR(pd, head_sectors[pd->name]) + head_offsets[pd->name];
+    head_offsets[pd->name] += record_size;
+
+    err = copy_record(pd, pe->addr, addr, sizeof(Record_header) + pe->len);
+    if (err) return err;
+    pe->addr = addr;
+  }
+
+  // 标记之后掉电, 挂载时不再使用该扇区中的记录
+  uint32_t collected = SECTOR_COLLECTED;
+  err = pd->flash->ops->write(pd->flash, SECTOR_ADDR(pd, head_sectors[pd->name]) + offsetof(Sector_header, collected), (uint8_t *)&collected, sizeof(collected));
+  if (err) return err;
+
+  return pd->flash->ops->erase(pd->flash, sector_addr, 1);
+}
+
+static errno_t copy_record(Device_KV *const pd, uint32_t src_addr, uint32_t dst_addr, uint32_t size) {
+  errno_t err = ESUCCESS;
+
+  for (uint32_t done = 0; done < size; ) {
+    const uint32_t cur_len = size - done > sizeof(buffer) ? sizeof(buffer) : size - done;
+    err = pd->flash->ops->read(pd->flash, src_addr + done, buffer, cur_len);
+    if (err) return err;
+    err = pd->flash->ops->write(pd->flash, dst_addr + done, buffer, cur_len);
+    if (err) return err;
+    done += cur_len;
+  }
+
+  return ESUCCESS;
+}
+
+static int16_t index_find(const Device_KV *const pd, kv_key_t key) {
+  for (uint16_t i = 0; i < index_counts[pd->name]; ++i) {
+    if (indexes[pd->name][i].key == key) return (int16_t)i;
+  }
+  return -1;
+}
+
+// len 为 0 时从索引中删除
+static errno_t index_update(Device_KV *const pd, kv_key_t key, uint16_t len, uint32_t addr) {
+  Index_entry *const entries = indexes[pd->name];
+  const int16_t i = index_find(pd, key);
+
+  if (len == 0) {
+    if (i >= 0) entries[i] = entries[--index_counts[pd->name]];
+    return ESUCCESS;
+  }
+
+  if (i >= 0) {
+    entries[i].len = len;
+    entries[i].addr = addr;
+    return ESUCCESS;
+  }
+
+  if (index_counts[pd->name] >= DEVICE_KV_KEY_MAX) return ENOMEM;
+  entries[index_counts[pd->name]++] = (Index_entry){
+    .key = key,
+    .len = len,
+    .addr = addr,
+  };
+
+  return ESUCCESS;
+}
+
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
+  return ((Device_KV *)pd)->name == *((Device_KV_name *)name);
+}
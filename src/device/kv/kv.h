@@ -0,0 +1,50 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/w25qx/w25qx.h"
+#include <stdint.h>
+
+// 内存索引最多保存的键数量
+#define DEVICE_KV_KEY_MAX 64
+// 键 0xFFFF 为 flash 擦除后的值, 不能使用
+#define DEVICE_KV_KEY_INVALID 0xFFFF
+
+typedef uint16_t kv_key_t;
+
+typedef enum {
+  DEVICE_KV_SETTINGS,
+  DEVICE_KV_COUNT,
+} Device_KV_name;
+
+struct Device_KV;
+struct Device_KV_ops;
+
+/**
+ * @brief 基于 flash 的日志结构键值存储
+ * 存储区由连续的扇区组成环形日志, 记录只追加不改写, 每条记录带 CRC
+ * 写满一个扇区后打开下一个空扇区, 并把最旧扇区中仍有效的记录搬到当前扇区后擦除最旧扇区, 各扇区轮流擦写
+ * 任意时刻掉电, 重新挂载后每个键的值为掉电前最后一次完整写入的值
+ */
+typedef struct Device_KV {
+  const Device_KV_name name;
+  const uint32_t base_addr; // 存储区起始地址, 需要扇区对齐
+  const uint16_t sector_count; // 存储区扇区数量, 至少 3 个
+  const Device_W25QX *flash;
+  const struct Device_KV_ops *ops;
+} Device_KV;
+
+typedef struct Device_KV_ops {
+  // 初始化 flash 并扫描存储区建立索引, 存储区为空或损坏时自动格式化
+  errno_t (*init)(Device_KV *const pd);
+  errno_t (*set)(Device_KV *const pd, kv_key_t key, const void *data, uint16_t len);
+  // 键不存在时返回 ENOENT, 缓冲区小于值的长度时返回 EFBIG, rt_len_ptr 可以为 NULL
+  errno_t (*get)(Device_KV *const pd, kv_key_t key, void *rt_data, uint16_t size, uint16_t *rt_len_ptr);
+  errno_t (*remove)(Device_KV *const pd, kv_key_t key);
+  // 擦除整个存储区
+  errno_t (*format)(Device_KV *const pd);
+} Device_KV_ops;
+
+// 全局方法
+errno_t Device_KV_module_init(void);
+errno_t Device_KV_register(Device_KV *const pd);
+errno_t Device_KV_find(Device_KV **pd_ptr, const Device_KV_name name);
@@ -1,6 +1,7 @@
 #include "motor.h"
 #include "common/list/list.h"
 #include "common/delay/delay.h"
+#include "common/critical/critical.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
@@ -8,11 +9,14 @@
 // 对象方法
 static errno_t init(Device_motor *const pd);
 static errno_t stop(Device_motor *const pd);
-static errno_t forward(Device_motor *const pd, const speed_t speed);
-static errno_t backward(Device_motor *const pd, const speed_t speed);
+static errno_t forward(Device_motor *const pd, speed_t speed);
+static errno_t backward(Device_motor *const pd, speed_t speed);
 
+// 内部方法 - 设置方向引脚
+static errno_t set_direction(Device_motor *const pd, const Device_motor_status status);
 // 内部方法 - 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
+// 内部方法 - 与控制中断互斥
 
 static const Device_motor_ops device_ops = {
   .init = init,
@@ -21,7 +25,15 @@ static const Device_motor_ops device_ops = {
   .backward = backward,
 };
 
+// PWM 计数频率 1 MHz, 每个周期 0xFF 个计数(约 3.9 kHz), 速度值即为比较值
+#define PWM_COUNT_FREQUENT 1000000
+#define PWM_PERIOD_COUNT 0xFF
+
 static List *list = NULL;
+// 所有电机共用的最大占空比, 由电源管理按电量调整
+static volatile speed_t duty_limit = PWM_PERIOD_COUNT;
+// 已注册的电机, 调整最大占空比时立即限制正在转的电机
+static Device_motor *motors[DEVICE_MOTOR_COUNT] = {0};
 
 errno_t Device_motor_module_init(void) {
   if (list == NULL) {
@@ -33,9 +45,10 @@ errno_t Device_motor_module_init(void) {
 }
 
 errno_t Device_motor_register(Device_motor *const pd) {
-  if (pd == NULL || list == NULL) return EINVAL;
+  if (pd == NULL || list == NULL || pd->name >= DEVICE_MOTOR_COUNT) return EINVAL;
   pd->ops = &device_ops;
   list->ops->head_insert(list, pd);
+  motors[pd->name] = pd;
   return ESUCCESS;
 }
 
@@ -48,6 +61,136 @@ errno_t Device_motor_find(Device_motor **pd_ptr, const Device_motor_name name) {
   return ESUCCESS;
 }
 
+/**
+ * @brief 设置所有电机的最大速度
+ * 之后设置的速度超过该值时按该值输出, 已经在转且超过该值的电机立即降到该值
+ * 先更新最大速度再改比较值, 之后控制中断设置的速度也不会超过新的最大速度
+ * @param limit 0 ~ 0xFF, 为 0 时电机只能停止, 正在转的电机立即停止
+ * @return errno_t 
+ */
+errno_t Device_motor_set_duty_limit(const speed_t limit) {
+  duty_limit = limit;
+
+  for (Device_motor_name name = 0; name < DEVICE_MOTOR_COUNT; ++name) {
+    Device_motor *const pd = motors[name];
+    if (pd == NULL) continue;
+
+    errno_t err = ESUCCESS;
+    const uint32_t primask = enter_critical();
+    if (pd->status != DEVICE_MOTOR_STATUS_STOP && pd->speed > limit) {
+      if (limit == 0) {
+        err = stop(pd);
+      } else {
+        err = pd->pwm->ops->set_duty(pd->pwm, limit);
+        if (err == ESUCCESS) pd->speed = limit;
+      }
+    }
+    exit_critical(primask);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+errno_t Device_motor_get_duty_limit(speed_t *rt_limit_ptr) {
+  if (rt_limit_ptr == NULL) return EINVAL;
+  *rt_limit_ptr = duty_limit;
+  return ESUCCESS;
+}
+
+/**
+ * @brief 初始化电机组
+ * 配置一次 PWM 时序并开启预装载
+ * @param pg 
+ * @param motors 组内电机, 需要共用同一个 PWM 定时器
+ * @param count 电机数量
+ * @return errno_t 
+ */
+errno_t Device_motor_group_init(Device_motor_group *const pg, Device_motor *const motors[], const uint8_t count) {
+  if (pg == NULL || motors == NULL || count == 0 || count > DEVICE_MOTOR_COUNT) return EINVAL;
+
+  errno_t err = ESUCCESS;
+
+  for (uint8_t i = 0; i < count; ++i) {
+    if (motors[i] == NULL) return EINVAL;
+    if (motors[i]->pwm->instance != motors[0]->pwm->instance) return EINVAL;
+
+    err = motors[i]->pwm->ops->set_preload(motors[i]->pwm, true);
+    if (err) return err;
+
+    pg->motors[i] = motors[i];
+  }
+  pg->count = count;
+
+  const Device_PWM *const pwm = motors[0]->pwm;
+  err = pwm->ops->set_timing(pwm, PWM_COUNT_FREQUENT, PWM_PERIOD_COUNT);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 同时设置组内所有电机的速度
+ * 写比较寄存器期间关闭定时器更新事件, 所有通道的新比较值在同一个更新事件生效
+ * @param pg 
+ * @param speeds 与组内电机一一对应, -0xFF ~ 0xFF
+ * @return errno_t 
+ */
+errno_t Device_motor_group_set(Device_motor_group *const pg, const int16_t speeds[]) {
+  if (pg == NULL || speeds == NULL || pg->count == 0) return EINVAL;
+
+  errno_t err = ESUCCESS;
+  const Device_PWM *const pwm = pg->motors[0]->pwm;
+
+  err = pwm->ops->set_update_enable(pwm, false);
+  if (err) return err;
+
+  for (uint8_t i = 0; i < pg->count; ++i) {
+    Device_motor *const pd = pg->motors[i];
+
+    const int16_t limit = duty_limit;
+    int16_t speed = speeds[i];
+    if (speed > limit) speed = limit;
+    if (speed < -limit) speed = -limit;
+
+    Device_motor_status status = DEVICE_MOTOR_STATUS_STOP;
+    if (speed > 0) status = DEVICE_MOTOR_STATUS_FORWARD;
+    else if (speed < 0) status = DEVICE_MOTOR_STATUS_BACKWARD;
+    const speed_t abs_speed = (speed_t)(speed < 0 ? -speed : speed);
+
+    err = pd->pwm->ops->set_duty(pd->pwm, abs_speed);
+    if (err) goto update_enable_tag;
+
+    if (status != pd->status) {
+      err = set_direction(pd, status);
+      if (err) goto update_enable_tag;
+    }
+
+    // 电机被单独停止过时, PWM 通道已关闭, 需要重新打开
+    if (status != DEVICE_MOTOR_STATUS_STOP) {
+      bool running = false;
+      err = pd->pwm->ops->is_running(pd->pwm, &running);
+      if (err) goto update_enable_tag;
+      if (running == false) {
+        err = pd->pwm->ops->start(pd->pwm);
+        if (err) goto update_enable_tag;
+      }
+    }
+
+    pd->speed = abs_speed;
+    pd->status = status;
+  }
+
+  update_enable_tag:
+  {
+    errno_t update_err = pwm->ops->set_update_enable(pwm, true);
+    if (err) return err;
+    if (update_err) return update_err;
+  }
+
+  return ESUCCESS;
+}
+
 static errno_t init(Device_motor *const pd) {
   if (pd == NULL) return EINVAL;
 
@@ -55,6 +198,9 @@ static errno_t init(Device_motor *const pd) {
 
   err = pd->pwm->ops->init(pd->pwm);
   if (err) return err;
+  // 时序只配置一次, 之后改变速度只写比较寄存器
+  err = pd->pwm->ops->set_timing(pd->pwm, PWM_COUNT_FREQUENT, PWM_PERIOD_COUNT);
+  if (err) return err;
   err = pd->in_1->ops->init(pd->in_1);
   if (err) return err;
   err = pd->in_2->ops->init(pd->in_2);
@@ -87,12 +233,13 @@ static errno_t stop(Device_motor *const pd) {
   return ESUCCESS;
 }
 
-static errno_t forward(Device_motor *const pd, const speed_t speed) {
+static errno_t forward(Device_motor *const pd, speed_t speed) {
   if (pd == NULL) return EINVAL;
+  if (speed > duty_limit) speed = duty_limit;
 
   errno_t err = ESUCCESS;
 
-  err = pd->pwm->ops->set_period(pd->pwm, speed, 0xFF);
+  err = pd->pwm->ops->set_duty(pd->pwm, speed);
   if (err) return err;
   err = pd->in_1->ops->write(pd->in_1, PIN_VALUE_1);
   if (err) return err;
@@ -113,12 +260,13 @@ static errno_t forward(Device_motor *const pd, const speed_t speed) {
   return ESUCCESS;
 }
 
-static errno_t backward(Device_motor *const pd, const speed_t speed) {
+static errno_t backward(Device_motor *const pd, speed_t speed) {
   if (pd == NULL) return EINVAL;
+  if (speed > duty_limit) speed = duty_limit;
 
   errno_t err = ESUCCESS;
 
-  err = pd->pwm->ops->set_period(pd->pwm, speed, 0xFF);
+  err = pd->pwm->ops->set_duty(pd->pwm, speed);
   if (err) return err;
   err = pd->in_1->ops->write(pd->in_1, PIN_VALUE_0);
   if (err) return err;
@@ -140,6 +288,20 @@ static errno_t backward(Device_motor *const pd, const speed_t speed) {
 }
 
 
+static errno_t set_direction(Device_motor *const pd, const Device_motor_status status) {
+  errno_t err = ESUCCESS;
+
+  const Pin_value in_1 = status == DEVICE_MOTOR_STATUS_FORWARD ? PIN_VALUE_1 : PIN_VALUE_0;
+  const Pin_value in_2 = status == DEVICE_MOTOR_STATUS_BACKWARD ? PIN_VALUE_1 : PIN_VALUE_0;
+
+  err = pd->in_1->ops->write(pd->in_1, in_1);
+  if (err) return err;
+  err = pd->in_2->ops->write(pd->in_2, in_2);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
   return ((Device_motor *)pd)->name == *((Device_motor_name *)name);
 }
@@ -41,7 +41,24 @@ typedef struct Device_motor_ops {
   errno_t (*backward)(Device_motor *const pd, const speed_t speed);
 } Device_motor_ops;
 
+/**
+ * @brief 电机组
+ * 组内电机共用同一个 PWM 定时器, 一次设置所有电机的速度, 在同一个 PWM 周期生效
+ * 更新时只需写比较寄存器, 方向变化时才写方向引脚
+ */
+typedef struct Device_motor_group {
+  Device_motor *motors[DEVICE_MOTOR_COUNT];
+  uint8_t count;
+} Device_motor_group;
+
 // 全局方法
 errno_t Device_motor_module_init(void);
 errno_t Device_motor_register(Device_motor *const pd);
 errno_t Device_motor_find(Device_motor **pd_ptr, const Device_motor_name name);
+// 最大速度, 对所有电机和电机组生效, 默认 0xFF
+errno_t Device_motor_set_duty_limit(const speed_t limit);
+errno_t Device_motor_get_duty_limit(speed_t *rt_limit_ptr);
+
+// 电机组, speeds 为 -0xFF ~ 0xFF, 正数为前进, 负数为后退, 0 为停止
+errno_t Device_motor_group_init(Device_motor_group *const pg, Device_motor *const motors[], const uint8_t count);
+errno_t Device_motor_group_set(Device_motor_group *const pg, const int16_t speeds[]);
@@ -0,0 +1,422 @@
+#include "mpu6050.h"
+#include "common/list/list.h"
+#include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
+#include "common/critical/critical.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 寄存器
+#define REG_SMPLRT_DIV 0x19
+#define REG_CONFIG 0x1A
+#define REG_GYRO_CONFIG 0x1B
+#define REG_ACCEL_CONFIG 0x1C
+#define REG_FIFO_EN 0x23
+#define REG_SIGNAL_PATH_RESET 0x68
+#define REG_USER_CTRL 0x6A
+#define REG_PWR_MGMT_1 0x6B
+#define REG_FIFO_COUNTH 0x72
+#define REG_FIFO_R_W 0x74
+#define REG_WHO_AM_I 0x75
+
+#define WHO_AM_I_VALUE 0x68
+#define PWR_MGMT_1_RESET 0x80
+// 时钟源使用 X 轴陀螺仪的锁相环, 比内部振荡器稳定
+#define PWR_MGMT_1_CLK_PLL_XGYRO 0x01
+#define SIGNAL_PATH_RESET_ALL 0x07
+#define USER_CTRL_FIFO_EN 0x40
+#define USER_CTRL_FIFO_RESET 0x04
+// 加速度和三轴角速度写入 FIFO, 按寄存器地址顺序排列
+#define FIFO_EN_ACCEL_GYRO 0x78
+
+#define FIFO_SIZE 1024
+#define PACKET_SIZE 12
+// 开启数字低通滤波器时陀螺仪输出频率为 1kHz
+#define GYRO_OUTPUT_RATE_HZ 1000
+// 复位后等待的时间
+#define RESET_DELAY_MS 100
+
+// 融合结果的修改请求, 在读取完成的中断中处理, 避免与正在进行的融合冲突
+#define PENDING_HEADING 0x01
+#define PENDING_RESET 0x02
+
+static errno_t init(const Device_MPU6050 *const pd);
+static errno_t stop(const Device_MPU6050 *const pd);
+static errno_t get_attitude(const Device_MPU6050 *const pd, Device_MPU6050_attitude *rt_attitude_ptr);
+static errno_t set_heading(const Device_MPU6050 *const pd, q16_t heading);
+static errno_t recalibrate(const Device_MPU6050 *const pd);
+static errno_t get_stats(const Device_MPU6050 *const pd, Device_MPU6050_stats *rt_stats_ptr);
+
+// 内部方法 - 寄存器读写, 只能在主循环中调用
+static errno_t read_reg(const Device_MPU6050 *const pd, uint8_t reg, uint8_t *rt_data, uint16_t len);
+static errno_t write_reg(const Device_MPU6050 *const pd, uint8_t reg, uint8_t value);
+// 内部方法 - 后台读取, 在软件定时器和传输完成中断中执行
+static void read_start(void *arg);
+static void count_done(Device_I2C_transaction *pt, errno_t err);
+static void data_done(Device_I2C_transaction *pt, errno_t err);
+static void reset_done(Device_I2C_transaction *pt, errno_t err);
+static void read_end(const Device_MPU6050 *const pd, errno_t err);
+// 内部方法 - 查找设备
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
+
+static const Device_MPU6050_ops device_ops = {
+  .init = init,
+  .stop = stop,
+  .get_attitude = get_attitude,
+  .set_heading = set_heading,
+  .recalibrate = recalibrate,
+  .get_stats = get_stats,
+};
+
+// 各量程的陀螺仪灵敏度, LSB/(度/秒)
+static const q16_t gyro_sensitivities[] = {
+  [DEVICE_MPU6050_GYRO_250DPS] = Q16_FROM_FLOAT(131.0),
+  [DEVICE_MPU6050_GYRO_500DPS] = Q16_FROM_FLOAT(65.5),
+  [DEVICE_MPU6050_GYRO_1000DPS] = Q16_FROM_FLOAT(32.8),
+  [DEVICE_MPU6050_GYRO_2000DPS] = Q16_FROM_FLOAT(16.4),
+};
+
+static List *list = NULL;
+
+static Attitude attitudes[DEVICE_MPU6050_COUNT] = {0};
+// 发布给主循环和控制中断的融合结果
+static Device_MPU6050_attitude outputs[DEVICE_MPU6050_COUNT] = {0};
+static uint32_t last_sample_ms[DEVICE_MPU6050_COUNT] = {0};
+static Device_MPU6050_stats stats[DEVICE_MPU6050_COUNT] = {0};
+static volatile uint8_t pendings[DEVICE_MPU6050_COUNT] = {0};
+static q16_t pending_headings[DEVICE_MPU6050_COUNT] = {0};
+
+static Timebase_timer read_timers[DEVICE_MPU6050_COUNT] = {0};
+// 上一次读取(字节数, 数据, 复位)还没结束时跳过本次定时
+static volatile uint8_t readings[DEVICE_MPU6050_COUNT] = {0};
+static Device_I2C_transaction count_transactions[DEVICE_MPU6050_COUNT] = {0};
+static Device_I2C_transaction data_transactions[DEVICE_MPU6050_COUNT] = {0};
+static Device_I2C_transaction reset_transactions[DEVICE_MPU6050_COUNT] = {0};
+static uint8_t count_bufs[DEVICE_MPU6050_COUNT][2] = {0};
+static uint8_t fifo_bufs[DEVICE_MPU6050_COUNT][DEVICE_MPU6050_BATCH_MAX * PACKET_SIZE] = {0};
+static uint8_t reset_bufs[DEVICE_MPU6050_COUNT] = {0};
+
+errno_t Device_MPU6050_module_init(void) {
+  if (list == NULL) {
+    errno_t err = list_create(&list);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+errno_t Device_MPU6050_register(Device_MPU6050 *const pd) {
+  if (pd == NULL || list == NULL) return EINVAL;
+  pd->ops = &device_ops;
+  list->ops->head_insert(list, pd);
+  return ESUCCESS;
+}
+
+errno_t Device_MPU6050_find(const Device_MPU6050 **pd_ptr, const Device_MPU6050_name name) {
+  if (list == NULL) return EINVAL;
+
+  errno_t err = list->ops->find(list, pd_ptr, &name, match_device_by_name);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t init(const Device_MPU6050 *const pd) {
+  if (pd == NULL) return EINVAL;
+  if (pd->sample_rate_hz < 4 || pd->sample_rate_hz > GYRO_OUTPUT_RATE_HZ || pd->dlpf < 1 || pd->dlpf > 6) return EINVAL;
+  if (pd->gyro_range > DEVICE_MPU6050_GYRO_2000DPS || pd->accel_range > DEVICE_MPU6050_ACCEL_16G) return EINVAL;
+  // 一个读取周期内产生的采样要能一次读完
+  if (pd->read_period_ms == 0 || (uint32_t)pd->sample_rate_hz * pd->read_period_ms > DEVICE_MPU6050_BATCH_MAX * 1000) return EINVAL;
+
+  errno_t err = timebase_init();
+  if (err) return err;
+
+  err = pd->i2c->ops->init(pd->i2c);
+  if (err) return err;
+
+  // 重复初始化时先停止后台读取
+  err = stop(pd);
+  if (err) return err;
+
+  uint8_t who_am_i = 0;
+  err = read_reg(pd, REG_WHO_AM_I, &who_am_i, 1);
+  if (err) return err;
+  if (who_am_i != WHO_AM_I_VALUE) return ENODEV;
+
+  err = write_reg(pd, REG_PWR_MGMT_1, PWR_MGMT_1_RESET);
+  if (err) return err;
+  delay_ms(RESET_DELAY_MS);
+  err = write_reg(pd, REG_SIGNAL_PATH_RESET, SIGNAL_PATH_RESET_ALL);
+  if (err) return err;
+  delay_ms(RESET_DELAY_MS);
+  err = write_reg(pd, REG_PWR_MGMT_1, PWR_MGMT_1_CLK_PLL_XGYRO);
+  if (err) return err;
+
+  // 采样率为陀螺仪输出频率分频, 不能整除时取较高的采样率
+  const uint32_t divider = GYRO_OUTPUT_RATE_HZ / pd->sample_rate_hz;
+  err = write_reg(pd, REG_SMPLRT_DIV, divider - 1);
+  if (err) return err;
+  err = write_reg(pd, REG_CONFIG, pd->dlpf);
+  if (err) return err;
+  err = write_reg(pd, REG_GYRO_CONFIG, pd->gyro_range << 3);
+  if (err) return err;
+  err = write_reg(pd, REG_ACCEL_CONFIG, pd->accel_range << 3);
+  if (err) return err;
+
+  err = write_reg(pd, REG_USER_CTRL, USER_CTRL_FIFO_RESET);
+  if (err) return err;
+  err = write_reg(pd, REG_USER_CTRL, USER_CTRL_FIFO_EN);
+  if (err) return err;
+  err = write_reg(pd, REG_FIFO_EN, FIFO_EN_ACCEL_GYRO);
+  if (err) return err;
+
+  const uint32_t sample_period_us = 1000000 / GYRO_OUTPUT_RATE_HZ * divider;
+  err = attitude_init(&attitudes[pd->name], &pd->attitude_param, sample_period_us, gyro_sensitivities[pd->gyro_range], 16384 >> pd->accel_range);
+  if (err) return err;
+
+  memset(&outputs[pd->name], 0, sizeof(Device_MPU6050_attitude));
+  memset(&stats[pd->name], 0, sizeof(Device_MPU6050_stats));
+  pendings[pd->name] = 0;
+  last_sample_ms[pd->name] = now_ms();
+
+  // 用 CPU 周期计数器统计融合耗时
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  // 字节数和数据都用组合传输读取, 高优先级, 不被 EEPROM 等低优先级传输推迟
+  count_transactions[pd->name] = (Device_I2C_transaction){
+    .slave_addr = pd->addr,
+    .direction = DEVICE_I2C_READ,
+    .reg = REG_FIFO_COUNTH,
+    .reg_len = 1,
+    .data = count_bufs[pd->name],
+    .len = sizeof(count_bufs[pd->name]),
+    .priority = DEVICE_I2C_PRIORITY_HIGH,
+    .callback = count_done,
+    .arg = (void *)pd,
+  };
+  data_transactions[pd->name] = (Device_I2C_transaction){
+    .slave_addr = pd->addr,
+    .direction = DEVICE_I2C_READ,
+    .reg = REG_FIFO_R_W,
+    .reg_len = 1,
+    .data = fifo_bufs[pd->name],
+    .priority = DEVICE_I2C_PRIORITY_HIGH,
+    .callback = data_done,
+    .arg = (void *)pd,
+  };
+  reset_bufs[pd->name] = USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RESET;
+  reset_transactions[pd->name] = (Device_I2C_transaction){
+    .slave_addr = pd->addr,
+    .direction = DEVICE_I2C_WRITE,
+    .reg = REG_USER_CTRL,
+    .reg_len = 1,
+    .data = &reset_bufs[pd->name],
+    .len = 1,
+    .priority = DEVICE_I2C_PRIORITY_HIGH,
+    .callback = reset_done,
+    .arg = (void *)pd,
+  };
+
+  return timebase_timer_start(&read_timers[pd->name], pd->read_period_ms, pd->read_period_ms, read_start, (void *)pd);
+}
+
+// 停止后台读取, 等待正在进行的读取结束
+static errno_t stop(const Device_MPU6050 *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  errno_t err = timebase_timer_stop(&read_timers[pd->name]);
+  if (err) return err;
+  while (readings[pd->name]);
+
+  return ESUCCESS;
+}
+
+static errno_t get_attitude(const Device_MPU6050 *const pd, Device_MPU6050_attitude *rt_attitude_ptr) {
+  if (pd == NULL || rt_attitude_ptr == NULL) return EINVAL;
+
+  const uint32_t primask = enter_critical();
+  *rt_attitude_ptr = outputs[pd->name];
+  const uint32_t sample_ms = last_sample_ms[pd->name];
+  exit_critical(primask);
+
+  rt_attitude_ptr->age_ms = now_ms() - sample_ms;
+
+  return ESUCCESS;
+}
+
+static errno_t set_heading(const Device_MPU6050 *const pd, q16_t heading) {
+  if (pd == NULL) return EINVAL;
+
+  const uint32_t primask = enter_critical();
+  pending_headings[pd->name] = heading;
+  pendings[pd->name] |= PENDING_HEADING;
+  // 下一次读取完成前也返回新的航向, 归一化到 [-180, 180)
+  outputs[pd->name].heading = attitude_heading_diff(heading, 0);
+  exit_critical(primask);
+
+  return ESUCCESS;
+}
+
+static errno_t recalibrate(const Device_MPU6050 *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  const uint32_t primask = enter_critical();
+  pendings[pd->name] |= PENDING_RESET;
+  pendings[pd->name] &= ~PENDING_HEADING;
+  outputs[pd->name].ready = false;
+  outputs[pd->name].still = false;
+  outputs[pd->name].heading = 0;
+  outputs[pd->name].yaw_rate = 0;
+  exit_critical(primask);
+
+  return ESUCCESS;
+}
+
+static errno_t get_stats(const Device_MPU6050 *const pd, Device_MPU6050_stats *rt_stats_ptr) {
+  if (pd == NULL || rt_stats_ptr == NULL) return EINVAL;
+
+  const uint32_t primask = enter_critical();
+  *rt_stats_ptr = stats[pd->name];
+  exit_critical(primask);
+
+  return ESUCCESS;
+}
+
+static errno_t read_reg(const Device_MPU6050 *const pd, uint8_t reg, uint8_t *rt_data, uint16_t len) {
+  Device_I2C_transaction transaction = {
+    .slave_addr = pd->addr,
+    .direction = DEVICE_I2C_READ,
+    .reg = reg,
+    .reg_len = 1,
+    .data = rt_data,
+    .len = len,
+    .priority = DEVICE_I2C_PRIORITY_LOW,
+  };
+  return pd->i2c->ops->transfer(pd->i2c, &transaction);
+}
+
+static errno_t write_reg(const Device_MPU6050 *const pd, uint8_t reg, uint8_t value) {
+  Device_I2C_transaction transaction = {
+    .slave_addr = pd->addr,
+    .direction = DEVICE_I2C_WRITE,
+    .reg = reg,
+    .reg_len = 1,
+    .data = &value,
+    .len = 1,
+    .priority = DEVICE_I2C_PRIORITY_LOW,
+  };
+  return pd->i2c->ops->transfer(pd->i2c, &transaction);
+}
+
+// 在 SysTick 中断中执行, 提交读取 FIFO 字节数的传输
+static void read_start(void *arg) {
+  const Device_MPU6050 *const pd = arg;
+  if (readings[pd->name]) return;
+  readings[pd->name] = 1;
+
+  errno_t err = pd->i2c->ops->submit(pd->i2c, &count_transactions[pd->name]);
+  if (err) read_end(pd, err);
+}
+
+/**
+ * @brief 读取字节数完成, 接着读取全部完整的采样
+ * 溢出后 FIFO 中的数据不再按采样对齐, 复位 FIFO 后从下一个采样重新开始
+ * 不完整的采样(传感器正在写入)留到下一次读取
+ */
+static void count_done(Device_I2C_transaction *pt, errno_t err) {
+  const Device_MPU6050 *const pd = pt->arg;
+  if (err) {
+    read_end(pd, err);
+    return;
+  }
+
+  const uint16_t count = ((uint16_t)count_bufs[pd->name][0] << 8) | count_bufs[pd->name][1];
+  if (count > FIFO_SIZE - PACKET_SIZE) {
+    ++stats[pd->name].overflows;
+    err = pd->i2c->ops->submit(pd->i2c, &reset_transactions[pd->name]);
+    if (err) read_end(pd, err);
+    return;
+  }
+
+  uint16_t packets = count / PACKET_SIZE;
+  if (packets > DEVICE_MPU6050_BATCH_MAX) packets = DEVICE_MPU6050_BATCH_MAX;
+  if (packets == 0) {
+    read_end(pd, ESUCCESS);
+    return;
+  }
+
+  data_transactions[pd->name].len = packets * PACKET_SIZE;
+  err = pd->i2c->ops->submit(pd->i2c, &data_transactions[pd->name]);
+  if (err) read_end(pd, err);
+}
+
+/**
+ * @brief 读取数据完成, 逐个采样融合后发布结果
+ * 在 DMA 中断中执行, 控制中断可能打断融合, 所以只在最后关中断复制结果
+ * 每个采样的融合耗时用 CPU 周期计数器测量
+ */
+static void data_done(Device_I2C_transaction *pt, errno_t err) {
+  const Device_MPU6050 *const pd = pt->arg;
+  if (err) {
+    read_end(pd, err);
+    return;
+  }
+
+  Attitude *const pa = &attitudes[pd->name];
+  Device_MPU6050_stats *const ps = &stats[pd->name];
+
+  uint32_t primask = enter_critical();
+  const uint8_t pending = pendings[pd->name];
+  const q16_t pending_heading = pending_headings[pd->name];
+  pendings[pd->name] = 0;
+  exit_critical(primask);
+  if (pending & PENDING_RESET) attitude_reset(pa);
+  if (pending & PENDING_HEADING) attitude_set_heading(pa, pending_heading);
+
+  const uint8_t *packet = fifo_bufs[pd->name];
+  const uint16_t packets = pt->len / PACKET_SIZE;
+  uint32_t cycles_max = 0, cycles = 0;
+  for (uint16_t i = 0; i < packets; ++i, packet += PACKET_SIZE) {
+    // 大端, 依次为加速度 XYZ, 角速度 XYZ
+    int16_t accel[ATTITUDE_AXIS_COUNT], gyro[ATTITUDE_AXIS_COUNT];
+    for (uint8_t axis = 0; axis < ATTITUDE_AXIS_COUNT; ++axis) {
+      accel[axis] = (int16_t)(((uint16_t)packet[axis * 2] << 8) | packet[axis * 2 + 1]);
+      gyro[axis] = (int16_t)(((uint16_t)packet[6 + axis * 2] << 8) | packet[6 + axis * 2 + 1]);
+    }
+
+    const uint32_t start_cycles = DWT->CYCCNT;
+    attitude_update(pa, accel, gyro);
+    cycles = DWT->CYCCNT - start_cycles;
+    if (cycles > cycles_max) cycles_max = cycles;
+  }
+
+  primask = enter_critical();
+  // 处理期间收到的新请求留到下一次, 此时发布的结果不覆盖请求设置的航向
+  if ((pendings[pd->name] & (PENDING_HEADING | PENDING_RESET)) == 0) {
+    outputs[pd->name].ready = attitude_ready(pa);
+    outputs[pd->name].still = attitude_still(pa);
+    outputs[pd->name].heading = attitude_get_heading(pa);
+    outputs[pd->name].yaw_rate = attitude_get_yaw_rate(pa);
+  }
+  last_sample_ms[pd->name] = now_ms();
+  ps->samples += packets;
+  ps->fusion_cycles_last = cycles;
+  if (cycles_max > ps->fusion_cycles_max) ps->fusion_cycles_max = cycles_max;
+  exit_critical(primask);
+
+  read_end(pd, ESUCCESS);
+}
+
+static void reset_done(Device_I2C_transaction *pt, errno_t err) {
+  read_end((const Device_MPU6050 *)pt->arg, err);
+}
+
+static void read_end(const Device_MPU6050 *const pd, errno_t err) {
+  if (err) ++stats[pd->name].errors;
+  readings[pd->name] = 0;
+}
+
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
+  return ((Device_MPU6050 *)pd)->name == *((Device_MPU6050_name *)name);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/errno/errno.h"
+#include "common/attitude/attitude.h"
+#include "device/i2c/i2c.h"
+
+// 每次从 FIFO 最多读取的采样数, 每个采样 12 字节(加速度和角速度各 3 轴)
+#define DEVICE_MPU6050_BATCH_MAX 16
+
+typedef enum {
+  DEVICE_MPU6050_1,
+  DEVICE_MPU6050_COUNT,
+} Device_MPU6050_name;
+
+// 陀螺仪量程, 对应 GYRO_CONFIG 的 FS_SEL
+typedef enum {
+  DEVICE_MPU6050_GYRO_250DPS,
+  DEVICE_MPU6050_GYRO_500DPS,
+  DEVICE_MPU6050_GYRO_1000DPS,
+  DEVICE_MPU6050_GYRO_2000DPS,
+} Device_MPU6050_gyro_range;
+
+// 加速度计量程, 对应 ACCEL_CONFIG 的 AFS_SEL
+typedef enum {
+  DEVICE_MPU6050_ACCEL_2G,
+  DEVICE_MPU6050_ACCEL_4G,
+  DEVICE_MPU6050_ACCEL_8G,
+  DEVICE_MPU6050_ACCEL_16G,
+} Device_MPU6050_accel_range;
+
+typedef struct {
+  bool ready; // 零偏标定完成
+  bool still;
+  q16_t heading; // 度, 逆时针为正, 范围 [-180, 180)
+  q16_t yaw_rate; // 度/秒, 逆时针为正
+  uint32_t age_ms; // 最近一个采样距今的毫秒数
+} Device_MPU6050_attitude;
+
+typedef struct {
+  uint32_t samples;
+  uint32_t overflows; // FIFO 溢出或错位后复位的次数
+  uint32_t errors; // I2C 传输失败的次数
+  // 每个采样的融合运算时间, 单位为 CPU 周期
+  uint32_t fusion_cycles_last;
+  uint32_t fusion_cycles_max;
+} Device_MPU6050_stats;
+
+struct Device_MPU6050;
+struct Device_MPU6050_ops;
+
+/**
+ * @brief MPU6050 六轴传感器
+ * 传感器按 sample_rate_hz 把采样写入内部 FIFO, 软件定时器每 read_period_ms 提交一次排队传输:
+ * 先读取 FIFO 中的字节数, 再用 DMA 一次读出全部完整的采样, 读取完成的中断中逐个采样做航向融合
+ * 主循环和控制中断只读取融合结果, 不等待 I2C
+ */
+typedef struct Device_MPU6050 {
+  const Device_MPU6050_name name;
+  const uint8_t addr;
+  const uint16_t sample_rate_hz; // 4 ~ 1000
+  const uint8_t dlpf; // 数字低通滤波器配置 DLPF_CFG, 1 ~ 6
+  const Device_MPU6050_gyro_range gyro_range;
+  const Device_MPU6050_accel_range accel_range;
+  const uint8_t read_period_ms;
+  const Attitude_param attitude_param;
+  Device_I2C *i2c;
+  const struct Device_MPU6050_ops *ops;
+} Device_MPU6050;
+
+typedef struct Device_MPU6050_ops {
+  // 配置传感器并开始后台读取, 之后需要静止一段时间标定零偏
+  errno_t (*init)(const Device_MPU6050 *const pd);
+  errno_t (*stop)(const Device_MPU6050 *const pd);
+  // 立即返回最近一次融合的结果, 可以在中断中调用
+  errno_t (*get_attitude)(const Device_MPU6050 *const pd, Device_MPU6050_attitude *rt_attitude_ptr);
+  // 设置当前航向, 单位为度
+  errno_t (*set_heading)(const Device_MPU6050 *const pd, q16_t heading);
+  // 重新标定零偏, 航向清零
+  errno_t (*recalibrate)(const Device_MPU6050 *const pd);
+  errno_t (*get_stats)(const Device_MPU6050 *const pd, Device_MPU6050_stats *rt_stats_ptr);
+} Device_MPU6050_ops;
+
+errno_t Device_MPU6050_module_init(void);
+errno_t Device_MPU6050_register(Device_MPU6050 *const pd);
+errno_t Device_MPU6050_find(const Device_MPU6050 **rt_pd_ptr, Device_MPU6050_name name);
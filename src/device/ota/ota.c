@@ -0,0 +1,358 @@
+#include "ota.h"
+#include "common/list/list.h"
+#include "common/crc/crc.h"
+#include "driver/ota/ota.h"
+#include "device/w25qx/config/index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+// 对象方法
+static errno_t init(Device_ota *const pd);
+static errno_t get_state(Device_ota *const pd, Device_ota_state *rt_state_ptr, uint32_t *rt_version_ptr);
+static errno_t begin(Device_ota *const pd, uint32_t size, uint32_t crc, uint32_t version, uint32_t *rt_offset_ptr);
+static errno_t write(Device_ota *const pd, uint32_t offset, const uint8_t *data, uint32_t len);
+static errno_t finish(Device_ota *const pd);
+static errno_t install(Device_ota *const pd);
+
+// 内部方法 - 读取暂存区头
+static errno_t load_header(Device_ota *const pd);
+// 内部方法 - 统计进度位图中已写入的扇区数量
+static errno_t count_written(Device_ota *const pd, uint32_t *rt_count_ptr);
+// 内部方法 - 把 [0, end) 内完整写入的扇区标记到进度位图
+static errno_t mark_written(Device_ota *const pd, uint32_t end);
+// 内部方法 - 等待上一块编程完成, 返回编程结果
+static errno_t wait_write(Device_ota *const pd);
+static void write_done(void *arg, errno_t err);
+static errno_t verify(Device_ota *const pd);
+static errno_t program_wait(Device_ota *const pd, uint32_t addr, const void *data, uint16_t len);
+static errno_t wait_idle(Device_ota *const pd);
+// 内部方法 - 查找设备
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
+
+static const Device_ota_ops device_ops = {
+  .init = init,
+  .get_state = get_state,
+  .begin = begin,
+  .write = write,
+  .finish = finish,
+  .install = install,
+};
+
+#define STATE_RECEIVING DEVICE_OTA_HEADER_STATE_RECEIVING
+#define STATE_READY DEVICE_OTA_HEADER_STATE_READY
+#define STATE_INSTALLED DEVICE_OTA_HEADER_STATE_INSTALLED
+
+#define HEADER_ADDR(pd) ((pd)->base_addr)
+#define BITMAP_ADDR(pd) ((pd)->base_addr + W25QX_PAGE_SIZE)
+#define IMAGE_ADDR(pd) ((pd)->base_addr + W25QX_SECTOR_SIZE)
+#define IMAGE_SIZE_MAX(pd) (((uint32_t)(pd)->sector_count - 1) * W25QX_SECTOR_SIZE)
+#define SECTORS(size) (((size) + W25QX_SECTOR_SIZE - 1) / W25QX_SECTOR_SIZE)
+
+static List *list = NULL;
+static const Driver_ota_ops *driver_ops = NULL;
+
+static Device_ota_header headers[DEVICE_OTA_COUNT] = {0};
+static Device_ota_state states[DEVICE_OTA_COUNT] = {0};
+// 下一块数据的偏移, 以及已经标记到进度位图的扇区数量
+static uint32_t next_offsets[DEVICE_OTA_COUNT] = {0};
+static uint32_t marked_sectors[DEVICE_OTA_COUNT] = {0};
+// 正在编程的块, 在 flash 回调中结束
+static volatile bool writings[DEVICE_OTA_COUNT] = {0};
+static volatile errno_t write_errs[DEVICE_OTA_COUNT] = {0};
+// 读取进度位图和校验固件用
+static uint8_t read_buffer[W25QX_PAGE_SIZE] = {0};
+
+errno_t Device_ota_module_init(void) {
+  if (list == NULL) {
+    errno_t err = list_create(&list);
+    if (err) return err;
+  }
+
+  if (driver_ops == NULL) {
+    errno_t err = Driver_ota_get_ops(&driver_ops);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+errno_t Device_ota_register(Device_ota *const pd) {
+  if (pd == NULL || list == NULL) return EINVAL;
+  pd->ops = &device_ops;
+  list->ops->head_insert(list, pd);
+  return ESUCCESS;
+}
+
+errno_t Device_ota_find(Device_ota **pd_ptr, const Device_ota_name name) {
+  if (list == NULL) return EINVAL;
+
+  errno_t err = list->ops->find(list, pd_ptr, &name, match_device_by_name);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t init(Device_ota *const pd) {
+  if (pd == NULL || pd->flash == NULL) return EINVAL;
+  if (pd->base_addr % W25QX_SECTOR_SIZE != 0 || pd->sector_count < 2) return EINVAL;
+  if (pd->base_addr + (uint32_t)pd->sector_count * W25QX_SECTOR_SIZE > W25QX_SIZE) return EINVAL;
+  // 进度位图只占一页
+  if ((uint32_t)pd->sector_count - 1 > W25QX_PAGE_SIZE * 8) return EINVAL;
+
+  errno_t err = pd->flash->ops->init(pd->flash);
+  if (err) return err;
+
+  writings[pd->name] = false;
+  write_errs[pd->name] = ESUCCESS;
+  next_offsets[pd->name] = 0;
+  marked_sectors[pd->name] = 0;
+
+  return load_header(pd);
+}
+
+static errno_t get_state(Device_ota *const pd, Device_ota_state *rt_state_ptr, uint32_t *rt_version_ptr) {
+  if (pd == NULL || rt_state_ptr == NULL) return EINVAL;
+  *rt_state_ptr = states[pd->name];
+  if (rt_version_ptr != NULL) *rt_version_ptr = headers[pd->name].version;
+  return ESUCCESS;
+}
+
+static errno_t begin(Device_ota *const pd, uint32_t size, uint32_t crc, uint32_t version, uint32_t *rt_offset_ptr) {
+  if (pd == NULL || rt_offset_ptr == NULL || size == 0) return EINVAL;
+  if (size > IMAGE_SIZE_MAX(pd) || size > DEVICE_OTA_APP_SIZE) return EFBIG;
+
+  // 上次中断的传输可能还有一块正在编程
+  errno_t err = wait_write(pd);
+  if (err) return err;
+
+  Device_ota_header *const ph = &headers[pd->name];
+  const Device_ota_state state = states[pd->name];
+  const bool same = (state == DEVICE_OTA_STATE_RECEIVING || state == DEVICE_OTA_STATE_READY)
+    && ph->size == size && ph->crc == crc && ph->version == version;
+
+  uint32_t written = 0;
+  if (same) {
+    err = count_written(pd, &written);
+    if (err) return err;
+
+    // 已写入的扇区之后可能有掉电时编程了一部分的数据
+    if (written < SECTORS(size)) {
+      err = pd->flash->ops->erase(pd->flash, IMAGE_ADDR(pd) + written * W25QX_SECTOR_SIZE, SECTORS(size) - written);
+      if (err) return err;
+    }
+  } else {
+    states[pd->name] = DEVICE_OTA_STATE_EMPTY;
+
+    err = pd->flash->ops->erase(pd->flash, pd->base_addr, 1 + SECTORS(size));
+    if (err) return err;
+
+    ph->magic = DEVICE_OTA_MAGIC;
+    ph->size = size;
+    ph->crc = crc;
+    ph->version = version;
+    ph->header_crc = crc32(0, ph, offsetof(Device_ota_header, header_crc));
+    ph->state = STATE_RECEIVING;
+    err = program_wait(pd, HEADER_ADDR(pd), ph, sizeof(Device_ota_header));
+    if (err) return err;
+
+    states[pd->name] = DEVICE_OTA_STATE_RECEIVING;
+  }
+
+  marked_sectors[pd->name] = written;
+  next_offsets[pd->name] = written * W25QX_SECTOR_SIZE < size ? written * W25QX_SECTOR_SIZE : size;
+  *rt_offset_ptr = next_offsets[pd->name];
+
+  return ESUCCESS;
+}
+
+static errno_t write(Device_ota *const pd, uint32_t offset, const uint8_t *data, uint32_t len) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  if (states[pd->name] != DEVICE_OTA_STATE_RECEIVING) return EPERM;
+  if (offset != next_offsets[pd->name]) return ESPIPE;
+  if (len > headers[pd->name].size - offset) return EFBIG;
+
+  errno_t err = wait_write(pd);
+  if (err) return err;
+
+  // 上一块已经编程完成, 之前的完整扇区可以标记
+  err = mark_written(pd, offset);
+  if (err) return err;
+
+  writings[pd->name] = true;
+  err = pd->flash->ops->program_async(pd->flash, IMAGE_ADDR(pd) + offset, data, len, write_done, pd);
+  if (err) {
+    writings[pd->name] = false;
+    return err;
+  }
+
+  next_offsets[pd->name] = offset + len;
+
+  return ESUCCESS;
+}
+
+static errno_t finish(Device_ota *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  const Device_ota_state state = states[pd->name];
+  if (state != DEVICE_OTA_STATE_RECEIVING && state != DEVICE_OTA_STATE_READY) return EPERM;
+
+  errno_t err = wait_write(pd);
+  if (err) return err;
+
+  Device_ota_header *const ph = &headers[pd->name];
+  if (next_offsets[pd->name] != ph->size) return EAGAIN;
+
+  err = mark_written(pd, ph->size);
+  if (err) return err;
+
+  err = verify(pd);
+  if (err == EBADMSG) {
+    // 清除标识, 下次 begin 时重新接收
+    const uint32_t magic = 0;
+    states[pd->name] = DEVICE_OTA_STATE_EMPTY;
+    errno_t err_invalidate = program_wait(pd, HEADER_ADDR(pd) + offsetof(Device_ota_header, magic), &magic, sizeof(magic));
+    if (err_invalidate) return err_invalidate;
+  }
+  if (err) return err;
+
+  ph->state = STATE_READY;
+  err = program_wait(pd, HEADER_ADDR(pd) + offsetof(Device_ota_header, state), &ph->state, sizeof(ph->state));
+  if (err) return err;
+
+  states[pd->name] = DEVICE_OTA_STATE_READY;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 安装固件
+ * 先检查固件开头的向量表(栈顶在 RAM 中, 复位地址在固件范围内), 避免把不是固件的数据写入内部 flash
+ * 等待 flash 空闲后复位, 引导程序看到等待安装的状态后完成复制
+ * @param pd
+ * @return errno_t 成功时不返回
+ */
+static errno_t install(Device_ota *const pd) {
+  if (pd == NULL) return EINVAL;
+  if (states[pd->name] != DEVICE_OTA_STATE_READY) return EPERM;
+
+  errno_t err = wait_write(pd);
+  if (err) return err;
+  err = wait_idle(pd);
+  if (err) return err;
+
+  const Device_ota_header *const ph = &headers[pd->name];
+
+  uint32_t vectors[2] = {0};
+  err = pd->flash->ops->read(pd->flash, IMAGE_ADDR(pd), (uint8_t *)vectors, sizeof(vectors));
+  if (err) return err;
+  const uint32_t sp = vectors[0], reset = vectors[1];
+  const bool sp_valid = (sp > 0x20000000u && sp <= 0x20020000u) || (sp > 0x10000000u && sp <= 0x10010000u);
+  const bool reset_valid = (reset & 1) && reset >= DEVICE_OTA_APP_ADDR && reset < DEVICE_OTA_APP_ADDR + ph->size;
+  if (!sp_valid || !reset_valid) return ENOEXEC;
+
+  return driver_ops->reset(pd);
+}
+
+static errno_t load_header(Device_ota *const pd) {
+  Device_ota_header *const ph = &headers[pd->name];
+
+  errno_t err = pd->flash->ops->read(pd->flash, HEADER_ADDR(pd), (uint8_t *)ph, sizeof(Device_ota_header));
+  if (err) return err;
+
+  states[pd->name] = DEVICE_OTA_STATE_EMPTY;
+  if (ph->magic != DEVICE_OTA_MAGIC) return ESUCCESS;
+  if (ph->header_crc != crc32(0, ph, offsetof(Device_ota_header, header_crc))) return ESUCCESS;
+  if (ph->size == 0 || ph->size > IMAGE_SIZE_MAX(pd)) return ESUCCESS;
+
+  // 编程 state 时掉电可能留下其他值, 按还没有完成的状态处理
+  if (ph->state == STATE_INSTALLED) {
+    states[pd->name] = DEVICE_OTA_STATE_INSTALLED;
+  } else if ((ph->state & 0xFFFFu) == 0) {
+    states[pd->name] = DEVICE_OTA_STATE_READY;
+  } else {
+    states[pd->name] = DEVICE_OTA_STATE_RECEIVING;
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t count_written(Device_ota *const pd, uint32_t *rt_count_ptr) {
+  const uint32_t sectors = SECTORS(headers[pd->name].size);
+
+  errno_t err = pd->flash->ops->read(pd->flash, BITMAP_ADDR(pd), read_buffer, (sectors + 7) / 8);
+  if (err) return err;
+
+  uint32_t count = 0;
+  while (count < sectors && (read_buffer[count / 8] & (1u << (count % 8))) == 0) ++count;
+  *rt_count_ptr = count;
+
+  return ESUCCESS;
+}
+
+static errno_t mark_written(Device_ota *const pd, uint32_t end) {
+  const uint32_t size = headers[pd->name].size;
+  const uint32_t target = end >= size ? SECTORS(size) : end / W25QX_SECTOR_SIZE;
+
+  for (uint32_t sector = marked_sectors[pd->name]; sector < target; ++sector) {
+    // 编程时 1 不改变原来的位, 只需要把这一位写成 0
+    const uint8_t value = ~(1u << (sector % 8));
+    errno_t err = program_wait(pd, BITMAP_ADDR(pd) + sector / 8, &value, 1);
+    if (err) return err;
+    marked_sectors[pd->name] = sector + 1;
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t wait_write(Device_ota *const pd) {
+  while (writings[pd->name]);
+
+  const errno_t err = write_errs[pd->name];
+  write_errs[pd->name] = ESUCCESS;
+  return err;
+}
+
+// 在 SPI 或 SysTick 中断中执行
+static void write_done(void *arg, errno_t err) {
+  Device_ota *const pd = arg;
+  write_errs[pd->name] = err;
+  writings[pd->name] = false;
+}
+
+static errno_t verify(Device_ota *const pd) {
+  const Device_ota_header *const ph = &headers[pd->name];
+
+  uint32_t crc = 0;
+  for (uint32_t offset = 0; offset < ph->size; offset += sizeof(read_buffer)) {
+    const uint32_t len = ph->size - offset < sizeof(read_buffer) ? ph->size - offset : sizeof(read_buffer);
+    errno_t err = pd->flash->ops->read(pd->flash, IMAGE_ADDR(pd) + offset, read_buffer, len);
+    if (err) return err;
+    crc = crc32(crc, read_buffer, len);
+  }
+
+  return crc == ph->crc ? ESUCCESS : EBADMSG;
+}
+
+static errno_t program_wait(Device_ota *const pd, uint32_t addr, const void *data, uint16_t len) {
+  writings[pd->name] = true;
+  errno_t err = pd->flash->ops->program_async(pd->flash, addr, data, len, write_done, pd);
+  if (err) {
+    writings[pd->name] = false;
+    return err;
+  }
+  return wait_write(pd);
+}
+
+static errno_t wait_idle(Device_ota *const pd) {
+  bool busy = true;
+  while (busy) {
+    errno_t err = pd->flash->ops->is_busy(pd->flash, &busy);
+    if (err) return err;
+  }
+  return ESUCCESS;
+}
+
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
+  return ((Device_ota *)pd)->name == *((Device_ota_name *)name);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/w25qx/w25qx.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// 暂存区头标识 "OTA1"
+#define DEVICE_OTA_MAGIC 0x3141544Fu
+/**
+ * 内部 flash 的划分: 扇区 0 (16KB) 为引导程序(boot/), 之后为应用程序
+ * 应用程序的链接地址和向量表偏移(VTOR)都与 DEVICE_OTA_APP_ADDR 一致
+ */
+#define DEVICE_OTA_BOOT_ADDR 0x08000000u
+#define DEVICE_OTA_APP_ADDR 0x08004000u
+#define DEVICE_OTA_APP_SIZE (0x100000u - (DEVICE_OTA_APP_ADDR - DEVICE_OTA_BOOT_ADDR))
+// 暂存区在外部 flash 中的位置, 引导程序和 device_config/ota 共用
+#define DEVICE_OTA_STAGING_ADDR 0x700000u
+#define DEVICE_OTA_STAGING_SECTOR_COUNT 224
+
+// 暂存区头 state 字段的取值, 只从 1 编程为 0
+#define DEVICE_OTA_HEADER_STATE_RECEIVING 0xFFFFFFFFu
+#define DEVICE_OTA_HEADER_STATE_READY 0xFFFF0000u
+#define DEVICE_OTA_HEADER_STATE_INSTALLED 0x00000000u
+
+typedef enum {
+  DEVICE_OTA_1,
+  DEVICE_OTA_COUNT,
+} Device_ota_name;
+
+typedef enum {
+  DEVICE_OTA_STATE_EMPTY, // 暂存区没有固件
+  DEVICE_OTA_STATE_RECEIVING, // 正在接收, 可以断点续传
+  DEVICE_OTA_STATE_READY, // 接收完成并校验通过, 等待安装
+  DEVICE_OTA_STATE_INSTALLED, // 已复制到内部 flash
+} Device_ota_state;
+
+/**
+ * @brief 暂存区头, 位于存储区第一个扇区的第一页
+ * state 只从 1 编程为 0, 不需要擦除: 全 1 为接收中, 低半字为 0 为等待安装, 全 0 为已安装
+ * 等待安装时引导程序每次启动都重新复制, 校验通过并写入已安装之后才跳转到应用程序, 复制中掉电不会留下损坏的程序
+ * 第二页为进度位图, 第 i 位为 0 表示固件的第 i 个扇区已写入, 掉电后从第一个为 1 的扇区继续
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t size; // 固件字节数
+  uint32_t crc; // 整个固件的 CRC32
+  uint32_t version; // 由服务端指定, 用于区分不同的固件
+  uint32_t header_crc; // 覆盖以上字段
+  uint32_t state;
+} Device_ota_header;
+
+struct Device_ota;
+struct Device_ota_ops;
+
+/**
+ * @brief 固件升级暂存区
+ * 固件分块接收后异步编程到外部 flash, 编程期间可以接收下一块; 校验通过后复位, 由引导程序复制到内部 flash
+ * 存储区第一个扇区为暂存区头和进度位图, 之后是固件
+ */
+typedef struct Device_ota {
+  const Device_ota_name name;
+  const uint32_t base_addr; // 存储区起始地址, 需要扇区对齐
+  const uint16_t sector_count; // 存储区扇区数量, 包括头所在的扇区
+  const Device_W25QX *flash;
+  const struct Device_ota_ops *ops;
+} Device_ota;
+
+typedef struct Device_ota_ops {
+  // 初始化 flash 并读取暂存区头
+  errno_t (*init)(Device_ota *const pd);
+  errno_t (*get_state)(Device_ota *const pd, Device_ota_state *rt_state_ptr, uint32_t *rt_version_ptr);
+  /**
+   * 开始接收固件, 返回下一块数据的偏移
+   * 暂存区中是同一个固件(大小, CRC 和版本相同)且没有接收完时从已写入的扇区之后继续, 否则擦除后从 0 开始
+   * 固件超过存储区或内部 flash 时返回 EFBIG
+   */
+  errno_t (*begin)(Device_ota *const pd, uint32_t size, uint32_t crc, uint32_t version, uint32_t *rt_offset_ptr);
+  /**
+   * 写入一块数据, 等待上一块编程完成后开始编程这一块并立即返回
+   * offset 必须等于上一块的末尾, data 在下一次 write 或 finish 返回之前必须保持有效
+   */
+  errno_t (*write)(Device_ota *const pd, uint32_t offset, const uint8_t *data, uint32_t len);
+  // 等待编程完成并校验整个固件, 通过后标记为等待安装, 不通过时返回 EBADMSG, 下次 begin 重新开始
+  errno_t (*finish)(Device_ota *const pd);
+  // 检查等待安装的固件后复位, 由引导程序复制到内部 flash, 成功时不返回
+  errno_t (*install)(Device_ota *const pd);
+} Device_ota_ops;
+
+typedef struct Driver_ota_ops {
+  // 等待外设空闲后复位
+  errno_t (*reset)(const Device_ota *const pd);
+} Driver_ota_ops;
+
+// 全局方法
+errno_t Device_ota_module_init(void);
+errno_t Device_ota_register(Device_ota *const pd);
+errno_t Device_ota_find(Device_ota **pd_ptr, const Device_ota_name name);
@@ -0,0 +1,316 @@
+#include "power.h"
+#include "common/list/list.h"
+#include "common/timebase/timebase.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 对象方法
+static errno_t init(Device_power *const pd);
+static errno_t update(Device_power *const pd);
+static errno_t get_status(Device_power *const pd, Device_power_status *rt_status_ptr);
+static errno_t get_policy(Device_power *const pd, const Device_power_policy **rt_policy_ptr);
+static errno_t sleep(Device_power *const pd);
+static errno_t wake(Device_power *const pd);
+
+// 内部方法 - 单节电压换算为电量
+static uint8_t cell_mv_to_soc(uint32_t cell_mv);
+// 内部方法 - 按电量计算等级, 带回差
+static Device_power_level soc_to_level(const Device_power *const pd, uint8_t soc, Device_power_level level);
+// 内部方法 - 应用等级对应的策略
+static errno_t apply_policy(Device_power *const pd, Device_power_level level);
+// 内部方法 - 睡眠, with_flash 为 false 时只关闭屏幕
+static errno_t enter_sleep(Device_power *const pd, bool with_flash);
+// 内部方法 - 查找设备
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
+
+static const Device_power_ops device_ops = {
+  .init = init,
+  .update = update,
+  .get_status = get_status,
+  .get_policy = get_policy,
+  .sleep = sleep,
+  .wake = wake,
+};
+
+// ADC 满量程
+#define ADC_FULL_SCALE 4095
+// 电压滤波系数为 1 / 2^VOLTAGE_EMA_SHIFT, ADC 已经做过平滑, 这里只滤除负载变化引起的波动
+#define VOLTAGE_EMA_SHIFT 2
+// 电压变化趋势的统计窗口
+#define TREND_WINDOW_MS 60000
+
+/**
+ * 锂电池单节开路电压与剩余电量的对应关系, 电压从低到高排列
+ * 放电中段电压变化平缓, 分段线性插值
+ */
+static const struct {
+  uint16_t cell_mv;
+  uint8_t soc;
+} soc_table[] = {
+  {3300, 0},
+  {3500, 5},
+  {3600, 10},
+  {3700, 30},
+  {3750, 45},
+  {3800, 55},
+  {3850, 65},
+  {3900, 72},
+  {4000, 82},
+  {4100, 92},
+  {4200, 100},
+};
+
+static List *list = NULL;
+
+static Device_power_status statuses[DEVICE_POWER_COUNT] = {0};
+// 是否已有电压值
+static bool sampled[DEVICE_POWER_COUNT] = {0};
+// 趋势窗口起点
+static uint32_t window_begin_ms[DEVICE_POWER_COUNT] = {0};
+static uint32_t window_begin_mv[DEVICE_POWER_COUNT] = {0};
+// 因电量过低自动进入的睡眠, 电量恢复后自动唤醒
+static bool auto_sleeping[DEVICE_POWER_COUNT] = {0};
+// flash 已进入掉电模式, 唤醒时才需要退出
+static bool flash_downs[DEVICE_POWER_COUNT] = {0};
+
+errno_t Device_power_module_init(void) {
+  if (list == NULL) {
+    errno_t err = list_create(&list);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+errno_t Device_power_register(Device_power *const pd) {
+  if (pd == NULL || list == NULL) return EINVAL;
+  pd->ops = &device_ops;
+  list->ops->head_insert(list, pd);
+  return ESUCCESS;
+}
+
+errno_t Device_power_find(Device_power **pd_ptr, const Device_power_name name) {
+  if (list == NULL) return EINVAL;
+
+  errno_t err = list->ops->find(list, pd_ptr, &name, match_device_by_name);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t init(Device_power *const pd) {
+  if (pd == NULL || pd->adc == NULL) return EINVAL;
+  if (pd->battery.divider_denominator == 0 || pd->battery.cell_count == 0) return EINVAL;
+
+  errno_t err = ESUCCESS;
+
+  err = timebase_init();
+  if (err) return err;
+
+  err = pd->adc->ops->init(pd->adc);
+  if (err) return err;
+
+  memset(&statuses[pd->name], 0, sizeof(Device_power_status));
+  statuses[pd->name].level = DEVICE_POWER_LEVEL_NORMAL;
+  sampled[pd->name] = false;
+  auto_sleeping[pd->name] = false;
+  flash_downs[pd->name] = false;
+
+  err = apply_policy(pd, DEVICE_POWER_LEVEL_NORMAL);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 更新电池状态
+ * 电量只降不升的方向立即切换等级, 回升时需要超过回差, 电机启停造成的电压跌落不会反复切换策略
+ * 进入严重低电量时停车并自动睡眠, 电量恢复(如更换电池)后自动唤醒
+ * 自动睡眠只关闭屏幕: 记录器和键值存储随时可能访问 flash, 掉电后的 flash 不响应读写命令
+ * @param pd
+ * @return errno_t
+ */
+static errno_t update(Device_power *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  errno_t err = ESUCCESS;
+  Device_power_status *const ps = &statuses[pd->name];
+
+  uint16_t raw = 0;
+  err = pd->adc->ops->read_latest(pd->adc, &raw);
+  if (err) return err;
+
+  const uint32_t pin_mv = (uint32_t)raw * pd->battery.vref_mv / ADC_FULL_SCALE;
+  const uint32_t battery_mv = pin_mv * pd->battery.divider_numerator / pd->battery.divider_denominator;
+  const uint32_t now = now_ms();
+
+  if (sampled[pd->name] == false) {
+    ps->voltage_mv = battery_mv;
+    window_begin_ms[pd->name] = now;
+    window_begin_mv[pd->name] = battery_mv;
+    sampled[pd->name] = true;
+  } else {
+    const int32_t diff = (int32_t)battery_mv - (int32_t)ps->voltage_mv;
+    ps->voltage_mv = (uint32_t)((int32_t)ps->voltage_mv + (diff >> VOLTAGE_EMA_SHIFT));
+  }
+
+  // 每个窗口结束时计算一次电压变化速度
+  const uint32_t window_ms = now - window_begin_ms[pd->name];
+  if (window_ms >= TREND_WINDOW_MS) {
+    const int32_t delta_mv = (int32_t)ps->voltage_mv - (int32_t)window_begin_mv[pd->name];
+    ps->trend_mv_per_min = (int32_t)((int64_t)delta_mv * 60000 / window_ms);
+    window_begin_ms[pd->name] = now;
+    window_begin_mv[pd->name] = ps->voltage_mv;
+  }
+
+  ps->soc = cell_mv_to_soc(ps->voltage_mv / pd->battery.cell_count);
+
+  const Device_power_level level = soc_to_level(pd, ps->soc, ps->level);
+  if (level == ps->level) return ESUCCESS;
+
+  err = apply_policy(pd, level);
+  if (err) return err;
+
+  if (level == DEVICE_POWER_LEVEL_CRITICAL && ps->sleeping == false) {
+    err = enter_sleep(pd, false);
+    if (err) return err;
+    auto_sleeping[pd->name] = true;
+  } else if (level != DEVICE_POWER_LEVEL_CRITICAL && auto_sleeping[pd->name]) {
+    err = wake(pd);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t get_status(Device_power *const pd, Device_power_status *rt_status_ptr) {
+  if (pd == NULL || rt_status_ptr == NULL) return EINVAL;
+  if (sampled[pd->name] == false) return ENODATA;
+
+  *rt_status_ptr = statuses[pd->name];
+
+  return ESUCCESS;
+}
+
+static errno_t get_policy(Device_power *const pd, const Device_power_policy **rt_policy_ptr) {
+  if (pd == NULL || rt_policy_ptr == NULL) return EINVAL;
+
+  *rt_policy_ptr = &pd->policies[statuses[pd->name].level];
+
+  return ESUCCESS;
+}
+
+static errno_t sleep(Device_power *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  return enter_sleep(pd, true);
+}
+
+static errno_t wake(Device_power *const pd) {
+  if (pd == NULL) return EINVAL;
+  if (statuses[pd->name].sleeping == false) return ESUCCESS;
+
+  errno_t err = ESUCCESS;
+
+  if (flash_downs[pd->name]) {
+    err = pd->flash->ops->release_power_down(pd->flash);
+    if (err) return err;
+    flash_downs[pd->name] = false;
+  }
+  if (pd->display != NULL) {
+    err = pd->display->ops->wake(pd->display);
+    if (err) return err;
+    // 唤醒会打开背光, 按当前策略恢复
+    err = pd->display->ops->set_backlight(pd->display, pd->policies[statuses[pd->name].level].backlight);
+    if (err) return err;
+  }
+
+  statuses[pd->name].sleeping = false;
+  auto_sleeping[pd->name] = false;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 屏幕进入睡眠, with_flash 时 flash 进入掉电模式
+ * flash 正在擦除/编程或有异步操作时返回 EBUSY, 屏幕保持原状态
+ * @param pd
+ * @param with_flash
+ * @return errno_t
+ */
+static errno_t enter_sleep(Device_power *const pd, bool with_flash) {
+  if (statuses[pd->name].sleeping) return ESUCCESS;
+
+  errno_t err = ESUCCESS;
+
+  if (with_flash && pd->flash != NULL) {
+    bool busy = false;
+    err = pd->flash->ops->is_busy(pd->flash, &busy);
+    if (err) return err;
+    if (busy) return EBUSY;
+  }
+
+  if (pd->display != NULL) {
+    err = pd->display->ops->sleep(pd->display);
+    if (err) return err;
+  }
+  if (with_flash && pd->flash != NULL) {
+    err = pd->flash->ops->power_down(pd->flash);
+    if (err) return err;
+    flash_downs[pd->name] = true;
+  }
+
+  statuses[pd->name].sleeping = true;
+
+  return ESUCCESS;
+}
+
+static uint8_t cell_mv_to_soc(uint32_t cell_mv) {
+  const uint8_t last = sizeof(soc_table) / sizeof(soc_table[0]) - 1;
+
+  if (cell_mv <= soc_table[0].cell_mv) return soc_table[0].soc;
+  if (cell_mv >= soc_table[last].cell_mv) return soc_table[last].soc;
+
+  uint8_t i = 1;
+  while (cell_mv > soc_table[i].cell_mv) ++i;
+
+  const uint32_t mv_low = soc_table[i - 1].cell_mv, mv_high = soc_table[i].cell_mv;
+  const uint32_t soc_low = soc_table[i - 1].soc, soc_high = soc_table[i].soc;
+
+  return (uint8_t)(soc_low + (cell_mv - mv_low) * (soc_high - soc_low) / (mv_high - mv_low));
+}
+
+static Device_power_level soc_to_level(const Device_power *const pd, uint8_t soc, Device_power_level level) {
+  // 电量下降, 进入更低的等级
+  while (level + 1 < DEVICE_POWER_LEVEL_COUNT && soc < pd->policies[level + 1].enter_soc) {
+    ++level;
+  }
+  // 电量回升, 超过回差后回到更高的等级
+  while (level > DEVICE_POWER_LEVEL_NORMAL && soc >= pd->policies[level].enter_soc + pd->battery.hysteresis_soc) {
+    --level;
+  }
+
+  return level;
+}
+
+static errno_t apply_policy(Device_power *const pd, Device_power_level level) {
+  const Device_power_policy *const pp = &pd->policies[level];
+  errno_t err = ESUCCESS;
+
+  err = Device_motor_set_duty_limit(pp->motor_duty_max);
+  if (err) return err;
+
+  // 睡眠时背光已关闭, 唤醒时再按策略设置
+  if (pd->display != NULL && statuses[pd->name].sleeping == false) {
+    err = pd->display->ops->set_backlight(pd->display, pp->backlight);
+    if (err) return err;
+  }
+
+  statuses[pd->name].level = level;
+
+  return ESUCCESS;
+}
+
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
+  return ((Device_power *)pd)->name == *((Device_power_name *)name);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/adc/adc.h"
+#include "device/motor/motor.h"
+#include "device/st7789v2/st7789v2.h"
+#include "device/w25qx/w25qx.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+  DEVICE_POWER_BATTERY,
+  DEVICE_POWER_COUNT,
+} Device_power_name;
+
+/**
+ * @brief 电量等级, 数值越大电量越低
+ */
+typedef enum {
+  DEVICE_POWER_LEVEL_NORMAL,
+  DEVICE_POWER_LEVEL_SAVING,
+  DEVICE_POWER_LEVEL_LOW,
+  DEVICE_POWER_LEVEL_CRITICAL,
+  DEVICE_POWER_LEVEL_COUNT,
+} Device_power_level;
+
+/**
+ * @brief 电量等级对应的功耗策略
+ * 电机最大速度和背光由电源管理直接设置, 其余周期由应用层按策略执行, 为 0 表示停止该功能
+ */
+typedef struct {
+  uint8_t enter_soc; // 电量(%)低于该值时进入该等级, 正常等级不使用
+  speed_t motor_duty_max;
+  bool backlight;
+  uint32_t display_refresh_ms;
+  uint32_t wifi_send_interval_ms;
+  uint32_t sensor_poll_ms;
+} Device_power_policy;
+
+/**
+ * @brief 电池参数
+ * 电池电压 = ADC 引脚电压 * divider_numerator / divider_denominator
+ */
+typedef struct {
+  uint16_t vref_mv;
+  uint16_t divider_numerator;
+  uint16_t divider_denominator;
+  uint8_t cell_count; // 串联的锂电池节数
+  uint8_t hysteresis_soc; // 电量回升超过进入值加该值后才回到上一个等级, 避免负载变化时来回切换
+} Device_power_battery_param;
+
+typedef struct {
+  uint32_t voltage_mv; // 滤波后的电池电压
+  uint8_t soc; // 剩余电量 0 ~ 100
+  // 电压变化趋势, 单位为 毫伏/分钟, 负数为放电; 没有电流采样, 用电压下降速度反映负载大小
+  int32_t trend_mv_per_min;
+  Device_power_level level;
+  bool sleeping;
+} Device_power_status;
+
+struct Device_power;
+struct Device_power_ops;
+
+typedef struct Device_power {
+  const Device_power_name name;
+  const Device_power_battery_param battery;
+  const Device_power_policy policies[DEVICE_POWER_LEVEL_COUNT];
+  Device_ADC *adc;
+  // 睡眠时关闭的外设, 可以为 NULL
+  Device_ST7789V2 *display;
+  const Device_W25QX *flash;
+  const struct Device_power_ops *ops;
+} Device_power;
+
+typedef struct Device_power_ops {
+  errno_t (*init)(Device_power *const pd);
+  // 采样电池电压并更新电量和等级, 等级变化时应用新的策略, 需要周期调用, 还没有采样结果时返回 ENODATA
+  errno_t (*update)(Device_power *const pd);
+  errno_t (*get_status)(Device_power *const pd, Device_power_status *rt_status_ptr);
+  // 当前等级的策略
+  errno_t (*get_policy)(Device_power *const pd, const Device_power_policy **rt_policy_ptr);
+  // 屏幕进入睡眠, flash 进入掉电模式; flash 正在擦写时返回 EBUSY, 调用前需停止记录器等使用 flash 的模块
+  errno_t (*sleep)(Device_power *const pd);
+  errno_t (*wake)(Device_power *const pd);
+} Device_power_ops;
+
+// 全局方法
+errno_t Device_power_module_init(void);
+errno_t Device_power_register(Device_power *const pd);
+errno_t Device_power_find(Device_power **pd_ptr, const Device_power_name name);
@@ -10,6 +10,11 @@ static errno_t is_running(const Device_PWM *const pd, bool *rt_running_ptr);
 static errno_t start(const Device_PWM *const pd);
 static errno_t stop(const Device_PWM *const pd);
 static errno_t set_period(const Device_PWM *const pd, uint32_t up_us, uint32_t total_us);
+static errno_t set_timing(const Device_PWM *const pd, uint32_t count_frequent, uint32_t period_count);
+static errno_t set_duty(const Device_PWM *const pd, uint32_t count);
+static errno_t get_auto_reload_register(const Device_PWM *const pd, uint32_t *rt_value_ptr);
+static errno_t set_preload(const Device_PWM *const pd, bool enable);
+static errno_t set_update_enable(const Device_PWM *const pd, bool enable);
 
 // 内部方法 - 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
@@ -20,6 +25,11 @@ static const Device_PWM_ops device_ops = {
   .start = start,
   .stop = stop,
   .set_period = set_period,
+  .set_timing = set_timing,
+  .set_duty = set_duty,
+  .get_auto_reload_register = get_auto_reload_register,
+  .set_preload = set_preload,
+  .set_update_enable = set_update_enable,
 };
 
 static const Driver_pwm_ops *driver_ops = NULL;
@@ -118,6 +128,54 @@ static errno_t set_period(const Device_PWM *const pd, uint32_t pre_us, uint32_t
   return ESUCCESS;
 }
 
+/**
+ * @brief 配置 PWM 时序
+ * 之后用 set_duty 直接以计数值设置占空比, 更新占空比时不需要任何除法
+ * @param pd 
+ * @param count_frequent 计数频率, 单位 Hz, 需要能整除定时器时钟频率
+ * @param period_count 每个周期的计数值
+ * @return errno_t 
+ */
+static errno_t set_timing(const Device_PWM *const pd, uint32_t count_frequent, uint32_t period_count) {
+  if (pd == NULL || driver_ops == NULL || count_frequent == 0 || period_count == 0) return EINVAL;
+  errno_t err = ESUCCESS;
+
+  uint32_t frequent = 0;
+  err = driver_ops->get_source_frequent(pd, &frequent);
+  if (err) return err;
+
+  const uint32_t prescaler = frequent / count_frequent;
+  if (prescaler == 0 || prescaler > 0x10000 || prescaler * count_frequent != frequent) return EINVAL;
+
+  err = driver_ops->set_prescaler(pd, prescaler - 1);
+  if (err) return err;
+
+  err = driver_ops->set_auto_reload_register(pd, period_count - 1);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t set_duty(const Device_PWM *const pd, uint32_t count) {
+  if (pd == NULL || driver_ops == NULL) return EINVAL;
+  return driver_ops->set_compare(pd, count);
+}
+
+static errno_t get_auto_reload_register(const Device_PWM *const pd, uint32_t *rt_value_ptr) {
+  if (pd == NULL || rt_value_ptr == NULL || driver_ops == NULL) return EINVAL;
+  return driver_ops->get_auto_reload_register(pd, rt_value_ptr);
+}
+
+static errno_t set_preload(const Device_PWM *const pd, bool enable) {
+  if (pd == NULL || driver_ops == NULL) return EINVAL;
+  return driver_ops->set_preload(pd, enable);
+}
+
+static errno_t set_update_enable(const Device_PWM *const pd, bool enable) {
+  if (pd == NULL || driver_ops == NULL) return EINVAL;
+  return driver_ops->set_update_enable(pd, enable);
+}
+
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
   return ((Device_PWM *)pd)->name == *((Device_PWM_name *)name);
 }
@@ -30,6 +30,15 @@ typedef struct Device_PWM_ops {
   errno_t (*start)(const Device_PWM *const pd);
   errno_t (*stop)(const Device_PWM *const pd);
   errno_t (*set_period)(const Device_PWM *const pd, uint32_t pre_us, uint32_t total_us);
+  // 配置计数频率和每个周期的计数值, 一般只在初始化时调用一次, 同一定时器的所有通道共用
+  errno_t (*set_timing)(const Device_PWM *const pd, uint32_t count_frequent, uint32_t period_count);
+  // 设置前半段电平的计数值, 只写比较寄存器, 不重新计算分频和重装载值
+  errno_t (*set_duty)(const Device_PWM *const pd, uint32_t count);
+  errno_t (*get_auto_reload_register)(const Device_PWM *const pd, uint32_t *rt_value_ptr);
+  // 开启后比较寄存器和重装载寄存器的写入在下一个更新事件才生效
+  errno_t (*set_preload)(const Device_PWM *const pd, bool enable);
+  // 关闭后不产生更新事件, 用于同一定时器多个通道的比较值同时生效
+  errno_t (*set_update_enable)(const Device_PWM *const pd, bool enable);
 } Device_PWM_ops;
 
 typedef struct Driver_pwm_ops {
@@ -40,6 +49,9 @@ typedef struct Driver_pwm_ops {
   errno_t (*set_clock_division)(const Device_PWM *const pd, uint8_t value);
   errno_t (*set_auto_reload_register)(const Device_PWM *const pd, uint32_t value);
   errno_t (*set_compare)(const Device_PWM *const pd, uint32_t value);
+  errno_t (*get_auto_reload_register)(const Device_PWM *const pd, uint32_t *rt_value_ptr);
+  errno_t (*set_preload)(const Device_PWM *const pd, bool enable);
+  errno_t (*set_update_enable)(const Device_PWM *const pd, bool enable);
   errno_t (*get_source_frequent)(const Device_PWM *const pd, uint32_t *rt_frequent_ptr);
 } Driver_pwm_ops;
 
@@ -0,0 +1,395 @@
+#include "recorder.h"
+#include "common/list/list.h"
+#include "common/crc/crc.h"
+#include "common/timebase/timebase.h"
+#include "device/w25qx/config/index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+// 对象方法
+static errno_t init(Device_recorder *const pd);
+static errno_t start(Device_recorder *const pd);
+static errno_t stop(Device_recorder *const pd);
+static errno_t record(Device_recorder *const pd, const Device_recorder_sample *const ps);
+static errno_t poll(Device_recorder *const pd);
+static errno_t dump(Device_recorder *const pd, Device_recorder_sink *sink, void *arg);
+static errno_t get_dropped(Device_recorder *const pd, uint32_t *rt_dropped_ptr);
+
+// 内部方法 - 查找上次记录的位置
+static errno_t find_head(Device_recorder *const pd);
+// 内部方法 - 异步擦除/编程完成回调, 在 SPI 或 SysTick 中断中执行
+static void erase_done(void *arg, errno_t err);
+static void program_done(void *arg, errno_t err);
+// 内部方法 - 等待正在进行的擦除/编程完成
+static errno_t wait_idle(Device_recorder *const pd);
+static uint32_t page_crc(const Device_recorder_page *const pp);
+// 内部方法 - 读取一页并检查 magic 和 crc, 编程时掉电的页 seq 可能只写了一部分, 不能只看 magic
+static errno_t read_valid_page(Device_recorder *const pd, uint32_t addr, bool *rt_valid_ptr);
+// 内部方法 - 查找设备
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
+
+static const Device_recorder_ops device_ops = {
+  .init = init,
+  .start = start,
+  .stop = stop,
+  .record = record,
+  .poll = poll,
+  .dump = dump,
+  .get_dropped = get_dropped,
+};
+
+#define PAGE_MAGIC 0x31524442u // "BDR1"
+
+_Static_assert(sizeof(Device_recorder_sample) == 30, "sample size");
+_Static_assert(sizeof(Device_recorder_page) == W25QX_PAGE_SIZE, "page size must equal flash page size");
+
+#define REGION_SIZE(pd) ((uint32_t)(pd)->sector_count * W25QX_SECTOR_SIZE)
+// 存储区内的下一个地址, 到末尾后回到开头
+#define REGION_NEXT(pd, addr, step) ((addr) + (step) >= (pd)->base_addr + REGION_SIZE(pd) ? (pd)->base_addr : (addr) + (step))
+
+static List *list = NULL;
+
+// 页缓冲为环形队列, [flush_index, fill_index) 为已写满等待写入 flash 的页, fill_index 为正在填充的页
+static Device_recorder_page buffers[DEVICE_RECORDER_COUNT][DEVICE_RECORDER_BUFFER_NUM] = {0};
+static volatile uint8_t fill_indexes[DEVICE_RECORDER_COUNT] = {0};
+static volatile uint8_t fill_counts[DEVICE_RECORDER_COUNT] = {0};
+static volatile uint8_t flush_indexes[DEVICE_RECORDER_COUNT] = {0};
+static volatile bool runnings[DEVICE_RECORDER_COUNT] = {0};
+static volatile uint32_t droppeds[DEVICE_RECORDER_COUNT] = {0};
+// 下一页写入 flash 的地址和序号
+static uint32_t write_addrs[DEVICE_RECORDER_COUNT] = {0};
+static uint32_t seqs[DEVICE_RECORDER_COUNT] = {0};
+// 需要提前擦除的扇区
+static volatile bool erase_pendings[DEVICE_RECORDER_COUNT] = {0};
+static uint32_t erase_addrs[DEVICE_RECORDER_COUNT] = {0};
+// 正在进行的异步擦除/编程, 由完成回调清除; 失败的结果留给下一次 poll 返回
+static volatile bool flash_busys[DEVICE_RECORDER_COUNT] = {0};
+static volatile errno_t flash_errs[DEVICE_RECORDER_COUNT] = {0};
+// 初始化和导出时读取 flash 用
+static Device_recorder_page read_page = {0};
+
+errno_t Device_recorder_module_init(void) {
+  if (list == NULL) {
+    errno_t err = list_create(&list);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+errno_t Device_recorder_register(Device_recorder *const pd) {
+  if (pd == NULL || list == NULL) return EINVAL;
+  pd->ops = &device_ops;
+  list->ops->head_insert(list, pd);
+  return ESUCCESS;
+}
+
+errno_t Device_recorder_find(Device_recorder **pd_ptr, const Device_recorder_name name) {
+  if (list == NULL) return EINVAL;
+
+  errno_t err = list->ops->find(list, pd_ptr, &name, match_device_by_name);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t init(Device_recorder *const pd) {
+  if (pd == NULL || pd->flash == NULL) return EINVAL;
+  if (pd->base_addr % W25QX_SECTOR_SIZE != 0 || pd->sector_count < 2) return EINVAL;
+  if (pd->base_addr + REGION_SIZE(pd) > W25QX_SIZE) return EINVAL;
+
+  errno_t err = ESUCCESS;
+
+  err = timebase_init();
+  if (err) return err;
+  err = pd->flash->ops->init(pd->flash);
+  if (err) return err;
+
+  runnings[pd->name] = false;
+  fill_indexes[pd->name] = 0;
+  fill_counts[pd->name] = 0;
+  flush_indexes[pd->name] = 0;
+  droppeds[pd->name] = 0;
+
+  return find_head(pd);
+}
+
+static errno_t start(Device_recorder *const pd) {
+  if (pd == NULL) return EINVAL;
+  runnings[pd->name] = true;
+  return ESUCCESS;
+}
+
+static errno_t stop(Device_recorder *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  runnings[pd->name] = false;
+
+  // 未满的页也提交写入, 缓冲区满时丢弃
+  const uint8_t count = fill_counts[pd->name];
+  if (count > 0 && count < DEVICE_RECORDER_SAMPLES_PER_PAGE) {
+    const uint8_t fill = fill_indexes[pd->name];
+    const uint8_t next = (fill + 1) % DEVICE_RECORDER_BUFFER_NUM;
+    if (next == flush_indexes[pd->name]) {
+      droppeds[pd->name] += count;
+    } else {
+      buffers[pd->name][fill].count = count;
+      fill_indexes[pd->name] = next;
+    }
+    fill_counts[pd->name] = 0;
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t record(Device_recorder *const pd, const Device_recorder_sample *const ps) {
+  if (pd == NULL || ps == NULL) return EINVAL;
+  if (runnings[pd->name] == false) return EPERM;
+
+  uint8_t fill = fill_indexes[pd->name];
+  uint8_t count = fill_counts[pd->name];
+
+  // 当前页已满且没有空闲的页
+  if (count == DEVICE_RECORDER_SAMPLES_PER_PAGE) {
+    const uint8_t next = (fill + 1) % DEVICE_RECORDER_BUFFER_NUM;
+    if (next == flush_indexes[pd->name]) {
+      ++droppeds[pd->name];
+      return ENOBUFS;
+    }
+    fill = next;
+    count = 0;
+  }
+
+  Device_recorder_page *const pp = &buffers[pd->name][fill];
+  pp->samples[count] = *ps;
+  pp->samples[count].time_ms = now_ms();
+  ++count;
+
+  // 写满一页后提交, 没有空闲的页时留到下次记录时再提交
+  if (count == DEVICE_RECORDER_SAMPLES_PER_PAGE) {
+    pp->count = count;
+    const uint8_t next = (fill + 1) % DEVICE_RECORDER_BUFFER_NUM;
+    if (next != flush_indexes[pd->name]) {
+      fill = next;
+      count = 0;
+    }
+  }
+
+  fill_indexes[pd->name] = fill;
+  fill_counts[pd->name] = count;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 后台写入 flash
+ * 每次最多提交一个异步擦除或编程, 上一个未完成时立即返回, 主循环不会被擦除或编程阻塞
+ * 异步操作由 flash 提交到 SPI 高优先级队列, 在屏幕刷新等大块传输之间插队执行
+ * 页编程完成后才移动写入位置和缓冲区, 编程失败时跳过这一页, 缓冲中的数据写到下一页
+ * @param pd
+ * @return errno_t 上一个异步操作的错误
+ */
+static errno_t poll(Device_recorder *const pd) {
+  if (pd == NULL) return EINVAL;
+  if (flash_busys[pd->name]) return ESUCCESS;
+
+  errno_t err = flash_errs[pd->name];
+  if (err) {
+    flash_errs[pd->name] = ESUCCESS;
+    return err;
+  }
+
+  if (erase_pendings[pd->name]) {
+    flash_busys[pd->name] = true;
+    err = pd->flash->ops->erase_async(pd->flash, erase_addrs[pd->name], 1, erase_done, pd);
+    if (err) flash_busys[pd->name] = false;
+    return err;
+  }
+
+  const uint8_t flush = flush_indexes[pd->name];
+  if (flush == fill_indexes[pd->name]) return ESUCCESS;
+
+  Device_recorder_page *const pp = &buffers[pd->name][flush];
+  pp->magic = PAGE_MAGIC;
+  pp->seq = seqs[pd->name];
+  pp->reserved = 0xFFFF;
+  pp->crc = page_crc(pp);
+
+  // 完成回调移动 flush_index 之前页缓冲不会被改写
+  flash_busys[pd->name] = true;
+  err = pd->flash->ops->program_async(pd->flash, write_addrs[pd->name], (const uint8_t *)pp, sizeof(Device_recorder_page), program_done, pd);
+  if (err) flash_busys[pd->name] = false;
+
+  return err;
+}
+
+static errno_t dump(Device_recorder *const pd, Device_recorder_sink *sink, void *arg) {
+  if (pd == NULL || sink == NULL) return EINVAL;
+  if (runnings[pd->name]) return EBUSY;
+
+  errno_t err = ESUCCESS;
+
+  // 先把缓冲中的页全部写入
+  while (flush_indexes[pd->name] != fill_indexes[pd->name] || erase_pendings[pd->name] || flash_busys[pd->name]) {
+    err = poll(pd);
+    if (err) return err;
+  }
+  err = wait_idle(pd);
+  if (err) return err;
+
+  // 当前扇区的下一个扇区已被提前擦除, 再下一个扇区是最旧的数据
+  const uint32_t head = write_addrs[pd->name];
+  const uint32_t head_sector = head - (head - pd->base_addr) % W25QX_SECTOR_SIZE;
+  uint32_t addr = REGION_NEXT(pd, head_sector, W25QX_SECTOR_SIZE);
+
+  while (addr != head) {
+    bool valid = false;
+    err = read_valid_page(pd, addr, &valid);
+    if (err) return err;
+
+    if (valid) {
+      err = sink(arg, (const uint8_t *)&read_page, sizeof(read_page));
+      if (err) return err;
+    }
+
+    addr = REGION_NEXT(pd, addr, W25QX_PAGE_SIZE);
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t get_dropped(Device_recorder *const pd, uint32_t *rt_dropped_ptr) {
+  if (pd == NULL || rt_dropped_ptr == NULL) return EINVAL;
+  *rt_dropped_ptr = droppeds[pd->name];
+  return ESUCCESS;
+}
+
+/**
+ * @brief 查找上次记录的位置
+ * 各扇区第一页序号最大的扇区为最新的扇区, 在其中找到序号连续的最后一页, 下一页即为写入位置
+ * 只相信 crc 正确的页的序号, 第一页编程时掉电的扇区不参与比较, 避免选错扇区后提前擦除掉更新的数据
+ * 写入位置的页不是空白(编程时掉电)时跳过
+ * @param pd
+ * @return errno_t
+ */
+static errno_t find_head(Device_recorder *const pd) {
+  errno_t err = ESUCCESS;
+  Device_recorder_page *const pp = &read_page;
+  bool valid = false;
+
+  bool found = false;
+  uint32_t newest_addr = pd->base_addr, newest_seq = 0;
+  for (uint32_t addr = pd->base_addr; addr < pd->base_addr + REGION_SIZE(pd); addr += W25QX_SECTOR_SIZE) {
+    err = read_valid_page(pd, addr, &valid);
+    if (err) return err;
+    if (valid == false) continue;
+    if (found == false || pp->seq > newest_seq) {
+      newest_addr = addr;
+      newest_seq = pp->seq;
+      found = true;
+    }
+  }
+
+  if (found == false) {
+    write_addrs[pd->name] = pd->base_addr;
+    seqs[pd->name] = 0;
+  } else {
+    uint32_t page = 1;
+    for (; page < W25QX_SECTOR_SIZE / W25QX_PAGE_SIZE; ++page) {
+      err = read_valid_page(pd, newest_addr + page * W25QX_PAGE_SIZE, &valid);
+      if (err) return err;
+      if (valid == false || pp->seq != newest_seq + page) break;
+    }
+    write_addrs[pd->name] = newest_addr + page * W25QX_PAGE_SIZE;
+    if (page == W25QX_SECTOR_SIZE / W25QX_PAGE_SIZE) write_addrs[pd->name] = REGION_NEXT(pd, newest_addr, W25QX_SECTOR_SIZE);
+    seqs[pd->name] = newest_seq + page;
+  }
+
+  // 跳过不是空白的页
+  uint32_t addr = write_addrs[pd->name];
+  while ((addr - pd->base_addr) % W25QX_SECTOR_SIZE != 0) {
+    err = pd->flash->ops->read(pd->flash, addr, (uint8_t *)pp, sizeof(Device_recorder_page));
+    if (err) return err;
+
+    const uint8_t *const bytes = (const uint8_t *)pp;
+    bool blank = true;
+    for (uint32_t i = 0; i < sizeof(Device_recorder_page); ++i) {
+      if (bytes[i] != 0xFF) {
+        blank = false;
+        break;
+      }
+    }
+    if (blank) break;
+
+    addr = REGION_NEXT(pd, addr, W25QX_PAGE_SIZE);
+  }
+  write_addrs[pd->name] = addr;
+
+  // 写入位置在扇区开头时, 该扇区可能还是旧数据
+  if ((addr - pd->base_addr) % W25QX_SECTOR_SIZE == 0) {
+    err = pd->flash->ops->erase(pd->flash, addr, 1);
+    if (err) return err;
+  }
+
+  // 不确定下一个扇区是否已经擦除, 重新擦除一次
+  const uint32_t sector = addr - (addr - pd->base_addr) % W25QX_SECTOR_SIZE;
+  erase_pendings[pd->name] = true;
+  erase_addrs[pd->name] = REGION_NEXT(pd, sector, W25QX_SECTOR_SIZE);
+
+  return ESUCCESS;
+}
+
+// 擦除失败时下一次 poll 重新擦除
+static void erase_done(void *arg, errno_t err) {
+  Device_recorder *const pd = arg;
+  erase_pendings[pd->name] = err != ESUCCESS;
+  flash_errs[pd->name] = err;
+  flash_busys[pd->name] = false;
+}
+
+static void program_done(void *arg, errno_t err) {
+  Device_recorder *const pd = arg;
+  const uint32_t addr = write_addrs[pd->name];
+
+  // 开始写一个扇区时擦除下一个扇区, 写到下一个扇区时已经擦除完成
+  if ((addr - pd->base_addr) % W25QX_SECTOR_SIZE == 0) {
+    erase_pendings[pd->name] = true;
+    erase_addrs[pd->name] = REGION_NEXT(pd, addr, W25QX_SECTOR_SIZE);
+  }
+
+  ++seqs[pd->name];
+  write_addrs[pd->name] = REGION_NEXT(pd, addr, W25QX_PAGE_SIZE);
+  if (err == ESUCCESS) flush_indexes[pd->name] = (flush_indexes[pd->name] + 1) % DEVICE_RECORDER_BUFFER_NUM;
+
+  flash_errs[pd->name] = err;
+  flash_busys[pd->name] = false;
+}
+
+static errno_t wait_idle(Device_recorder *const pd) {
+  while (flash_busys[pd->name]);
+
+  const errno_t err = flash_errs[pd->name];
+  flash_errs[pd->name] = ESUCCESS;
+  return err;
+}
+
+static uint32_t page_crc(const Device_recorder_page *const pp) {
+  uint32_t crc = crc32(0, &pp->seq, offsetof(Device_recorder_page, crc) - offsetof(Device_recorder_page, seq));
+  return crc32(crc, pp->samples, pp->count * sizeof(Device_recorder_sample));
+}
+
+// 读到 read_page 中
+static errno_t read_valid_page(Device_recorder *const pd, uint32_t addr, bool *rt_valid_ptr) {
+  Device_recorder_page *const pp = &read_page;
+
+  errno_t err = pd->flash->ops->read(pd->flash, addr, (uint8_t *)pp, sizeof(Device_recorder_page));
+  if (err) return err;
+
+  *rt_valid_ptr = pp->magic == PAGE_MAGIC && pp->count <= DEVICE_RECORDER_SAMPLES_PER_PAGE && pp->crc == page_crc(pp);
+  return ESUCCESS;
+}
+
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
+  return ((Device_recorder *)pd)->name == *((Device_recorder_name *)name);
+}
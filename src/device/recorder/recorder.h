@@ -0,0 +1,85 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/w25qx/w25qx.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// 每页保存的样本数量, 一页正好是 flash 的一页(256 字节)
+#define DEVICE_RECORDER_SAMPLES_PER_PAGE 8
+// 内存中的页缓冲数量, 擦除扇区(典型 45 毫秒, 最长 400 毫秒)期间样本暂存在缓冲中
+#define DEVICE_RECORDER_BUFFER_NUM 8
+
+typedef enum {
+  DEVICE_RECORDER_1,
+  DEVICE_RECORDER_COUNT,
+} Device_recorder_name;
+
+/**
+ * @brief 一次采样, 30 字节
+ * 转速单位为 0.1 转/分, 距离单位为毫米
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t time_ms; // 记录时由记录器填入
+  int16_t wheel_rpm[4]; // 车轮实际转速
+  int16_t wheel_target[4]; // 车轮目标转速, 即控制指令
+  uint8_t tracker_raw;
+  uint8_t tracker_status;
+  int16_t tracker_position;
+  uint16_t distance_mm;
+  uint16_t battery_mv;
+  uint16_t flags; // 由应用层定义
+} Device_recorder_sample;
+
+/**
+ * @brief flash 中的一页记录
+ * crc 覆盖 seq count 和所有样本, 从旧到新按 seq 递增
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+  uint16_t count;
+  uint16_t reserved;
+  uint32_t crc;
+  Device_recorder_sample samples[DEVICE_RECORDER_SAMPLES_PER_PAGE];
+} Device_recorder_page;
+
+// 导出数据的输出函数, 例如串口发送或网络发送
+typedef errno_t Device_recorder_sink(void *arg, const uint8_t *data, uint32_t len);
+
+struct Device_recorder;
+struct Device_recorder_ops;
+
+/**
+ * @brief 黑匣子记录器
+ * 样本先写入内存页缓冲, 满一页后由 poll 在后台编程到 flash, 不等待编程完成
+ * flash 存储区为环形日志, 写入某个扇区的第一页时提前擦除下一个扇区, 写满后覆盖最旧的数据
+ */
+typedef struct Device_recorder {
+  const Device_recorder_name name;
+  const uint32_t base_addr; // 存储区起始地址, 需要扇区对齐
+  const uint16_t sector_count; // 存储区扇区数量, 至少 2 个
+  const Device_W25QX *flash;
+  const struct Device_recorder_ops *ops;
+} Device_recorder;
+
+typedef struct Device_recorder_ops {
+  // 初始化 flash 并找到上次记录的位置, 之后的记录接在后面
+  errno_t (*init)(Device_recorder *const pd);
+  errno_t (*start)(Device_recorder *const pd);
+  // 停止记录, 未满的页会在下次 poll 时写入
+  errno_t (*stop)(Device_recorder *const pd);
+  // 记录一个样本, 可以在中断中调用, 缓冲区满时丢弃样本
+  errno_t (*record)(Device_recorder *const pd, const Device_recorder_sample *const ps);
+  // 在主循环中调用, 上一个异步擦除或编程完成后提交下一个并立即返回, 返回上一个异步操作的错误
+  errno_t (*poll)(Device_recorder *const pd);
+  // 按从旧到新的顺序导出所有完整的页, 需要先停止记录
+  errno_t (*dump)(Device_recorder *const pd, Device_recorder_sink *sink, void *arg);
+  // 因缓冲区满丢弃的样本数量
+  errno_t (*get_dropped)(Device_recorder *const pd, uint32_t *rt_dropped_ptr);
+} Device_recorder_ops;
+
+// 全局方法
+errno_t Device_recorder_module_init(void);
+errno_t Device_recorder_register(Device_recorder *const pd);
+errno_t Device_recorder_find(Device_recorder **pd_ptr, const Device_recorder_name name);
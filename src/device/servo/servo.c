@@ -1,27 +1,36 @@
 #include "servo.h"
 #include "common/list/list.h"
 #include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
 #include <stdlib.h>
 #include <string.h>
 
 // 对象方法
 static errno_t init(Device_servo *const pd);
 static errno_t set_angle(Device_servo *const pd, const angle_t angle);
+static errno_t is_moving(Device_servo *const pd, bool *rt_moving_ptr);
 static errno_t start(Device_servo *const pd);
 static errno_t stop(Device_servo *const pd);
 
+// 内部方法 - 转动曲线更新
+static void profile_callback(void *arg);
+static errno_t set_pulse(Device_servo *const pd, int32_t centi_angle);
 // 内部方法 - 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
 static const Device_servo_ops device_ops = {
   .init = init,
   .set_angle = set_angle,
+  .is_moving = is_moving,
   .start = start,
   .stop = stop,
 };
 
 static List *list = NULL;
 
+static Trajectory profiles[DEVICE_SERVO_COUNT] = {0};
+static Timebase_timer profile_timers[DEVICE_SERVO_COUNT] = {0};
+
 errno_t Device_servo_module_init(void) {
   if (list == NULL) {
     errno_t err = list_create(&list);
@@ -54,6 +63,18 @@ static errno_t init(Device_servo *const pd) {
 
   err = pd->pwm->ops->init(pd->pwm);
   if (err) return err;
+
+  err = timebase_init();
+  if (err) return err;
+
+  // 计数频率 1 MHz, 周期 20ms, 之后脉宽的微秒数即为比较值
+  err = pd->pwm->ops->set_timing(pd->pwm, 1000000, DEVICE_SERVO_UPDATE_PERIOD_US);
+  if (err) return err;
+
+  err = trajectory_init(&profiles[pd->name], &pd->profile_param, (int32_t)pd->angle * 100);
+  if (err) return err;
+  err = set_pulse(pd, (int32_t)pd->angle * 100);
+  if (err) return err;
   
   err = pd->pwm->ops->stop(pd->pwm);
   if (err) return err;
@@ -63,17 +84,27 @@ static errno_t init(Device_servo *const pd) {
 
 static errno_t set_angle(Device_servo *const pd, const angle_t angle) {
   if (pd == NULL) return EINVAL;
+  if (angle < -90 || angle > 90) return EINVAL;
 
-  // 周期为 20ms, 其中高电平为 0.5ms 时朝向最左边(-90), 1.5 ms 朝向中间(0), 2.5ms 朝向右边(90)
-  const uint32_t pulse = 1500 + angle * 1000 / 90; 
-  errno_t err = pd->pwm->ops->set_period(pd->pwm, pulse, 20000);
-  if (err) return err;
-
+  trajectory_set_target(&profiles[pd->name], (int32_t)angle * 100);
   pd->angle = angle;
 
+  // 每个 PWM 周期更新一次, 转到目标角度后定时器自行停止
+  if (profile_timers[pd->name].active == false) {
+    errno_t err = timebase_timer_start(&profile_timers[pd->name], 0, DEVICE_SERVO_UPDATE_PERIOD_US / 1000, profile_callback, pd);
+    if (err) return err;
+  }
+
   return ESUCCESS;
 }
 
+static errno_t is_moving(Device_servo *const pd, bool *rt_moving_ptr) {
+  if (pd == NULL || rt_moving_ptr == NULL) return EINVAL;
+
+  *rt_moving_ptr = profile_timers[pd->name].active;
+
+  return ESUCCESS;
+}
 
 static errno_t start(Device_servo *const pd) {
   if (pd == NULL) return EINVAL;
@@ -101,6 +132,24 @@ static errno_t stop(Device_servo *const pd) {
   return ESUCCESS;
 }
 
+static void profile_callback(void *arg) {
+  Device_servo *const pd = (Device_servo *)arg;
+
+  const int32_t centi_angle = trajectory_step(&profiles[pd->name]);
+  set_pulse(pd, centi_angle);
+
+  if (trajectory_done(&profiles[pd->name])) {
+    timebase_timer_stop(&profile_timers[pd->name]);
+  }
+}
+
+static errno_t set_pulse(Device_servo *const pd, int32_t centi_angle) {
+  // 周期为 20ms, 其中高电平为 0.5ms 时朝向最左边(-90), 1.5 ms 朝向中间(0), 2.5ms 朝向右边(90)
+  // 即每 0.09 度 1 微秒
+  const uint32_t pulse = (uint32_t)(1500 + centi_angle / 9);
+  return pd->pwm->ops->set_duty(pd->pwm, pulse);
+}
+
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
   return ((Device_servo *)pd)->name == *((Device_servo_name *)name);
 }
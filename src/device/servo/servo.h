@@ -2,6 +2,7 @@
 
 #include "common/errno/errno.h"
 #include "device/pwm/pwm.h"
+#include "common/trajectory/trajectory.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -18,18 +19,25 @@ struct Device_servo_ops;
 typedef struct Device_servo {
   const Device_servo_name name;
   bool running;
-  angle_t angle;
+  angle_t angle; // 目标角度
+  // 转动曲线, 位置单位为 0.01 度, 更新周期需为 DEVICE_SERVO_UPDATE_PERIOD_US
+  const Trajectory_param profile_param;
   const Device_PWM *pwm;
   const struct Device_servo_ops *ops;
 } Device_servo;
 
 typedef struct Device_servo_ops {
   errno_t (*init)(Device_servo *const pd);
+  // 设置目标角度, 按速度/加速度限制逐步转到目标角度, 立即返回
   errno_t (*set_angle)(Device_servo *const pd, const angle_t angle);
+  errno_t (*is_moving)(Device_servo *const pd, bool *rt_moving_ptr);
   errno_t (*start)(Device_servo *const pd);
   errno_t (*stop)(Device_servo *const pd);
 } Device_servo_ops;
 
+// 舵机每个 PWM 周期(20ms)更新一次角度
+#define DEVICE_SERVO_UPDATE_PERIOD_US 20000
+
 // 全局方法
 errno_t Device_servo_module_init(void);
 errno_t Device_servo_register(Device_servo *const pd);
@@ -1,26 +1,59 @@
 #include "speed_test.h"
 #include "common/list/list.h"
-#include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include "stm32f4xx_hal.h"
+
+// 保存最近若干次中断的时间戳, 用首尾时间差计算周期
+// 间隔数取偶数, 正好覆盖整数个码盘格, 抵消上升沿和下降沿占空比不对称带来的误差
+#define EDGE_HISTORY_SIZE 9
+// 计算周期的时间窗口(微秒), 窗口越长测量越平滑, 但速度闭环的滞后越大
+// 高速时在窗口内取尽量多的间隔, 低速时只取最近一个码盘格
+#define SPAN_WINDOW_US 20000
+// 两次中断间隔小于该值(微秒)视为抖动, 直接忽略
+#define DEBOUNCE_US 200
+// 超过该时间(微秒)没有中断, 认为车轮已经停止
+#define STOP_TIMEOUT_US 500000
 
 // 对象方法
 static errno_t init(Device_speed_test *const pd);
 static errno_t get_speed(Device_speed_test *const pd, float *rt_speed_ptr);
+static errno_t get_rpm(Device_speed_test *const pd, uint32_t *rt_rpm_ptr);
+static errno_t get_distance(Device_speed_test *const pd, uint32_t *rt_distance_ptr);
+static errno_t get_count(Device_speed_test *const pd, uint32_t *rt_count_ptr);
+static errno_t hold(Device_speed_test *const pd, bool held);
+static errno_t is_stale(Device_speed_test *const pd, bool *rt_stale_ptr);
 
-// 内部方法 - 查找设备
+// 内部方法
+// 一致地读取中断中维护的计数和时间戳
+static void snapshot(Device_speed_test *const pd, uint32_t *rt_count_ptr, uint32_t *rt_intervals_ptr, uint32_t *rt_newest_ptr, uint32_t *rt_oldest_ptr);
+// 中断线借出期间及归还后还没有测到一个码盘格时, 测量值不可信
+static bool stale(const Device_speed_test_name name);
+// 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
 static const Device_speed_test_ops device_ops = {
   .init = init,
   .get_speed = get_speed,
+  .get_rpm = get_rpm,
+  .get_distance = get_distance,
+  .get_count = get_count,
+  .hold = hold,
+  .is_stale = is_stale,
 };
 
 static List *list = NULL;
+// 累计中断次数
 static volatile uint32_t counts[DEVICE_SPEED_TEST_COUNT] = {0};
-static uint32_t last_read_ticks[DEVICE_SPEED_TEST_COUNT] = {0};
+// 最近若干次中断的时间戳, 下标为 counts % EDGE_HISTORY_SIZE
+static volatile uint32_t edge_us[DEVICE_SPEED_TEST_COUNT][EDGE_HISTORY_SIZE] = {0};
+// 可用于计算周期的第一个中断的计数, 中断线归还后之前的时间戳和之后的间隔中间有丢失的中断, 不能再用
+static volatile uint32_t bases[DEVICE_SPEED_TEST_COUNT] = {0};
+// 中断线是否被借出, 借出时的转速和归还的时刻
+static volatile bool helds[DEVICE_SPEED_TEST_COUNT] = {0};
+static volatile uint32_t held_rpms[DEVICE_SPEED_TEST_COUNT] = {0};
+static volatile uint32_t release_us[DEVICE_SPEED_TEST_COUNT] = {0};
 
 errno_t Device_speed_test_module_init(void) {
   if (list == NULL) {
@@ -47,68 +80,192 @@ errno_t Device_speed_test_find(Device_speed_test **pd_ptr, const Device_speed_te
   return ESUCCESS;
 }
 
+/**
+ * @brief 码盘中断回调, 只记录时间戳和计数, 速度在读取时再计算
+ */
 errno_t Device_speed_test_EXTI_callback(Device_speed_test *pd) {
   if (pd == NULL) return EINVAL;
 
-  ++counts[pd->name];
+  const Device_speed_test_name name = pd->name;
+  const uint32_t now = now_us();
+  const uint32_t count = counts[name];
+
+  if (now - edge_us[name][count % EDGE_HISTORY_SIZE] < DEBOUNCE_US) return ESUCCESS;
+
+  edge_us[name][(count + 1) % EDGE_HISTORY_SIZE] = now;
+  counts[name] = count + 1;
 
   return ESUCCESS;
 }
 
 static errno_t init(Device_speed_test *const pd) {
-  if (pd == NULL) return EINVAL;
+  if (pd == NULL || pd->counts_per_rev == 0) return EINVAL;
 
   errno_t err = ESUCCESS;
 
+  err = timebase_init();
+  if (err) return err;
+
   err = pd->in->ops->init(pd->in);
   if (err) return err;
 
-  err = pd->timer->ops->init(pd->timer);
+  counts[pd->name] = 0;
+  memset((void *)edge_us[pd->name], 0, sizeof(edge_us[pd->name]));
+  bases[pd->name] = 1;
+  helds[pd->name] = false;
+
+  return ESUCCESS;
+}
+
+static errno_t get_speed(Device_speed_test *const pd, float *rt_speed_ptr) {
+  if (pd == NULL || rt_speed_ptr == NULL) return EINVAL;
+
+  uint32_t rpm = 0;
+  errno_t err = get_rpm(pd, &rpm);
   if (err) return err;
 
-  // 如果采用通用计时器, 那么设定事件单位为 1 毫秒, 因为滴答定时器默认为 1 毫秒且无法更改, 此处保持一致
-  if (pd->timer->type == DEVICE_TIMER_TYPE_GENERAL) {
-    err = pd->timer->ops->set_period(pd->timer, 1000);
-    if (err) return err;
+  // 要返回马达每秒转动的圈数
+  *rt_speed_ptr = (float)rpm / 100 / 60;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 获取转速
+ * 由最近若干次中断的首尾时间差计算, 分辨率为 1 微秒, 间隔数的选取见 SPAN_WINDOW_US
+ * 低速时如果距上次中断已经超过了测得的周期, 用这段时间作为周期的下限, 让转速平滑地降到 0
+ * 测量值不可信时(见 is_stale)返回借出中断线之前的转速
+ * @param rt_rpm_ptr 返回转速, 单位为 0.01 转/分
+ */
+static errno_t get_rpm(Device_speed_test *const pd, uint32_t *rt_rpm_ptr) {
+  if (pd == NULL || rt_rpm_ptr == NULL) return EINVAL;
+
+  if (stale(pd->name)) {
+    *rt_rpm_ptr = held_rpms[pd->name];
+    return ESUCCESS;
   }
 
-  // 如果计时器未运行, 启动定时器
-  bool timer_is_running = false;
-  err = pd->timer->ops->is_running(pd->timer, &timer_is_running);
-  if (err) return err;
+  uint32_t count = 0, intervals = 0, newest = 0, oldest = 0;
+  snapshot(pd, &count, &intervals, &newest, &oldest);
 
-  if (timer_is_running == false) {
-    err = pd->timer->ops->start(pd->timer, DEVICE_TIMER_START_MODE_IT);
-    if (err) return err;
+  const uint32_t since_last = now_us() - newest;
+  if (intervals == 0 || since_last >= STOP_TIMEOUT_US) {
+    *rt_rpm_ptr = 0;
+    return ESUCCESS;
   }
 
-  counts[pd->name] = 0;
+  uint32_t span = newest - oldest;
+
+  // 距上次中断的时间已经超过平均间隔, 说明正在减速, 按再来一次中断的最早时间估计
+  if ((uint64_t)since_last * intervals > span) {
+    span = newest - oldest + since_last;
+    intervals += 1;
+  }
+  if (span == 0) {
+    *rt_rpm_ptr = 0;
+    return ESUCCESS;
+  }
+
+  // 转/分 * 100 = 间隔数 / 每圈间隔数 / (span / 1000000) * 60 * 100
+  *rt_rpm_ptr = (uint32_t)((uint64_t)intervals * 6000000000ULL / ((uint64_t)pd->counts_per_rev * span));
 
   return ESUCCESS;
 }
 
-static errno_t get_speed(Device_speed_test *const pd, float *rt_speed_ptr) {
-  if (pd == NULL || rt_speed_ptr == NULL) return EINVAL;
+/**
+ * @brief 获取累计行驶距离
+ * 码盘只有一路信号, 无法区分方向, 距离只增不减
+ * @param rt_distance_ptr 返回距离, 单位为毫米
+ */
+static errno_t get_distance(Device_speed_test *const pd, uint32_t *rt_distance_ptr) {
+  if (pd == NULL || rt_distance_ptr == NULL) return EINVAL;
 
-  errno_t err = ESUCCESS;
+  const uint32_t count = counts[pd->name];
+  *rt_distance_ptr = (uint32_t)((uint64_t)count * pd->wheel_circumference_mm / pd->counts_per_rev);
 
-  uint32_t cur_read_tick = 0;
-  err = pd->timer->ops->get_count(pd->timer, &cur_read_tick);
-  if (err) return err;
+  return ESUCCESS;
+}
 
-  // 经过的毫秒数
-  uint32_t tick_num = cur_read_tick - last_read_ticks[pd->name];
-  uint32_t count = counts[pd->name];
+static errno_t get_count(Device_speed_test *const pd, uint32_t *rt_count_ptr) {
+  if (pd == NULL || rt_count_ptr == NULL) return EINVAL;
+  *rt_count_ptr = counts[pd->name];
+  return ESUCCESS;
+}
 
-  last_read_ticks[pd->name] = cur_read_tick;
-  counts[pd->name] = 0;
+/**
+ * @brief 码盘的中断线被其他设备借出或归还
+ * 借出期间的中断全部丢失, 保持借出前的转速; 归还后丢弃之前的时间戳, 重新测到一个码盘格前仍保持该转速
+ * 在借用方的中断中调用
+ * @param held true 为借出, false 为归还
+ */
+static errno_t hold(Device_speed_test *const pd, bool held) {
+  if (pd == NULL) return EINVAL;
+
+  const Device_speed_test_name name = pd->name;
+  if (held == helds[name]) return ESUCCESS;
+
+  if (held) {
+    // 上次归还后还没有恢复时继续沿用之前保持的转速
+    if (!stale(name)) {
+      uint32_t rpm = 0;
+      errno_t err = get_rpm(pd, &rpm);
+      if (err) return err;
+      held_rpms[name] = rpm;
+    }
+    helds[name] = true;
+  } else {
+    bases[name] = counts[name] + 1;
+    release_us[name] = now_us();
+    helds[name] = false;
+  }
 
-  // 要返回马达每秒转动的圈数, 其中每40个count对应一圈
-  *rt_speed_ptr = (float)count * 1000 / 40 / tick_num;
+  return ESUCCESS;
+}
 
+static errno_t is_stale(Device_speed_test *const pd, bool *rt_stale_ptr) {
+  if (pd == NULL || rt_stale_ptr == NULL) return EINVAL;
+  *rt_stale_ptr = stale(pd->name);
   return ESUCCESS;
 }
 
+static bool stale(const Device_speed_test_name name) {
+  if (helds[name]) return true;
+  // 从未借出过, 或借出前还没有中断时 bases 为 1, 没有要丢弃的时间戳
+  if (bases[name] <= 1) return false;
+  // 归还后要有三个新的中断才有一个码盘格的两个间隔, 只有一个间隔时格和缝不等宽, 误差可达 10%
+  // 长时间没有中断说明车轮已经停止, 不再保持
+  return counts[name] < bases[name] + 2 && now_us() - release_us[name] < STOP_TIMEOUT_US;
+}
+
+static void snapshot(Device_speed_test *const pd, uint32_t *rt_count_ptr, uint32_t *rt_intervals_ptr, uint32_t *rt_newest_ptr, uint32_t *rt_oldest_ptr) {
+  const Device_speed_test_name name = pd->name;
+  uint32_t count = 0, intervals = 0, newest = 0, oldest = 0;
+
+  // 读取过程中如果来了新的中断, 计数会变化, 重新读取即可
+  do {
+    count = counts[name];
+    // bases 之后的中断才能用于计算
+    const uint32_t base = bases[name];
+    const uint32_t edges = count >= base ? count - base + 1 : 0;
+    newest = edge_us[name][count % EDGE_HISTORY_SIZE];
+    oldest = newest;
+    // 数据不足两个间隔时按一个间隔计算, 否则取窗口内最多的偶数个间隔, 至少两个
+    intervals = edges == 2 ? 1 : 0;
+    if (intervals) oldest = edge_us[name][(count - 1) % EDGE_HISTORY_SIZE];
+    for (uint32_t i = 2; i < EDGE_HISTORY_SIZE && i < edges; i += 2) {
+      const uint32_t t = edge_us[name][(count - i) % EDGE_HISTORY_SIZE];
+      if (intervals && newest - t > SPAN_WINDOW_US) break;
+      intervals = i;
+      oldest = t;
+    }
+  } while (count != counts[name]);
+
+  *rt_count_ptr = count;
+  *rt_intervals_ptr = intervals;
+  *rt_newest_ptr = newest;
+  *rt_oldest_ptr = oldest;
+}
+
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
   return ((Device_speed_test *)pd)->name == *((Device_speed_test_name *)name);
 }
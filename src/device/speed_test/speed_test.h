@@ -2,8 +2,8 @@
 
 #include "common/errno/errno.h"
 #include "device/gpio/gpio.h"
-#include "device/timer/timer.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef enum {
   DEVICE_SPEED_TEST_HEAD_LEFT,
@@ -18,14 +18,26 @@ struct Device_speed_test_ops;
 
 typedef struct Device_speed_test {
   const Device_speed_test_name name;
+  const uint16_t counts_per_rev; // 车轮每转一圈产生的中断次数
+  const uint16_t wheel_circumference_mm; // 车轮周长, 单位为毫米
   Device_GPIO *in;
-  Device_timer *timer;
   const struct Device_speed_test_ops *ops;
 } Device_speed_test;
 
 typedef struct Device_speed_test_ops {
   errno_t (*init)(Device_speed_test *const pd);
+  // 每秒转动圈数
   errno_t (*get_speed)(Device_speed_test *const pd, float *rt_speed_ptr);
+  // 每分钟转动圈数, 单位为 0.01 转/分
+  errno_t (*get_rpm)(Device_speed_test *const pd, uint32_t *rt_rpm_ptr);
+  // 累计行驶距离, 单位为毫米
+  errno_t (*get_distance)(Device_speed_test *const pd, uint32_t *rt_distance_ptr);
+  // 累计中断次数
+  errno_t (*get_count)(Device_speed_test *const pd, uint32_t *rt_count_ptr);
+  // 码盘的中断线被其他设备借出(held 为 true)或归还, 由借用方在中断中调用
+  errno_t (*hold)(Device_speed_test *const pd, bool held);
+  // 测量值是否不可信: 中断线借出期间, 或归还后还没有测到一个码盘格, 此时 get_rpm 返回借出前的转速
+  errno_t (*is_stale)(Device_speed_test *const pd, bool *rt_stale_ptr);
 } Device_speed_test_ops;
 
 // 全局方法
@@ -34,4 +46,4 @@ errno_t Device_speed_test_register(Device_speed_test *const pd);
 errno_t Device_speed_test_find(Device_speed_test **pd_ptr, const Device_speed_test_name name);
 
 // 中断回调
-errno_t Device_speed_test_EXTI_callback(Device_speed_test *pd);
\ No newline at end of file
+errno_t Device_speed_test_EXTI_callback(Device_speed_test *pd);
@@ -1,14 +1,43 @@
 #include "spi.h"
 #include "common/list/list.h"
 #include "common/ring_buffer/ring_buffer.h"
+#include "common/timebase/timebase.h"
+#include "common/critical/critical.h"
 #include "driver/spi/spi.h"
 #include <stdlib.h>
 
 #define MAX_MSG_LEN 0xFFFF
+// SPI1 挂在 APB2 上, 分频前的时钟为 84MHz, SCK = 84MHz / divider
+#define SPI_CLOCK_HZ 84000000
+// 分频为 1 时每毫秒传输的字节数
+#define BYTES_PER_MS (SPI_CLOCK_HZ / 8 / 1000)
+// 排队传输的超时时间, 按 BYTES_PER_MS / divider 计算传输时间, 另外留出 10 毫秒的中断延迟
+#define TIMEOUT_MS(len, divider) (10 + (uint32_t)((uint64_t)(len) * (divider) / BYTES_PER_MS))
+
+// 排队传输的阶段
+typedef enum {
+  TRANSFER_PHASE_CMD,
+  TRANSFER_PHASE_TX,
+  TRANSFER_PHASE_RX,
+  TRANSFER_PHASE_END,
+} Transfer_phase;
 
 static errno_t init(const Device_SPI *const pd);
 static errno_t receive(const Device_SPI *const pd, uint8_t *data, uint32_t len);
 static errno_t transmit(const Device_SPI *const pd, const uint8_t *const data, uint32_t len);
+static errno_t lock(const Device_SPI *const pd);
+static errno_t unlock(const Device_SPI *const pd);
+static errno_t configure(const Device_SPI *const pd, uint8_t mode, uint16_t divider);
+static errno_t submit(const Device_SPI *const pd, Device_SPI_transfer *const pt);
+
+// 内部方法 - 发起一次发送/接收, 超过 DMA 上限的部分由完成中断接着传输
+static errno_t start_transmit(const Device_SPI *const pd, const uint8_t *data, uint32_t len);
+static errno_t start_receive(const Device_SPI *const pd, uint8_t *data, uint32_t len);
+// 内部方法 - 排队传输
+static void queue_run(const Device_SPI *const pd);
+static void transfer_step(const Device_SPI *const pd, Device_SPI_transfer *const pt);
+static void transfer_finish(const Device_SPI *const pd, Device_SPI_transfer *const pt, errno_t err);
+static void transfer_timeout(void *arg);
 
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
@@ -16,12 +45,31 @@ static const Device_SPI_ops device_ops = {
   .init = init,
   .receive = receive,
   .transmit = transmit,
+  .lock = lock,
+  .unlock = unlock,
+  .configure = configure,
+  .submit = submit,
 };
 
 static List *list = NULL;
 static const Driver_SPI_ops *driver_ops = NULL;
 static volatile uint8_t receiving[DEVICE_SPI_COUNT] = {0};
 static volatile uint8_t transmitting[DEVICE_SPI_COUNT] = {0};
+static volatile uint8_t lockeds[DEVICE_SPI_COUNT] = {0};
+// 分段传输中下一段的起始位置和剩余长度, 由完成中断继续传输
+static const uint8_t *tx_nexts[DEVICE_SPI_COUNT] = {0};
+static uint8_t *rx_nexts[DEVICE_SPI_COUNT] = {0};
+static volatile uint32_t tx_remainings[DEVICE_SPI_COUNT] = {0};
+static volatile uint32_t rx_remainings[DEVICE_SPI_COUNT] = {0};
+static volatile errno_t tx_errs[DEVICE_SPI_COUNT] = {0};
+static volatile errno_t rx_errs[DEVICE_SPI_COUNT] = {0};
+// 每个优先级一个先进先出队列, 以及正在执行的排队传输
+static Device_SPI_transfer *queue_heads[DEVICE_SPI_COUNT][DEVICE_SPI_PRIORITY_COUNT] = {0};
+static Device_SPI_transfer *queue_tails[DEVICE_SPI_COUNT][DEVICE_SPI_PRIORITY_COUNT] = {0};
+static Device_SPI_transfer *volatile currents[DEVICE_SPI_COUNT] = {0};
+// 完成中断, 错误中断和超时定时器可能同时结束同一个传输, 先置位的一方负责结束
+static volatile uint8_t finishings[DEVICE_SPI_COUNT] = {0};
+static Timebase_timer timeout_timers[DEVICE_SPI_COUNT] = {0};
 
 errno_t Device_SPI_module_init(void) {
   if (driver_ops == NULL) {
@@ -48,13 +96,78 @@ errno_t Device_SPI_find(Device_SPI **pd_ptr, const Device_SPI_name name) {
   return list->ops->find(list, pd_ptr, &name, match_device_by_name);
 }
 
+// 还有剩余数据时发起下一段 DMA, 全部完成或出错时结束本次发送, 排队传输则进入下一阶段
 errno_t Device_SPI_TxCpltCallback(const Device_SPI *const pd) {
+  if (tx_remainings[pd->name] > 0) {
+    const uint32_t cur_len = tx_remainings[pd->name] > MAX_MSG_LEN ? MAX_MSG_LEN : tx_remainings[pd->name];
+    const uint8_t *const data = tx_nexts[pd->name];
+    tx_nexts[pd->name] += cur_len;
+    tx_remainings[pd->name] -= cur_len;
+    errno_t err = driver_ops->transmit_DMA(pd, data, cur_len);
+    if (err == ESUCCESS) return ESUCCESS;
+    tx_errs[pd->name] = err;
+  }
   transmitting[pd->name] = 0;
+
+  Device_SPI_transfer *const pt = currents[pd->name];
+  if (pt != NULL && finishings[pd->name] == 0) {
+    if (tx_errs[pd->name]) {
+      transfer_finish(pd, pt, tx_errs[pd->name]);
+    } else {
+      ++pt->phase;
+      transfer_step(pd, pt);
+    }
+  }
+
   return ESUCCESS;
 }
 
 errno_t Device_SPI_RxCpltCallback(const Device_SPI *const pd) {
+  if (rx_remainings[pd->name] > 0) {
+    const uint32_t cur_len = rx_remainings[pd->name] > MAX_MSG_LEN ? MAX_MSG_LEN : rx_remainings[pd->name];
+    uint8_t *const data = rx_nexts[pd->name];
+    rx_nexts[pd->name] += cur_len;
+    rx_remainings[pd->name] -= cur_len;
+    errno_t err = driver_ops->receive_DMA(pd, data, cur_len);
+    if (err == ESUCCESS) return ESUCCESS;
+    rx_errs[pd->name] = err;
+  }
   receiving[pd->name] = 0;
+
+  Device_SPI_transfer *const pt = currents[pd->name];
+  if (pt != NULL && finishings[pd->name] == 0) {
+    if (rx_errs[pd->name]) {
+      transfer_finish(pd, pt, rx_errs[pd->name]);
+    } else {
+      ++pt->phase;
+      transfer_step(pd, pt);
+    }
+  }
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 溢出, 模式错误或 DMA 错误
+ * 直接传输返回 EIO; 排队传输停止 DMA, 拉高片选, 以 EIO 回调后开始下一个
+ * @param pd
+ * @return errno_t
+ */
+errno_t Device_SPI_ErrorCallback(const Device_SPI *const pd) {
+  tx_remainings[pd->name] = 0;
+  rx_remainings[pd->name] = 0;
+  if (transmitting[pd->name]) tx_errs[pd->name] = EIO;
+  if (receiving[pd->name]) rx_errs[pd->name] = EIO;
+  transmitting[pd->name] = 0;
+  receiving[pd->name] = 0;
+
+  Device_SPI_transfer *const pt = currents[pd->name];
+  if (pt != NULL) {
+    transfer_finish(pd, pt, EIO);
+  } else {
+    driver_ops->abort(pd);
+  }
+
   return ESUCCESS;
 }
 
@@ -65,73 +178,244 @@ static inline uint8_t match_device_by_name(const void *const name, const void *c
 static errno_t init(const Device_SPI *const pd) {
   if (pd == NULL) return EINVAL;
 
-  return ESUCCESS;
+  return timebase_init();
 }
 
+/**
+ * @brief 发送数据
+ * 单字节用中断发送, 多字节用 DMA, 超过一次 DMA 的最大长度时由完成中断直接发起下一段, 段与段之间不回到调用方
+ * @param pd 
+ * @param data 
+ * @param len 
+ * @return errno_t 
+ */
 static errno_t transmit(const Device_SPI *const pd, const uint8_t *const data, uint32_t len) {
   if (pd == NULL || data == NULL || len == 0) return EINVAL;
 
-  uint32_t cur_idx = 0;
-  uint32_t cur_len = 0;
+  errno_t err = start_transmit(pd, data, len);
+  if (err) return err;
+  while (transmitting[pd->name]);
 
-  do {
-    if (len > MAX_MSG_LEN) {
-      cur_len = MAX_MSG_LEN;
-      len -= MAX_MSG_LEN;
-    } else {
-      cur_len = len;
-      len = 0;
-    }
+  return tx_errs[pd->name];
+}
 
-    transmitting[pd->name] = 1;
-    errno_t err = ESUCCESS;
-    if (cur_len == 1) {
-      err = driver_ops->transmit_IT(pd, data + cur_idx, cur_len);
-    } else {
-      err = driver_ops->transmit_DMA(pd, data + cur_idx, cur_len);
-    }
-    if (err) {
-      transmitting[pd->name] = 0;
-      return err;
+static errno_t receive(const Device_SPI *const pd, uint8_t *data, uint32_t len) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+
+  errno_t err = start_receive(pd, data, len);
+  if (err) return err;
+  while (receiving[pd->name]);
+
+  return rx_errs[pd->name];
+}
+
+/**
+ * @brief 占用总线, 用于直接传输
+ * 等待正在执行的排队传输结束, 占用期间新的排队传输只入队不执行, 释放时再开始
+ * 排队传输在中断中推进, 所以只能在主循环中调用
+ * @param pd 
+ * @return errno_t 
+ */
+static errno_t lock(const Device_SPI *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  while (1) {
+    const uint32_t primask = enter_critical();
+    if (lockeds[pd->name] == 0 && currents[pd->name] == NULL) {
+      lockeds[pd->name] = 1;
+      exit_critical(primask);
+      return ESUCCESS;
     }
-    while (transmitting[pd->name]);
+    exit_critical(primask);
+  }
+}
 
-    cur_idx += cur_len;
-  } while (len > 0);
+static errno_t unlock(const Device_SPI *const pd) {
+  if (pd == NULL) return EINVAL;
+  lockeds[pd->name] = 0;
+  queue_run(pd);
+  return ESUCCESS;
+}
+
+static errno_t configure(const Device_SPI *const pd, uint8_t mode, uint16_t divider) {
+  if (pd == NULL) return EINVAL;
+  return driver_ops->configure(pd, mode, divider);
+}
+
+static errno_t submit(const Device_SPI *const pd, Device_SPI_transfer *const pt) {
+  if (pd == NULL || pt == NULL || pt->cs == NULL || pt->priority >= DEVICE_SPI_PRIORITY_COUNT) return EINVAL;
+  if ((pt->cmd_len && pt->cmd == NULL) || (pt->tx_len && pt->tx == NULL) || (pt->rx_len && pt->rx == NULL)) return EINVAL;
+  if (pt->cmd_len + pt->tx_len + pt->rx_len == 0) return EINVAL;
+
+  pt->next = NULL;
+
+  const uint32_t primask = enter_critical();
+  if (queue_tails[pd->name][pt->priority] == NULL) {
+    queue_heads[pd->name][pt->priority] = pt;
+  } else {
+    queue_tails[pd->name][pt->priority]->next = pt;
+  }
+  queue_tails[pd->name][pt->priority] = pt;
+  exit_critical(primask);
+
+  queue_run(pd);
 
   return ESUCCESS;
 }
 
-static errno_t receive(const Device_SPI *const pd, uint8_t *data, uint32_t len) {
-  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+static errno_t start_transmit(const Device_SPI *const pd, const uint8_t *data, uint32_t len) {
+  errno_t err = ESUCCESS;
+  transmitting[pd->name] = 1;
+  tx_errs[pd->name] = ESUCCESS;
 
-  uint32_t cur_idx = 0;
-  uint32_t cur_len = 0;
+  // 单字节用中断发送, 多字节用 DMA
+  if (len == 1) {
+    tx_remainings[pd->name] = 0;
+    err = driver_ops->transmit_IT(pd, data, 1);
+  } else {
+    const uint32_t cur_len = len > MAX_MSG_LEN ? MAX_MSG_LEN : len;
+    tx_nexts[pd->name] = data + cur_len;
+    tx_remainings[pd->name] = len - cur_len;
+    err = driver_ops->transmit_DMA(pd, data, cur_len);
+  }
+  if (err) transmitting[pd->name] = 0;
 
-  do {
-    if (len > MAX_MSG_LEN) {
-      cur_len = MAX_MSG_LEN;
-      len -= MAX_MSG_LEN;
-    } else {
-      cur_len = len;
-      len = 0;
+  return err;
+}
+
+static errno_t start_receive(const Device_SPI *const pd, uint8_t *data, uint32_t len) {
+  errno_t err = ESUCCESS;
+  receiving[pd->name] = 1;
+  rx_errs[pd->name] = ESUCCESS;
+
+  if (len == 1) {
+    rx_remainings[pd->name] = 0;
+    err = driver_ops->receive_IT(pd, data, 1);
+  } else {
+    const uint32_t cur_len = len > MAX_MSG_LEN ? MAX_MSG_LEN : len;
+    rx_nexts[pd->name] = data + cur_len;
+    rx_remainings[pd->name] = len - cur_len;
+    err = driver_ops->receive_DMA(pd, data, cur_len);
+  }
+  if (err) receiving[pd->name] = 0;
+
+  return err;
+}
+
+/**
+ * @brief 总线空闲且没有被占用时, 取出优先级最高的排队传输并开始
+ * 在提交, 释放总线和上一个传输结束(中断)时调用
+ * @param pd 
+ */
+static void queue_run(const Device_SPI *const pd) {
+  Device_SPI_transfer *pt = NULL;
+
+  const uint32_t primask = enter_critical();
+  if (lockeds[pd->name] == 0 && currents[pd->name] == NULL) {
+    for (Device_SPI_priority priority = 0; priority < DEVICE_SPI_PRIORITY_COUNT; ++priority) {
+      pt = queue_heads[pd->name][priority];
+      if (pt == NULL) continue;
+      queue_heads[pd->name][priority] = pt->next;
+      if (pt->next == NULL) queue_tails[pd->name][priority] = NULL;
+      pt->next = NULL;
+      break;
     }
+    currents[pd->name] = pt;
+  }
+  exit_critical(primask);
 
-    receiving[pd->name] = 1;
-    errno_t err = ESUCCESS;
-    if (cur_len == 1) {
-      err = driver_ops->receive_IT(pd, data + cur_idx, cur_len);
-    } else {
-      err = driver_ops->receive_DMA(pd, data + cur_idx, cur_len);
+  if (pt == NULL) return;
+
+  errno_t err = timebase_timer_start(&timeout_timers[pd->name], TIMEOUT_MS(pt->cmd_len + pt->tx_len + pt->rx_len, pt->divider), 0, transfer_timeout, (void *)pd);
+  if (err) goto finish_tag;
+  err = driver_ops->configure(pd, pt->mode, pt->divider);
+  if (err) goto finish_tag;
+  err = pt->cs->ops->write(pt->cs, PIN_VALUE_0);
+  if (err) goto finish_tag;
+
+  pt->phase = TRANSFER_PHASE_CMD;
+  transfer_step(pd, pt);
+  return;
+
+  finish_tag:
+  transfer_finish(pd, pt, err);
+}
+
+// 从 pt->phase 开始启动第一个不为空的阶段, 没有剩余阶段时结束传输
+static void transfer_step(const Device_SPI *const pd, Device_SPI_transfer *const pt) {
+  errno_t err = ESUCCESS;
+
+  for (; pt->phase < TRANSFER_PHASE_END; ++pt->phase) {
+    if (pt->phase == TRANSFER_PHASE_CMD && pt->cmd_len > 0) {
+      if (pt->dc != NULL) {
+        err = pt->dc->ops->write(pt->dc, PIN_VALUE_0);
+        if (err) break;
+      }
+      err = start_transmit(pd, pt->cmd, pt->cmd_len);
+      if (err) break;
+      return;
     }
-    if (err) {
-      receiving[pd->name] = 0;
-      return err;
+    if (pt->phase == TRANSFER_PHASE_TX && pt->tx_len > 0) {
+      if (pt->dc != NULL) {
+        err = pt->dc->ops->write(pt->dc, PIN_VALUE_1);
+        if (err) break;
+      }
+      err = start_transmit(pd, pt->tx, pt->tx_len);
+      if (err) break;
+      return;
     }
-    while (receiving[pd->name]);
+    if (pt->phase == TRANSFER_PHASE_RX && pt->rx_len > 0) {
+      if (pt->dc != NULL) {
+        err = pt->dc->ops->write(pt->dc, PIN_VALUE_1);
+        if (err) break;
+      }
+      err = start_receive(pd, pt->rx, pt->rx_len);
+      if (err) break;
+      return;
+    }
+  }
 
-    cur_idx += cur_len;
-  } while (len > 0);
+  transfer_finish(pd, pt, err);
+}
 
-  return ESUCCESS;
+/**
+ * @brief 拉高片选, 回调后开始下一个排队传输
+ * 出错或超时时先停止 SPI 和 DMA, 之后不会再有这个传输的完成中断
+ * @param pd
+ * @param pt
+ * @param err
+ */
+static void transfer_finish(const Device_SPI *const pd, Device_SPI_transfer *const pt, errno_t err) {
+  const uint32_t primask = enter_critical();
+  if (currents[pd->name] != pt || finishings[pd->name]) {
+    exit_critical(primask);
+    return;
+  }
+  finishings[pd->name] = 1;
+  exit_critical(primask);
+
+  timebase_timer_stop(&timeout_timers[pd->name]);
+  if (err) {
+    driver_ops->abort(pd);
+    tx_remainings[pd->name] = 0;
+    rx_remainings[pd->name] = 0;
+    transmitting[pd->name] = 0;
+    receiving[pd->name] = 0;
+  }
+
+  pt->cs->ops->write(pt->cs, PIN_VALUE_1);
+  if (pt->dc != NULL) pt->dc->ops->write(pt->dc, PIN_VALUE_0);
+
+  currents[pd->name] = NULL;
+  finishings[pd->name] = 0;
+  if (pt->callback != NULL) pt->callback(pt, err);
+
+  queue_run(pd);
+}
+
+// 在 SysTick 中断中执行, 完成中断没有到来, 例如 DMA 请求丢失
+static void transfer_timeout(void *arg) {
+  const Device_SPI *const pd = arg;
+  Device_SPI_transfer *const pt = currents[pd->name];
+  if (pt != NULL) transfer_finish(pd, pt, ETIMEDOUT);
 }
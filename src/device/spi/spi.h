@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/errno/errno.h"
+#include "device/gpio/gpio.h"
 #include <stdint.h>
 
 typedef enum {
@@ -8,6 +9,41 @@ typedef enum {
   DEVICE_SPI_COUNT,
 } Device_SPI_name;
 
+// 排队传输的优先级, 高优先级的传输先执行, 同一优先级按提交顺序执行
+typedef enum {
+  DEVICE_SPI_PRIORITY_HIGH,
+  DEVICE_SPI_PRIORITY_LOW,
+  DEVICE_SPI_PRIORITY_COUNT,
+} Device_SPI_priority;
+
+struct Device_SPI_transfer;
+// 传输完成回调, 在 SPI/DMA 中断中执行, 可以在回调中提交新的传输
+typedef void Device_SPI_transfer_callback(struct Device_SPI_transfer *pt, errno_t err);
+
+/**
+ * @brief 排队执行的一次传输
+ * 拉低片选后依次为: 命令阶段(dc 输出低电平) -> 发送阶段(dc 输出高电平) -> 接收阶段, 最后拉高片选并回调
+ * 长度为 0 的阶段跳过, 由调用方分配内存(一般为静态变量), 回调之前不能修改
+ */
+typedef struct Device_SPI_transfer {
+  Device_GPIO *cs;
+  Device_GPIO *dc; // 不需要区分命令和数据时为 NULL
+  uint8_t mode; // SPI 模式 0~3
+  uint16_t divider; // 时钟分频 2~256
+  const uint8_t *cmd;
+  uint32_t cmd_len;
+  const uint8_t *tx;
+  uint32_t tx_len;
+  uint8_t *rx;
+  uint32_t rx_len;
+  Device_SPI_priority priority;
+  Device_SPI_transfer_callback *callback;
+  void *arg;
+  // 以下由 SPI 设备使用
+  uint8_t phase;
+  struct Device_SPI_transfer *next;
+} Device_SPI_transfer;
+
 struct Device_SPI;
 struct Device_SPI_ops;
 
@@ -21,6 +57,14 @@ typedef struct Device_SPI_ops {
   errno_t (*init)(const Device_SPI *const pd);
   errno_t (*transmit)(const Device_SPI *const pd, const uint8_t *const data, uint32_t len);
   errno_t (*receive)(const Device_SPI *const pd, uint8_t *data, uint32_t len);
+  // 直接传输前占用总线, 等待正在执行的排队传输结束, 只能在主循环中调用, 从拉低片选到拉高片选期间都要占用
+  errno_t (*lock)(const Device_SPI *const pd);
+  // 释放总线, 开始执行等待中的排队传输
+  errno_t (*unlock)(const Device_SPI *const pd);
+  // 占用总线期间设置 SPI 模式和时钟分频
+  errno_t (*configure)(const Device_SPI *const pd, uint8_t mode, uint16_t divider);
+  // 提交排队传输后立即返回, 总线空闲时立即开始, 前一个传输在中断中结束时接着开始下一个
+  errno_t (*submit)(const Device_SPI *const pd, Device_SPI_transfer *const pt);
 } Device_SPI_ops;
 
 typedef struct Driver_SPI_ops {
@@ -30,6 +74,9 @@ typedef struct Driver_SPI_ops {
   errno_t (*transmit_IT)(const Device_SPI *const pd, const uint8_t *const data, uint16_t len);
   errno_t (*receive_DMA)(const Device_SPI *const pd, uint8_t *data, uint16_t len);
   errno_t (*transmit_DMA)(const Device_SPI *const pd, const uint8_t *const data, uint16_t len);
+  errno_t (*configure)(const Device_SPI *const pd, uint8_t mode, uint16_t divider);
+  // 停止正在进行的中断/DMA 传输, 可以在中断中调用, 不等待 SysTick
+  errno_t (*abort)(const Device_SPI *const pd);
 } Driver_SPI_ops;
 
 errno_t Device_SPI_module_init(void);
@@ -38,3 +85,4 @@ errno_t Device_SPI_find(Device_SPI **pd_ptr, const Device_SPI_name name);
 
 errno_t Device_SPI_TxCpltCallback(const Device_SPI *const pd);
 errno_t Device_SPI_RxCpltCallback(const Device_SPI *const pd);
+errno_t Device_SPI_ErrorCallback(const Device_SPI *const pd);
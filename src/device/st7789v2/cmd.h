@@ -18,4 +18,5 @@ typedef enum {
   ST7789V2_CMD_RAMWR = 0x2C,
   ST7789V2_CMD_MADCTL = 0x36,
   ST7789V2_CMD_COLMOD = 0x3A,
+  ST7789V2_CMD_RAMWRC = 0x3C,
 } ST7789V2_cmd;
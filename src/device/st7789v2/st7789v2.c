@@ -2,6 +2,7 @@
 #include "cmd.h"
 #include "common/delay/delay.h"
 #include "common/list/list.h"
+#include "common/timebase/timebase.h"
 #include "font/index.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -18,7 +19,13 @@ static errno_t set_ascii_char(Device_ST7789V2 *pds, uint8_t ch, uint16_t start_y
 static errno_t set_ascii_str(Device_ST7789V2 *pds, const uint8_t *const str, uint32_t len, uint16_t start_y, uint16_t start_x, color_t color);
 static errno_t fill_window(Device_ST7789V2 *const pd, color_t color);
 static errno_t refresh_window(const Device_ST7789V2 *const pd);
+static errno_t refresh_window_async(const Device_ST7789V2 *const pd, Device_ST7789V2_callback *callback, void *arg);
+static errno_t set_area(const Device_ST7789V2 *const pd, uint16_t start_y, uint16_t start_x, uint16_t end_y, uint16_t end_x);
+static errno_t write_area_async(const Device_ST7789V2 *const pd, const uint8_t *data, uint32_t len, bool first, Device_ST7789V2_callback *callback, void *arg);
 static errno_t clear_screen(Device_ST7789V2 *const pd, color_t color);
+static errno_t set_backlight(const Device_ST7789V2 *const pd, bool on);
+static errno_t sleep(const Device_ST7789V2 *const pd);
+static errno_t wake(const Device_ST7789V2 *const pd);
 
 // 内部方法
 // 设备命令方法
@@ -27,7 +34,7 @@ static errno_t no_operation(const Device_ST7789V2 *const pd) __attribute__((unus
 static errno_t software_reset(const Device_ST7789V2 *const pd) __attribute__((unused));
 static errno_t read_display_id(const Device_ST7789V2 *const pd, uint8_t rt_ids[3]) __attribute__((unused));
 static errno_t read_display_status(const Device_ST7789V2 *const pd, uint8_t rt_status[4]) __attribute__((unused));
-static errno_t sleep_in(const Device_ST7789V2 *const pd) __attribute__((unused));
+static errno_t sleep_in(const Device_ST7789V2 *const pd);
 static errno_t sleep_out(const Device_ST7789V2 *const pd);
 static errno_t partial_mode_on(const Device_ST7789V2 *const pd) __attribute__((unused));
 static errno_t normal_mode_on(const Device_ST7789V2 *const pd);
@@ -44,6 +51,11 @@ static errno_t set_pixel_color_format(const Device_ST7789V2 *const pd, uint8_t b
 static errno_t write_register(const Device_ST7789V2 *const pd, const uint8_t cmd);
 static errno_t write_data(const Device_ST7789V2 *const pd, const uint8_t *data, uint32_t len);
 static errno_t read_data(const Device_ST7789V2 *const pd, uint8_t *rt_data, uint32_t len);
+// 片选, 与 flash 共用 SPI 总线
+static errno_t bus_select(const Device_ST7789V2 *const pd);
+static errno_t bus_deselect(const Device_ST7789V2 *const pd);
+// 异步刷新的 SPI 传输完成
+static void refresh_done(Device_SPI_transfer *pt, errno_t err);
 // 检查对象是否完整
 static inline uint8_t pd_is_cplt(const Device_ST7789V2 *const pd);
 // 查找设备
@@ -62,8 +74,26 @@ static const Device_ST7789V2_ops device_ops = {
   .set_ascii_str = set_ascii_str,
   .fill_window = fill_window,
   .refresh_window = refresh_window,
+  .refresh_window_async = refresh_window_async,
+  .set_area = set_area,
+  .write_area_async = write_area_async,
   .clear_screen = clear_screen,
+  .set_backlight = set_backlight,
+  .sleep = sleep,
+  .wake = wake,
 };
+// 最近一次退出睡眠的时间, 退出睡眠 120 毫秒内不能再进入睡眠
+static uint32_t sleep_out_ms[DEVICE_ST7789V2_COUNT] = {0};
+// SPI 模式 0, 写时钟最高约 62MHz, SPI1 二分频为 42MHz
+#define SPI_MODE 0
+#define SPI_DIVIDER 2
+// 异步刷新, 与 flash 共用总线, 使用低优先级, flash 操作在两帧之间插队执行
+static const uint8_t refresh_cmd = ST7789V2_CMD_RAMWR;
+static const uint8_t continue_cmd = ST7789V2_CMD_RAMWRC;
+static Device_SPI_transfer refresh_transfers[DEVICE_ST7789V2_COUNT] = {0};
+static volatile bool refresh_pendings[DEVICE_ST7789V2_COUNT] = {0};
+static Device_ST7789V2_callback *refresh_callbacks[DEVICE_ST7789V2_COUNT] = {0};
+static void *refresh_args[DEVICE_ST7789V2_COUNT] = {0};
 
 errno_t Device_ST7789V2_module_init(void) {
   if (list == NULL) {
@@ -96,6 +126,9 @@ static errno_t init(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
+  err = timebase_init();
+  if (err) return err;
+
   err = pd->cs->ops->init(pd->cs);
   if (err) return err;
 
@@ -157,6 +190,59 @@ static errno_t off(const Device_ST7789V2 *const pd) {
   return display_off(pd);
 }
 
+// 背光低电平点亮
+static errno_t set_backlight(const Device_ST7789V2 *const pd, bool on) {
+  if (!pd_is_cplt(pd)) return EINVAL;
+  return pd->backlight->ops->write(pd->backlight, on ? PIN_VALUE_0 : PIN_VALUE_1);
+}
+
+/**
+ * @brief 关闭背光并进入睡眠模式
+ * 睡眠时显存内容保留, 唤醒后不需要重新刷新
+ * @param pd 
+ * @return errno_t 
+ */
+static errno_t sleep(const Device_ST7789V2 *const pd) {
+  if (!pd_is_cplt(pd)) return EINVAL;
+
+  errno_t err = ESUCCESS;
+
+  err = set_backlight(pd, false);
+  if (err) return err;
+
+  err = display_off(pd);
+  if (err) return err;
+
+  // 退出睡眠 120 毫秒后才可以进入睡眠
+  const uint32_t elapsed_ms = now_ms() - sleep_out_ms[pd->name];
+  if (elapsed_ms < 120) {
+    err = delay_ms(120 - elapsed_ms);
+    if (err) return err;
+  }
+
+  err = sleep_in(pd);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t wake(const Device_ST7789V2 *const pd) {
+  if (!pd_is_cplt(pd)) return EINVAL;
+
+  errno_t err = ESUCCESS;
+
+  err = sleep_out(pd);
+  if (err) return err;
+
+  err = display_on(pd);
+  if (err) return err;
+
+  err = set_backlight(pd, true);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
 static errno_t set_display_memory(Device_ST7789V2 *const pd, uint8_t *memory_ptr, uint32_t memory_size) {
   if (!pd_is_cplt(pd)) return EINVAL;
 
@@ -294,6 +380,57 @@ static errno_t refresh_window(const Device_ST7789V2 *const pd) {
   return ESUCCESS;
 }
 
+static errno_t refresh_window_async(const Device_ST7789V2 *const pd, Device_ST7789V2_callback *callback, void *arg) {
+  if (!pd_is_cplt(pd)) return EINVAL;
+  if (pd->display_memory == NULL || pd->window_height == 0 || pd->window_width == 0 || pd->one_pixel_byte_num == 0) return EINVAL;
+
+  return write_area_async(pd, pd->display_memory, pd->window_height * pd->window_width * pd->one_pixel_byte_num, true, callback, arg);
+}
+
+static errno_t set_area(const Device_ST7789V2 *const pd, uint16_t start_y, uint16_t start_x, uint16_t end_y, uint16_t end_x) {
+  if (!pd_is_cplt(pd)) return EINVAL;
+  if (start_x > end_x || start_y > end_y) return EINVAL;
+  if (end_x >= pd->screen_width || end_y >= pd->screen_height) return EINVAL;
+
+  errno_t err = ESUCCESS;
+
+  err = col_addr_set(pd, start_x, end_x);
+  if (err) return err;
+  err = row_addr_set(pd, start_y, end_y);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static errno_t write_area_async(const Device_ST7789V2 *const pd, const uint8_t *data, uint32_t len, bool first, Device_ST7789V2_callback *callback, void *arg) {
+  if (!pd_is_cplt(pd) || data == NULL || len == 0) return EINVAL;
+  if (refresh_pendings[pd->name]) return EBUSY;
+
+  Device_SPI_transfer *const pt = &refresh_transfers[pd->name];
+  memset(pt, 0, sizeof(Device_SPI_transfer));
+  pt->cs = pd->cs;
+  pt->dc = pd->dc;
+  pt->mode = SPI_MODE;
+  pt->divider = SPI_DIVIDER;
+  // 写入命令从区域起点开始, 继续写入命令接着上次的位置
+  pt->cmd = first ? &refresh_cmd : &continue_cmd;
+  pt->cmd_len = 1;
+  pt->tx = data;
+  pt->tx_len = len;
+  pt->priority = DEVICE_SPI_PRIORITY_LOW;
+  pt->callback = refresh_done;
+  pt->arg = (void *)pd;
+
+  refresh_callbacks[pd->name] = callback;
+  refresh_args[pd->name] = arg;
+  refresh_pendings[pd->name] = true;
+
+  errno_t err = pd->spi->ops->submit(pd->spi, pt);
+  if (err) refresh_pendings[pd->name] = false;
+
+  return err;
+}
+
 static errno_t clear_screen(Device_ST7789V2 *const pd, color_t color) {
   if (!pd_is_cplt(pd)) return EINVAL;
 
@@ -374,22 +511,22 @@ static errno_t software_reset(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_SWRESET);
   if (err) goto reset_cs_tag;
 
   err = delay_ms(5);
-  if (err) return err;
+  if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -398,19 +535,19 @@ static errno_t no_operation(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_NOP);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -421,7 +558,7 @@ static errno_t read_display_id(const Device_ST7789V2 *const pd, uint8_t rt_ids[3
   errno_t err = ESUCCESS;
   uint8_t rt_data[4] = {0};
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_RDDID);
@@ -430,7 +567,7 @@ static errno_t read_display_id(const Device_ST7789V2 *const pd, uint8_t rt_ids[3
   err = read_data(pd, rt_data, 4);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   rt_ids[0] = rt_data[1];
@@ -440,7 +577,7 @@ static errno_t read_display_id(const Device_ST7789V2 *const pd, uint8_t rt_ids[3
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -450,7 +587,7 @@ static errno_t read_display_status(const Device_ST7789V2 *const pd, uint8_t rt_s
   errno_t err = ESUCCESS;
   uint8_t rt_data[5] = {0};
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_RDDST);
@@ -459,7 +596,7 @@ static errno_t read_display_status(const Device_ST7789V2 *const pd, uint8_t rt_s
   err = read_data(pd, rt_data, 5);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   rt_status[0] = rt_data[1];
@@ -470,7 +607,7 @@ static errno_t read_display_status(const Device_ST7789V2 *const pd, uint8_t rt_s
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -479,19 +616,23 @@ static errno_t sleep_in(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_SLPIN);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  // 进入睡眠 5 毫秒后才可以发送下一个命令
+  err = delay_ms(5);
+  if (err) goto reset_cs_tag;
+
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -500,23 +641,24 @@ static errno_t sleep_out(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_SLPOUT);
   if (err) goto reset_cs_tag;
+  sleep_out_ms[pd->name] = now_ms();
 
   // 唤醒后 5 毫秒可以发送除了 SLPIN 以外的命令, 120 毫秒后可以发送 SLPIN 命令
   err = delay_ms(5);
-  if (err) return err;
+  if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -525,19 +667,19 @@ static errno_t partial_mode_on(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_PTLON);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -546,19 +688,19 @@ static errno_t normal_mode_on(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_NORON);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -567,19 +709,19 @@ static errno_t display_inversion_off(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_INVOFF);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -588,19 +730,19 @@ static errno_t display_inversion_on(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_INVON);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -610,19 +752,19 @@ static errno_t display_off(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_DISPOFF);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -631,19 +773,19 @@ static errno_t display_on(const Device_ST7789V2 *const pd) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_DISPON);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -652,7 +794,7 @@ static errno_t col_addr_set(const Device_ST7789V2 *const pd, uint16_t start, uin
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_CASET);
@@ -662,13 +804,13 @@ static errno_t col_addr_set(const Device_ST7789V2 *const pd, uint16_t start, uin
   err = write_data(pd, data, 4);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -677,7 +819,7 @@ static errno_t row_addr_set(const Device_ST7789V2 *const pd, uint16_t start, uin
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_RASET);
@@ -687,13 +829,13 @@ static errno_t row_addr_set(const Device_ST7789V2 *const pd, uint16_t start, uin
   err = write_data(pd, data, 4);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -702,7 +844,7 @@ static errno_t memory_write(const Device_ST7789V2 *const pd, uint8_t *data, uint
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_RAMWR);
@@ -711,13 +853,13 @@ static errno_t memory_write(const Device_ST7789V2 *const pd, uint8_t *data, uint
   err = write_data(pd, data, len);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -726,7 +868,7 @@ static errno_t memory_data_access_control(const Device_ST7789V2 *const pd, uint8
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_MADCTL);
@@ -735,13 +877,13 @@ static errno_t memory_data_access_control(const Device_ST7789V2 *const pd, uint8
   err = write_data(pd, &param, 1);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -758,7 +900,7 @@ static errno_t set_pixel_color_format(const Device_ST7789V2 *const pd, uint8_t b
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
 
   err = write_register(pd, ST7789V2_CMD_COLMOD);
@@ -767,13 +909,13 @@ static errno_t set_pixel_color_format(const Device_ST7789V2 *const pd, uint8_t b
   err = write_data(pd, &param, 1);
   if (err) goto reset_cs_tag;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -853,3 +995,29 @@ static inline uint8_t pd_is_cplt(const Device_ST7789V2 *const pd) {
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
   return ((Device_ST7789V2 *)pd)->name == *((Device_ST7789V2_name *)name);
 }
+
+// 占用总线并拉低片选
+static errno_t bus_select(const Device_ST7789V2 *const pd) {
+  errno_t err = pd->spi->ops->lock(pd->spi);
+  if (err) return err;
+  err = pd->spi->ops->configure(pd->spi, SPI_MODE, SPI_DIVIDER);
+  if (err == ESUCCESS) err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  if (err) pd->spi->ops->unlock(pd->spi);
+  return err;
+}
+
+// 拉高片选并释放总线
+static errno_t bus_deselect(const Device_ST7789V2 *const pd) {
+  errno_t err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  pd->spi->ops->unlock(pd->spi);
+  return err;
+}
+
+static void refresh_done(Device_SPI_transfer *pt, errno_t err) {
+  const Device_ST7789V2 *const pd = pt->arg;
+  Device_ST7789V2_callback *const callback = refresh_callbacks[pd->name];
+  void *const callback_arg = refresh_args[pd->name];
+
+  refresh_pendings[pd->name] = false;
+  if (callback != NULL) callback(callback_arg, err);
+}
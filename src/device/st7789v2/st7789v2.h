@@ -4,6 +4,7 @@
 #include "device/gpio/gpio.h"
 #include "device/spi/spi.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef uint16_t color_t;
 
@@ -15,6 +16,9 @@ typedef enum {
 struct Device_ST7789V2;
 struct Device_ST7789V2_ops;
 
+// 异步刷新完成回调, 在 SPI 中断中调用
+typedef void Device_ST7789V2_callback(void *arg, errno_t err);
+
 typedef struct Device_ST7789V2 {
   const Device_ST7789V2_name name;
   const uint16_t screen_width;
@@ -43,7 +47,18 @@ typedef struct Device_ST7789V2_ops {
   errno_t (*set_ascii_str)(Device_ST7789V2 *pds, const uint8_t *const str, uint32_t len, uint16_t start_y, uint16_t start_x, color_t color);
   errno_t (*fill_window)(Device_ST7789V2 *const pd, color_t color);
   errno_t (*refresh_window)(const Device_ST7789V2 *const pd);
+  // 把显存作为一次低优先级 SPI 传输排队发送后立即返回, 完成前不能修改显存, 上次刷新未完成时返回 EBUSY
+  errno_t (*refresh_window_async)(const Device_ST7789V2 *const pd, Device_ST7789V2_callback *callback, void *arg);
+  // 只设置屏幕的写入区域, 不使用显存, 用于从其他存储直接向屏幕写像素
+  errno_t (*set_area)(const Device_ST7789V2 *const pd, uint16_t start_y, uint16_t start_x, uint16_t end_y, uint16_t end_x);
+  // 把 data 中的像素排队写入区域, first 为 true 时从区域起点开始, 否则接着上次写入的位置; 与 refresh_window_async 共用一个传输
+  errno_t (*write_area_async)(const Device_ST7789V2 *const pd, const uint8_t *data, uint32_t len, bool first, Device_ST7789V2_callback *callback, void *arg);
   errno_t (*clear_screen)(Device_ST7789V2 *const pd, color_t color);
+  errno_t (*set_backlight)(const Device_ST7789V2 *const pd, bool on);
+  // 关闭背光和显示并进入睡眠模式, 显存内容保留
+  errno_t (*sleep)(const Device_ST7789V2 *const pd);
+  // 退出睡眠模式并打开显示和背光
+  errno_t (*wake)(const Device_ST7789V2 *const pd);
 } Device_ST7789V2_ops;
 
 // 全局方法
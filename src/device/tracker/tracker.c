@@ -1,6 +1,7 @@
 #include "tracker.h"
 #include "common/list/list.h"
 #include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
@@ -9,18 +10,43 @@
 // 对象方法
 static errno_t init(Device_tracker *const pd);
 static errno_t get_line_center(Device_tracker *const pd, uint8_t *rt_direction_ptr);
+static errno_t get_raw(Device_tracker *const pd, uint8_t *rt_value_ptr);
+static errno_t get_line(Device_tracker *const pd, Device_tracker_line *rt_line_ptr);
 
+// 内部方法 - 生成探头状态查找表
+static void build_line_table(void);
 // 内部方法 - 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
 static const Device_tracker_ops device_ops = {
   .init = init,
   .get_line_center = get_line_center,
+  .get_raw = get_raw,
+  .get_line = get_line,
 };
 
+#define PATTERN_COUNT (1 << DEVICE_TRACKER_IN_COUNT)
+// 压线探头数量达到该值时认为是路口
+#define INTERSECTION_ACTIVE_COUNT 5
+
 static List *list = NULL;
 
+// 探头状态查找表, 以 7 个探头的检测结果为下标
+static int16_t line_positions[PATTERN_COUNT] = {0};
+static Device_tracker_line_status line_statuses[PATTERN_COUNT] = {0};
+static bool line_table_built = false;
+
+// 丢线记忆
+static volatile int16_t last_positions[DEVICE_TRACKER_COUNT] = {0};
+static volatile uint32_t lost_begin_ms[DEVICE_TRACKER_COUNT] = {0};
+static volatile bool losts[DEVICE_TRACKER_COUNT] = {0};
+
 errno_t Device_tracker_module_init(void) {
+  if (line_table_built == false) {
+    build_line_table();
+    line_table_built = true;
+  }
+
   if (list == NULL) {
     errno_t err = list_create(&list);
     if (err) return err;
@@ -55,6 +81,12 @@ static errno_t init(Device_tracker *const pd) {
     if (err) return err;
   }
 
+  err = Device_GPIO_bus_init(&pd->bus, pd->ins, DEVICE_TRACKER_IN_COUNT);
+  if (err) return err;
+
+  last_positions[pd->name] = 0;
+  losts[pd->name] = false;
+
   // err = pd->timer->ops->init(pd->timer);
   // if (err) return err;
 
@@ -90,19 +122,10 @@ static errno_t init(Device_tracker *const pd) {
 static errno_t get_line_center(Device_tracker *const pd, uint8_t *rt_direction_ptr) {
   if (pd == NULL || rt_direction_ptr == NULL) return EINVAL;
 
-  errno_t err = ESUCCESS;
   // 从 0 到 6 位表示第 0 到 6 个探头的检测结果
   uint8_t ins_value = 0;
-
-  for (uint8_t i = 0; i < DEVICE_TRACKER_IN_COUNT; ++i) {
-    uint8_t one_value = 0;
-    err = pd->ins[i]->ops->read(pd->ins[i], &one_value);
-    if (err) return err;
-
-    if (one_value == PIN_VALUE_1) {
-      ins_value |= 1 << i;
-    }
-  }
+  errno_t err = get_raw(pd, &ins_value);
+  if (err) return err;
 
   // 如果没有找到轨迹, 返回 0
   if (ins_value == 0) {
@@ -127,6 +150,110 @@ static errno_t get_line_center(Device_tracker *const pd, uint8_t *rt_direction_p
   return ESUCCESS;
 }
 
+/**
+ * @brief 获取 7 个探头的检测结果
+ * 通过 GPIO 总线读取, 每个端口只读一次输入寄存器, 同一端口上的探头是同一时刻的值
+ * @param pd 
+ * @param rt_value_ptr 传返回值的指针, 从 0 到 6 位表示第 0 到 6 个探头的检测结果
+ * @return errno_t 
+ */
+static errno_t get_raw(Device_tracker *const pd, uint8_t *rt_value_ptr) {
+  if (pd == NULL || rt_value_ptr == NULL) return EINVAL;
+
+  uint32_t value = 0;
+  errno_t err = Device_GPIO_bus_read(&pd->bus, &value);
+  if (err) return err;
+
+  *rt_value_ptr = (uint8_t)value;
+  return ESUCCESS;
+}
+
+/**
+ * @brief 获取导航线位置
+ * 位置由查找表给出, 为压线探头位置的平均值, 可以分辨到半个探头间距
+ * 丢线时按最后一次检测到的位置所在方向给出最边缘外侧的位置, 中间丢线则给出 0
+ * 路口时保持路口前的位置
+ * @param pd 
+ * @param rt_line_ptr 传返回值的指针
+ * @return errno_t 
+ */
+static errno_t get_line(Device_tracker *const pd, Device_tracker_line *rt_line_ptr) {
+  if (pd == NULL || rt_line_ptr == NULL) return EINVAL;
+
+  uint8_t raw = 0;
+  errno_t err = get_raw(pd, &raw);
+  if (err) return err;
+
+  const Device_tracker_line_status status = line_statuses[raw];
+  int16_t position = last_positions[pd->name];
+  uint32_t lost_ms = 0;
+
+  switch (status) {
+    case DEVICE_TRACKER_LINE_FOUND: {
+      position = line_positions[raw];
+      last_positions[pd->name] = position;
+      losts[pd->name] = false;
+      break;
+    }
+    case DEVICE_TRACKER_LINE_LOST: {
+      if (losts[pd->name] == false) {
+        losts[pd->name] = true;
+        lost_begin_ms[pd->name] = now_ms();
+      }
+      lost_ms = now_ms() - lost_begin_ms[pd->name];
+
+      if (position > 0) position = DEVICE_TRACKER_POSITION_LOST;
+      else if (position < 0) position = -DEVICE_TRACKER_POSITION_LOST;
+      break;
+    }
+    case DEVICE_TRACKER_LINE_INTERSECTION: {
+      losts[pd->name] = false;
+      break;
+    }
+  }
+
+  rt_line_ptr->status = status;
+  rt_line_ptr->position = position;
+  rt_line_ptr->raw = raw;
+  rt_line_ptr->lost_ms = lost_ms;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 预先计算 128 种探头状态对应的导航线位置和状态
+ * 位置为压线探头位置的平均值(加权质心, 探头权重相同)
+ * 压线探头达到 INTERSECTION_ACTIVE_COUNT 个, 或压线探头不连续(分叉), 认为是路口
+ */
+static void build_line_table(void) {
+  for (uint16_t pattern = 0; pattern < PATTERN_COUNT; ++pattern) {
+    int32_t sum = 0;
+    uint8_t active = 0, segments = 0;
+    bool last_active = false;
+
+    for (uint8_t i = 0; i < DEVICE_TRACKER_IN_COUNT; ++i) {
+      const bool one_active = (pattern & (1 << i)) != 0;
+      if (one_active) {
+        sum += (int32_t)i * DEVICE_TRACKER_POSITION_SCALE - DEVICE_TRACKER_POSITION_MAX;
+        ++active;
+        if (last_active == false) ++segments;
+      }
+      last_active = one_active;
+    }
+
+    if (active == 0) {
+      line_statuses[pattern] = DEVICE_TRACKER_LINE_LOST;
+      line_positions[pattern] = 0;
+    } else if (active >= INTERSECTION_ACTIVE_COUNT || segments > 1) {
+      line_statuses[pattern] = DEVICE_TRACKER_LINE_INTERSECTION;
+      line_positions[pattern] = (int16_t)(sum / active);
+    } else {
+      line_statuses[pattern] = DEVICE_TRACKER_LINE_FOUND;
+      line_positions[pattern] = (int16_t)(sum / active);
+    }
+  }
+}
+
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
   return ((Device_tracker *)pd)->name == *((Device_tracker_name *)name);
 }
@@ -6,24 +6,50 @@
 #include <stdint.h>
 
 #define DEVICE_TRACKER_IN_COUNT 7
+// 导航线位置单位为探头间距的 1/1000, 最左探头为 -3000, 中间为 0, 最右探头为 3000
+#define DEVICE_TRACKER_POSITION_SCALE 1000
+#define DEVICE_TRACKER_POSITION_MAX ((DEVICE_TRACKER_IN_COUNT - 1) * DEVICE_TRACKER_POSITION_SCALE / 2)
+// 丢线时按最后一次位置的方向给出的位置, 比最边缘探头再往外半个间距
+#define DEVICE_TRACKER_POSITION_LOST (DEVICE_TRACKER_POSITION_MAX + DEVICE_TRACKER_POSITION_SCALE / 2)
 
 typedef enum {
   DEVICE_TRACKER_1,
   DEVICE_TRACKER_COUNT,
 } Device_tracker_name;
 
+typedef enum {
+  DEVICE_TRACKER_LINE_LOST,
+  DEVICE_TRACKER_LINE_FOUND,
+  // 检测到路口(大部分探头压线或轨迹分叉), 位置保持为路口前的值
+  DEVICE_TRACKER_LINE_INTERSECTION,
+} Device_tracker_line_status;
+
+typedef struct {
+  Device_tracker_line_status status;
+  int16_t position;
+  // 从 0 到 6 位表示第 0 到 6 个探头的检测结果
+  uint8_t raw;
+  // 丢线持续的毫秒数, 未丢线时为 0
+  uint32_t lost_ms;
+} Device_tracker_line;
+
 struct Device_tracker;
 struct Device_tracker_ops;
 
 typedef struct Device_tracker {
   const Device_tracker_name name;
   Device_GPIO *ins[DEVICE_TRACKER_IN_COUNT];
+  // 由 ins 组成的总线, init 时生成
+  Device_GPIO_bus bus;
   const struct Device_tracker_ops *ops;
 } Device_tracker;
 
 typedef struct Device_tracker_ops {
   errno_t (*init)(Device_tracker *const pd);
   errno_t (*get_line_center)(Device_tracker *const pd, uint8_t *rt_direction_ptr);
+  errno_t (*get_raw)(Device_tracker *const pd, uint8_t *rt_value_ptr);
+  // 加权质心估算导航线位置, 带丢线记忆和路口检测
+  errno_t (*get_line)(Device_tracker *const pd, Device_tracker_line *rt_line_ptr);
 } Device_tracker_ops;
 
 // 全局方法
@@ -1,30 +1,66 @@
 #include "ultrasonic.h"
 #include "common/list/list.h"
-#include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 
-// 计时单位 10 微秒
-#define TIME_UNIT_US_NUM 10
+// 每次触发的间隔(毫秒), 多个设备轮流触发, 需要大于回波最长时间, 避免相互干扰
+#define TRIGGER_PERIOD_MS 60
+// 触发脉冲宽度(微秒), 模块要求至少 10 微秒
+#define TRIGGER_PULSE_US 15
+// 回波最长时间(微秒), 超过视为超出量程
+#define ECHO_TIMEOUT_US 30000
+// 中值滤波窗口大小
+#define FILTER_WINDOW_SIZE 5
+
+typedef enum {
+  ECHO_STATE_IDLE,
+  ECHO_STATE_TRIGGERED,
+  ECHO_STATE_HIGH,
+} Echo_state;
 
 // 对象方法
 static errno_t init(Device_ultrasonic *const pd);
+static errno_t start(Device_ultrasonic *const pd);
+static errno_t stop(Device_ultrasonic *const pd);
 static errno_t read(Device_ultrasonic *const pd, uint32_t *rt_data_ptr);
+static errno_t read_latest(Device_ultrasonic *const pd, uint32_t *rt_data_ptr, uint32_t *rt_age_ms_ptr);
 
 // 内部方法
-// 等待直到引脚达到某状态
-static errno_t wait_until_pin_is(Device_ultrasonic *const pd, const Pin_value target, const uint16_t timeout, uint16_t *rt_time_taken_ptr);
+// 定时触发回调, 每次轮到一个设备
+static void trigger_callback(void *arg);
+// 发出触发脉冲
+static errno_t trigger(Device_ultrasonic *const pd);
+// 高电平时间(微秒)转换为距离(0.1 毫米)
+static inline uint32_t echo_us_to_distance(uint32_t us);
 // 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 
 static const Device_ultrasonic_ops device_ops = {
   .init = init,
+  .start = start,
+  .stop = stop,
   .read = read,
+  .read_latest = read_latest,
 };
 
 static List *list = NULL;
 
+// 正在连续测距的设备, 由触发定时器轮流触发
+static Device_ultrasonic *volatile running_devices[DEVICE_ULTRASONIC_COUNT] = {0};
+static uint8_t running_count = 0;
+static Device_ultrasonic_name next_trigger = 0;
+static Timebase_timer trigger_timer = {0};
+
+static volatile Echo_state echo_states[DEVICE_ULTRASONIC_COUNT] = {0};
+static volatile uint32_t echo_rise_us[DEVICE_ULTRASONIC_COUNT] = {0};
+// 最近若干次测量结果, 用于中值滤波
+static volatile uint32_t samples[DEVICE_ULTRASONIC_COUNT][FILTER_WINDOW_SIZE] = {0};
+static volatile uint8_t sample_counts[DEVICE_ULTRASONIC_COUNT] = {0};
+static volatile uint8_t sample_idxs[DEVICE_ULTRASONIC_COUNT] = {0};
+static volatile uint32_t latest_ms[DEVICE_ULTRASONIC_COUNT] = {0};
+
 errno_t Device_ultrasonic_module_init(void) {
   if (list == NULL) {
     errno_t err = list_create(&list);
@@ -50,100 +86,181 @@ errno_t Device_ultrasonic_find(Device_ultrasonic **pd_ptr, const Device_ultrason
   return ESUCCESS;
 }
 
-static errno_t init(Device_ultrasonic *const pd) {
+/**
+ * @brief echo 引脚外部中断回调(双边沿)
+ * 上升沿记录时间戳, 下降沿计算高电平时长并写入滤波窗口
+ */
+errno_t Device_ultrasonic_echo_EXTI_callback(Device_ultrasonic *const pd) {
   if (pd == NULL) return EINVAL;
 
-  errno_t err = ESUCCESS;
+  const uint32_t now = now_us();
 
-  err = pd->timer->ops->init(pd->timer);
-  if (err) return err;
-  
-  err = pd->timer->ops->set_time_for_count_incr(pd->timer, TIME_UNIT_US_NUM);
-  if (err) return err;
-  // 溢出值设置为最大(为了保持兼容, 设置 0xFFFF)
-  err = pd->timer->ops->set_auto_reload_register(pd->timer, 0xFFFF);
-  if (err) return err;
-  
-  err = pd->timer->ops->start(pd->timer, DEVICE_TIMER_START_MODE_NO_IT);
+  Pin_value pv = PIN_VALUE_0;
+  errno_t err = pd->echo->ops->read(pd->echo, &pv);
   if (err) return err;
 
-  err = pd->trig->ops->init(pd->trig);
-  if (err) return err;
+  const Device_ultrasonic_name name = pd->name;
 
-  err = pd->echo->ops->init(pd->echo);
-  if (err) return err;
+  if (pv == PIN_VALUE_1) {
+    if (echo_states[name] == ECHO_STATE_TRIGGERED) {
+      echo_rise_us[name] = now;
+      echo_states[name] = ECHO_STATE_HIGH;
+    }
+    return ESUCCESS;
+  }
+
+  if (echo_states[name] != ECHO_STATE_HIGH) return ESUCCESS;
+  echo_states[name] = ECHO_STATE_IDLE;
+
+  const uint32_t width = now - echo_rise_us[name];
+  // 超出量程的结果丢弃
+  if (width > ECHO_TIMEOUT_US) return ESUCCESS;
+
+  samples[name][sample_idxs[name]] = echo_us_to_distance(width);
+  sample_idxs[name] = (sample_idxs[name] + 1) % FILTER_WINDOW_SIZE;
+  if (sample_counts[name] < FILTER_WINDOW_SIZE) ++sample_counts[name];
+  latest_ms[name] = now_ms();
 
   return ESUCCESS;
 }
 
-static errno_t read(Device_ultrasonic *const pd, uint32_t *rt_data_ptr) {
+static errno_t init(Device_ultrasonic *const pd) {
   if (pd == NULL) return EINVAL;
 
   errno_t err = ESUCCESS;
 
-  err = pd->trig->ops->write(pd->trig, PIN_VALUE_1);
+  err = timebase_init();
   if (err) return err;
-  err = delay_us(15);
+
+  err = pd->trig->ops->init(pd->trig);
   if (err) return err;
+
   err = pd->trig->ops->write(pd->trig, PIN_VALUE_0);
   if (err) return err;
 
-  err = wait_until_pin_is(pd, PIN_VALUE_1, 3000, NULL);
+  err = pd->echo->ops->init(pd->echo);
   if (err) return err;
 
-  uint16_t time_taken = 0;
-  err = wait_until_pin_is(pd, PIN_VALUE_0, 5000, &time_taken);
-  if (err) return err;
+  echo_states[pd->name] = ECHO_STATE_IDLE;
+  sample_counts[pd->name] = 0;
+  sample_idxs[pd->name] = 0;
 
-  // 距离单位为 0.1 毫米, 计算公式为: 声速 / 2 * 秒数 * 10000
-  // 即: 340 / 2 * (ime_taken / (1000000 / TIME_UNIT_US_NUM)) * 10000, 化简如下
-  uint32_t distance = 34 / 2 * time_taken * TIME_UNIT_US_NUM / 10;
+  return ESUCCESS;
+}
+
+/**
+ * @brief 开始后台连续测距
+ * 所有正在测距的设备共用一个软件定时器, 每 TRIGGER_PERIOD_MS 毫秒轮流触发一个
+ */
+static errno_t start(Device_ultrasonic *const pd) {
+  if (pd == NULL) return EINVAL;
+  if (running_devices[pd->name] != NULL) return ESUCCESS;
+
+  running_devices[pd->name] = pd;
+  ++running_count;
+
+  if (running_count > 1) return ESUCCESS;
+
+  return timebase_timer_start(&trigger_timer, TRIGGER_PERIOD_MS, TRIGGER_PERIOD_MS, trigger_callback, NULL);
+}
+
+static errno_t stop(Device_ultrasonic *const pd) {
+  if (pd == NULL) return EINVAL;
+  if (running_devices[pd->name] == NULL) return ESUCCESS;
+
+  running_devices[pd->name] = NULL;
+  echo_states[pd->name] = ECHO_STATE_IDLE;
+  --running_count;
+
+  if (running_count > 0) return ESUCCESS;
+
+  return timebase_timer_stop(&trigger_timer);
+}
+
+/**
+ * @brief 读取中值滤波后的距离, 不会阻塞
+ * @param rt_data_ptr 返回距离, 单位为 0.1 毫米
+ * @return 还没有测量结果时返回 ENODATA
+ */
+static errno_t read(Device_ultrasonic *const pd, uint32_t *rt_data_ptr) {
+  if (pd == NULL || rt_data_ptr == NULL) return EINVAL;
+
+  const uint8_t count = sample_counts[pd->name];
+  if (count == 0) return ENODATA;
+
+  // 拷贝出来再排序, 窗口很小, 插入排序即可
+  uint32_t sorted[FILTER_WINDOW_SIZE] = {0};
+  for (uint8_t i = 0; i < count; i++) {
+    const uint32_t value = samples[pd->name][i];
+    uint8_t j = i;
+    for (; j > 0 && sorted[j - 1] > value; j--) {
+      sorted[j] = sorted[j - 1];
+    }
+    sorted[j] = value;
+  }
 
-  *rt_data_ptr = distance;
+  *rt_data_ptr = sorted[count / 2];
 
   return ESUCCESS;
 }
 
 /**
- * @brief 等待引脚到达指定状态
- * 
- * @param pd 设备对象
- * @param target 需要到达的状态
- * @param timeout 超时时长
- * @param rt_time_taken_ptr 接收返回的实际用时时长, 传 NULL 不返回
- * @return errno_t 返回的错误码
+ * @brief 读取最近一次测量的原始距离
+ * @param rt_data_ptr 返回距离, 单位为 0.1 毫米
+ * @param rt_age_ms_ptr 返回该结果距今的毫秒数, 传 NULL 不返回
+ * @return 还没有测量结果时返回 ENODATA
  */
-static errno_t wait_until_pin_is(Device_ultrasonic *const pd, const Pin_value target, const uint16_t timeout, uint16_t *rt_time_taken_ptr) {
-  uint32_t first_tick32 = 0;
-  errno_t err = pd->timer->ops->get_register_count(pd->timer, &first_tick32);
-  if (err) return err;
-  uint16_t first_tick = (uint16_t)first_tick32;
+static errno_t read_latest(Device_ultrasonic *const pd, uint32_t *rt_data_ptr, uint32_t *rt_age_ms_ptr) {
+  if (pd == NULL || rt_data_ptr == NULL) return EINVAL;
+  if (sample_counts[pd->name] == 0) return ENODATA;
 
-  Pin_value pv = PIN_VALUE_1;
-  uint16_t tick = first_tick;
+  const uint8_t idx = (sample_idxs[pd->name] + FILTER_WINDOW_SIZE - 1) % FILTER_WINDOW_SIZE;
+  *rt_data_ptr = samples[pd->name][idx];
 
-  for (;;) {
-    err = pd->echo->ops->read(pd->echo, &pv);
-    if (err) return err;
+  if (rt_age_ms_ptr != NULL) {
+    *rt_age_ms_ptr = now_ms() - latest_ms[pd->name];
+  }
 
-    uint32_t tick32 = 0;
-    err = pd->timer->ops->get_register_count(pd->timer, &tick32);
-    if (err) return err;
-    tick = (uint16_t)tick32;
+  return ESUCCESS;
+}
 
-    uint16_t diff = (uint16_t)(tick - first_tick);
+static void trigger_callback(void *arg) {
+  (void)arg;
 
-    if (pv == target) {
-      if (rt_time_taken_ptr != NULL) {
-        *rt_time_taken_ptr = diff;
-      }
-      return ESUCCESS;
-    }
+  for (uint8_t i = 0; i < DEVICE_ULTRASONIC_COUNT; i++) {
+    const Device_ultrasonic_name name = next_trigger;
+    next_trigger = (next_trigger + 1) % DEVICE_ULTRASONIC_COUNT;
+
+    Device_ultrasonic *const pd = running_devices[name];
+    if (pd == NULL) continue;
 
-    if (diff >= timeout) break;
+    trigger(pd);
+    return;
   }
+}
+
+static errno_t trigger(Device_ultrasonic *const pd) {
+  errno_t err = ESUCCESS;
+
+  // 上一次回波还没结束(超出量程)时直接放弃
+  echo_states[pd->name] = ECHO_STATE_TRIGGERED;
+
+  err = pd->trig->ops->write(pd->trig, PIN_VALUE_1);
+  if (err) return err;
+
+  const uint32_t begin = now_us();
+  while (now_us() - begin < TRIGGER_PULSE_US);
+
+  err = pd->trig->ops->write(pd->trig, PIN_VALUE_0);
+  if (err) return err;
 
-  return ETIMEDOUT;
+  return ESUCCESS;
+}
+
+static inline uint32_t echo_us_to_distance(uint32_t us) {
+  // 距离单位为 0.1 毫米, 计算公式为: 声速 / 2 * 秒数 * 10000
+  // 即: 340 / 2 * (us / 1000000) * 10000, 化简如下
+  return us * 17 / 10;
 }
 
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
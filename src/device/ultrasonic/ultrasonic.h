@@ -2,7 +2,6 @@
 
 #include "common/errno/errno.h"
 #include "device/gpio/gpio.h"
-#include "device/timer/timer.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -18,16 +17,24 @@ typedef struct Device_ultrasonic {
   const Device_ultrasonic_name name;
   Device_GPIO *trig;
   Device_GPIO *echo;
-  Device_timer *timer;
   const struct Device_ultrasonic_ops *ops;
 } Device_ultrasonic;
 
 typedef struct Device_ultrasonic_ops {
   errno_t (*init)(Device_ultrasonic *const pd);
+  // 开始/停止后台连续测距, 多个设备轮流触发
+  errno_t (*start)(Device_ultrasonic *const pd);
+  errno_t (*stop)(Device_ultrasonic *const pd);
+  // 读取中值滤波后的距离, 立即返回, 单位 0.1 毫米
   errno_t (*read)(Device_ultrasonic *const pd, uint32_t *rt_data_ptr);
+  // 读取最近一次测量的原始距离及其距今的毫秒数
+  errno_t (*read_latest)(Device_ultrasonic *const pd, uint32_t *rt_data_ptr, uint32_t *rt_age_ms_ptr);
 } Device_ultrasonic_ops;
 
 // 全局方法
 errno_t Device_ultrasonic_module_init(void);
 errno_t Device_ultrasonic_register(Device_ultrasonic *const pd);
 errno_t Device_ultrasonic_find(Device_ultrasonic **pd_ptr, const Device_ultrasonic_name name);
+
+// echo 引脚外部中断回调处理
+errno_t Device_ultrasonic_echo_EXTI_callback(Device_ultrasonic *const pd);
@@ -6,3 +6,8 @@
 #define W25QX_SIZE             (W25QX_PAGE_NUM * W25QX_PAGE_SIZE)
 #define W25QX_SECTOR_SIZE      0x1000u
 #define W25QX_SECTOR_NUM       0x800u
+#define W25QX_BLOCK_32K_SIZE   0x8000u
+#define W25QX_BLOCK_64K_SIZE   0x10000u
+// SPI 模式 0, 时钟不超过 104MHz, SPI1 二分频为 42MHz
+#define W25QX_SPI_MODE         0
+#define W25QX_SPI_DIVIDER      2
@@ -4,28 +4,56 @@
 #include "config/index.h"
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
 #include "common/list/list.h"
+#include "common/delay/delay.h"
+#include "common/timebase/timebase.h"
 
 // 对象方法
 static errno_t init(const Device_W25QX *const pd);
 static errno_t erase(const Device_W25QX *const pd, uint32_t addr, uint16_t sector_count);
 static errno_t read(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len);
 static errno_t write(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len);
+static errno_t power_down(const Device_W25QX *const pd);
+static errno_t release_power_down(const Device_W25QX *const pd);
+static errno_t is_busy(const Device_W25QX *const pd, bool *rt_busy_ptr);
+static errno_t erase_async(const Device_W25QX *const pd, uint32_t addr, uint16_t sector_count, Device_W25QX_callback *callback, void *arg);
+static errno_t program_async(const Device_W25QX *const pd, uint32_t addr, const uint8_t *data, uint32_t len, Device_W25QX_callback *callback, void *arg);
+static errno_t read_async(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len, Device_W25QX_callback *callback, void *arg);
 
 // 内部方法 - 查找设备
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
 // 内部方法 - W25QX 操作
 static errno_t read_id(const Device_W25QX *const pd, uint32_t *id_ptr);
-static errno_t power_down(const Device_W25QX *const pd) __attribute__((unused));
-static errno_t release_power_down(const Device_W25QX *const pd) __attribute__((unused));
 static errno_t write_enable(const Device_W25QX *const pd);
 static errno_t write_disable(const Device_W25QX *const pd) __attribute__((unused));
 static errno_t wait_write_complete(const Device_W25QX *const pd);
 static errno_t sector_erase(const Device_W25QX *const pd, uint32_t addr);
-static errno_t block_erase_32k(const Device_W25QX *const pd, uint32_t addr) __attribute__((unused));
-static errno_t block_erase_64k(const Device_W25QX *const pd, uint32_t addr) __attribute__((unused));
-static errno_t chip_erase(const Device_W25QX *const pd) __attribute__((unused));
 static errno_t page_write(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint16_t len);
+// 只发送命令, 不等待完成
+static errno_t page_program(const Device_W25QX *const pd, uint32_t addr, const uint8_t *data, uint16_t len);
+static errno_t erase_command(const Device_W25QX *const pd, W25QX_cmd cmd, uint32_t addr);
+// 内部方法 - 选择覆盖 [addr, end) 开头部分的最大擦除命令, 返回擦除的字节数
+static uint32_t erase_plan(uint32_t addr, uint32_t end, W25QX_cmd *rt_cmd_ptr);
+static errno_t read_data(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len);
+// 读取一次状态寄存器 1 的 BUSY 位
+static errno_t read_busy(const Device_W25QX *const pd, bool *rt_busy_ptr);
+// 片选, 与屏幕共用 SPI 总线
+static errno_t bus_select(const Device_W25QX *const pd);
+static errno_t bus_deselect(const Device_W25QX *const pd);
+// 内部方法 - 异步操作
+static inline bool async_active(const Device_W25QX *const pd);
+static errno_t async_start(const Device_W25QX *const pd);
+static errno_t async_submit_next(const Device_W25QX *const pd);
+static void async_poll(void *arg);
+static void async_enable_done(Device_SPI_transfer *pt, errno_t err);
+static void async_command_done(Device_SPI_transfer *pt, errno_t err);
+static void async_status_done(Device_SPI_transfer *pt, errno_t err);
+static void async_finish(const Device_W25QX *const pd, errno_t err);
+static void async_read_done(Device_SPI_transfer *pt, errno_t err);
+// 内部方法 - 写入一个扇区内的数据
+static errno_t sector_write(const Device_W25QX *const pd, uint32_t sector_addr, uint16_t offset, const uint8_t *data, uint16_t len);
 // 内部方法 - 地址由整型转为字节数组
 static errno_t addr_to_bytes(uint32_t addr, uint8_t *bytes);
 
@@ -36,7 +64,50 @@ static const Device_W25QX_ops device_ops = {
   .erase = erase,
   .read = read,
   .write = write,
+  .power_down = power_down,
+  .release_power_down = release_power_down,
+  .is_busy = is_busy,
+  .erase_async = erase_async,
+  .program_async = program_async,
+  .read_async = read_async,
 };
+// 扇区缓存, 保存最近一次读改写的扇区内容, 与 flash 中的内容一致
+static uint8_t sector_caches[DEVICE_W25QX_COUNT][W25QX_SECTOR_SIZE] = {0};
+static uint32_t cache_addrs[DEVICE_W25QX_COUNT] = {0};
+static bool cache_valids[DEVICE_W25QX_COUNT] = {0};
+
+// 异步操作查询状态的周期, 页编程典型 0.7 毫秒, 扇区擦除典型 45 毫秒
+#define ASYNC_PROGRAM_POLL_MS 1
+#define ASYNC_ERASE_POLL_MS 5
+
+typedef enum {
+  ASYNC_IDLE,
+  ASYNC_ERASE,
+  ASYNC_PROGRAM,
+  ASYNC_READ,
+} Async_type;
+
+// 异步操作状态, [addr, end) 为剩余的范围
+typedef struct {
+  volatile Async_type type;
+  uint32_t addr;
+  uint32_t end;
+  const uint8_t *data;
+  errno_t enable_err; // 写使能传输的结果, 由命令传输的回调检查
+  Device_W25QX_callback *callback;
+  void *arg;
+} Async_state;
+
+static Async_state async_states[DEVICE_W25QX_COUNT] = {0};
+static Timebase_timer async_timers[DEVICE_W25QX_COUNT] = {0};
+// 异步操作通过 SPI 排队传输完成: 写使能, 擦除/编程命令, 读状态寄存器
+static const uint8_t enable_cmd = W25QX_CMD_WRITE_ENABLE;
+static const uint8_t status_cmd = W25QX_CMD_READ_STATUS_REGISTER_1;
+static uint8_t command_bytes[DEVICE_W25QX_COUNT][5] = {0};
+static uint8_t status_values[DEVICE_W25QX_COUNT] = {0};
+static Device_SPI_transfer enable_transfers[DEVICE_W25QX_COUNT] = {0};
+static Device_SPI_transfer command_transfers[DEVICE_W25QX_COUNT] = {0};
+static Device_SPI_transfer status_transfers[DEVICE_W25QX_COUNT] = {0};
 
 errno_t Device_W25QX_module_init() {
   if (list == NULL) {
@@ -84,15 +155,27 @@ static errno_t init(const Device_W25QX *const pd) {
 
 static errno_t erase(const Device_W25QX *const pd, uint32_t addr, uint16_t sector_count) {
   if (pd == NULL) return EINVAL;
+  if (async_active(pd)) return EBUSY;
   // 地址必须是扇区的起始地址
   if (addr % W25QX_SECTOR_SIZE != 0) return E_CUSTOM_W25QX_ADDR_ERROR;
   // 从 addr 开始的剩余扇区数量必须大于传入的扇区数量, 由于乘法性能高于除法, 此处比较字节数
   if (W25QX_SIZE - addr < sector_count * W25QX_SECTOR_SIZE) return E_CUSTOM_W25QX_OVERSTEP;
 
-  while (sector_count--) {
-    errno_t err = sector_erase(pd, addr);
+  // 擦除范围包含缓存的扇区时缓存失效
+  const uint32_t cache_addr = cache_addrs[pd->name];
+  if (cache_addr >= addr && cache_addr < addr + sector_count * W25QX_SECTOR_SIZE) cache_valids[pd->name] = false;
+
+  const uint32_t end = addr + sector_count * W25QX_SECTOR_SIZE;
+  while (addr < end) {
+    W25QX_cmd cmd = W25QX_CMD_SECTOR_ERASE;
+    const uint32_t size = erase_plan(addr, end, &cmd);
+
+    errno_t err = erase_command(pd, cmd, addr);
     if (err) return err;
-    addr += W25QX_SECTOR_SIZE;
+    err = wait_write_complete(pd);
+    if (err) return err;
+
+    addr += size;
   }
 
   return ESUCCESS;
@@ -100,81 +183,53 @@ static errno_t erase(const Device_W25QX *const pd, uint32_t addr, uint16_t secto
 
 static errno_t read(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len) {
   if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  if (async_active(pd)) return EBUSY;
   // 从 addr 开始的剩余字节数必须大于 len
   if (W25QX_SIZE - addr < len) return E_CUSTOM_W25QX_OVERSTEP;
 
-  errno_t err = ESUCCESS;
-
-  uint8_t cmd_addr[4] = {W25QX_CMD_READ_DATA};
-  err = addr_to_bytes(addr, cmd_addr + 1);
-  if (err) return err;
-
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
-  if (err) return err;
-  err = pd->spi->ops->transmit(pd->spi, cmd_addr, 4);
-  if (err) goto reset_cs_tag;
-  err = pd->spi->ops->receive(pd->spi, data, len);
-  if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
-  if (err) return err;
-
-  return ESUCCESS;
+  // 读取范围在缓存的扇区内时直接从缓存复制
+  const uint32_t cache_addr = cache_addrs[pd->name];
+  if (cache_valids[pd->name] && addr >= cache_addr && addr + len <= cache_addr + W25QX_SECTOR_SIZE) {
+    memcpy(data, sector_caches[pd->name] + (addr - cache_addr), len);
+    return ESUCCESS;
+  }
 
-  reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
-  return err;
+  return read_data(pd, addr, data, len);
 }
 
+/**
+ * @brief 写入任意地址和长度的数据, 不影响写入范围以外的数据
+ * 按扇区读出-合并-写回, 只有需要把 0 写成 1 时才擦除扇区, 并且只编程内容有变化的页
+ * @param pd 
+ * @param addr 
+ * @param data 
+ * @param len 
+ * @return errno_t 
+ */
 static errno_t write(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len) {
   if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  if (async_active(pd)) return EBUSY;
   // 从 addr 开始的剩余字节数必须大于 len
   if (W25QX_SIZE - addr < len) return E_CUSTOM_W25QX_OVERSTEP;
 
   errno_t err = ESUCCESS;
 
-  // 擦除将会写入的扇区
-  // 获取擦除起始地址对应的扇区 扇区数量 起始扇区地址
-  const uint16_t start_sector = addr / W25QX_SECTOR_SIZE;
-  uint16_t sector_count = (addr + len) / W25QX_SECTOR_SIZE - start_sector + 1;
-  uint32_t sector_addr = start_sector * W25QX_SECTOR_SIZE;
-  while (sector_count--) {
-    err = sector_erase(pd, sector_addr);
-    if (err) return err;
-    sector_addr += W25QX_SECTOR_SIZE;
-  }
+  while (len) {
+    const uint32_t sector_addr = addr - addr % W25QX_SECTOR_SIZE;
+    const uint16_t offset = addr - sector_addr;
+    const uint16_t cur_len = len > W25QX_SECTOR_SIZE - offset ? W25QX_SECTOR_SIZE - offset : len;
 
-  // 分页写入
-  // 获取第一页可以写入的字节数
-  const uint16_t first_page_remain = W25QX_PAGE_SIZE - (addr % W25QX_PAGE_SIZE);
-  uint16_t cur_len = 0;
-  if (len > first_page_remain) {
-    cur_len = first_page_remain;
-    len -= cur_len;
-  } else {
-    cur_len = len;
-    len = 0;
-  }
-  err = page_write(pd, addr, data, cur_len);
-  if (err) return err;
+    err = sector_write(pd, sector_addr, offset, data, cur_len);
+    if (err) return err;
 
-  while (len) {
     addr += cur_len;
     data += cur_len;
-    if (len > W25QX_PAGE_SIZE) {
-      cur_len = W25QX_PAGE_SIZE;
-      len -= W25QX_PAGE_SIZE;
-    } else {
-      cur_len = len;
-      len = 0;
-    }
-    err = page_write(pd, addr, data, cur_len);
-    if (err) return err;
+    len -= cur_len;
   }
 
   return ESUCCESS;
 }
 
-
 static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
   return ((Device_W25QX *)pd)->name == *((Device_W25QX_name *)name);
 }
@@ -187,13 +242,13 @@ static errno_t read_id(const Device_W25QX *const pd, uint32_t *id_ptr) {
 
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
   err = pd->spi->ops->transmit(pd->spi, &cmd, 1);
   if (err) goto reset_cs_tag;
   err = pd->spi->ops->receive(pd->spi, data, 3);
   if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   // 先返回的高位数据, 后返回的低位数据
@@ -202,47 +257,52 @@ static errno_t read_id(const Device_W25QX *const pd, uint32_t *id_ptr) {
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
 static errno_t power_down(const Device_W25QX *const pd) {
   if (pd == NULL) return EINVAL;
+  if (async_active(pd)) return EBUSY;
 
   uint8_t cmd = W25QX_CMD_POWER_DOWN;
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
   err = pd->spi->ops->transmit(pd->spi, &cmd, 1);
   if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
 static errno_t release_power_down(const Device_W25QX *const pd) {
   if (pd == NULL) return EINVAL;
+  if (async_active(pd)) return EBUSY;
 
   uint8_t cmd = W25QX_CMD_RELEASE_POWER_DOWN;
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
   err = pd->spi->ops->transmit(pd->spi, &cmd, 1);
   if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
+  if (err) return err;
+  // 退出掉电模式 3 微秒后才能接收其他命令
+  err = delay_us(3);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -252,17 +312,17 @@ static errno_t write_enable(const Device_W25QX *const pd) {
   uint8_t cmd = W25QX_CMD_WRITE_ENABLE;
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
   err = pd->spi->ops->transmit(pd->spi, &cmd, 1);
   if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
@@ -272,185 +332,541 @@ static errno_t write_disable(const Device_W25QX *const pd) {
   uint8_t cmd = W25QX_CMD_WRITE_DISABLE;
   errno_t err = ESUCCESS;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
   err = pd->spi->ops->transmit(pd->spi, &cmd, 1);
   if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  err = bus_deselect(pd);
   if (err) return err;
 
   return ESUCCESS;
 
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
+// 每次查询都是一次独立的短传输, 等待期间不一直占用总线
 static errno_t wait_write_complete(const Device_W25QX *const pd) {
   if (pd == NULL) return EINVAL;
 
-  uint8_t cmd = W25QX_CMD_READ_STATUS_REGISTER_1;
-  errno_t err = ESUCCESS;
-  uint8_t status = 0;
+  bool busy = true;
+  while (busy) {
+    errno_t err = read_busy(pd, &busy);
+    if (err) return err;
+  }
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
-  if (err) return err;
+  return ESUCCESS;
+}
 
-  err = pd->spi->ops->transmit(pd->spi, &cmd, 1);
-  if (err) goto reset_cs_tag;
+static errno_t sector_erase(const Device_W25QX *const pd, uint32_t addr) {
+  errno_t err = erase_command(pd, W25QX_CMD_SECTOR_ERASE, addr);
+  if (err) return err;
 
-  do {
-    err = pd->spi->ops->receive(pd->spi, &status, 1);
-    if (err) goto reset_cs_tag;
-  } while ((status & 0x01) == 1);
+  return wait_write_complete(pd);
+}
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+static errno_t page_write(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint16_t len) {
+  errno_t err = page_program(pd, addr, data, len);
   if (err) return err;
 
-  return ESUCCESS;
-
-  reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
-  return err;
+  return wait_write_complete(pd);
 }
 
-static errno_t sector_erase(const Device_W25QX *const pd, uint32_t addr) {
-  if (pd == NULL) return EINVAL;
-  // 必须为扇区的起始地址
-  if (addr % W25QX_SECTOR_SIZE != 0) return E_CUSTOM_W25QX_ADDR_ERROR;
+static errno_t page_program(const Device_W25QX *const pd, uint32_t addr, const uint8_t *data, uint16_t len) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  // 检查片写是否越界
+  if (addr % W25QX_PAGE_SIZE + len > W25QX_PAGE_SIZE) return E_CUSTOM_W25QX_OVERSTEP;
 
   errno_t err = ESUCCESS;
 
-  uint8_t data[4] = { W25QX_CMD_SECTOR_ERASE };
-  err = addr_to_bytes(addr, data + 1);
+  uint8_t cmd_addr[4] = {W25QX_CMD_PAGE_PROGRAM};
+  err = addr_to_bytes(addr, cmd_addr + 1);
   if (err) return err;
 
   err = write_enable(pd);
   if (err) return err;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
-  err = pd->spi->ops->transmit(pd->spi, data, 4);
+  err = pd->spi->ops->transmit(pd->spi, cmd_addr, 4);
   if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
-  if (err) return err;
-  err = wait_write_complete(pd);
+  err = pd->spi->ops->transmit(pd->spi, data, len);
+  if (err) goto reset_cs_tag;
+  err = bus_deselect(pd);
   if (err) return err;
 
+  return ESUCCESS;
+
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
-static errno_t block_erase_32k(const Device_W25QX *const pd, uint32_t addr) {
+/**
+ * @brief 发送擦除命令后立即返回, 不等待擦除完成
+ * @param pd 
+ * @param cmd 扇区/32K 块/64K 块/整片擦除
+ * @param addr 必须与擦除范围对齐, 整片擦除时忽略
+ * @return errno_t 
+ */
+static errno_t erase_command(const Device_W25QX *const pd, W25QX_cmd cmd, uint32_t addr) {
   if (pd == NULL) return EINVAL;
-  // 必须为 32k 空间的起始地址
-  if (addr % 0x8000 != 0) return E_CUSTOM_W25QX_ADDR_ERROR;
+
+  uint32_t align = W25QX_SECTOR_SIZE;
+  if (cmd == W25QX_CMD_BLOCK_ERASE_32K) align = W25QX_BLOCK_32K_SIZE;
+  else if (cmd == W25QX_CMD_BLOCK_ERASE_64K) align = W25QX_BLOCK_64K_SIZE;
+  else if (cmd == W25QX_CMD_CHIP_ERASE) align = W25QX_SIZE;
+  else if (cmd != W25QX_CMD_SECTOR_ERASE) return EINVAL;
+  if (addr % align != 0) return E_CUSTOM_W25QX_ADDR_ERROR;
 
   errno_t err = ESUCCESS;
 
-  uint8_t data[4] = { W25QX_CMD_BLOCK_ERASE_32K };
+  // 整片擦除只有命令, 没有地址
+  uint8_t data[4] = { cmd };
+  const uint8_t len = cmd == W25QX_CMD_CHIP_ERASE ? 1 : 4;
   err = addr_to_bytes(addr, data + 1);
   if (err) return err;
 
   err = write_enable(pd);
   if (err) return err;
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
-  err = pd->spi->ops->transmit(pd->spi, data, 4);
+  err = pd->spi->ops->transmit(pd->spi, data, len);
   if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
-  if (err) return err;
-  err = wait_write_complete(pd);
+  err = bus_deselect(pd);
   if (err) return err;
 
+  return ESUCCESS;
+
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
-static errno_t block_erase_64k(const Device_W25QX *const pd, uint32_t addr) {
-  if (pd == NULL) return EINVAL;
-  // 必须为 64k 空间的起始地址
-  if (addr % 0x10000 != 0) return E_CUSTOM_W25QX_ADDR_ERROR;
+/**
+ * @brief 擦除计划, 依次调用即可用最少的命令覆盖整个范围
+ * 起始地址对齐且剩余长度足够时优先用大块擦除, 范围为整片时用整片擦除
+ * 64K 块擦除典型 150 毫秒, 而 16 次扇区擦除典型 720 毫秒
+ * @param addr 当前地址, 扇区对齐
+ * @param end 结束地址, 扇区对齐
+ * @param rt_cmd_ptr 返回使用的命令
+ * @return uint32_t 本次擦除的字节数
+ */
+static uint32_t erase_plan(uint32_t addr, uint32_t end, W25QX_cmd *rt_cmd_ptr) {
+  const uint32_t remaining = end - addr;
+
+  if (addr == 0 && remaining == W25QX_SIZE) {
+    *rt_cmd_ptr = W25QX_CMD_CHIP_ERASE;
+    return W25QX_SIZE;
+  }
+  if (addr % W25QX_BLOCK_64K_SIZE == 0 && remaining >= W25QX_BLOCK_64K_SIZE) {
+    *rt_cmd_ptr = W25QX_CMD_BLOCK_ERASE_64K;
+    return W25QX_BLOCK_64K_SIZE;
+  }
+  if (addr % W25QX_BLOCK_32K_SIZE == 0 && remaining >= W25QX_BLOCK_32K_SIZE) {
+    *rt_cmd_ptr = W25QX_CMD_BLOCK_ERASE_32K;
+    return W25QX_BLOCK_32K_SIZE;
+  }
+  *rt_cmd_ptr = W25QX_CMD_SECTOR_ERASE;
+  return W25QX_SECTOR_SIZE;
+}
 
-  errno_t err = ESUCCESS;
+// 查询擦除/编程是否还在进行, 异步操作未完成时也返回忙
+static errno_t is_busy(const Device_W25QX *const pd, bool *rt_busy_ptr) {
+  if (pd == NULL || rt_busy_ptr == NULL) return EINVAL;
 
-  uint8_t data[4] = { W25QX_CMD_BLOCK_ERASE_64K };
-  err = addr_to_bytes(addr, data + 1);
-  if (err) return err;
+  if (async_active(pd)) {
+    *rt_busy_ptr = true;
+    return ESUCCESS;
+  }
 
-  err = write_enable(pd);
-  if (err) return err;
+  return read_busy(pd, rt_busy_ptr);
+}
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
-  if (err) return err;
-  err = pd->spi->ops->transmit(pd->spi, data, 4);
-  if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+static errno_t erase_async(const Device_W25QX *const pd, uint32_t addr, uint16_t sector_count, Device_W25QX_callback *callback, void *arg) {
+  if (pd == NULL || sector_count == 0) return EINVAL;
+  if (addr % W25QX_SECTOR_SIZE != 0) return E_CUSTOM_W25QX_ADDR_ERROR;
+  if (W25QX_SIZE - addr < sector_count * W25QX_SECTOR_SIZE) return E_CUSTOM_W25QX_OVERSTEP;
+  if (async_active(pd)) return EBUSY;
+
+  errno_t err = timebase_init();
   if (err) return err;
-  err = wait_write_complete(pd);
+
+  const uint32_t end = addr + sector_count * W25QX_SECTOR_SIZE;
+  if (cache_addrs[pd->name] >= addr && cache_addrs[pd->name] < end) cache_valids[pd->name] = false;
+
+  Async_state *const ps = &async_states[pd->name];
+  ps->addr = addr;
+  ps->end = end;
+  ps->data = NULL;
+  ps->callback = callback;
+  ps->arg = arg;
+  ps->type = ASYNC_ERASE;
+
+  return async_start(pd);
+}
+
+static errno_t program_async(const Device_W25QX *const pd, uint32_t addr, const uint8_t *data, uint32_t len, Device_W25QX_callback *callback, void *arg) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  if (W25QX_SIZE - addr < len) return E_CUSTOM_W25QX_OVERSTEP;
+  if (async_active(pd)) return EBUSY;
+
+  errno_t err = timebase_init();
   if (err) return err;
 
-  reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  // 编程范围与缓存的扇区重叠时缓存失效
+  const uint32_t cache_addr = cache_addrs[pd->name];
+  if (addr < cache_addr + W25QX_SECTOR_SIZE && addr + len > cache_addr) cache_valids[pd->name] = false;
+
+  Async_state *const ps = &async_states[pd->name];
+  ps->addr = addr;
+  ps->end = addr + len;
+  ps->data = data;
+  ps->callback = callback;
+  ps->arg = arg;
+  ps->type = ASYNC_PROGRAM;
+
+  return async_start(pd);
+}
+
+/**
+ * @brief 异步读取, 一次排队传输完成
+ * 读取通常是大块数据(如图片), 使用低优先级, 与屏幕写入按提交顺序执行
+ * @param pd 
+ * @param addr 
+ * @param data 
+ * @param len 
+ * @param callback 
+ * @param arg 
+ * @return errno_t 
+ */
+static errno_t read_async(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len, Device_W25QX_callback *callback, void *arg) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  if (W25QX_SIZE - addr < len) return E_CUSTOM_W25QX_OVERSTEP;
+  if (async_active(pd)) return EBUSY;
+
+  uint8_t *const command = command_bytes[pd->name];
+  Device_SPI_transfer *const pt = &command_transfers[pd->name];
+  Async_state *const ps = &async_states[pd->name];
+
+  // 扇区缓存与 flash 内容一致, 直接从 flash 读取
+  memset(pt, 0, sizeof(Device_SPI_transfer));
+  command[0] = W25QX_CMD_READ_DATA;
+  pt->cmd_len = 4;
+  if (pd->read_mode == DEVICE_W25QX_READ_FAST) {
+    command[0] = W25QX_CMD_FAST_READ;
+    command[4] = 0;
+    pt->cmd_len = 5;
+  }
+  addr_to_bytes(addr, command + 1);
+  pt->cs = pd->cs;
+  pt->mode = W25QX_SPI_MODE;
+  pt->divider = W25QX_SPI_DIVIDER;
+  pt->cmd = command;
+  pt->rx = data;
+  pt->rx_len = len;
+  pt->priority = DEVICE_SPI_PRIORITY_LOW;
+  pt->callback = async_read_done;
+  pt->arg = (void *)pd;
+
+  ps->addr = addr + len;
+  ps->end = addr + len;
+  ps->data = NULL;
+  ps->callback = callback;
+  ps->arg = arg;
+  ps->type = ASYNC_READ;
+
+  errno_t err = pd->spi->ops->submit(pd->spi, pt);
+  if (err) ps->type = ASYNC_IDLE;
+
   return err;
 }
 
-static errno_t chip_erase(const Device_W25QX *const pd) {
-  if (pd == NULL) return EINVAL;
+static inline bool async_active(const Device_W25QX *const pd) {
+  return async_states[pd->name].type != ASYNC_IDLE;
+}
+
+/**
+ * @brief 准备排队传输并提交第一条命令, 失败时结束异步操作
+ * 之后的流程都在中断中进行: 命令传输结束 -> 定时器到期 -> 读状态传输结束 -> 仍忙则等待下个周期, 否则提交下一条命令或结束
+ * flash 的传输使用高优先级, 屏幕刷新等大块传输之间插队执行
+ * @param pd 
+ * @return errno_t 
+ */
+static errno_t async_start(const Device_W25QX *const pd) {
+  Device_SPI_transfer *const transfers[] = {&enable_transfers[pd->name], &command_transfers[pd->name], &status_transfers[pd->name]};
+  Device_SPI_transfer_callback *const callbacks[] = {async_enable_done, async_command_done, async_status_done};
+
+  for (uint8_t i = 0; i < 3; ++i) {
+    Device_SPI_transfer *const pt = transfers[i];
+    memset(pt, 0, sizeof(Device_SPI_transfer));
+    pt->cs = pd->cs;
+    pt->mode = W25QX_SPI_MODE;
+    pt->divider = W25QX_SPI_DIVIDER;
+    pt->priority = DEVICE_SPI_PRIORITY_HIGH;
+    pt->callback = callbacks[i];
+    pt->arg = (void *)pd;
+  }
+  enable_transfers[pd->name].cmd = &enable_cmd;
+  enable_transfers[pd->name].cmd_len = 1;
+  status_transfers[pd->name].cmd = &status_cmd;
+  status_transfers[pd->name].cmd_len = 1;
+  status_transfers[pd->name].rx = &status_values[pd->name];
+  status_transfers[pd->name].rx_len = 1;
 
+  errno_t err = async_submit_next(pd);
+  if (err) async_states[pd->name].type = ASYNC_IDLE;
+
+  return err;
+}
+
+// 提交写使能和下一条擦除或编程命令, 擦除按擦除计划选择块大小, 编程时每次最多写到页末尾
+static errno_t async_submit_next(const Device_W25QX *const pd) {
+  Async_state *const ps = &async_states[pd->name];
+  Device_SPI_transfer *const pt = &command_transfers[pd->name];
+  uint8_t *const command = command_bytes[pd->name];
   errno_t err = ESUCCESS;
-  uint8_t cmd = W25QX_CMD_CHIP_ERASE;
 
-  err = write_enable(pd);
+  err = addr_to_bytes(ps->addr, command + 1);
+  if (err) return err;
+  pt->cmd = command;
+  pt->cmd_len = 4;
+
+  if (ps->type == ASYNC_ERASE) {
+    W25QX_cmd cmd = W25QX_CMD_SECTOR_ERASE;
+    const uint32_t size = erase_plan(ps->addr, ps->end, &cmd);
+    command[0] = cmd;
+    // 整片擦除只有命令, 没有地址
+    if (cmd == W25QX_CMD_CHIP_ERASE) pt->cmd_len = 1;
+    pt->tx_len = 0;
+    ps->addr += size;
+  } else {
+    uint32_t len = W25QX_PAGE_SIZE - ps->addr % W25QX_PAGE_SIZE;
+    if (len > ps->end - ps->addr) len = ps->end - ps->addr;
+    command[0] = W25QX_CMD_PAGE_PROGRAM;
+    pt->tx = ps->data;
+    pt->tx_len = len;
+    ps->addr += len;
+    ps->data += len;
+  }
+
+  ps->enable_err = ESUCCESS;
+  err = pd->spi->ops->submit(pd->spi, &enable_transfers[pd->name]);
   if (err) return err;
+  return pd->spi->ops->submit(pd->spi, pt);
+}
+
+// 查询定时器到期(SysTick 中断), 提交读状态寄存器的传输
+static void async_poll(void *arg) {
+  const Device_W25QX *const pd = arg;
+  errno_t err = pd->spi->ops->submit(pd->spi, &status_transfers[pd->name]);
+  if (err) async_finish(pd, err);
+}
+
+static void async_enable_done(Device_SPI_transfer *pt, errno_t err) {
+  const Device_W25QX *const pd = pt->arg;
+  async_states[pd->name].enable_err = err;
+}
 
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+// 命令已发出, 等待一个查询周期后读状态
+static void async_command_done(Device_SPI_transfer *pt, errno_t err) {
+  const Device_W25QX *const pd = pt->arg;
+  Async_state *const ps = &async_states[pd->name];
+
+  if (err == ESUCCESS) err = ps->enable_err;
+  if (err) {
+    async_finish(pd, err);
+    return;
+  }
+
+  const uint32_t poll_ms = ps->type == ASYNC_ERASE ? ASYNC_ERASE_POLL_MS : ASYNC_PROGRAM_POLL_MS;
+  err = timebase_timer_start(&async_timers[pd->name], poll_ms, 0, async_poll, pt->arg);
+  if (err) async_finish(pd, err);
+}
+
+static void async_status_done(Device_SPI_transfer *pt, errno_t err) {
+  const Device_W25QX *const pd = pt->arg;
+  Async_state *const ps = &async_states[pd->name];
+
+  if (err) {
+    async_finish(pd, err);
+    return;
+  }
+
+  // 仍在擦除/编程
+  if (status_values[pd->name] & 0x01) {
+    const uint32_t poll_ms = ps->type == ASYNC_ERASE ? ASYNC_ERASE_POLL_MS : ASYNC_PROGRAM_POLL_MS;
+    err = timebase_timer_start(&async_timers[pd->name], poll_ms, 0, async_poll, pt->arg);
+    if (err) async_finish(pd, err);
+    return;
+  }
+
+  if (ps->addr == ps->end) {
+    async_finish(pd, ESUCCESS);
+    return;
+  }
+
+  err = async_submit_next(pd);
+  if (err) async_finish(pd, err);
+}
+
+static void async_read_done(Device_SPI_transfer *pt, errno_t err) {
+  async_finish(pt->arg, err);
+}
+
+// 先结束再回调, 回调中可以开始下一次异步操作
+static void async_finish(const Device_W25QX *const pd, errno_t err) {
+  Async_state *const ps = &async_states[pd->name];
+  Device_W25QX_callback *const callback = ps->callback;
+  void *const callback_arg = ps->arg;
+
+  ps->type = ASYNC_IDLE;
+  if (callback != NULL) callback(callback_arg, err);
+}
+
+static errno_t read_busy(const Device_W25QX *const pd, bool *rt_busy_ptr) {
+  uint8_t cmd = W25QX_CMD_READ_STATUS_REGISTER_1;
+  uint8_t status = 0;
+  errno_t err = ESUCCESS;
+
+  err = bus_select(pd);
   if (err) return err;
   err = pd->spi->ops->transmit(pd->spi, &cmd, 1);
   if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
-  if (err) return err;
-  err = wait_write_complete(pd);
+  err = pd->spi->ops->receive(pd->spi, &status, 1);
+  if (err) goto reset_cs_tag;
+  err = bus_deselect(pd);
   if (err) return err;
 
+  *rt_busy_ptr = status & 0x01;
+  return ESUCCESS;
+
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
-static errno_t page_write(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint16_t len) {
-  if (pd == NULL || data == NULL || len == 0) return EINVAL;
-  // 检查片写是否越界
-  if (addr % 0x100 + len > 0x100) return E_CUSTOM_W25QX_OVERSTEP;
-
+/**
+ * @brief 连续读取任意长度, 只发送一次命令
+ * 长度超过一次 DMA 的上限时由 SPI 设备在中断中接着传输, 期间片选保持低电平, flash 地址自动递增
+ * @param pd 
+ * @param addr 
+ * @param data 
+ * @param len 
+ * @return errno_t 
+ */
+static errno_t read_data(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len) {
   errno_t err = ESUCCESS;
 
-  uint8_t cmd_addr[4] = {W25QX_CMD_PAGE_PROGRAM};
+  // 快速读取在地址后多发送一个空字节
+  uint8_t cmd_addr[5] = {W25QX_CMD_READ_DATA};
+  uint8_t cmd_len = 4;
+  if (pd->read_mode == DEVICE_W25QX_READ_FAST) {
+    cmd_addr[0] = W25QX_CMD_FAST_READ;
+    cmd_len = 5;
+  }
   err = addr_to_bytes(addr, cmd_addr + 1);
   if (err) return err;
 
-  err = write_enable(pd);
-  if (err) return err;
-
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  err = bus_select(pd);
   if (err) return err;
-  err = pd->spi->ops->transmit(pd->spi, cmd_addr, 4);
+  err = pd->spi->ops->transmit(pd->spi, cmd_addr, cmd_len);
   if (err) goto reset_cs_tag;
-  err = pd->spi->ops->transmit(pd->spi, data, len);
+  err = pd->spi->ops->receive(pd->spi, data, len);
   if (err) goto reset_cs_tag;
-  err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
-  if (err) return err;
-  err = wait_write_complete(pd);
+  err = bus_deselect(pd);
   if (err) return err;
 
+  return ESUCCESS;
+
   reset_cs_tag:
-  pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  bus_deselect(pd);
   return err;
 }
 
+static errno_t sector_write(const Device_W25QX *const pd, uint32_t sector_addr, uint16_t offset, const uint8_t *data, uint16_t len) {
+  errno_t err = ESUCCESS;
+  uint8_t *const cache = sector_caches[pd->name];
+
+  if (cache_valids[pd->name] == false || cache_addrs[pd->name] != sector_addr) {
+    cache_valids[pd->name] = false;
+    err = read_data(pd, sector_addr, cache, W25QX_SECTOR_SIZE);
+    if (err) return err;
+    cache_addrs[pd->name] = sector_addr;
+    cache_valids[pd->name] = true;
+  }
+
+  // 编程只能把 1 写成 0, 有 0 变 1 的位时才需要擦除
+  bool changed = false, need_erase = false;
+  for (uint16_t i = 0; i < len; ++i) {
+    const uint8_t old_value = cache[offset + i];
+    if (old_value != data[i]) changed = true;
+    if ((old_value & data[i]) != data[i]) {
+      need_erase = true;
+      break;
+    }
+  }
+  if (changed == false) return ESUCCESS;
+
+  if (need_erase) {
+    memcpy(cache + offset, data, len);
+    // 擦除或编程失败时 flash 内容与缓存不一致
+    cache_valids[pd->name] = false;
+
+    err = sector_erase(pd, sector_addr);
+    if (err) return err;
+
+    // 擦除后全为 0xFF, 跳过全 0xFF 的页
+    for (uint16_t page = 0; page < W25QX_SECTOR_SIZE; page += W25QX_PAGE_SIZE) {
+      bool blank = true;
+      for (uint16_t i = 0; i < W25QX_PAGE_SIZE; ++i) {
+        if (cache[page + i] != 0xFF) {
+          blank = false;
+          break;
+        }
+      }
+      if (blank) continue;
+
+      err = page_write(pd, sector_addr + page, cache + page, W25QX_PAGE_SIZE);
+      if (err) return err;
+    }
+
+    cache_valids[pd->name] = true;
+    return ESUCCESS;
+  }
+
+  // 不需要擦除, 每页只编程第一个到最后一个有变化的字节
+  const uint16_t end = offset + len;
+  uint16_t page_start = offset;
+  while (page_start < end) {
+    uint16_t page_end = page_start - page_start % W25QX_PAGE_SIZE + W25QX_PAGE_SIZE;
+    if (page_end > end) page_end = end;
+
+    uint16_t first = page_end, last = page_start;
+    for (uint16_t i = page_start; i < page_end; ++i) {
+      if (cache[i] != data[i - offset]) {
+        if (first == page_end) first = i;
+        last = i;
+      }
+    }
+
+    if (first != page_end) {
+      memcpy(cache + first, data + (first - offset), last - first + 1);
+      err = page_write(pd, sector_addr + first, cache + first, last - first + 1);
+      if (err) {
+        cache_valids[pd->name] = false;
+        return err;
+      }
+    }
+
+    page_start = page_end;
+  }
+
+  return ESUCCESS;
+}
+
 static errno_t addr_to_bytes(uint32_t addr, uint8_t *bytes) {
   if (bytes == NULL) return EINVAL;
   bytes[0] = (addr & 0xFF0000) >> 16;
@@ -458,3 +874,20 @@ static errno_t addr_to_bytes(uint32_t addr, uint8_t *bytes) {
   bytes[2] = (addr & 0x0000FF);
   return ESUCCESS;
 }
+
+// 占用总线并拉低片选
+static errno_t bus_select(const Device_W25QX *const pd) {
+  errno_t err = pd->spi->ops->lock(pd->spi);
+  if (err) return err;
+  err = pd->spi->ops->configure(pd->spi, W25QX_SPI_MODE, W25QX_SPI_DIVIDER);
+  if (err == ESUCCESS) err = pd->cs->ops->write(pd->cs, PIN_VALUE_0);
+  if (err) pd->spi->ops->unlock(pd->spi);
+  return err;
+}
+
+// 拉高片选并释放总线
+static errno_t bus_deselect(const Device_W25QX *const pd) {
+  errno_t err = pd->cs->ops->write(pd->cs, PIN_VALUE_1);
+  pd->spi->ops->unlock(pd->spi);
+  return err;
+}
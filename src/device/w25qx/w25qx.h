@@ -4,12 +4,27 @@
 #include "device/gpio/gpio.h"
 #include "device/spi/spi.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef enum {
   DEVICE_W25Q64,
   DEVICE_W25QX_COUNT,
 } Device_W25QX_name;
 
+/**
+ * 读取命令, 按 SPI 时钟选择
+ * NORMAL 为 0x03 命令, 时钟不能超过 50MHz
+ * FAST 为 0x0B 命令, 地址后多一个空字节, 时钟可以到 104MHz 以上
+ * 双线/四线输出需要 flash 的 IO1~IO3 接到能同时收多根数据线的外设(QSPI), SPI1 只有一根 MISO, 不支持
+ */
+typedef enum {
+  DEVICE_W25QX_READ_NORMAL,
+  DEVICE_W25QX_READ_FAST,
+} Device_W25QX_read_mode;
+
+// 异步操作完成回调, 在 SPI 或 SysTick 中断中执行, err 为操作结果
+typedef void Device_W25QX_callback(void *arg, errno_t err);
+
 struct Device_W25QX;
 struct Device_W25QX_ops;
 
@@ -17,6 +32,7 @@ typedef struct Device_W25QX {
   const Device_W25QX_name name;
   Device_GPIO *cs;
   Device_SPI *spi;
+  const Device_W25QX_read_mode read_mode;
   const struct Device_W25QX_ops *ops;
 } Device_W25QX;
 
@@ -24,7 +40,22 @@ typedef struct Device_W25QX_ops {
   errno_t (*init)(const Device_W25QX *const pd);
   errno_t (*erase)(const Device_W25QX *const pd, uint32_t addr, uint16_t sector_count);
   errno_t (*read)(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len);
+  // 只改写 [addr, addr + len) 范围内的数据, 不需要事先擦除
   errno_t (*write)(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len);
+  // 进入掉电模式, 之后只响应 release_power_down 命令
+  errno_t (*power_down)(const Device_W25QX *const pd);
+  errno_t (*release_power_down)(const Device_W25QX *const pd);
+  // 查询 flash 是否正在擦除/编程, 异步操作未完成时也返回忙
+  errno_t (*is_busy)(const Device_W25QX *const pd, bool *rt_busy_ptr);
+  /**
+   * 异步擦除/编程, 把第一条命令提交到 SPI 高优先级队列后立即返回, 之后由软件定时器提交读状态传输并发出后续命令, 全部完成后调用 callback
+   * 两次查询之间总线空闲, 共用 SPI 的屏幕可以正常刷新; 完成前其他操作返回 EBUSY, is_busy 返回忙
+   * program_async 不擦除, 目标范围需要事先擦除, data 在回调之前必须保持有效
+   */
+  errno_t (*erase_async)(const Device_W25QX *const pd, uint32_t addr, uint16_t sector_count, Device_W25QX_callback *callback, void *arg);
+  errno_t (*program_async)(const Device_W25QX *const pd, uint32_t addr, const uint8_t *data, uint32_t len, Device_W25QX_callback *callback, void *arg);
+  // 异步读取, 提交到 SPI 低优先级队列后立即返回, 读完后调用 callback, 回调中可以提交下一次读取
+  errno_t (*read_async)(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len, Device_W25QX_callback *callback, void *arg);
 } Device_W25QX_ops;
 
 // 全局方法
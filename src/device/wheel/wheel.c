@@ -0,0 +1,213 @@
+#include "wheel.h"
+#include "common/list/list.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// 对象方法
+static errno_t init(Device_wheel *const pd);
+static errno_t set_target(Device_wheel *const pd, int32_t target_rpm);
+static errno_t get_target(Device_wheel *const pd, int32_t *rt_target_rpm_ptr);
+static errno_t get_rpm(Device_wheel *const pd, int32_t *rt_rpm_ptr);
+static errno_t stop(Device_wheel *const pd);
+
+// 内部方法 - 查找设备
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd);
+
+static const Device_wheel_ops device_ops = {
+  .init = init,
+  .set_target = set_target,
+  .get_target = get_target,
+  .get_rpm = get_rpm,
+  .stop = stop,
+};
+
+static List *list = NULL;
+
+static Pid pids[DEVICE_WHEEL_COUNT] = {0};
+static Trajectory profiles[DEVICE_WHEEL_COUNT] = {0};
+static volatile int32_t targets[DEVICE_WHEEL_COUNT] = {0};
+// 当前的设定值, 即运动曲线的输出
+static volatile int32_t setpoints[DEVICE_WHEEL_COUNT] = {0};
+static volatile int32_t measures[DEVICE_WHEEL_COUNT] = {0};
+// 上一个控制周期的输出, 测量值不可信时沿用
+static volatile int16_t outputs[DEVICE_WHEEL_COUNT] = {0};
+static volatile bool running[DEVICE_WHEEL_COUNT] = {0};
+
+errno_t Device_wheel_module_init(void) {
+  if (list == NULL) {
+    errno_t err = list_create(&list);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+errno_t Device_wheel_register(Device_wheel *const pd) {
+  if (pd == NULL || list == NULL) return EINVAL;
+  pd->ops = &device_ops;
+  list->ops->head_insert(list, pd);
+  return ESUCCESS;
+}
+
+errno_t Device_wheel_find(Device_wheel **pd_ptr, const Device_wheel_name name) {
+  if (list == NULL) return EINVAL;
+
+  errno_t err = list->ops->find(list, pd_ptr, &name, match_device_by_name);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 执行一次速度闭环, 需在固定周期的定时器中断中调用
+ * 测速模块只有单路信号, 无法区分转向, 测量转速的方向取自电机当前的转向
+ * 测速的中断线被借出时测量值不可信, 这期间不更新控制器, 保持上一个周期的输出
+ * @param pd 
+ * @param rt_speed_ptr 返回电机速度, 由调用方和其他车轮一起写入电机组, 使所有车轮在同一个 PWM 周期更新
+ * @return errno_t 
+ */
+errno_t Device_wheel_control_callback(Device_wheel *const pd, int16_t *rt_speed_ptr) {
+  if (pd == NULL || rt_speed_ptr == NULL) return EINVAL;
+
+  *rt_speed_ptr = 0;
+  if (!running[pd->name]) return ESUCCESS;
+
+  errno_t err = ESUCCESS;
+
+  const int32_t last_setpoint = setpoints[pd->name];
+  const int32_t setpoint = trajectory_step(&profiles[pd->name]);
+  setpoints[pd->name] = setpoint;
+
+  // 减速到 0 后停止
+  if (setpoint == 0 && trajectory_done(&profiles[pd->name])) {
+    running[pd->name] = false;
+    measures[pd->name] = 0;
+    outputs[pd->name] = 0;
+    pid_reset(&pids[pd->name]);
+    return ESUCCESS;
+  }
+
+  // 设定值换向时复位控制器, 避免积分项沿旧方向继续输出
+  if ((last_setpoint > 0 && setpoint < 0) || (last_setpoint < 0 && setpoint > 0)) {
+    pid_reset(&pids[pd->name]);
+  }
+
+  // 测量值不可信时沿用上一个周期的输出, 不更新控制器, 积分项也不会累加
+  bool stale = false;
+  err = pd->speed_test->ops->is_stale(pd->speed_test, &stale);
+  if (err) return err;
+  if (stale) {
+    *rt_speed_ptr = outputs[pd->name];
+    return ESUCCESS;
+  }
+
+  uint32_t rpm = 0;
+  err = pd->speed_test->ops->get_rpm(pd->speed_test, &rpm);
+  if (err) return err;
+
+  int32_t measure = (int32_t)rpm;
+  if (pd->motor->status == DEVICE_MOTOR_STATUS_BACKWARD) measure = -measure;
+  measures[pd->name] = measure;
+
+  // 电源管理限制占空比时按实际的上限饱和, 条件积分才能在上限处停止累加, 负载减小后不会超调
+  speed_t duty_limit = 0;
+  err = Device_motor_get_duty_limit(&duty_limit);
+  if (err) return err;
+  err = pid_set_output_limit(&pids[pd->name], -(int32_t)duty_limit, duty_limit);
+  if (err) return err;
+
+  int32_t output = 0;
+  err = pid_update(&pids[pd->name], setpoint, measure, &output);
+  if (err) return err;
+
+  outputs[pd->name] = (int16_t)output;
+  *rt_speed_ptr = (int16_t)output;
+
+  return ESUCCESS;
+}
+
+static errno_t init(Device_wheel *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  errno_t err = ESUCCESS;
+
+  err = pid_init(&pids[pd->name], &pd->pid_param);
+  if (err) return err;
+  err = trajectory_init(&profiles[pd->name], &pd->profile_param, 0);
+  if (err) return err;
+
+  err = pd->motor->ops->init(pd->motor);
+  if (err) return err;
+  err = pd->speed_test->ops->init(pd->speed_test);
+  if (err) return err;
+
+  running[pd->name] = false;
+  targets[pd->name] = 0;
+  setpoints[pd->name] = 0;
+  measures[pd->name] = 0;
+  outputs[pd->name] = 0;
+
+  // 控制周期定时器所有车轮共用, 未运行时才配置并启动
+  bool timer_running = false;
+  err = pd->timer->ops->is_running(pd->timer, &timer_running);
+  if (err) return err;
+  if (timer_running == false) {
+    err = pd->timer->ops->set_period_elapsed_callback(pd->timer, pd->control_callback);
+    if (err) return err;
+    err = pd->timer->ops->set_period(pd->timer, DEVICE_WHEEL_CONTROL_PERIOD_US);
+    if (err) return err;
+    err = pd->timer->ops->start(pd->timer, DEVICE_TIMER_START_MODE_IT);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t set_target(Device_wheel *const pd, int32_t target_rpm) {
+  if (pd == NULL) return EINVAL;
+
+  targets[pd->name] = target_rpm;
+  trajectory_set_target(&profiles[pd->name], target_rpm);
+  if (target_rpm != 0) running[pd->name] = true;
+
+  return ESUCCESS;
+}
+
+static errno_t get_target(Device_wheel *const pd, int32_t *rt_target_rpm_ptr) {
+  if (pd == NULL || rt_target_rpm_ptr == NULL) return EINVAL;
+
+  *rt_target_rpm_ptr = targets[pd->name];
+
+  return ESUCCESS;
+}
+
+static errno_t get_rpm(Device_wheel *const pd, int32_t *rt_rpm_ptr) {
+  if (pd == NULL || rt_rpm_ptr == NULL) return EINVAL;
+
+  *rt_rpm_ptr = measures[pd->name];
+
+  return ESUCCESS;
+}
+
+static errno_t stop(Device_wheel *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  // 先停止闭环, 再停止电机, 防止中断中重新驱动
+  running[pd->name] = false;
+  targets[pd->name] = 0;
+  setpoints[pd->name] = 0;
+  measures[pd->name] = 0;
+  outputs[pd->name] = 0;
+  pid_reset(&pids[pd->name]);
+  trajectory_reset(&profiles[pd->name], 0);
+
+  errno_t err = pd->motor->ops->stop(pd->motor);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+static inline uint8_t match_device_by_name(const void *const name, const void *const pd) {
+  return ((Device_wheel *)pd)->name == *((Device_wheel_name *)name);
+}
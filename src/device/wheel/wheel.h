@@ -0,0 +1,60 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "common/pid/pid.h"
+#include "common/trajectory/trajectory.h"
+#include "device/motor/motor.h"
+#include "device/speed_test/speed_test.h"
+#include "device/timer/timer.h"
+#include <stdint.h>
+
+// 速度闭环控制周期, 单位为微秒, PID 参数中的积分/微分增益按此周期整定
+#define DEVICE_WHEEL_CONTROL_PERIOD_US 1000
+
+typedef enum {
+  DEVICE_WHEEL_HEAD_LEFT,
+  DEVICE_WHEEL_HEAD_RIGHT,
+  DEVICE_WHEEL_TAIL_LEFT,
+  DEVICE_WHEEL_TAIL_RIGHT,
+  DEVICE_WHEEL_COUNT,
+} Device_wheel_name;
+
+struct Device_wheel;
+struct Device_wheel_ops;
+
+/**
+ * @brief 车轮速度闭环
+ * 由电机和测速模块组成, 目标转速和测量转速单位均为 0.01 转/分, 正数为前进, 负数为后退
+ * 控制器输出为电机速度 -0xFF ~ 0xFF, 由调用方通过电机组统一写入
+ * 目标转速经过运动曲线平滑后作为控制器的设定值, 运动曲线的位置即转速, 速度即角加速度
+ */
+typedef struct Device_wheel {
+  const Device_wheel_name name;
+  const Pid_param pid_param;
+  const Trajectory_param profile_param;
+  Device_motor *motor;
+  Device_speed_test *speed_test;
+  // 控制周期定时器, 所有车轮共用
+  Device_timer *timer;
+  Device_timer_callback *control_callback;
+  const struct Device_wheel_ops *ops;
+} Device_wheel;
+
+typedef struct Device_wheel_ops {
+  errno_t (*init)(Device_wheel *const pd);
+  // 设置目标转速, 按加速度限制平滑过渡, 减速到 0 后停止电机
+  errno_t (*set_target)(Device_wheel *const pd, int32_t target_rpm);
+  errno_t (*get_target)(Device_wheel *const pd, int32_t *rt_target_rpm_ptr);
+  // 最近一次控制周期中测得的带方向转速
+  errno_t (*get_rpm)(Device_wheel *const pd, int32_t *rt_rpm_ptr);
+  // 立即停止电机, 不经过减速过程
+  errno_t (*stop)(Device_wheel *const pd);
+} Device_wheel_ops;
+
+// 全局方法
+errno_t Device_wheel_module_init(void);
+errno_t Device_wheel_register(Device_wheel *const pd);
+errno_t Device_wheel_find(Device_wheel **pd_ptr, const Device_wheel_name name);
+
+// 控制周期定时器中断中调用, 执行一次速度闭环, 返回电机速度, 未运行时为 0
+errno_t Device_wheel_control_callback(Device_wheel *const pd, int16_t *rt_speed_ptr);
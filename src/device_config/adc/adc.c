@@ -2,19 +2,24 @@
 #include "stm32f4xx_hal.h"
 #include "driver/adc/adc.h"
 #include "Core/Inc/adc.h"
+#include "Core/Inc/tim.h"
 
+// TIM5 以 10kHz 触发扫描, 每次转换约 23 微秒, 两个通道一轮约 47 微秒, 不会跟不上触发
+// 每半个 DMA 缓冲区(32 次过采样)约 3.2 毫秒
 static Device_ADC devices[DEVICE_ADC_COUNT] = {
   [DEVICE_ADC_POWER] = {
     .name = DEVICE_ADC_POWER,
     .instance = &hadc1,
+    .trigger = &htim5,
     .channel = DEVICE_ADC_CHANNEL_10,
-    .sampling_time = DEVICE_ADC_SAMPLING_TIME_144_CYCLES,
+    .sampling_time = DEVICE_ADC_SAMPLING_TIME_480_CYCLES,
   },
   [DEVICE_ADC_LIGHT] = {
     .name = DEVICE_ADC_LIGHT,
     .instance = &hadc1,
+    .trigger = &htim5,
     .channel = DEVICE_ADC_CHANNEL_11,
-    .sampling_time = DEVICE_ADC_SAMPLING_TIME_144_CYCLES,
+    .sampling_time = DEVICE_ADC_SAMPLING_TIME_480_CYCLES,
   },
 };
 
@@ -29,3 +34,15 @@ errno_t Device_config_ADC_register(void) {
 
   return ESUCCESS;
 }
+
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc) {
+  Device_ADC_scan_callback(hadc, true);
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc) {
+  Device_ADC_scan_callback(hadc, false);
+}
+
+void HAL_ADC_ErrorCallback(ADC_HandleTypeDef *hadc) {
+  Device_ADC_error_callback(hadc);
+}
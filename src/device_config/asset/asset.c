@@ -0,0 +1,37 @@
+#include "asset.h"
+#include "device/w25qx/w25qx.h"
+#include "device/st7789v2/st7789v2.h"
+#include <stdlib.h>
+
+// 使用 flash 开头的 6MB, 之后是记录器和键值存储
+static Device_asset devices[DEVICE_ASSET_COUNT] = {
+  [DEVICE_ASSET_1] = {
+    .name = DEVICE_ASSET_1,
+    .base_addr = 0x000000,
+    .region_size = 0x600000,
+  },
+};
+// 关联的 flash 和屏幕
+static const Device_W25QX_name relate_flash[DEVICE_ASSET_COUNT] = {
+  [DEVICE_ASSET_1] = DEVICE_W25Q64,
+};
+static const Device_ST7789V2_name relate_display[DEVICE_ASSET_COUNT] = {
+  [DEVICE_ASSET_1] = DEVICE_ST7789V2_1,
+};
+
+errno_t Device_config_asset_register(void) {
+  errno_t err = Device_asset_module_init();
+  if (err) return err;
+
+  for (Device_asset_name name = 0; name < DEVICE_ASSET_COUNT; ++name) {
+    err = Device_W25QX_find(&devices[name].flash, relate_flash[name]);
+    if (err) return err;
+    err = Device_ST7789V2_find(&devices[name].display, relate_display[name]);
+    if (err) return err;
+
+    err = Device_asset_register(&devices[name]);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/asset/asset.h"
+
+errno_t Device_config_asset_register(void);
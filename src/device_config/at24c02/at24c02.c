@@ -1,6 +1,7 @@
 #include "at24c02.h"
 #include "device/gpio/gpio.h"
 #include "device/i2c/i2c.h"
+#include "device/kv/kv.h"
 #include <stdlib.h>
 
 static Device_AT24C02 devices[DEVICE_AT24C02_COUNT] = {
@@ -10,12 +11,17 @@ static Device_AT24C02 devices[DEVICE_AT24C02_COUNT] = {
     .size = 0x100,
     .page_size = 0x08,
     .page_count = 0x20,
+    .page_writes_key = 0x0100,
   },
 };
 // 关联的 I2c
 static const Device_I2C_name relate_i2c[DEVICE_AT24C02_COUNT] = {
   [DEVICE_AT24C02_1] = DEVICE_I2C_1,
 };
+// 保存写回次数的 kv
+static const Device_KV_name relate_kv[DEVICE_AT24C02_COUNT] = {
+  [DEVICE_AT24C02_1] = DEVICE_KV_SETTINGS,
+};
 
 errno_t Device_config_AT24C02_register(void) {
   errno_t err = Device_AT24C02_module_init();
@@ -26,6 +32,9 @@ errno_t Device_config_AT24C02_register(void) {
     err = Device_I2C_find(&devices[name].i2c, relate_i2c[name]);
     if (err) return err;
 
+    // 没有注册 kv 的程序只统计本次上电的写回次数
+    if (Device_KV_find(&devices[name].kv, relate_kv[name]) != ESUCCESS) devices[name].kv = NULL;
+
     err = Device_AT24C02_register(&devices[name]);
     if (err) return err;
   }
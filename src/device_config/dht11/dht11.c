@@ -1,8 +1,11 @@
 #include "dht11.h"
 #include "device/gpio/gpio.h"
-#include "device/timer/timer.h"
+#include "device/speed_test/speed_test.h"
 #include <stdlib.h>
 
+static void in_callback(void);
+static void borrow_callback(bool borrowed);
+
 static Device_DHT11 devices[DEVICE_DHT11_COUNT] = {
   [DEVICE_DHT11_1] = {
     .name = DEVICE_DHT11_1,
@@ -12,9 +15,13 @@ static Device_DHT11 devices[DEVICE_DHT11_COUNT] = {
 static const Device_GPIO_name relate_in[DEVICE_DHT11_COUNT] = {
   [DEVICE_DHT11_1] = DEVICE_DHT11_IN,
 };
-// 关联计时器
-static const Device_timer_name relate_timer[DEVICE_DHT11_COUNT] = {
-  [DEVICE_DHT11_1] = DEVICE_TIMER_TIM10,
+// 关联中断线回调函数
+static void (*const relate_callbacks[DEVICE_DHT11_COUNT])(void) = {
+  [DEVICE_DHT11_1] = in_callback,
+};
+// 关联借用中断线的通知函数
+static void (*const relate_borrow_callbacks[DEVICE_DHT11_COUNT])(bool) = {
+  [DEVICE_DHT11_1] = borrow_callback,
 };
 
 errno_t Device_config_DHT11_register(void) {
@@ -25,8 +32,16 @@ errno_t Device_config_DHT11_register(void) {
     err = Device_GPIO_find(&devices[name].in, relate_in[name]);
     if (err) return err;
 
-    err = Device_timer_find(&devices[name].timer, relate_timer[name]);
-    if (err) return err;
+    /**
+     * 数据引脚 PB5 和右后轮测速 PE5 共用 EXTI 5, 板上没有空闲的中断线可以换
+     * 中断线只在接收响应时由设备借用: 起始信号结束后借出, 收完响应(约 5 毫秒)或超时(10 毫秒)后归还
+     * 这段时间内右后轮的码盘中断全部丢失, 借出和归还时通知右后轮测速, 测速保持借出前的转速,
+     * 车轮闭环在重新测到转速前保持该轮的输出
+     * 借用的次数和时长见 get_stats
+     * PB5 也可以作为 TIM3_CH2 输入捕获, 但 TIM3 的计数周期由舵机 PWM 决定, 暂未改用
+     */
+    devices[name].in_EXTI_callback = relate_callbacks[name];
+    devices[name].borrow_callback = relate_borrow_callbacks[name];
 
     err = Device_DHT11_register(&devices[name]);
     if (err) return err;
@@ -34,3 +49,19 @@ errno_t Device_config_DHT11_register(void) {
 
   return ESUCCESS;
 }
+
+static void in_callback(void) {
+  Device_DHT11 *pd = NULL;
+  errno_t err = Device_DHT11_find(&pd, DEVICE_DHT11_1);
+  if (err) return;
+
+  Device_DHT11_in_EXTI_callback(pd);
+}
+
+static void borrow_callback(bool borrowed) {
+  Device_speed_test *ps = NULL;
+  errno_t err = Device_speed_test_find(&ps, DEVICE_SPEED_TEST_TAIL_RIGHT);
+  if (err) return;
+
+  ps->ops->hold(ps, borrowed);
+}
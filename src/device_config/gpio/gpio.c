@@ -132,6 +132,7 @@ static Device_GPIO devices[DEVICE_GPIO_COUNT] = {
     .pin = GPIO_PIN_4,
     .exti_handle = &hexti4,
   },
+  // 和 DEVICE_DHT11_IN 共用 EXTI 5, DHT11 测量期间收不到中断
   [DEVICE_SPEED_TEST_TAIL_RIGHT_IN] = {
     .name = DEVICE_SPEED_TEST_TAIL_RIGHT_IN,
     .port = GPIOE,
@@ -179,10 +180,12 @@ static Device_GPIO devices[DEVICE_GPIO_COUNT] = {
     .pin = GPIO_PIN_1,
     .exti_handle = &hexti1,
   },
+  // 和 DEVICE_SPEED_TEST_TAIL_RIGHT_IN 共用 EXTI 5, 见 device_config/dht11
   [DEVICE_DHT11_IN] = {
     .name = DEVICE_DHT11_IN,
     .port = GPIOB,
     .pin = GPIO_PIN_5,
+    .exti_handle = &hexti5,
   },
   [DEVICE_ULTRASONIC_TRIG] = {
     .name = DEVICE_ULTRASONIC_TRIG,
@@ -193,6 +196,7 @@ static Device_GPIO devices[DEVICE_GPIO_COUNT] = {
     .name = DEVICE_ULTRASONIC_ECHO,
     .port = GPIOD,
     .pin = GPIO_PIN_7,
+    .exti_handle = &hexti7,
   },
 };
 
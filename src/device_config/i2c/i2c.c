@@ -7,6 +7,10 @@ static Device_I2C devices[DEVICE_I2C_COUNT] = {
   [DEVICE_I2C_1] = {
     .name = DEVICE_I2C_1,
     .instance = &hi2c1,
+    .scl_port = GPIOB,
+    .scl_pin = GPIO_PIN_6,
+    .sda_port = GPIOB,
+    .sda_pin = GPIO_PIN_7,
   },
 };
 
@@ -33,3 +37,21 @@ void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c) {
     Device_I2C_MasterRxCpltCallback(&devices[DEVICE_I2C_1]);
   }
 }
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+  if (hi2c == &hi2c1) {
+    Device_I2C_MasterTxCpltCallback(&devices[DEVICE_I2C_1]);
+  }
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+  if (hi2c == &hi2c1) {
+    Device_I2C_MasterRxCpltCallback(&devices[DEVICE_I2C_1]);
+  }
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+  if (hi2c == &hi2c1) {
+    Device_I2C_ErrorCallback(&devices[DEVICE_I2C_1]);
+  }
+}
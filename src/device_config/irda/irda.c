@@ -1,6 +1,5 @@
 #include "irda.h"
 #include "device/gpio/gpio.h"
-#include "device/timer/timer.h"
 #include <stdlib.h>
 
 static void in_callback(void);
@@ -14,10 +13,6 @@ static Device_IRDA devices[DEVICE_IRDA_COUNT] = {
 static const Device_GPIO_name relate_in[DEVICE_IRDA_COUNT] = {
   [DEVICE_IRDA_1] = DEVICE_IRDA_IN,
 };
-// 关联计时器
-static const Device_timer_name relate_timer[DEVICE_IRDA_COUNT] = {
-  [DEVICE_IRDA_1] = DEVICE_TIMER_TIM7,
-};
 // 关联中断线回调函数
 static void (*const relate_callbacks[DEVICE_IRDA_COUNT])(void) = {
   [DEVICE_IRDA_1] = in_callback,
@@ -34,9 +29,6 @@ errno_t Device_config_IRDA_register(void) {
     err = devices[name].in->ops->set_EXTI_handle(devices[name].in, DEVICE_GPIO_EXTI_TRIGGER_RISING_FALLING, relate_callbacks[name]);
     if (err) return err;
 
-    err = Device_timer_find(&devices[name].timer, relate_timer[name]);
-    if (err) return err;
-
     err = Device_IRDA_register(&devices[name]);
     if (err) return err;
   }
@@ -0,0 +1,31 @@
+#include "kv.h"
+#include "device/w25qx/w25qx.h"
+#include <stdlib.h>
+
+// 使用 flash 最后 128KB, 用于保存标定数据和设置
+static Device_KV devices[DEVICE_KV_COUNT] = {
+  [DEVICE_KV_SETTINGS] = {
+    .name = DEVICE_KV_SETTINGS,
+    .base_addr = 0x7E0000,
+    .sector_count = 32,
+  },
+};
+// 关联的 flash
+static const Device_W25QX_name relate_flash[DEVICE_KV_COUNT] = {
+  [DEVICE_KV_SETTINGS] = DEVICE_W25Q64,
+};
+
+errno_t Device_config_KV_register(void) {
+  errno_t err = Device_KV_module_init();
+  if (err) return err;
+
+  for (Device_KV_name name = 0; name < DEVICE_KV_COUNT; ++name) {
+    err = Device_W25QX_find(&devices[name].flash, relate_flash[name]);
+    if (err) return err;
+
+    err = Device_KV_register(&devices[name]);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
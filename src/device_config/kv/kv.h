@@ -0,0 +1,6 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/kv/kv.h"
+
+errno_t Device_config_KV_register(void);
@@ -0,0 +1,46 @@
+#include "mpu6050.h"
+#include "device/i2c/i2c.h"
+#include <stdlib.h>
+
+/**
+ * 1kHz 采样, 数字低通滤波器约 98Hz, 每 2 毫秒读取一次 FIFO(2 个采样, 约 0.7 毫秒的总线时间)
+ * 小车原地转向不超过 300 度/秒, 陀螺仪量程取 500 度/秒; 加速度计量程取 4g
+ * 重力方向修正时间常数约 0.5 秒, 零偏跟踪时间常数约 1 秒, 静止 0.2 秒后开始跟踪
+ */
+static Device_MPU6050 devices[DEVICE_MPU6050_COUNT] = {
+  [DEVICE_MPU6050_1] = {
+    .name = DEVICE_MPU6050_1,
+    .addr = 0x68,
+    .sample_rate_hz = 1000,
+    .dlpf = 2,
+    .gyro_range = DEVICE_MPU6050_GYRO_500DPS,
+    .accel_range = DEVICE_MPU6050_ACCEL_4G,
+    .read_period_ms = 2,
+    .attitude_param = {
+      .accel_shift = 9,
+      .bias_shift = 10,
+      .still_dps = Q16_FROM_FLOAT(2.0),
+      .still_samples = 200,
+      .calibration_samples = 500,
+    },
+  },
+};
+// 关联的 I2C
+static const Device_I2C_name relate_i2c[DEVICE_MPU6050_COUNT] = {
+  [DEVICE_MPU6050_1] = DEVICE_I2C_1,
+};
+
+errno_t Device_config_MPU6050_register(void) {
+  errno_t err = Device_MPU6050_module_init();
+  if (err) return err;
+
+  for (Device_MPU6050_name name = 0; name < DEVICE_MPU6050_COUNT; ++name) {
+    err = Device_I2C_find(&devices[name].i2c, relate_i2c[name]);
+    if (err) return err;
+
+    err = Device_MPU6050_register(&devices[name]);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/mpu6050/mpu6050.h"
+
+errno_t Device_config_MPU6050_register(void);
@@ -0,0 +1,31 @@
+#include "ota.h"
+#include "device/w25qx/w25qx.h"
+#include <stdlib.h>
+
+// 使用 flash 0x700000 开始的 896KB, 位于记录器和键值存储之间, 固件最大 892KB; 引导程序读取同一位置
+static Device_ota devices[DEVICE_OTA_COUNT] = {
+  [DEVICE_OTA_1] = {
+    .name = DEVICE_OTA_1,
+    .base_addr = DEVICE_OTA_STAGING_ADDR,
+    .sector_count = DEVICE_OTA_STAGING_SECTOR_COUNT,
+  },
+};
+// 关联的 flash
+static const Device_W25QX_name relate_flash[DEVICE_OTA_COUNT] = {
+  [DEVICE_OTA_1] = DEVICE_W25Q64,
+};
+
+errno_t Device_config_ota_register(void) {
+  errno_t err = Device_ota_module_init();
+  if (err) return err;
+
+  for (Device_ota_name name = 0; name < DEVICE_OTA_COUNT; ++name) {
+    err = Device_W25QX_find(&devices[name].flash, relate_flash[name]);
+    if (err) return err;
+
+    err = Device_ota_register(&devices[name]);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/ota/ota.h"
+
+errno_t Device_config_ota_register(void);
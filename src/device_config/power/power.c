@@ -0,0 +1,83 @@
+#include "power.h"
+#include "device/adc/adc.h"
+#include "device/st7789v2/st7789v2.h"
+#include "device/w25qx/w25qx.h"
+#include <stdlib.h>
+
+static Device_power devices[DEVICE_POWER_COUNT] = {
+  [DEVICE_POWER_BATTERY] = {
+    .name = DEVICE_POWER_BATTERY,
+    // 两节串联锂电池, 分压为 1/3 后接到 ADC(满电 8.4V 对应 2.8V), 更换电池或分压电阻时需要修改
+    .battery = {
+      .vref_mv = 3300,
+      .divider_numerator = 3,
+      .divider_denominator = 1,
+      .cell_count = 2,
+      .hysteresis_soc = 5,
+    },
+    .policies = {
+      [DEVICE_POWER_LEVEL_NORMAL] = {
+        .enter_soc = 100,
+        .motor_duty_max = 0xFF,
+        .backlight = true,
+        .display_refresh_ms = 200,
+        .wifi_send_interval_ms = 1000,
+        .sensor_poll_ms = 10,
+      },
+      [DEVICE_POWER_LEVEL_SAVING] = {
+        .enter_soc = 50,
+        .motor_duty_max = 0xD0,
+        .backlight = true,
+        .display_refresh_ms = 500,
+        .wifi_send_interval_ms = 2000,
+        .sensor_poll_ms = 20,
+      },
+      [DEVICE_POWER_LEVEL_LOW] = {
+        .enter_soc = 20,
+        .motor_duty_max = 0xA0,
+        .backlight = false,
+        .display_refresh_ms = 1000,
+        .wifi_send_interval_ms = 5000,
+        .sensor_poll_ms = 50,
+      },
+      // 电量过低时停车, 屏幕进入睡眠, 只保留电压检测
+      [DEVICE_POWER_LEVEL_CRITICAL] = {
+        .enter_soc = 5,
+        .motor_duty_max = 0,
+        .backlight = false,
+        .display_refresh_ms = 0,
+        .wifi_send_interval_ms = 0,
+        .sensor_poll_ms = 1000,
+      },
+    },
+  },
+};
+// 关联的 ADC 屏幕 flash 设备
+static const Device_ADC_name relate_adc[DEVICE_POWER_COUNT] = {
+  [DEVICE_POWER_BATTERY] = DEVICE_ADC_POWER,
+};
+static const Device_ST7789V2_name relate_display[DEVICE_POWER_COUNT] = {
+  [DEVICE_POWER_BATTERY] = DEVICE_ST7789V2_1,
+};
+static const Device_W25QX_name relate_flash[DEVICE_POWER_COUNT] = {
+  [DEVICE_POWER_BATTERY] = DEVICE_W25Q64,
+};
+
+errno_t Device_config_power_register(void) {
+  errno_t err = Device_power_module_init();
+  if (err) return err;
+
+  for (Device_power_name name = 0; name < DEVICE_POWER_COUNT; ++name) {
+    err = Device_ADC_find(&devices[name].adc, relate_adc[name]);
+    if (err) return err;
+    err = Device_ST7789V2_find(&devices[name].display, relate_display[name]);
+    if (err) return err;
+    err = Device_W25QX_find(&devices[name].flash, relate_flash[name]);
+    if (err) return err;
+
+    err = Device_power_register(&devices[name]);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/power/power.h"
+
+errno_t Device_config_power_register(void);
@@ -0,0 +1,31 @@
+#include "recorder.h"
+#include "device/w25qx/w25qx.h"
+#include <stdlib.h>
+
+// 使用 flash 0x600000 开始的 1MB, 每秒 100 个样本时约可保存 5 分钟
+static Device_recorder devices[DEVICE_RECORDER_COUNT] = {
+  [DEVICE_RECORDER_1] = {
+    .name = DEVICE_RECORDER_1,
+    .base_addr = 0x600000,
+    .sector_count = 256,
+  },
+};
+// 关联的 flash
+static const Device_W25QX_name relate_flash[DEVICE_RECORDER_COUNT] = {
+  [DEVICE_RECORDER_1] = DEVICE_W25Q64,
+};
+
+errno_t Device_config_recorder_register(void) {
+  errno_t err = Device_recorder_module_init();
+  if (err) return err;
+
+  for (Device_recorder_name name = 0; name < DEVICE_RECORDER_COUNT; ++name) {
+    err = Device_W25QX_find(&devices[name].flash, relate_flash[name]);
+    if (err) return err;
+
+    err = Device_recorder_register(&devices[name]);
+    if (err) return err;
+  }
+
+  return ESUCCESS;
+}
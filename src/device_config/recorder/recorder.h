@@ -0,0 +1,6 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/recorder/recorder.h"
+
+errno_t Device_config_recorder_register(void);
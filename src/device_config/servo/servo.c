@@ -7,6 +7,13 @@ static Device_servo devices[DEVICE_SERVO_COUNT] = {
     .name = DEVICE_SERVO_1,
     .running = false,
     .angle = 0,
+    // 最大角速度 180 度/秒, 最大角加速度 720 度/秒^2, 转动 90 度约 0.75 秒
+    .profile_param = {
+      .max_velocity = 18000,
+      .max_acceleration = 72000,
+      .max_jerk = 0,
+      .period_us = DEVICE_SERVO_UPDATE_PERIOD_US,
+    },
   },
 };
 // 关联 pwm 设备
@@ -1,6 +1,5 @@
 #include "speed_test.h"
 #include "device/gpio/gpio.h"
-#include "device/pwm/pwm.h"
 #include <stdlib.h>
 
 static void in_head_left_callback(void);
@@ -8,18 +7,31 @@ static void in_head_right_callback(void);
 static void in_tail_left_callback(void);
 static void in_tail_right_callback(void);
 
+// 码盘 20 格, 双边沿触发, 每圈 40 次中断
+#define COUNTS_PER_REV 40
+// 车轮直径 65 毫米
+#define WHEEL_CIRCUMFERENCE_MM 204
+
 static Device_speed_test devices[DEVICE_SPEED_TEST_COUNT] = {
   [DEVICE_SPEED_TEST_HEAD_LEFT] = {
     .name = DEVICE_SPEED_TEST_HEAD_LEFT,
+    .counts_per_rev = COUNTS_PER_REV,
+    .wheel_circumference_mm = WHEEL_CIRCUMFERENCE_MM,
   },
   [DEVICE_SPEED_TEST_HEAD_RIGHT] = {
     .name = DEVICE_SPEED_TEST_HEAD_RIGHT,
+    .counts_per_rev = COUNTS_PER_REV,
+    .wheel_circumference_mm = WHEEL_CIRCUMFERENCE_MM,
   },
   [DEVICE_SPEED_TEST_TAIL_LEFT] = {
     .name = DEVICE_SPEED_TEST_TAIL_LEFT,
+    .counts_per_rev = COUNTS_PER_REV,
+    .wheel_circumference_mm = WHEEL_CIRCUMFERENCE_MM,
   },
   [DEVICE_SPEED_TEST_TAIL_RIGHT] = {
     .name = DEVICE_SPEED_TEST_TAIL_RIGHT,
+    .counts_per_rev = COUNTS_PER_REV,
+    .wheel_circumference_mm = WHEEL_CIRCUMFERENCE_MM,
   },
 };
 
@@ -30,13 +42,6 @@ static const Device_GPIO_name relate_in[DEVICE_SPEED_TEST_COUNT] = {
   [DEVICE_SPEED_TEST_TAIL_LEFT] = DEVICE_SPEED_TEST_TAIL_LEFT_IN,
   [DEVICE_SPEED_TEST_TAIL_RIGHT] = DEVICE_SPEED_TEST_TAIL_RIGHT_IN,
 };
-// 关联定时器
-static const Device_timer_name relate_timer[DEVICE_SPEED_TEST_COUNT] = {
-  [DEVICE_SPEED_TEST_HEAD_LEFT] = DEVICE_TIMER_SYSTICK,
-  [DEVICE_SPEED_TEST_HEAD_RIGHT] = DEVICE_TIMER_SYSTICK,
-  [DEVICE_SPEED_TEST_TAIL_LEFT] = DEVICE_TIMER_SYSTICK,
-  [DEVICE_SPEED_TEST_TAIL_RIGHT] = DEVICE_TIMER_SYSTICK,
-};
 // 关联的回调函数
 static void (*const callbacks[DEVICE_SPEED_TEST_COUNT])(void) = {
   [DEVICE_SPEED_TEST_HEAD_LEFT] = in_head_left_callback,
@@ -57,9 +62,6 @@ errno_t Device_config_speed_test_register(void) {
     err = devices[name].in->ops->set_EXTI_handle(devices[name].in, DEVICE_GPIO_EXTI_TRIGGER_RISING_FALLING, callbacks[name]);
     if (err) return err;
 
-    err = Device_timer_find(&devices[name].timer, relate_timer[name]);
-    if (err) return err;
-
     err = Device_speed_test_register(&devices[name]);
     if (err) return err;
   }
@@ -67,34 +69,19 @@ errno_t Device_config_speed_test_register(void) {
   return ESUCCESS;
 }
 
+// 每个脉冲都会进中断, 直接使用设备表, 不在链表中查找
 static void in_head_left_callback(void) {
-  Device_speed_test *pd = NULL;
-  errno_t err = Device_speed_test_find(&pd, DEVICE_SPEED_TEST_HEAD_LEFT);
-  if (err) return;
-
-  Device_speed_test_EXTI_callback(pd);
+  Device_speed_test_EXTI_callback(&devices[DEVICE_SPEED_TEST_HEAD_LEFT]);
 }
 
 static void in_head_right_callback(void) {
-  Device_speed_test *pd = NULL;
-  errno_t err = Device_speed_test_find(&pd, DEVICE_SPEED_TEST_HEAD_RIGHT);
-  if (err) return;
-
-  Device_speed_test_EXTI_callback(pd);
+  Device_speed_test_EXTI_callback(&devices[DEVICE_SPEED_TEST_HEAD_RIGHT]);
 }
 
 static void in_tail_left_callback(void) {
-  Device_speed_test *pd = NULL;
-  errno_t err = Device_speed_test_find(&pd, DEVICE_SPEED_TEST_TAIL_LEFT);
-  if (err) return;
-
-  Device_speed_test_EXTI_callback(pd);
+  Device_speed_test_EXTI_callback(&devices[DEVICE_SPEED_TEST_TAIL_LEFT]);
 }
 
 static void in_tail_right_callback(void) {
-  Device_speed_test *pd = NULL;
-  errno_t err = Device_speed_test_find(&pd, DEVICE_SPEED_TEST_TAIL_RIGHT);
-  if (err) return;
-
-  Device_speed_test_EXTI_callback(pd);
+  Device_speed_test_EXTI_callback(&devices[DEVICE_SPEED_TEST_TAIL_RIGHT]);
 }
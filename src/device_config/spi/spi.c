@@ -33,3 +33,10 @@ void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi) {
     Device_SPI_RxCpltCallback(&devices[DEVICE_SPI_1]);
   }
 }
+
+// 溢出, 模式错误或 DMA 错误, 结束当前传输
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi) {
+  if (hspi == &hspi1) {
+    Device_SPI_ErrorCallback(&devices[DEVICE_SPI_1]);
+  }
+}
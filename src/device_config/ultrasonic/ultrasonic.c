@@ -1,8 +1,9 @@
 #include "ultrasonic.h"
 #include "device/gpio/gpio.h"
-#include "device/timer/timer.h"
 #include <stdlib.h>
 
+static void echo_callback(void);
+
 static Device_ultrasonic devices[DEVICE_ULTRASONIC_COUNT] = {
   [DEVICE_ULTRASONIC_1] = {
     .name = DEVICE_ULTRASONIC_1,
@@ -16,9 +17,9 @@ static const Device_GPIO_name relate_trig[DEVICE_ULTRASONIC_COUNT] = {
 static const Device_GPIO_name relate_echo[DEVICE_ULTRASONIC_COUNT] = {
   [DEVICE_ULTRASONIC_1] = DEVICE_ULTRASONIC_ECHO,
 };
-// 关联计时器
-static const Device_timer_name relate_timer[DEVICE_ULTRASONIC_COUNT] = {
-  [DEVICE_ULTRASONIC_1] = DEVICE_TIMER_TIM11,
+// 关联 echo 中断线回调函数
+static void (*const relate_echo_callbacks[DEVICE_ULTRASONIC_COUNT])(void) = {
+  [DEVICE_ULTRASONIC_1] = echo_callback,
 };
 
 errno_t Device_config_ultrasonic_register(void) {
@@ -32,7 +33,7 @@ errno_t Device_config_ultrasonic_register(void) {
     err = Device_GPIO_find(&devices[name].echo, relate_echo[name]);
     if (err) return err;
 
-    err = Device_timer_find(&devices[name].timer, relate_timer[name]);
+    err = devices[name].echo->ops->set_EXTI_handle(devices[name].echo, DEVICE_GPIO_EXTI_TRIGGER_RISING_FALLING, relate_echo_callbacks[name]);
     if (err) return err;
 
     err = Device_ultrasonic_register(&devices[name]);
@@ -41,3 +42,11 @@ errno_t Device_config_ultrasonic_register(void) {
 
   return ESUCCESS;
 }
+
+static void echo_callback(void) {
+  Device_ultrasonic *pd = NULL;
+  errno_t err = Device_ultrasonic_find(&pd, DEVICE_ULTRASONIC_1);
+  if (err) return;
+
+  Device_ultrasonic_echo_EXTI_callback(pd);
+}
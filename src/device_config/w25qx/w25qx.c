@@ -6,6 +6,8 @@
 static Device_W25QX devices[DEVICE_W25QX_COUNT] = {
   [DEVICE_W25Q64] = {
     .name = DEVICE_W25Q64,
+    // SPI1 时钟为 42MHz, 两种读取命令都能用, 快速读取在更高时钟下也能工作
+    .read_mode = DEVICE_W25QX_READ_FAST,
   },
 };
 // 关联的 GPIO
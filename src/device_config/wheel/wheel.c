@@ -0,0 +1,123 @@
+#include "wheel.h"
+#include "device/motor/motor.h"
+#include "device/speed_test/speed_test.h"
+#include "device/timer/timer.h"
+#include <stdlib.h>
+
+static errno_t control_callback(void);
+
+/**
+ * 电机满占空比空载约 300 转/分, 前馈增益取 0xFF / 30000
+ * 比例增益约为前馈的 2 倍, 积分时间约 100 毫秒(按 1 毫秒控制周期换算)
+ * 前馈偏置用于克服静摩擦, 更换电机或电池电压变化较大时需重新整定
+ * 机械时间常数约 60 毫秒, 按最大角加速度 1000 转/分/秒跟随时需多出约 51 的占空比,
+ * 此时目标每周期增加 100, 变化率前馈增益取 0.5, 避免由积分项补足后超调
+ * 用 tools/sim/wheel_sim 在电机模型上检验, 修改参数后需重新运行
+ */
+#define WHEEL_PID_PARAM { \
+  .kp = Q16_FROM_FLOAT(0.017), \
+  .ki = Q16_FROM_FLOAT(0.0002), \
+  .kd = 0, \
+  .kff = Q16_FROM_FLOAT(0.0085), \
+  .kaff = Q16_FROM_FLOAT(0.5), \
+  .ff_offset = 0x20, \
+  .out_min = -0xFF, \
+  .out_max = 0xFF, \
+}
+
+/**
+ * 转速变化曲线, 位置为转速(0.01 转/分), 速度为角加速度, 加速度为角加加速度
+ * 最大角加速度 1000 转/分/秒, 约 0.1 秒达到, 0 到 200 转/分约 0.3 秒
+ * 曲线本身是梯形(max_jerk 为 0), 但梯形的是角加速度, 转速因此按 S 形过渡, 起步和刹车更柔和, 避免打滑和电源跌落
+ * max_jerk 限制的是角加加速度的变化率, 在 tools/sim/wheel_sim 的电机模型上只会拉长过渡并加大超调, 不使用
+ */
+#define WHEEL_PROFILE_PARAM { \
+  .max_velocity = 100000, \
+  .max_acceleration = 1000000, \
+  .max_jerk = 0, \
+  .period_us = DEVICE_WHEEL_CONTROL_PERIOD_US, \
+}
+
+static Device_wheel devices[DEVICE_WHEEL_COUNT] = {
+  [DEVICE_WHEEL_HEAD_LEFT] = {
+    .name = DEVICE_WHEEL_HEAD_LEFT,
+    .pid_param = WHEEL_PID_PARAM,
+    .profile_param = WHEEL_PROFILE_PARAM,
+  },
+  [DEVICE_WHEEL_HEAD_RIGHT] = {
+    .name = DEVICE_WHEEL_HEAD_RIGHT,
+    .pid_param = WHEEL_PID_PARAM,
+    .profile_param = WHEEL_PROFILE_PARAM,
+  },
+  [DEVICE_WHEEL_TAIL_LEFT] = {
+    .name = DEVICE_WHEEL_TAIL_LEFT,
+    .pid_param = WHEEL_PID_PARAM,
+    .profile_param = WHEEL_PROFILE_PARAM,
+  },
+  [DEVICE_WHEEL_TAIL_RIGHT] = {
+    .name = DEVICE_WHEEL_TAIL_RIGHT,
+    .pid_param = WHEEL_PID_PARAM,
+    .profile_param = WHEEL_PROFILE_PARAM,
+  },
+};
+// 关联的电机 测速 定时器设备
+static const Device_motor_name relate_motor[DEVICE_WHEEL_COUNT] = {
+  [DEVICE_WHEEL_HEAD_LEFT] = DEVICE_MOTOR_HEAD_LEFT,
+  [DEVICE_WHEEL_HEAD_RIGHT] = DEVICE_MOTOR_HEAD_RIGHT,
+  [DEVICE_WHEEL_TAIL_LEFT] = DEVICE_MOTOR_TAIL_LEFT,
+  [DEVICE_WHEEL_TAIL_RIGHT] = DEVICE_MOTOR_TAIL_RIGHT,
+};
+static const Device_speed_test_name relate_speed_test[DEVICE_WHEEL_COUNT] = {
+  [DEVICE_WHEEL_HEAD_LEFT] = DEVICE_SPEED_TEST_HEAD_LEFT,
+  [DEVICE_WHEEL_HEAD_RIGHT] = DEVICE_SPEED_TEST_HEAD_RIGHT,
+  [DEVICE_WHEEL_TAIL_LEFT] = DEVICE_SPEED_TEST_TAIL_LEFT,
+  [DEVICE_WHEEL_TAIL_RIGHT] = DEVICE_SPEED_TEST_TAIL_RIGHT,
+};
+static const Device_timer_name relate_timer = DEVICE_TIMER_TIM7;
+
+// 四个车轮的电机共用 TIM8, 控制输出通过电机组在同一个 PWM 周期生效
+static Device_motor_group motor_group = {0};
+
+errno_t Device_config_wheel_register(void) {
+  errno_t err = Device_wheel_module_init();
+  if (err) return err;
+
+  for (Device_wheel_name name = 0; name < DEVICE_WHEEL_COUNT; ++name) {
+    err = Device_motor_find(&devices[name].motor, relate_motor[name]);
+    if (err) return err;
+    err = Device_speed_test_find(&devices[name].speed_test, relate_speed_test[name]);
+    if (err) return err;
+    err = Device_timer_find(&devices[name].timer, relate_timer);
+    if (err) return err;
+
+    devices[name].control_callback = control_callback;
+
+    err = Device_wheel_register(&devices[name]);
+    if (err) return err;
+  }
+
+  Device_motor *motors[DEVICE_WHEEL_COUNT] = {0};
+  for (Device_wheel_name name = 0; name < DEVICE_WHEEL_COUNT; ++name) {
+    motors[name] = devices[name].motor;
+  }
+  err = Device_motor_group_init(&motor_group, motors, DEVICE_WHEEL_COUNT);
+  if (err) return err;
+
+  return ESUCCESS;
+}
+
+// 每个控制周期都会进中断, 直接使用设备表, 不在链表中查找
+static errno_t control_callback(void) {
+  errno_t err = ESUCCESS;
+  int16_t speeds[DEVICE_WHEEL_COUNT] = {0};
+
+  for (Device_wheel_name name = 0; name < DEVICE_WHEEL_COUNT; ++name) {
+    errno_t e = Device_wheel_control_callback(&devices[name], &speeds[name]);
+    if (e) err = e;
+  }
+
+  errno_t e = Device_motor_group_set(&motor_group, speeds);
+  if (e) err = e;
+
+  return err;
+}
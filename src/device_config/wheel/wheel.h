@@ -0,0 +1,6 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/wheel/wheel.h"
+
+errno_t Device_config_wheel_register(void);
@@ -8,6 +8,8 @@ static errno_t start(const Device_ADC *const pd);
 static errno_t stop(const Device_ADC *const pd);
 static errno_t poll(const Device_ADC *const pd, uint32_t timeout_ms);
 static errno_t get_value(const Device_ADC *const pd, uint16_t *rt_value);
+static errno_t start_scan(const Device_ADC *const pd, const Device_ADC_channel_config configs[], uint8_t count, uint16_t *buffer, uint32_t len);
+static errno_t stop_scan(const Device_ADC *const pd);
 
 static const uint32_t relate_channel[] = {
   [DEVICE_ADC_CHANNEL_0] = ADC_CHANNEL_0,
@@ -48,6 +50,8 @@ static const Driver_ADC_ops ops = {
   .stop = stop,
   .poll = poll,
   .get_value = get_value,
+  .start_scan = start_scan,
+  .stop_scan = stop_scan,
 };
 
 errno_t Driver_ADC_get_ops(const Driver_ADC_ops **po_ptr) {
@@ -95,3 +99,45 @@ static errno_t get_value(const Device_ADC *const pd, uint16_t *rt_value) {
   return ESUCCESS;
 }
 
+static errno_t start_scan(const Device_ADC *const pd, const Device_ADC_channel_config configs[], uint8_t count, uint16_t *buffer, uint32_t len) {
+  if (pd == NULL || configs == NULL || count == 0 || count > 16 || buffer == NULL || len == 0) return EINVAL;
+
+  ADC_HandleTypeDef *hadc = (ADC_HandleTypeDef *)pd->instance;
+
+  TIM_HandleTypeDef *htim = (TIM_HandleTypeDef *)pd->trigger;
+  if (htim == NULL) return EINVAL;
+
+  // 重新配置前先停止正在进行的扫描
+  HAL_TIM_PWM_Stop(htim, TIM_CHANNEL_1);
+  HAL_ADC_Stop_DMA(hadc);
+
+  // 每个 TIM5 CC1 上升沿触发一轮扫描, 采样率由定时器决定
+  hadc->Init.ScanConvMode = ENABLE;
+  hadc->Init.ContinuousConvMode = DISABLE;
+  hadc->Init.DiscontinuousConvMode = DISABLE;
+  hadc->Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  hadc->Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T5_CC1;
+  hadc->Init.NbrOfConversion = count;
+  hadc->Init.DMAContinuousRequests = ENABLE;
+  hadc->Init.EOCSelection = ADC_EOC_SEQ_CONV;
+  if (HAL_ADC_Init(hadc) != HAL_OK) return EINTR;
+
+  for (uint8_t i = 0; i < count; ++i) {
+    errno_t err = config_channel(pd, &configs[i]);
+    if (err) return err;
+  }
+
+  HAL_StatusTypeDef status = HAL_ADC_Start_DMA(hadc, (uint32_t *)buffer, len);
+  if (status != HAL_OK) return EINTR;
+  status = HAL_TIM_PWM_Start(htim, TIM_CHANNEL_1);
+  if (status != HAL_OK) return EINTR;
+  return ESUCCESS;
+}
+
+static errno_t stop_scan(const Device_ADC *const pd) {
+  if (pd == NULL) return EINVAL;
+  if (pd->trigger != NULL) HAL_TIM_PWM_Stop((TIM_HandleTypeDef *)pd->trigger, TIM_CHANNEL_1);
+  HAL_StatusTypeDef status = HAL_ADC_Stop_DMA((ADC_HandleTypeDef *)pd->instance);
+  if (status != HAL_OK) return EINTR;
+  return ESUCCESS;
+}
@@ -1,23 +1,44 @@
 #include "gpio.h"
 #include <stdlib.h>
+#include <stdbool.h>
 #include "stm32f4xx_hal.h"
 
 static errno_t read(const Device_GPIO *const pd, Pin_value *value_ptr);
+static errno_t read_port(void *const port, uint16_t *rt_value_ptr);
 static errno_t write(const Device_GPIO *const pd, const Pin_value value);
 static errno_t set_EXTI_handle(const Device_GPIO *const pd, Device_GPIO_EXTI_trigger trigger, void (*callback)(void));
+static errno_t save_EXTI_handle(const Device_GPIO *const pd);
+static errno_t restore_EXTI_handle(const Device_GPIO *const pd);
 
 static const Driver_GPIO_ops ops = {
   .read = read,
+  .read_port = read_port,
   .write = write,
   .set_EXTI_handle = set_EXTI_handle,
+  .save_EXTI_handle = save_EXTI_handle,
+  .restore_EXTI_handle = restore_EXTI_handle,
 };
 
+// GPIO 中断线数量
+#define EXTI_GPIO_LINE_NUM 16
+
+// 被借用的中断线原来的配置
+static EXTI_ConfigTypeDef saved_configs[EXTI_GPIO_LINE_NUM] = {0};
+static void (*saved_callbacks[EXTI_GPIO_LINE_NUM])(void) = {0};
+static bool saved[EXTI_GPIO_LINE_NUM] = {0};
+
 static errno_t read(const Device_GPIO *const pd, Pin_value *value_ptr) {
   if (pd == NULL) return EINVAL;
   *value_ptr = (Pin_value)HAL_GPIO_ReadPin((GPIO_TypeDef *)pd->port, pd->pin);
   return ESUCCESS;
 }
 
+static errno_t read_port(void *const port, uint16_t *rt_value_ptr) {
+  if (port == NULL) return EINVAL;
+  *rt_value_ptr = (uint16_t)((GPIO_TypeDef *)port)->IDR;
+  return ESUCCESS;
+}
+
 static errno_t write(const Device_GPIO *const pd, const Pin_value value) {
   if (pd == NULL) return EINVAL;
   HAL_GPIO_WritePin((GPIO_TypeDef *)pd->port, pd->pin, (GPIO_PinState)value);
@@ -39,6 +60,8 @@ static errno_t set_EXTI_handle(const Device_GPIO *const pd, Device_GPIO_EXTI_tri
     GPIOSel = EXTI_GPIOE;
   } else if (hgpio == GPIOB) {
     GPIOSel = EXTI_GPIOB;
+  } else if (hgpio == GPIOD) {
+    GPIOSel = EXTI_GPIOD;
   } else {
     // 其余 GPIO 口暂时不支持
     return EINVAL;
@@ -70,6 +93,44 @@ static errno_t set_EXTI_handle(const Device_GPIO *const pd, Device_GPIO_EXTI_tri
   return status == HAL_OK ? ESUCCESS : EINTR;
 }
 
+static errno_t save_EXTI_handle(const Device_GPIO *const pd) {
+  if (pd == NULL || pd->exti_handle == NULL) return EINVAL;
+
+  EXTI_HandleTypeDef *hexti = (EXTI_HandleTypeDef *)pd->exti_handle;
+  const uint32_t line = hexti->Line & EXTI_PIN_MASK;
+  if (line >= EXTI_GPIO_LINE_NUM) return EINVAL;
+  if (saved[line]) return EBUSY;
+
+  HAL_StatusTypeDef status = HAL_EXTI_GetConfigLine(hexti, &saved_configs[line]);
+  if (status != HAL_OK) return EINTR;
+
+  saved_callbacks[line] = hexti->PendingCallback;
+  saved[line] = true;
+
+  return ESUCCESS;
+}
+
+static errno_t restore_EXTI_handle(const Device_GPIO *const pd) {
+  if (pd == NULL || pd->exti_handle == NULL) return EINVAL;
+
+  EXTI_HandleTypeDef *hexti = (EXTI_HandleTypeDef *)pd->exti_handle;
+  const uint32_t line = hexti->Line & EXTI_PIN_MASK;
+  if (line >= EXTI_GPIO_LINE_NUM) return EINVAL;
+  if (!saved[line]) return ESUCCESS;
+
+  saved[line] = false;
+  hexti->PendingCallback = saved_callbacks[line];
+
+  // 原来没有配置过中断的线, 直接关闭中断即可
+  if ((saved_configs[line].Mode & EXTI_MODE_INTERRUPT) == 0) {
+    CLEAR_BIT(EXTI->IMR, 1UL << line);
+    return ESUCCESS;
+  }
+
+  HAL_StatusTypeDef status = HAL_EXTI_SetConfigLine(hexti, &saved_configs[line]);
+  return status == HAL_OK ? ESUCCESS : EINTR;
+}
+
 errno_t Driver_GPIO_get_ops(const Driver_GPIO_ops **po_ptr) {
   *po_ptr = &ops;
   return ESUCCESS;
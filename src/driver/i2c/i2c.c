@@ -2,6 +2,11 @@
 #include <stdlib.h>
 #include "stm32f4xx_hal.h"
 #include "device/i2c/i2c.h"
+#include "common/timebase/timebase.h"
+
+// 总线恢复时手动产生的时钟个数和半周期
+#define RECOVER_CLOCKS 9
+#define RECOVER_HALF_PERIOD_US 5
 
 static errno_t get_own_addr(const Device_I2C *const pd, uint16_t *rt_own_addr_ptr);
 static errno_t is_device_ready(const Device_I2C *const pd, uint16_t slave_addr, uint32_t trial_num, uint32_t timeout);
@@ -11,7 +16,18 @@ static errno_t master_receive_IT(const Device_I2C *const pd, uint16_t slave_addr
 static errno_t master_transmit_IT(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len);
 static errno_t master_receive_DMA(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *data, uint16_t len);
 static errno_t master_transmit_DMA(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len);
+static errno_t mem_read_IT(const Device_I2C *const pd, uint16_t slave_addr, uint16_t reg, uint8_t reg_len, uint8_t *data, uint16_t len);
+static errno_t mem_write_IT(const Device_I2C *const pd, uint16_t slave_addr, uint16_t reg, uint8_t reg_len, uint8_t *const data, uint16_t len);
+static errno_t seq_transmit_IT(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len, Device_I2C_frame frame);
+static errno_t seq_transmit_DMA(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len, Device_I2C_frame frame);
+static errno_t seq_receive_DMA(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *data, uint16_t len, Device_I2C_frame frame);
+static errno_t get_error(const Device_I2C *const pd, errno_t *rt_err_ptr);
+static errno_t recover(const Device_I2C *const pd);
 
+static inline errno_t status_to_errno(HAL_StatusTypeDef status);
+static inline uint16_t get_param_reg_size(uint8_t reg_len);
+static inline uint32_t get_param_frame(Device_I2C_frame frame);
+static void wait_us(uint32_t us);
 static inline uint16_t get_param_slave_addr(const Device_I2C *const pd, uint16_t slave_addr);
 
 static const Driver_I2C_ops ops = {
@@ -23,6 +39,13 @@ static const Driver_I2C_ops ops = {
   .master_transmit_IT = master_transmit_IT,
   .master_receive_DMA = master_receive_DMA,
   .master_transmit_DMA = master_transmit_DMA,
+  .mem_read_IT = mem_read_IT,
+  .mem_write_IT = mem_write_IT,
+  .seq_transmit_IT = seq_transmit_IT,
+  .seq_transmit_DMA = seq_transmit_DMA,
+  .seq_receive_DMA = seq_receive_DMA,
+  .get_error = get_error,
+  .recover = recover,
 };
 
 errno_t Driver_I2C_get_ops(const Driver_I2C_ops **po_ptr) {
@@ -91,6 +114,124 @@ static errno_t master_transmit_DMA(const Device_I2C *const pd, uint16_t slave_ad
   return EIO;
 }
 
+static errno_t mem_read_IT(const Device_I2C *const pd, uint16_t slave_addr, uint16_t reg, uint8_t reg_len, uint8_t *data, uint16_t len) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  HAL_StatusTypeDef status = HAL_I2C_Mem_Read_IT((I2C_HandleTypeDef *)pd->instance, get_param_slave_addr(pd, slave_addr), reg, get_param_reg_size(reg_len), data, len);
+  return status_to_errno(status);
+}
+
+static errno_t mem_write_IT(const Device_I2C *const pd, uint16_t slave_addr, uint16_t reg, uint8_t reg_len, uint8_t *const data, uint16_t len) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  HAL_StatusTypeDef status = HAL_I2C_Mem_Write_IT((I2C_HandleTypeDef *)pd->instance, get_param_slave_addr(pd, slave_addr), reg, get_param_reg_size(reg_len), data, len);
+  return status_to_errno(status);
+}
+
+static errno_t seq_transmit_IT(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len, Device_I2C_frame frame) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  HAL_StatusTypeDef status = HAL_I2C_Master_Seq_Transmit_IT((I2C_HandleTypeDef *)pd->instance, get_param_slave_addr(pd, slave_addr), data, len, get_param_frame(frame));
+  return status_to_errno(status);
+}
+
+static errno_t seq_transmit_DMA(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *const data, uint16_t len, Device_I2C_frame frame) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  HAL_StatusTypeDef status = HAL_I2C_Master_Seq_Transmit_DMA((I2C_HandleTypeDef *)pd->instance, get_param_slave_addr(pd, slave_addr), data, len, get_param_frame(frame));
+  return status_to_errno(status);
+}
+
+static errno_t seq_receive_DMA(const Device_I2C *const pd, uint16_t slave_addr, uint8_t *data, uint16_t len, Device_I2C_frame frame) {
+  if (pd == NULL || data == NULL || len == 0) return EINVAL;
+  HAL_StatusTypeDef status = HAL_I2C_Master_Seq_Receive_DMA((I2C_HandleTypeDef *)pd->instance, get_param_slave_addr(pd, slave_addr), data, len, get_param_frame(frame));
+  return status_to_errno(status);
+}
+
+static errno_t get_error(const Device_I2C *const pd, errno_t *rt_err_ptr) {
+  if (pd == NULL || rt_err_ptr == NULL) return EINVAL;
+
+  const uint32_t error = HAL_I2C_GetError((I2C_HandleTypeDef *)pd->instance);
+  if (error == HAL_I2C_ERROR_NONE) {
+    *rt_err_ptr = ESUCCESS;
+  } else if (error == HAL_I2C_ERROR_AF) {
+    *rt_err_ptr = ENXIO;
+  } else if (error & HAL_I2C_ERROR_TIMEOUT) {
+    *rt_err_ptr = ETIMEDOUT;
+  } else {
+    *rt_err_ptr = EIO;
+  }
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 总线恢复
+ * 从机在传输中途复位或被打断时可能一直拉低 SDA, 此时外设无法产生起始条件
+ * 反初始化外设后把 SCL 作为开漏输出产生最多 9 个时钟, 直到从机释放 SDA, 再产生停止条件并重新初始化
+ * 可以在中断中调用, 耗时约 100 微秒
+ * @param pd
+ * @return errno_t
+ */
+static errno_t recover(const Device_I2C *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  I2C_HandleTypeDef *const hi2c = (I2C_HandleTypeDef *)pd->instance;
+  GPIO_TypeDef *const scl_port = (GPIO_TypeDef *)pd->scl_port;
+  GPIO_TypeDef *const sda_port = (GPIO_TypeDef *)pd->sda_port;
+
+  HAL_I2C_DeInit(hi2c);
+
+  if (scl_port != NULL && sda_port != NULL) {
+    GPIO_InitTypeDef init = {
+      .Mode = GPIO_MODE_OUTPUT_OD,
+      .Pull = GPIO_NOPULL,
+      .Speed = GPIO_SPEED_FREQ_VERY_HIGH,
+    };
+    HAL_GPIO_WritePin(scl_port, pd->scl_pin, GPIO_PIN_SET);
+    HAL_GPIO_WritePin(sda_port, pd->sda_pin, GPIO_PIN_SET);
+    init.Pin = pd->scl_pin;
+    HAL_GPIO_Init(scl_port, &init);
+    init.Pin = pd->sda_pin;
+    HAL_GPIO_Init(sda_port, &init);
+
+    for (uint8_t i = 0; i < RECOVER_CLOCKS && HAL_GPIO_ReadPin(sda_port, pd->sda_pin) == GPIO_PIN_RESET; ++i) {
+      HAL_GPIO_WritePin(scl_port, pd->scl_pin, GPIO_PIN_RESET);
+      wait_us(RECOVER_HALF_PERIOD_US);
+      HAL_GPIO_WritePin(scl_port, pd->scl_pin, GPIO_PIN_SET);
+      wait_us(RECOVER_HALF_PERIOD_US);
+    }
+
+    // 停止条件: SCL 为高时 SDA 从低变高
+    HAL_GPIO_WritePin(sda_port, pd->sda_pin, GPIO_PIN_RESET);
+    wait_us(RECOVER_HALF_PERIOD_US);
+    HAL_GPIO_WritePin(sda_port, pd->sda_pin, GPIO_PIN_SET);
+    wait_us(RECOVER_HALF_PERIOD_US);
+
+    HAL_GPIO_DeInit(scl_port, pd->scl_pin);
+    HAL_GPIO_DeInit(sda_port, pd->sda_pin);
+  }
+
+  // 重新初始化时由 MspInit 恢复引脚复用, DMA 和中断
+  return HAL_I2C_Init(hi2c) == HAL_OK ? ESUCCESS : EIO;
+}
+
+static inline errno_t status_to_errno(HAL_StatusTypeDef status) {
+  if (status == HAL_OK) return ESUCCESS;
+  if (status == HAL_BUSY) return EBUSY;
+  return EIO;
+}
+
+static inline uint16_t get_param_reg_size(uint8_t reg_len) {
+  return reg_len == 2 ? I2C_MEMADD_SIZE_16BIT : I2C_MEMADD_SIZE_8BIT;
+}
+
+static inline uint32_t get_param_frame(Device_I2C_frame frame) {
+  return frame == DEVICE_I2C_FRAME_FIRST ? I2C_FIRST_FRAME : I2C_LAST_FRAME;
+}
+
+// 忙等, 使用 TIM2 的微秒计数, 中断中也可以使用
+static void wait_us(uint32_t us) {
+  const uint32_t begin_us = now_us();
+  while (timebase_elapsed_us(begin_us) < us);
+}
+
 /**
  * @brief 获取 HAL 库发送的从机地址
  * 如果是 7 位地址则左移 1 位, 10 位地址不左移
@@ -0,0 +1,28 @@
+#include "ota.h"
+#include <stdlib.h>
+#include "stm32f4xx_hal.h"
+
+/**
+ * 复制固件由引导程序(boot/)完成, 应用程序只负责复位
+ * 引导程序从内部 flash 扇区 0 执行, 复制中掉电后下次启动重新复制
+ */
+
+static errno_t reset(const Device_ota *const pd);
+
+static const Driver_ota_ops ops = {
+  .reset = reset,
+};
+
+static errno_t reset(const Device_ota *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  __disable_irq();
+  NVIC_SystemReset();
+
+  return ESUCCESS;
+}
+
+errno_t Driver_ota_get_ops(const Driver_ota_ops **po_ptr) {
+  *po_ptr = &ops;
+  return ESUCCESS;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "common/errno/errno.h"
+#include "device/ota/ota.h"
+
+errno_t Driver_ota_get_ops(const Driver_ota_ops **po_ptr);
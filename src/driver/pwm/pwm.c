@@ -11,6 +11,9 @@ static errno_t set_prescaler(const Device_PWM *const pd, uint16_t value);
 static errno_t set_clock_division(const Device_PWM *const pd, uint8_t value);
 static errno_t set_auto_reload_register(const Device_PWM *const pd, uint32_t value);
 static errno_t set_compare(const Device_PWM *const pd, uint32_t value);
+static errno_t get_auto_reload_register(const Device_PWM *const pd, uint32_t *rt_value_ptr);
+static errno_t set_preload(const Device_PWM *const pd, bool enable);
+static errno_t set_update_enable(const Device_PWM *const pd, bool enable);
 static errno_t get_source_frequent(const Device_PWM *const pd, uint32_t *rt_frequent_ptr);
 
 static const Driver_pwm_ops ops = {
@@ -21,6 +24,9 @@ static const Driver_pwm_ops ops = {
   .set_clock_division = set_clock_division,
   .set_auto_reload_register = set_auto_reload_register,
   .set_compare = set_compare,
+  .get_auto_reload_register = get_auto_reload_register,
+  .set_preload = set_preload,
+  .set_update_enable = set_update_enable,
   .get_source_frequent = get_source_frequent,
 };
 
@@ -115,6 +121,59 @@ static errno_t set_compare(const Device_PWM *const pd, uint32_t value) {
   return ESUCCESS;
 }
 
+static errno_t get_auto_reload_register(const Device_PWM *const pd, uint32_t *rt_value_ptr) {
+  *rt_value_ptr = __HAL_TIM_GET_AUTORELOAD((TIM_HandleTypeDef *)pd->instance);
+  return ESUCCESS;
+}
+
+static errno_t set_preload(const Device_PWM *const pd, bool enable) {
+  TIM_TypeDef *tim = ((TIM_HandleTypeDef *)pd->instance)->Instance;
+
+  volatile uint32_t *ccmr = NULL;
+  uint32_t preload_bit = 0;
+  switch (pd->channel) {
+    case TIM_CHANNEL_1:
+      ccmr = &tim->CCMR1;
+      preload_bit = TIM_CCMR1_OC1PE;
+      break;
+    case TIM_CHANNEL_2:
+      ccmr = &tim->CCMR1;
+      preload_bit = TIM_CCMR1_OC2PE;
+      break;
+    case TIM_CHANNEL_3:
+      ccmr = &tim->CCMR2;
+      preload_bit = TIM_CCMR2_OC3PE;
+      break;
+    case TIM_CHANNEL_4:
+      ccmr = &tim->CCMR2;
+      preload_bit = TIM_CCMR2_OC4PE;
+      break;
+    default:
+      return EINVAL;
+  }
+
+  if (enable) {
+    SET_BIT(*ccmr, preload_bit);
+    SET_BIT(tim->CR1, TIM_CR1_ARPE);
+  } else {
+    CLEAR_BIT(*ccmr, preload_bit);
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t set_update_enable(const Device_PWM *const pd, bool enable) {
+  TIM_TypeDef *tim = ((TIM_HandleTypeDef *)pd->instance)->Instance;
+
+  if (enable) {
+    CLEAR_BIT(tim->CR1, TIM_CR1_UDIS);
+  } else {
+    SET_BIT(tim->CR1, TIM_CR1_UDIS);
+  }
+
+  return ESUCCESS;
+}
+
 static errno_t get_source_frequent(const Device_PWM *const pd, uint32_t *rt_frequent_ptr) {
   TIM_HandleTypeDef *htim = (TIM_HandleTypeDef *)pd->instance;
 
@@ -9,6 +9,10 @@ static errno_t receive_IT(const Device_SPI *const pd, uint8_t *data, uint16_t le
 static errno_t transmit_IT(const Device_SPI *const pd, const uint8_t *const data, uint16_t len);
 static errno_t receive_DMA(const Device_SPI *const pd, uint8_t *data, uint16_t len);
 static errno_t transmit_DMA(const Device_SPI *const pd, const uint8_t *const data, uint16_t len);
+static errno_t configure(const Device_SPI *const pd, uint8_t mode, uint16_t divider);
+static errno_t abort_transfer(const Device_SPI *const pd);
+
+static void dma_stop(DMA_HandleTypeDef *hdma);
 
 static const Driver_SPI_ops ops = {
   .receive = receive,
@@ -17,6 +21,8 @@ static const Driver_SPI_ops ops = {
   .transmit_IT = transmit_IT,
   .receive_DMA = receive_DMA,
   .transmit_DMA = transmit_DMA,
+  .configure = configure,
+  .abort = abort_transfer,
 };
 
 static errno_t receive(const Device_SPI *const pd, uint8_t *data, uint16_t len) {
@@ -63,6 +69,90 @@ static errno_t transmit_DMA(const Device_SPI *const pd, const uint8_t *const dat
   return EIO;
 }
 
+/**
+ * @brief 修改 SPI 模式和时钟分频
+ * 只在配置变化时关闭 SPI 改写 CR1, 下一次传输时 HAL 会重新使能
+ * @param pd 
+ * @param mode 0~3, bit1 为 CPOL, bit0 为 CPHA
+ * @param divider 2 4 8 ... 256
+ * @return errno_t 
+ */
+static errno_t configure(const Device_SPI *const pd, uint8_t mode, uint16_t divider) {
+  if (pd == NULL || mode > 3) return EINVAL;
+
+  uint32_t prescaler = 0;
+  switch (divider) {
+    case 2: prescaler = SPI_BAUDRATEPRESCALER_2; break;
+    case 4: prescaler = SPI_BAUDRATEPRESCALER_4; break;
+    case 8: prescaler = SPI_BAUDRATEPRESCALER_8; break;
+    case 16: prescaler = SPI_BAUDRATEPRESCALER_16; break;
+    case 32: prescaler = SPI_BAUDRATEPRESCALER_32; break;
+    case 64: prescaler = SPI_BAUDRATEPRESCALER_64; break;
+    case 128: prescaler = SPI_BAUDRATEPRESCALER_128; break;
+    case 256: prescaler = SPI_BAUDRATEPRESCALER_256; break;
+    default: return EINVAL;
+  }
+  const uint32_t polarity = (mode & 0x02) ? SPI_POLARITY_HIGH : SPI_POLARITY_LOW;
+  const uint32_t phase = (mode & 0x01) ? SPI_PHASE_2EDGE : SPI_PHASE_1EDGE;
+
+  SPI_HandleTypeDef *const hspi = (SPI_HandleTypeDef *)pd->instance;
+  if (hspi->Init.BaudRatePrescaler == prescaler && hspi->Init.CLKPolarity == polarity && hspi->Init.CLKPhase == phase) return ESUCCESS;
+  if (hspi->State != HAL_SPI_STATE_READY) return EBUSY;
+
+  __HAL_SPI_DISABLE(hspi);
+  MODIFY_REG(hspi->Instance->CR1, SPI_CR1_BR | SPI_CR1_CPOL | SPI_CR1_CPHA, prescaler | polarity | phase);
+  hspi->Init.BaudRatePrescaler = prescaler;
+  hspi->Init.CLKPolarity = polarity;
+  hspi->Init.CLKPhase = phase;
+
+  return ESUCCESS;
+}
+
+/**
+ * @brief 停止正在进行的传输, 恢复到可以开始下一次传输的状态
+ * HAL_SPI_Abort 中的 HAL_DMA_Abort 以 HAL_GetTick 计时等待, 在优先级高于 SysTick 的中断中调用时不会超时, 这里直接操作寄存器
+ * @param pd
+ * @return errno_t
+ */
+static errno_t abort_transfer(const Device_SPI *const pd) {
+  if (pd == NULL) return EINVAL;
+
+  SPI_HandleTypeDef *const hspi = (SPI_HandleTypeDef *)pd->instance;
+
+  CLEAR_BIT(hspi->Instance->CR2, SPI_CR2_TXEIE | SPI_CR2_RXNEIE | SPI_CR2_ERRIE | SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+  if (hspi->hdmatx != NULL) dma_stop(hspi->hdmatx);
+  if (hspi->hdmarx != NULL) dma_stop(hspi->hdmarx);
+
+  // 关闭 SPI 丢弃移位寄存器中的数据, 下一次传输时 HAL 重新使能
+  __HAL_SPI_DISABLE(hspi);
+  __HAL_SPI_CLEAR_OVRFLAG(hspi);
+  __HAL_SPI_CLEAR_MODFFLAG(hspi);
+
+  hspi->TxXferCount = 0;
+  hspi->RxXferCount = 0;
+  hspi->ErrorCode = HAL_SPI_ERROR_NONE;
+  hspi->State = HAL_SPI_STATE_READY;
+  __HAL_UNLOCK(hspi);
+
+  return ESUCCESS;
+}
+
+// 关闭 DMA 流的中断后再关闭流, 避免停止时产生的完成中断被当作传输完成
+static void dma_stop(DMA_HandleTypeDef *hdma) {
+  DMA_Stream_TypeDef *const stream = hdma->Instance;
+
+  CLEAR_BIT(stream->CR, DMA_IT_TC | DMA_IT_HT | DMA_IT_TE | DMA_IT_DME);
+  CLEAR_BIT(stream->FCR, DMA_IT_FE);
+  __HAL_DMA_DISABLE(hdma);
+  // 当前数据传输完成后 EN 位才清零, 最多几个总线周期
+  for (uint32_t i = 0; i < 1000 && (stream->CR & DMA_SxCR_EN); ++i);
+
+  __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma) | __HAL_DMA_GET_HT_FLAG_INDEX(hdma) | __HAL_DMA_GET_TE_FLAG_INDEX(hdma) | __HAL_DMA_GET_DME_FLAG_INDEX(hdma) | __HAL_DMA_GET_FE_FLAG_INDEX(hdma));
+  hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+  hdma->State = HAL_DMA_STATE_READY;
+  __HAL_UNLOCK(hdma);
+}
+
 errno_t Driver_SPI_get_ops(const Driver_SPI_ops **po_ptr) {
   *po_ptr = &ops;
   return ESUCCESS;
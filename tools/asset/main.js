@@ -0,0 +1,290 @@
+// 资源包生成和上传工具, 格式见 src/device/asset/asset.h
+//   node main.js build <manifest.json> [output.bin]
+//   node main.js upload <assets.bin> <串口设备>
+// example.json 使用 samples 中的示例资源, 字体由 src/device/st7789v2/font/ascii.c 转换而来, 只有 ASCII 字符
+// 显示中文时换成含中文的 BDF 字体(例如文泉驿点阵), 并用 chars 或 charsFile 列出需要的字符
+// 上传前需要先设置串口, 例如 stty -F /dev/ttyUSB0 115200 raw -echo
+const fs = require('fs');
+const path = require('path');
+
+const MAGIC = 0x31545341; // "AST1"
+const VERSION = 1;
+const HEADER_SIZE = 32;
+const ENTRY_SIZE = 32;
+const NAME_LEN = 16;
+const GLYPH_MAX = 128;
+const TYPE_IMAGE_RGB565 = 1;
+const TYPE_IMAGE_RLE = 2;
+const TYPE_FONT = 3;
+const UPLOAD_COMMAND = 'u';
+const UPLOAD_BLOCK_SIZE = 128;
+
+// CRC-32 (IEEE 802.3), 与 src/common/crc 相同
+const CRC_TABLE = (() => {
+  const table = new Uint32Array(256);
+  for (let i = 0; i < 256; ++i) {
+    let c = i;
+    for (let k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320 ^ (c >>> 1) : c >>> 1;
+    table[i] = c >>> 0;
+  }
+  return table;
+})();
+
+function crc32(buf) {
+  let c = 0xFFFFFFFF;
+  for (const b of buf) c = CRC_TABLE[(c ^ b) & 0xFF] ^ (c >>> 8);
+  return (c ^ 0xFFFFFFFF) >>> 0;
+}
+
+// 读取未压缩的 24/32 位 BMP, 返回 RGB565 像素(高字节在前)
+function readBmp(file) {
+  const buf = fs.readFileSync(file);
+  if (buf.toString('ascii', 0, 2) !== 'BM') throw new Error(`${file}: 不是 BMP 文件`);
+  const dataOffset = buf.readUInt32LE(10);
+  const width = buf.readInt32LE(18);
+  const rawHeight = buf.readInt32LE(22);
+  const bpp = buf.readUInt16LE(28);
+  const compression = buf.readUInt32LE(30);
+  if ((bpp !== 24 && bpp !== 32) || (compression !== 0 && compression !== 3)) {
+    throw new Error(`${file}: 只支持未压缩的 24/32 位 BMP`);
+  }
+  // 高度为正时从下往上存储
+  const height = Math.abs(rawHeight);
+  const bottomUp = rawHeight > 0;
+  const rowSize = Math.ceil(width * bpp / 32) * 4;
+  const pixels = Buffer.alloc(width * height * 2);
+  for (let y = 0; y < height; ++y) {
+    const row = dataOffset + (bottomUp ? height - 1 - y : y) * rowSize;
+    for (let x = 0; x < width; ++x) {
+      const p = row + x * (bpp / 8);
+      const b = buf[p], g = buf[p + 1], r = buf[p + 2];
+      const color = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+      pixels.writeUInt16BE(color, (y * width + x) * 2);
+    }
+  }
+  return { width, height, pixels };
+}
+
+/**
+ * 行程编码, 以像素为单位
+ * 包头最高位为 1: 后面 1 个像素重复 (低 7 位 + 1) 次; 为 0: 后面 (低 7 位 + 1) 个原样的像素
+ */
+function rleEncode(pixels) {
+  const count = pixels.length / 2;
+  const at = (i) => pixels.readUInt16BE(i * 2);
+  const out = [];
+  let literal = [];
+  const flushLiteral = () => {
+    while (literal.length) {
+      const part = literal.splice(0, 128);
+      out.push(part.length - 1);
+      for (const c of part) out.push(c >> 8, c & 0xFF);
+    }
+  };
+  let i = 0;
+  while (i < count) {
+    let run = 1;
+    while (i + run < count && run < 128 && at(i + run) === at(i)) ++run;
+    // 2 个相同像素编码为重复包和原样包一样长, 3 个以上才用重复包
+    if (run >= 3) {
+      flushLiteral();
+      out.push(0x80 | (run - 1), at(i) >> 8, at(i) & 0xFF);
+      i += run;
+    } else {
+      literal.push(at(i));
+      ++i;
+    }
+  }
+  flushLiteral();
+  return Buffer.from(out);
+}
+
+/**
+ * 读取 BDF 点阵字体, 所有字形放到 FONTBOUNDINGBOX 大小的格子中
+ * chars 为需要的字符, 为空时取字体中所有字符
+ */
+function readBdf(file, chars) {
+  const lines = fs.readFileSync(file, 'utf8').split(/\r?\n/);
+  let cellW = 0, cellH = 0, cellX = 0, cellY = 0;
+  const glyphs = new Map();
+  let cur = null;
+  for (let i = 0; i < lines.length; ++i) {
+    const [key, ...args] = lines[i].trim().split(/\s+/);
+    if (key === 'FONTBOUNDINGBOX') {
+      [cellW, cellH, cellX, cellY] = args.map(Number);
+    } else if (key === 'STARTCHAR') {
+      cur = { code: -1 };
+    } else if (key === 'ENCODING' && cur) {
+      cur.code = Number(args[0]);
+    } else if (key === 'BBX' && cur) {
+      [cur.w, cur.h, cur.x, cur.y] = args.map(Number);
+    } else if (key === 'BITMAP' && cur) {
+      cur.rows = [];
+      while (lines[++i].trim() !== 'ENDCHAR') cur.rows.push(lines[i].trim());
+      if (cur.code >= 0) glyphs.set(cur.code, cur);
+      cur = null;
+    }
+  }
+  if (cellW === 0 || cellH === 0) throw new Error(`${file}: 没有 FONTBOUNDINGBOX`);
+
+  const stride = Math.ceil(cellW / 8);
+  if (stride * cellH > GLYPH_MAX) throw new Error(`${file}: 字形超过 ${GLYPH_MAX} 字节`);
+
+  const codes = chars ? [...new Set([...chars].map((c) => c.codePointAt(0)))] : [...glyphs.keys()];
+  const missing = codes.filter((c) => !glyphs.has(c));
+  if (missing.length) console.warn(`${file}: 缺少 ${missing.length} 个字符: ${missing.map((c) => String.fromCodePoint(c)).join('')}`);
+  const present = codes.filter((c) => glyphs.has(c)).sort((a, b) => a - b);
+
+  const table = Buffer.alloc(present.length * 4);
+  const bitmaps = Buffer.alloc(present.length * stride * cellH);
+  present.forEach((code, n) => {
+    table.writeUInt32LE(code, n * 4);
+    const g = glyphs.get(code);
+    // 字形左下角相对格子左下角的偏移
+    const left = g.x - cellX;
+    const top = cellH + cellY - (g.h + g.y);
+    const base = n * stride * cellH;
+    g.rows.forEach((hex, row) => {
+      const bits = BigInt('0x' + hex);
+      const bitCount = hex.length * 4;
+      for (let col = 0; col < g.w; ++col) {
+        if (((bits >> BigInt(bitCount - 1 - col)) & 1n) === 0n) continue;
+        const x = left + col, y = top + row;
+        if (x < 0 || x >= cellW || y < 0 || y >= cellH) continue;
+        bitmaps[base + y * stride + (x >> 3)] |= 0x80 >> (x & 7);
+      }
+    });
+  });
+  return { width: cellW, height: cellH, count: present.length, data: Buffer.concat([table, bitmaps]) };
+}
+
+function build(manifestFile, outputFile) {
+  const manifest = JSON.parse(fs.readFileSync(manifestFile, 'utf8'));
+  const dir = path.dirname(manifestFile);
+  const assets = manifest.assets || [];
+  if (assets.length > 0xFFFF) throw new Error('资源数量过多');
+
+  const entries = [];
+  const blobs = [];
+  let offset = HEADER_SIZE + assets.length * ENTRY_SIZE;
+
+  for (const asset of assets) {
+    if (Buffer.byteLength(asset.name, 'utf8') > NAME_LEN) throw new Error(`${asset.name}: 名称超过 ${NAME_LEN} 字节`);
+    const file = path.resolve(dir, asset.file);
+    let entry;
+    if (asset.type === 'image') {
+      const image = readBmp(file);
+      if (asset.compress === 'rle') {
+        entry = { type: TYPE_IMAGE_RLE, width: image.width, height: image.height, count: 0, data: rleEncode(image.pixels) };
+      } else {
+        entry = { type: TYPE_IMAGE_RGB565, width: image.width, height: image.height, count: 0, data: image.pixels };
+      }
+    } else if (asset.type === 'font') {
+      let chars = asset.chars || '';
+      if (asset.charsFile) chars += fs.readFileSync(path.resolve(dir, asset.charsFile), 'utf8').replace(/\s/g, '');
+      if (asset.ascii) for (let c = 0x20; c < 0x7F; ++c) chars += String.fromCharCode(c);
+      const font = readBdf(file, chars);
+      if (font.count > 0xFFFF) throw new Error(`${asset.name}: 字符数量过多`);
+      entry = { type: TYPE_FONT, width: font.width, height: font.height, count: font.count, data: font.data };
+    } else {
+      throw new Error(`${asset.name}: 未知类型 ${asset.type}`);
+    }
+    entry.name = asset.name;
+    entry.offset = offset;
+    // 按 4 字节对齐
+    const padded = Buffer.alloc(Math.ceil(entry.data.length / 4) * 4);
+    entry.data.copy(padded);
+    offset += padded.length;
+    entries.push(entry);
+    blobs.push(padded);
+    console.log(`${entry.name.padEnd(NAME_LEN)} type ${entry.type} ${entry.width}x${entry.height} count ${entry.count} offset 0x${entry.offset.toString(16)} size ${entry.data.length}`);
+  }
+
+  const index = Buffer.alloc(entries.length * ENTRY_SIZE);
+  entries.forEach((e, n) => {
+    const p = n * ENTRY_SIZE;
+    index.write(e.name, p, NAME_LEN, 'utf8');
+    index.writeUInt8(e.type, p + 16);
+    index.writeUInt16LE(e.width, p + 18);
+    index.writeUInt16LE(e.height, p + 20);
+    index.writeUInt16LE(e.count, p + 22);
+    index.writeUInt32LE(e.offset, p + 24);
+    index.writeUInt32LE(e.data.length, p + 28);
+  });
+
+  const header = Buffer.alloc(HEADER_SIZE);
+  header.writeUInt32LE(MAGIC, 0);
+  header.writeUInt16LE(VERSION, 4);
+  header.writeUInt16LE(entries.length, 6);
+  header.writeUInt32LE(offset, 8);
+  header.writeUInt32LE(crc32(index), 12);
+
+  const image = Buffer.concat([header, index, ...blobs]);
+  fs.writeFileSync(outputFile, image);
+  console.log(`${outputFile}: ${image.length} bytes`);
+}
+
+/**
+ * 按块上传: 发送 'u', 等待 READY, 发送 4 字节长度, 之后每收到一个 OK 发送一块, 最后等待 DONE
+ * 设备端见 src/application/asset
+ */
+function upload(imageFile, port) {
+  const image = fs.readFileSync(imageFile);
+  const fd = fs.openSync(port, 'r+');
+  const output = fs.createWriteStream(null, { fd, autoClose: false });
+  const input = fs.createReadStream(null, { fd, autoClose: false });
+
+  let offset = -1;
+  let line = '';
+  const sendNext = () => {
+    if (offset < 0) {
+      const size = Buffer.alloc(4);
+      size.writeUInt32LE(image.length);
+      output.write(size);
+      offset = 0;
+      return;
+    }
+    if (offset >= image.length) return;
+    const block = image.subarray(offset, offset + UPLOAD_BLOCK_SIZE);
+    output.write(block);
+    offset += block.length;
+    process.stdout.write(`\r${offset} / ${image.length}`);
+  };
+
+  input.on('data', (chunk) => {
+    line += chunk.toString('latin1');
+    let idx;
+    while ((idx = line.indexOf('\r\n')) !== -1) {
+      const frame = line.slice(0, idx).trim();
+      line = line.slice(idx + 2);
+      if (frame === 'READY') {
+        sendNext();
+      } else if (frame === 'OK') {
+        sendNext();
+      } else if (frame === 'DONE') {
+        console.log('\nupload done');
+        process.exit(0);
+      } else if (frame.startsWith('ERR')) {
+        console.error(`\nupload failed: ${frame}`);
+        process.exit(1);
+      }
+    }
+  });
+  input.on('error', (err) => {
+    console.error(err.message);
+    process.exit(1);
+  });
+
+  output.write(UPLOAD_COMMAND);
+}
+
+const [command, ...args] = process.argv.slice(2);
+if (command === 'build' && args[0]) {
+  build(args[0], args[1] || 'assets.bin');
+} else if (command === 'upload' && args[0] && args[1]) {
+  upload(args[0], args[1]);
+} else {
+  console.log('usage: node main.js build <manifest.json> [output.bin]');
+  console.log('       node main.js upload <assets.bin> <serial device>');
+  process.exit(1);
+}
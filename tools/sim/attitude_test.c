@@ -0,0 +1,118 @@
+/**
+ * @brief 航向融合的主机测试
+ * 按 MPU6050 的配置(1kHz 采样, 陀螺仪 ±500dps, 加速度计 ±4g)生成传感器原始值:
+ * 传感器绕 x 轴倾斜 10 度安装, 陀螺仪带固定零偏和噪声, 加速度计带噪声
+ * 检查标定后静止不漂移, 转弯后的航向和角速度, 航向跨越 ±180 度, 零偏变化后的跟踪, 以及航向差的归一化
+ * 最后测量单个采样的融合耗时, 实际硬件上的耗时见 Device_MPU6050_stats
+ */
+#include "common/attitude/attitude.h"
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#define SAMPLE_HZ 1000
+#define GYRO_LSB_PER_DPS 65.5
+#define ACCEL_LSB_PER_G 8192
+
+static const Attitude_param param = {
+  .accel_shift = 9,
+  .bias_shift = 10,
+  .still_dps = Q16_FROM_FLOAT(2.0),
+  .still_samples = 200,
+  .calibration_samples = 500,
+};
+
+// 传感器坐标系中的竖直向上方向
+static double up[ATTITUDE_AXIS_COUNT] = {0};
+static double bias[ATTITUDE_AXIS_COUNT] = {20, -35, 12};
+static uint32_t rand_state = 1;
+static uint32_t failures = 0;
+
+static int32_t noise(int32_t amplitude) {
+  uint32_t x = rand_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rand_state = x;
+  return (int32_t)(x % (uint32_t)(2 * amplitude + 1)) - amplitude;
+}
+
+// 以 rate_dps 绕竖直方向(逆时针为正)转动 seconds 秒
+static void run(Attitude *const pa, double rate_dps, double seconds) {
+  const uint32_t samples = (uint32_t)lround(seconds * SAMPLE_HZ);
+
+  for (uint32_t k = 0; k < samples; ++k) {
+    int16_t accel[ATTITUDE_AXIS_COUNT], gyro[ATTITUDE_AXIS_COUNT];
+    for (uint8_t i = 0; i < ATTITUDE_AXIS_COUNT; ++i) {
+      accel[i] = (int16_t)lround(up[i] * ACCEL_LSB_PER_G + noise(20));
+      gyro[i] = (int16_t)lround(rate_dps * up[i] * GYRO_LSB_PER_DPS + bias[i] + noise(3));
+    }
+    attitude_update(pa, accel, gyro);
+  }
+}
+
+static void expect(const char *name, double value, double expected, double tolerance) {
+  const bool ok = fabs(value - expected) <= tolerance;
+  printf("  %-32s %9.3f (expected %.1f +- %.2f)%s\r\n", name, value, expected, tolerance, ok ? "" : " FAIL");
+  if (!ok) ++failures;
+}
+
+static double heading(const Attitude *const pa) {
+  return attitude_get_heading(pa) / 65536.0;
+}
+
+int main(void) {
+  Attitude attitude;
+  Attitude *const pa = &attitude;
+
+  const double tilt = 10 * M_PI / 180;
+  up[0] = 0;
+  up[1] = sin(tilt);
+  up[2] = cos(tilt);
+
+  errno_t err = attitude_init(pa, &param, 1000000 / SAMPLE_HZ, Q16_FROM_FLOAT(GYRO_LSB_PER_DPS), ACCEL_LSB_PER_G);
+  if (err) {
+    printf("init err %d\r\n", err);
+    return 1;
+  }
+
+  printf("attitude (sensor tilted 10 deg, gyro bias %.0f %.0f %.0f LSB)\r\n", bias[0], bias[1], bias[2]);
+  run(pa, 0, 1);
+  expect("ready after calibration", attitude_ready(pa), 1, 0);
+  expect("heading still", heading(pa), 0, 0.05);
+
+  run(pa, 90, 1);
+  expect("yaw rate turning", attitude_get_yaw_rate(pa) / 65536.0, 90, 1);
+  run(pa, 0, 1);
+  expect("heading after 90 deg turn", heading(pa), 90, 1);
+  expect("still after turn", attitude_still(pa), 1, 0);
+
+  // 再转 180 度, 航向跨过 180 度回到 -90
+  run(pa, 90, 2);
+  run(pa, 0, 0.5);
+  expect("heading after 270 deg total", heading(pa), -90, 2);
+
+  // 零偏变化约 0.15 度/秒, 不跟踪时 20 秒漂移约 3 度, 静止时跟踪新的零偏
+  attitude_set_heading(pa, 0);
+  bias[2] += 10;
+  run(pa, 0, 20);
+  expect("drift 20 s after bias change", heading(pa), 0, 0.5);
+
+  expect("diff(170, -170)", attitude_heading_diff(Q16_FROM_FLOAT(170), Q16_FROM_FLOAT(-170)) / 65536.0, -20, 0.001);
+  expect("diff(-170, 170)", attitude_heading_diff(Q16_FROM_FLOAT(-170), Q16_FROM_FLOAT(170)) / 65536.0, 20, 0.001);
+  expect("diff(0, -180)", attitude_heading_diff(0, Q16_FROM_FLOAT(-180)) / 65536.0, -180, 0.001);
+
+  // 耗时, 输入值每次变化, 避免编译器优化掉
+  const uint32_t updates = 10000000;
+  int16_t accel[ATTITUDE_AXIS_COUNT] = {0, 1422, 8068};
+  int16_t gyro[ATTITUDE_AXIS_COUNT] = {30, 200, -500};
+  const clock_t start = clock();
+  for (uint32_t k = 0; k < updates; ++k) {
+    gyro[0] ^= k & 1;
+    attitude_update(pa, accel, gyro);
+  }
+  printf("  %lu updates, host %.1f ns/update\r\n", (unsigned long)updates, (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / updates);
+
+  printf("attitude: %s\r\n", failures ? "FAIL" : "ok");
+  return failures ? 1 : 0;
+}
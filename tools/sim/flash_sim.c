@@ -0,0 +1,139 @@
+#include "flash_sim.h"
+#include <stdlib.h>
+#include <string.h>
+
+static errno_t init(const Device_W25QX *const pd);
+static errno_t erase(const Device_W25QX *const pd, uint32_t addr, uint16_t sector_count);
+static errno_t read(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len);
+static errno_t write(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len);
+
+static void cut_check(void);
+static void cut_erase_check(void);
+
+static const Device_W25QX_ops ops = {
+  .init = init,
+  .erase = erase,
+  .read = read,
+  .write = write,
+};
+
+Flash_sim flash_sim = {0};
+const Device_W25QX flash_sim_device = {
+  .name = DEVICE_W25Q64,
+  .ops = &ops,
+};
+
+// 数据手册典型值: 页编程 0.7ms, 扇区擦除 45ms; SPI1 二分频 42MHz, 每字节约 0.19us
+#define PROGRAM_SECONDS 0.0007
+#define ERASE_SECONDS 0.045
+#define BYTE_SECONDS (8.0 / 42000000.0)
+
+static uint32_t rand_state = 1;
+
+void flash_sim_init(uint32_t seed) {
+  if (flash_sim.data == NULL) flash_sim.data = malloc(W25QX_SIZE);
+  memset(flash_sim.data, 0xFF, W25QX_SIZE);
+  flash_sim.cut_after = 0;
+  flash_sim.cut_erase_after = 0;
+  flash_sim.erase_partial = 0.5;
+  rand_state = seed ? seed : 1;
+  flash_sim_reset_stats();
+}
+
+void flash_sim_reset_stats(void) {
+  flash_sim.read_bytes = 0;
+  flash_sim.program_bytes = 0;
+  flash_sim.program_commands = 0;
+  flash_sim.erase_commands = 0;
+  flash_sim.overwrites = 0;
+}
+
+double flash_sim_estimate_seconds(void) {
+  // 读取每次另有 4 字节命令和地址, 按字节数估算时忽略
+  return flash_sim.program_commands * PROGRAM_SECONDS
+    + flash_sim.erase_commands * ERASE_SECONDS
+    + (flash_sim.read_bytes + flash_sim.program_bytes) * BYTE_SECONDS;
+}
+
+// xorshift32, 结果只由种子决定, 失败的用例可以复现
+uint32_t flash_sim_rand(void) {
+  uint32_t x = rand_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rand_state = x;
+  return x;
+}
+
+static errno_t init(const Device_W25QX *const pd) {
+  (void)pd;
+  return flash_sim.data == NULL ? ENOMEM : ESUCCESS;
+}
+
+static errno_t erase(const Device_W25QX *const pd, uint32_t addr, uint16_t sector_count) {
+  (void)pd;
+  if (addr % W25QX_SECTOR_SIZE != 0 || addr + (uint32_t)sector_count * W25QX_SECTOR_SIZE > W25QX_SIZE) return EINVAL;
+
+  for (uint16_t i = 0; i < sector_count; ++i) {
+    uint8_t *const sector = flash_sim.data + addr + (uint32_t)i * W25QX_SECTOR_SIZE;
+    ++flash_sim.erase_commands;
+    flash_sim.last_erase_addr = addr + (uint32_t)i * W25QX_SECTOR_SIZE;
+
+    if (flash_sim.cut_after == 1 || flash_sim.cut_erase_after == 1) {
+      flash_sim.cut_in_erase = true;
+      const uint32_t threshold = (uint32_t)(flash_sim.erase_partial * 4294967295.0);
+      for (uint32_t j = 0; j < W25QX_SECTOR_SIZE; ++j) {
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+          if (flash_sim_rand() <= threshold) sector[j] |= 1u << bit;
+        }
+      }
+    } else {
+      memset(sector, 0xFF, W25QX_SECTOR_SIZE);
+    }
+    cut_erase_check();
+    cut_check();
+  }
+
+  return ESUCCESS;
+}
+
+static errno_t read(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len) {
+  (void)pd;
+  if (addr + len > W25QX_SIZE) return EINVAL;
+
+  memcpy(data, flash_sim.data + addr, len);
+  flash_sim.read_bytes += len;
+  return ESUCCESS;
+}
+
+static errno_t write(const Device_W25QX *const pd, uint32_t addr, uint8_t *data, uint32_t len) {
+  (void)pd;
+  if (addr + len > W25QX_SIZE) return EINVAL;
+
+  for (uint32_t i = 0; i < len; ++i) {
+    uint8_t *const p = flash_sim.data + addr + i;
+    if ((*p & data[i]) != data[i]) ++flash_sim.overwrites;
+    if (i == 0 || (addr + i) % W25QX_PAGE_SIZE == 0) ++flash_sim.program_commands;
+    ++flash_sim.program_bytes;
+
+    if (flash_sim.cut_after == 1) {
+      flash_sim.cut_in_erase = false;
+      *p &= data[i] | (uint8_t)flash_sim_rand();
+    } else {
+      *p &= data[i];
+    }
+    cut_check();
+  }
+
+  return ESUCCESS;
+}
+
+static void cut_check(void) {
+  if (flash_sim.cut_after == 0) return;
+  if (--flash_sim.cut_after == 0) longjmp(flash_sim.cut_jmp, 1);
+}
+
+static void cut_erase_check(void) {
+  if (flash_sim.cut_erase_after == 0) return;
+  if (--flash_sim.cut_erase_after == 0) longjmp(flash_sim.cut_jmp, 1);
+}
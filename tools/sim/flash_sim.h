@@ -0,0 +1,42 @@
+#pragma once
+
+#include "device/w25qx/w25qx.h"
+#include "device/w25qx/config/index.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <setjmp.h>
+
+/**
+ * @brief 主机上模拟的 W25QX, 用于在 PC 上测试使用 flash 的模块
+ * 按 NOR flash 的规则工作: 编程只能把 1 写成 0, 擦除把整个扇区写成 0xFF
+ * 设置 cut_after 后, 第 cut_after 个编程字节或擦除扇区只完成一部分, 然后 longjmp 到 cut_jmp 模拟掉电
+ * cut_erase_after 只计擦除的扇区, 用于在指定的擦除中掉电, 掉电时:
+ *   编程: 该字节中随机一部分应清零的位被清零, 之后的字节不变
+ *   擦除: 扇区中每个为 0 的位以 erase_partial 的概率变为 1
+ */
+typedef struct {
+  uint8_t *data;
+  // 掉电注入, cut_after 为 0 时不注入
+  uint64_t cut_after;
+  uint32_t cut_erase_after;
+  double erase_partial;
+  uint32_t last_erase_addr; // 最近一次擦除的扇区地址
+  bool cut_in_erase; // 最近一次掉电发生在擦除中
+  jmp_buf cut_jmp;
+  // 累计的操作统计
+  uint64_t read_bytes;
+  uint64_t program_bytes;
+  uint64_t program_commands; // 页编程命令数, 跨页的写入拆成多条
+  uint64_t erase_commands;
+  uint64_t overwrites; // 需要把 0 写成 1 的写入, 驱动会先读改写整个扇区, 日志结构的存储不应出现
+} Flash_sim;
+
+extern Flash_sim flash_sim;
+extern const Device_W25QX flash_sim_device;
+
+void flash_sim_init(uint32_t seed);
+// 清空统计
+void flash_sim_reset_stats(void);
+// 按 W25Q64 数据手册的典型值和 42MHz SPI 估算统计中的操作在实际硬件上的耗时, 单位为秒
+double flash_sim_estimate_seconds(void);
+uint32_t flash_sim_rand(void);
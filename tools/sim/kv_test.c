@@ -0,0 +1,329 @@
+/**
+ * @brief KV 存储的主机测试
+ * 1. 吞吐: 按 device_config 的配置随机写入/删除, 统计 flash 操作量并估算在实际硬件上的耗时
+ * 2. 随机掉电: 随机操作一段时间后在任意编程字节或擦除中掉电, 恢复挂载时也可能再次掉电
+ * 3. 回收擦除掉电: 新扇区已写入扇区头并搬完记录, 擦除最旧扇区时掉电
+ * 每次掉电后重新挂载, 每个键的值必须是掉电前最后一次完成写入的值, 正在写入的键可以是新值或旧值
+ */
+#include "flash_sim.h"
+#include "device/kv/kv.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define KEY_COUNT 24
+#define VALUE_MAX 400
+#define SMALL_SECTOR_COUNT 4
+
+typedef struct {
+  bool present;
+  uint16_t len;
+  uint8_t data[VALUE_MAX];
+} Value;
+
+// 正在执行的操作, 掉电后键的值可以是模型中的旧值或 after
+typedef struct {
+  bool active;
+  kv_key_t key;
+  Value after;
+} Pending;
+
+static Device_KV kv_throughput = {
+  .name = DEVICE_KV_SETTINGS,
+  .base_addr = 0x7E0000,
+  .sector_count = 32,
+  .flash = &flash_sim_device,
+};
+static Device_KV kv_small = {
+  .name = DEVICE_KV_SETTINGS,
+  .base_addr = 0,
+  .sector_count = SMALL_SECTOR_COUNT,
+  .flash = &flash_sim_device,
+};
+
+static Value model[KEY_COUNT] = {0};
+static Pending pending = {0};
+static uint32_t failures = 0;
+
+static void random_value(Value *pv) {
+  pv->present = true;
+  pv->len = flash_sim_rand() % 16 == 0 ? 200 + flash_sim_rand() % (VALUE_MAX - 200) : 1 + flash_sim_rand() % 48;
+  for (uint16_t i = 0; i < pv->len; ++i) pv->data[i] = (uint8_t)flash_sim_rand();
+}
+
+static bool value_equal(const Value *a, const Value *b) {
+  if (a->present != b->present) return false;
+  if (a->present == false) return true;
+  return a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+static errno_t read_value(Device_KV *const pd, kv_key_t key, Value *rt_value) {
+  uint16_t len = 0;
+  errno_t err = pd->ops->get(pd, key, rt_value->data, sizeof(rt_value->data), &len);
+  if (err == ENOENT) {
+    rt_value->present = false;
+    return ESUCCESS;
+  }
+  if (err) return err;
+  rt_value->present = true;
+  rt_value->len = len;
+  return ESUCCESS;
+}
+
+// 随机执行一个操作, 掉电时 pending 记录该操作
+static errno_t random_op(Device_KV *const pd) {
+  const kv_key_t key = flash_sim_rand() % KEY_COUNT;
+  errno_t err = ESUCCESS;
+
+  pending.key = key;
+  if (model[key].present && flash_sim_rand() % 8 == 0) {
+    pending.after.present = false;
+    pending.active = true;
+    err = pd->ops->remove(pd, key);
+  } else {
+    random_value(&pending.after);
+    pending.active = true;
+    err = pd->ops->set(pd, key, pending.after.data, pending.after.len);
+  }
+  pending.active = false;
+
+  // 有效数据超过容量时拒绝写入, 值不变
+  if (err == ENOSPC) return ESUCCESS;
+  if (err) return err;
+  model[key] = pending.after;
+  return ESUCCESS;
+}
+
+// 挂载后逐个键与模型比较, 以读到的值作为新的模型
+static void verify(Device_KV *const pd, const char *name, uint32_t seed) {
+  for (kv_key_t key = 0; key < KEY_COUNT; ++key) {
+    Value value = {0};
+    errno_t err = read_value(pd, key, &value);
+    bool ok = err == ESUCCESS && value_equal(&value, &model[key]);
+    if (!ok && pending.active && key == pending.key) ok = err == ESUCCESS && value_equal(&value, &pending.after);
+    if (!ok) {
+      if (failures++ < 10) printf("  %s seed %lu: key %u mismatch, err %d\r\n", name, (unsigned long)seed, key, err);
+      continue;
+    }
+    model[key] = value;
+  }
+  pending.active = false;
+}
+
+static void model_reset(void) {
+  memset(model, 0, sizeof(model));
+  pending.active = false;
+}
+
+// 执行随机操作直到掉电, snapshot 不为 NULL 时每次操作前保存存储区内容; 操作出错时返回 false
+static bool run_until_cut(Device_KV *const pd, uint8_t *snapshot, errno_t *rt_err_ptr) {
+  if (setjmp(flash_sim.cut_jmp)) return true;
+  for (;;) {
+    if (snapshot != NULL) memcpy(snapshot, flash_sim.data + pd->base_addr, (uint32_t)pd->sector_count * W25QX_SECTOR_SIZE);
+    *rt_err_ptr = random_op(pd);
+    if (*rt_err_ptr) break;
+  }
+  flash_sim.cut_after = 0;
+  flash_sim.cut_erase_after = 0;
+  return false;
+}
+
+// 挂载, 掉电时返回 true
+static bool init_until_cut(Device_KV *const pd, errno_t *rt_err_ptr) {
+  if (setjmp(flash_sim.cut_jmp)) return true;
+  *rt_err_ptr = pd->ops->init(pd);
+  flash_sim.cut_after = 0;
+  return false;
+}
+
+// 挂载, 恢复过程中也可能掉电, 最后一次不注入掉电
+static errno_t mount_with_cuts(Device_KV *const pd, uint32_t cuts) {
+  errno_t err = ESUCCESS;
+  for (uint32_t i = 0; i < cuts; ++i) {
+    flash_sim.cut_after = 1 + flash_sim_rand() % 8192;
+    if (init_until_cut(pd, &err) == false) return err;
+  }
+  return pd->ops->init(pd);
+}
+
+static void test_throughput(void) {
+  const uint32_t ops = 50000;
+  Device_KV *const pd = &kv_throughput;
+
+  flash_sim_init(1);
+  model_reset();
+  errno_t err = pd->ops->init(pd);
+  if (err) {
+    printf("  init err %d\r\n", err);
+    ++failures;
+    return;
+  }
+  flash_sim_reset_stats();
+
+  uint64_t user_bytes = 0;
+  const clock_t start = clock();
+  for (uint32_t i = 0; i < ops; ++i) {
+    err = random_op(pd);
+    if (err) {
+      printf("  op %lu err %d\r\n", (unsigned long)i, err);
+      ++failures;
+      return;
+    }
+    user_bytes += pending.after.present ? pending.after.len : 0;
+  }
+  const double host_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  const double flash_seconds = flash_sim_estimate_seconds();
+
+  printf("  %lu ops, %llu value bytes -> %llu programmed bytes (x%.2f), %llu page programs, %llu sector erases\r\n",
+    (unsigned long)ops, (unsigned long long)user_bytes, (unsigned long long)flash_sim.program_bytes,
+    (double)flash_sim.program_bytes / (double)user_bytes, (unsigned long long)flash_sim.program_commands,
+    (unsigned long long)flash_sim.erase_commands);
+  printf("  estimated flash time %.3f ms/op (%.0f ops/s), host %.2f us/op\r\n",
+    flash_seconds * 1000 / ops, ops / flash_seconds, host_seconds * 1e6 / ops);
+  if (flash_sim.overwrites) {
+    printf("  %llu writes needed erase\r\n", (unsigned long long)flash_sim.overwrites);
+    ++failures;
+  }
+
+  // 重新挂载耗时
+  flash_sim_reset_stats();
+  err = pd->ops->init(pd);
+  if (err) ++failures;
+  printf("  mount reads %llu bytes, estimated %.1f ms\r\n",
+    (unsigned long long)flash_sim.read_bytes, flash_sim_estimate_seconds() * 1000);
+  verify(pd, "throughput", 1);
+}
+
+static void test_random_cut(uint32_t iterations) {
+  Device_KV *const pd = &kv_small;
+  uint32_t cut_erases = 0;
+
+  for (uint32_t seed = 1; seed <= iterations; ++seed) {
+    flash_sim_init(seed);
+    model_reset();
+    if (pd->ops->init(pd)) {
+      ++failures;
+      continue;
+    }
+
+    // 先随机操作一段时间, 让掉电落在扇区环的不同位置
+    const uint32_t warmup = flash_sim_rand() % 2000;
+    errno_t err = ESUCCESS;
+    for (uint32_t i = 0; i < warmup && err == ESUCCESS; ++i) err = random_op(pd);
+    if (err) {
+      printf("  random seed %lu: warmup err %d\r\n", (unsigned long)seed, err);
+      ++failures;
+      continue;
+    }
+
+    // 擦除只占很少的步数, 四分之一的用例只在擦除中掉电
+    flash_sim.erase_partial = (double)(flash_sim_rand() % 1000) / 1000;
+    if (flash_sim_rand() % 4 == 0) {
+      flash_sim.cut_erase_after = 1 + flash_sim_rand() % 8;
+    } else {
+      flash_sim.cut_after = 1 + flash_sim_rand() % 20000;
+    }
+    if (run_until_cut(pd, NULL, &err) == false) {
+      printf("  random seed %lu: op err %d\r\n", (unsigned long)seed, err);
+      ++failures;
+      continue;
+    }
+    if (flash_sim.cut_in_erase) ++cut_erases;
+
+    err = mount_with_cuts(pd, flash_sim_rand() % 3);
+    if (err) {
+      printf("  random seed %lu: mount err %d\r\n", (unsigned long)seed, err);
+      ++failures;
+      continue;
+    }
+    verify(pd, "random", seed);
+
+    // 恢复后继续使用, 再次挂载结果一致
+    for (uint32_t i = 0; i < 200 && err == ESUCCESS; ++i) err = random_op(pd);
+    if (err == ESUCCESS) err = pd->ops->init(pd);
+    if (err) {
+      printf("  random seed %lu: reuse err %d\r\n", (unsigned long)seed, err);
+      ++failures;
+      continue;
+    }
+    verify(pd, "random reuse", seed);
+  }
+
+  printf("  %lu power cuts, %lu of them during an erase\r\n", (unsigned long)iterations, (unsigned long)cut_erases);
+}
+
+static void test_collect_erase_cut(uint32_t iterations) {
+  Device_KV *const pd = &kv_small;
+  static const double partials[] = {0.001, 0.01, 0.1, 0.5, 0.9};
+  // 每次操作前的存储区内容, 用于判断被打断擦除的扇区头是否还完整
+  static uint8_t before[SMALL_SECTOR_COUNT * W25QX_SECTOR_SIZE];
+  uint32_t header_kept = 0, cases = 0;
+
+  for (uint32_t seed = 1; seed <= iterations; ++seed) {
+    for (uint8_t p = 0; p < sizeof(partials) / sizeof(partials[0]); ++p) {
+      flash_sim_init(seed * 16 + p);
+      model_reset();
+      if (pd->ops->init(pd)) {
+        ++failures;
+        continue;
+      }
+
+      // 写满一圈, 之后每次回收的最旧扇区中都有有效记录
+      errno_t err = ESUCCESS;
+      const uint32_t warmup = 600 + flash_sim_rand() % 600;
+      for (uint32_t i = 0; i < warmup && err == ESUCCESS; ++i) err = random_op(pd);
+      if (err) {
+        ++failures;
+        continue;
+      }
+
+      // 下一次擦除是回收最旧扇区: 打开的新扇区已在上一次回收时擦除, 不需要再擦除
+      flash_sim.erase_partial = partials[p];
+      flash_sim.cut_erase_after = 1;
+      if (run_until_cut(pd, before, &err) == false) {
+        printf("  collect seed %lu: op err %d\r\n", (unsigned long)seed, err);
+        ++failures;
+        continue;
+      }
+      ++cases;
+      const uint32_t offset = flash_sim.last_erase_addr - pd->base_addr;
+      if (memcmp(flash_sim.data + flash_sim.last_erase_addr, before + offset, 12) == 0) ++header_kept;
+
+      err = pd->ops->init(pd);
+      if (err) {
+        printf("  collect seed %lu: mount err %d\r\n", (unsigned long)seed, err);
+        ++failures;
+        continue;
+      }
+      verify(pd, "collect", seed * 16 + p);
+
+      for (uint32_t i = 0; i < 200 && err == ESUCCESS; ++i) err = random_op(pd);
+      if (err == ESUCCESS) err = pd->ops->init(pd);
+      if (err) {
+        printf("  collect seed %lu: reuse err %d\r\n", (unsigned long)seed, err);
+        ++failures;
+        continue;
+      }
+      verify(pd, "collect reuse", seed * 16 + p);
+    }
+  }
+
+  printf("  %lu cuts during collection erase, old header intact in %lu\r\n", (unsigned long)cases, (unsigned long)header_kept);
+}
+
+int main(void) {
+  Device_KV_module_init();
+  Device_KV_register(&kv_throughput);
+  // 两个实例名字相同, 只用于测试, 不通过 find 查找
+  Device_KV_register(&kv_small);
+
+  printf("kv throughput (32 sectors)\r\n");
+  test_throughput();
+  printf("kv random power cut (4 sectors)\r\n");
+  test_random_cut(3000);
+  printf("kv power cut in collection erase (4 sectors)\r\n");
+  test_collect_erase_cut(200);
+
+  printf("kv: %s\r\n", failures ? "FAIL" : "ok");
+  return failures ? 1 : 0;
+}
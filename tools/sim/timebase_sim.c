@@ -0,0 +1,111 @@
+#include "timebase_sim.h"
+#include "common/delay/delay.h"
+#include <stddef.h>
+
+static uint64_t now = 0; // 微秒
+static Timebase_timer *timers = NULL;
+
+void timebase_sim_reset(void) {
+  now = 0;
+  timers = NULL;
+}
+
+// 逐毫秒前进, 与 SysTick 一样每个节拍检查一次到期的定时器
+void timebase_sim_advance(uint32_t us) {
+  const uint64_t target = now + us;
+
+  while (now < target) {
+    const uint64_t next_tick = (now / 1000 + 1) * 1000;
+    now = next_tick < target ? next_tick : target;
+    if (now % 1000 != 0) break;
+
+    const uint32_t tick = (uint32_t)(now / 1000);
+    for (Timebase_timer **pp = &timers; *pp != NULL; ) {
+      Timebase_timer *const pt = *pp;
+      if ((int32_t)(tick - pt->expire_tick) < 0) {
+        pp = &pt->next;
+        continue;
+      }
+
+      *pp = pt->next;
+      pt->active = false;
+      if (pt->period_ms) timebase_timer_start(pt, pt->period_ms, pt->period_ms, pt->callback, pt->arg);
+      // 回调中可能启动或停止定时器, 从头重新查找
+      pt->callback(pt->arg);
+      pp = &timers;
+    }
+  }
+}
+
+bool timebase_sim_pending(void) {
+  return timers != NULL;
+}
+
+errno_t timebase_init(void) {
+  return ESUCCESS;
+}
+
+uint32_t now_us(void) {
+  return (uint32_t)now;
+}
+
+uint32_t now_ms(void) {
+  return (uint32_t)(now / 1000);
+}
+
+uint32_t timebase_elapsed_us(uint32_t begin_us) {
+  return now_us() - begin_us;
+}
+
+void timebase_deadline_set(uint32_t *rt_deadline_ptr, uint32_t timeout_us) {
+  *rt_deadline_ptr = now_us() + timeout_us;
+}
+
+bool timebase_deadline_expired(uint32_t deadline) {
+  return (int32_t)(now_us() - deadline) >= 0;
+}
+
+errno_t timebase_timer_start(Timebase_timer *const pt, uint32_t delay_ms, uint32_t period_ms, Timebase_timer_callback *callback, void *arg) {
+  if (pt == NULL || callback == NULL) return EINVAL;
+
+  timebase_timer_stop(pt);
+  pt->callback = callback;
+  pt->arg = arg;
+  pt->period_ms = period_ms;
+  pt->expire_tick = now_ms() + (delay_ms ? delay_ms : 1);
+  pt->active = true;
+  pt->next = timers;
+  timers = pt;
+
+  return ESUCCESS;
+}
+
+errno_t timebase_timer_stop(Timebase_timer *const pt) {
+  if (pt == NULL) return EINVAL;
+
+  for (Timebase_timer **pp = &timers; *pp != NULL; pp = &(*pp)->next) {
+    if (*pp == pt) {
+      *pp = pt->next;
+      break;
+    }
+  }
+  pt->active = false;
+  pt->next = NULL;
+
+  return ESUCCESS;
+}
+
+errno_t delay_s(uint32_t s) {
+  timebase_sim_advance(s * 1000000);
+  return ESUCCESS;
+}
+
+errno_t delay_ms(uint32_t ms) {
+  timebase_sim_advance(ms * 1000);
+  return ESUCCESS;
+}
+
+errno_t delay_us(uint32_t us) {
+  timebase_sim_advance(us);
+  return ESUCCESS;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "common/timebase/timebase.h"
+#include <stdint.h>
+
+/**
+ * @brief 主机上的时间基准, 替代 common/timebase 和 common/delay
+ * 时间只在调用 timebase_sim_advance 或 delay_* 时前进, 到期的软件定时器在前进时按到期顺序回调
+ */
+void timebase_sim_reset(void);
+void timebase_sim_advance(uint32_t us);
+// 还有未到期的定时器
+bool timebase_sim_pending(void);
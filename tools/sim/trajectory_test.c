@@ -0,0 +1,210 @@
+/**
+ * @brief 运动曲线的主机测试
+ * 按车轮和舵机的配置参数生成曲线, 检查到达目标的周期数与理论时间相符, 不越过目标,
+ * 每个周期的速度, 加速度(S 形曲线还有加加速度)变化不超过限制, 停下时丢掉的速度不超过一个周期的加速度(S 形曲线为加加速度),
+ * 运动中修改目标后仍能停在新目标
+ * 最后测量单步的耗时
+ */
+#include "common/trajectory/trajectory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+// 车轮: 位置为转速(0.01 转/分), 速度为角加速度, 加速度为角加加速度, 见 device_config/wheel
+static const Trajectory_param wheel_param = {
+  .max_velocity = 100000,
+  .max_acceleration = 1000000,
+  .max_jerk = 0,
+  .period_us = 1000,
+};
+// 舵机: 位置为角度(0.01 度), 见 device_config/servo
+static const Trajectory_param servo_param = {
+  .max_velocity = 18000,
+  .max_acceleration = 72000,
+  .max_jerk = 0,
+  .period_us = 20000,
+};
+// S 形曲线
+static const Trajectory_param s_curve_param = {
+  .max_velocity = 100000,
+  .max_acceleration = 1000000,
+  .max_jerk = 20000000,
+  .period_us = 1000,
+};
+
+#define STEPS_MAX 100000
+/**
+ * 到达目标时允许的加速度, 为每周期最大加速度的倍数
+ * 梯形曲线按离散的刹车距离减速, 最后一个周期只是走不满, 之后从不超过一个周期的减速量停下
+ */
+#define ARRIVAL_TRAPEZOID 1.5
+
+static uint32_t failures = 0;
+
+/**
+ * @brief 梯形曲线从静止到静止走完 distance 的理论时间(秒)
+ * 距离不足以加速到最大速度时为三角形曲线
+ */
+static double trapezoid_seconds(const Trajectory_param *const param, double distance) {
+  const double v = param->max_velocity, a = param->max_acceleration;
+  if (distance >= v * v / a) return distance / v + v / a;
+  return 2 * sqrt(distance / a);
+}
+
+/**
+ * @brief S 形曲线从静止到静止走完 distance 的理论时间(秒)
+ * 从静止加速到 v 用时 v / a + a / j(达不到最大加速度时为 2 * sqrt(v / j)), 平均速度 v / 2
+ * 距离不足以加速到最大速度时二分查找能达到的最高速度
+ */
+static double s_curve_seconds(const Trajectory_param *const param, double distance) {
+  const double a = param->max_acceleration, j = param->max_jerk;
+  double low = 0, high = param->max_velocity;
+  double ramp = high >= a * a / j ? high / a + a / j : 2 * sqrt(high / j);
+  if (distance >= high * ramp) return distance / high + ramp;
+
+  for (uint32_t k = 0; k < 100; ++k) {
+    const double v = (low + high) / 2;
+    ramp = v >= a * a / j ? v / a + a / j : 2 * sqrt(v / j);
+    if (v * ramp > distance) high = v;
+    else low = v;
+  }
+  return 2 * ramp;
+}
+
+typedef struct {
+  uint32_t steps;
+  int32_t overshoot;
+  // 单个周期内的最大变化量, 速度为一阶差分, 加速度为二阶差分, 加加速度为三阶差分
+  int32_t velocity;
+  int32_t acceleration;
+  int32_t jerk;
+  // 到达目标的那个周期只走剩下的行程, 单独统计其加速度, 以及之后直接停下时丢掉的速度
+  int32_t arrival;
+  int32_t stop;
+} Result;
+
+// 从当前位置运行到停止, 记录每个周期的差分
+static Result run(Trajectory *const pt, int32_t start, int32_t target) {
+  Result r = {0};
+  int32_t last = start, last_velocity = 0, last_acceleration = 0;
+
+  trajectory_set_target(pt, target);
+  while (!trajectory_done(pt) && r.steps < STEPS_MAX) {
+    const int32_t position = trajectory_step(pt);
+    const int32_t velocity = position - last;
+    const int32_t acceleration = velocity - last_velocity;
+    const int32_t jerk = acceleration - last_acceleration;
+    last = position;
+    last_velocity = velocity;
+    last_acceleration = acceleration;
+    ++r.steps;
+
+    const int32_t over = target >= start ? position - target : target - position;
+    if (over > r.overshoot) r.overshoot = over;
+    if (abs(velocity) > r.velocity) r.velocity = abs(velocity);
+    if (trajectory_done(pt)) {
+      r.arrival = abs(acceleration);
+      continue;
+    }
+    if (abs(acceleration) > r.acceleration) r.acceleration = abs(acceleration);
+    if (abs(jerk) > r.jerk) r.jerk = abs(jerk);
+  }
+  if (last != target) r.overshoot = abs(target - last) + 1;
+  r.stop = abs(last_velocity);
+
+  return r;
+}
+
+/**
+ * @brief 检查一次从 start 到 target 的运动
+ * 周期数与理论时间的偏差不超过 tolerance(比例)
+ * 差分按每周期的限制检查, 位置四舍五入为整数, 速度差分允许 1, 加速度差分允许 2 的误差, 到达的周期见 ARRIVAL_TRAPEZOID
+ * S 形曲线到达的周期和停下时丢掉的速度都不超过一个周期的加加速度
+ */
+static void check(const char *name, const Trajectory_param *const param, int32_t start, int32_t target, double tolerance) {
+  Trajectory trajectory;
+  errno_t err = trajectory_init(&trajectory, param, start);
+  if (err) {
+    printf("  %-26s init err %d FAIL\r\n", name, err);
+    ++failures;
+    return;
+  }
+
+  const Result r = run(&trajectory, start, target);
+  const double period = param->period_us / 1e6;
+  const double distance = fabs((double)target - start);
+  const double expected = (param->max_jerk ? s_curve_seconds(param, distance) : trapezoid_seconds(param, distance)) / period;
+  const double velocity_max = param->max_velocity * period + 1;
+  const double acceleration_max = param->max_acceleration * period * period + 2;
+  const double jerk_step = param->max_jerk * period * period * period;
+  const double arrival_max = param->max_jerk ? jerk_step + 2 : param->max_acceleration * period * period * ARRIVAL_TRAPEZOID + 2;
+  const double stop_max = param->max_jerk ? jerk_step + 1 : acceleration_max;
+  const double jerk_max = param->max_jerk ? jerk_step + 4 : 0;
+
+  bool ok = r.overshoot == 0 && r.velocity <= velocity_max && r.acceleration <= acceleration_max && r.arrival <= arrival_max && r.stop <= stop_max;
+  ok = ok && fabs(r.steps - expected) <= expected * tolerance + 1;
+  if (param->max_jerk) ok = ok && r.jerk <= jerk_max;
+
+  printf("  %-26s %4lu steps (expected %5.1f) dv %ld/%.0f da %ld/%.0f arrival %ld/%.0f stop %ld/%.0f", name, (unsigned long)r.steps, expected,
+    (long)r.velocity, velocity_max, (long)r.acceleration, acceleration_max, (long)r.arrival, arrival_max, (long)r.stop, stop_max);
+  if (param->max_jerk) printf(" dj %ld/%.0f", (long)r.jerk, jerk_max);
+  printf("%s\r\n", ok ? "" : " FAIL");
+  if (!ok) ++failures;
+}
+
+// 运动中途修改目标, 仍应停在新目标上且不越过
+static void check_retarget(const char *name, const Trajectory_param *const param, int32_t first, uint32_t steps, int32_t second) {
+  Trajectory trajectory;
+  trajectory_init(&trajectory, param, 0);
+  trajectory_set_target(&trajectory, first);
+  int32_t position = 0;
+  for (uint32_t k = 0; k < steps; ++k) position = trajectory_step(&trajectory);
+
+  const Result r = run(&trajectory, position, second);
+  const bool ok = r.steps < STEPS_MAX && r.overshoot == 0 && trajectory_step(&trajectory) == second;
+  printf("  %-26s %4lu steps after retarget at %ld%s\r\n", name, (unsigned long)r.steps, (long)position, ok ? "" : " FAIL");
+  if (!ok) ++failures;
+}
+
+int main(void) {
+  printf("trajectory\r\n");
+
+  // 车轮 0 到 200 转/分: 角加速度 0.1 秒升到 1000 转/分/秒, 匀加速 0.1 秒, 再 0.1 秒降到 0, 共约 0.3 秒
+  check("wheel 0 -> 200 rpm", &wheel_param, 0, 20000, 0.02);
+  check("wheel 0 -> 150 rpm", &wheel_param, 0, 15000, 0.02);
+  check("wheel 150 -> -150 rpm", &wheel_param, 15000, -15000, 0.02);
+  check("wheel 0 -> 5 rpm", &wheel_param, 0, 500, 0.05);
+  check("wheel 0 -> 0.01 rpm", &wheel_param, 0, 1, 1);
+
+  // 舵机转 90 度: 0.25 秒升到 180 度/秒, 匀速 0.25 秒, 再 0.25 秒停下, 共 0.75 秒
+  check("servo 0 -> 90 deg", &servo_param, 0, 9000, 0.1);
+  check("servo 90 -> -90 deg", &servo_param, 9000, -9000, 0.1);
+  check("servo 0 -> 5 deg", &servo_param, 0, 500, 0.15);
+
+  // S 形曲线 0 到 200 转/分: 加速 0.15 秒(加加速度 0.05 秒升到最大加速度), 匀速 0.05 秒, 减速 0.15 秒, 共 0.35 秒
+  check("s-curve 0 -> 200 rpm", &s_curve_param, 0, 20000, 0.03);
+  check("s-curve 150 -> -150 rpm", &s_curve_param, 15000, -15000, 0.03);
+  check("s-curve 0 -> 5 rpm", &s_curve_param, 0, 500, 0.05);
+  check("s-curve 0 -> 0.01 rpm", &s_curve_param, 0, 1, 1);
+
+  check_retarget("wheel reverse mid-ramp", &wheel_param, 20000, 150, -10000);
+  check_retarget("wheel lower mid-ramp", &wheel_param, 20000, 150, 5000);
+  check_retarget("s-curve reverse mid-ramp", &s_curve_param, 20000, 150, -10000);
+  check_retarget("servo back mid-move", &servo_param, 9000, 20, 0);
+
+  // 耗时, 目标来回切换, 保持曲线一直在运动
+  Trajectory trajectory;
+  trajectory_init(&trajectory, &s_curve_param, 0);
+  const uint32_t steps = 10000000;
+  int32_t sum = 0;
+  const clock_t start = clock();
+  for (uint32_t k = 0; k < steps; ++k) {
+    if (k % 1000 == 0) trajectory_set_target(&trajectory, k % 2000 ? 20000 : -20000);
+    sum += trajectory_step(&trajectory);
+  }
+  printf("  %lu steps, host %.1f ns/step (%ld)\r\n", (unsigned long)steps, (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / steps, (long)sum);
+
+  printf("trajectory: %s\r\n", failures ? "FAIL" : "ok");
+  return failures ? 1 : 0;
+}
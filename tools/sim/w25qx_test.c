@@ -0,0 +1,323 @@
+/**
+ * @brief W25QX 擦除计划的主机测试
+ * 用模拟的 SPI 总线和 flash 芯片运行 w25qx.c 中的 erase 和 erase_async, 按芯片收到的命令记录被擦除的扇区
+ * 随机范围下检查:
+ *   范围内每个扇区恰好擦除一次, 范围外没有擦除
+ *   命令数等于用对齐的 4K/32K/64K 块(整片时用整片擦除)覆盖该范围的最少命令数, 最少命令数由动态规划独立计算
+ *   每条擦除命令之前都有写使能
+ */
+#include "timebase_sim.h"
+#include "device/w25qx/w25qx.h"
+#include "device/w25qx/cmd.h"
+#include "device/w25qx/config/index.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SECTOR_BLOCK_32K (W25QX_BLOCK_32K_SIZE / W25QX_SECTOR_SIZE)
+#define SECTOR_BLOCK_64K (W25QX_BLOCK_64K_SIZE / W25QX_SECTOR_SIZE)
+
+// 模拟的芯片, 只记录擦除
+static struct {
+  bool selected;
+  bool write_enabled;
+  uint8_t frame[8]; // 一次片选期间收到的开头几个字节
+  uint32_t frame_len;
+  uint16_t erase_counts[W25QX_SECTOR_NUM];
+  uint32_t commands[4]; // 4K 32K 64K 整片
+  uint32_t errors; // 没有写使能的擦除, 未对齐或超出芯片的地址
+} chip;
+
+static errno_t cs_init(const Device_GPIO *const pd);
+static errno_t cs_write(const Device_GPIO *const pd, const Pin_value value);
+static errno_t spi_init(const Device_SPI *const pd);
+static errno_t spi_transmit(const Device_SPI *const pd, const uint8_t *const data, uint32_t len);
+static errno_t spi_receive(const Device_SPI *const pd, uint8_t *data, uint32_t len);
+static errno_t spi_lock(const Device_SPI *const pd);
+static errno_t spi_configure(const Device_SPI *const pd, uint8_t mode, uint16_t divider);
+static errno_t spi_submit(const Device_SPI *const pd, Device_SPI_transfer *const pt);
+
+static const Device_GPIO_ops cs_ops = {
+  .init = cs_init,
+  .write = cs_write,
+};
+static const Device_SPI_ops spi_ops = {
+  .init = spi_init,
+  .transmit = spi_transmit,
+  .receive = spi_receive,
+  .lock = spi_lock,
+  .unlock = spi_lock,
+  .configure = spi_configure,
+  .submit = spi_submit,
+};
+
+static Device_GPIO cs = {
+  .name = DEVICE_W25Q64_CS,
+  .ops = &cs_ops,
+};
+static Device_SPI spi = {
+  .name = DEVICE_SPI_1,
+  .ops = &spi_ops,
+};
+static Device_W25QX flash = {
+  .name = DEVICE_W25Q64,
+  .cs = &cs,
+  .spi = &spi,
+  .read_mode = DEVICE_W25QX_READ_NORMAL,
+};
+
+// 排队传输, 由 bus_run 依次执行
+#define QUEUE_SIZE 8
+static Device_SPI_transfer *queue[QUEUE_SIZE];
+static uint8_t queue_count = 0;
+
+static uint32_t rand_state = 1;
+static uint32_t failures = 0;
+
+static uint32_t next_rand(void) {
+  uint32_t x = rand_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rand_state = x;
+  return x;
+}
+
+static void frame_end(void) {
+  if (chip.frame_len == 0) return;
+
+  const uint8_t cmd = chip.frame[0];
+  const uint32_t addr = (uint32_t)chip.frame[1] << 16 | (uint32_t)chip.frame[2] << 8 | chip.frame[3];
+  uint32_t size = 0;
+  uint8_t kind = 0;
+
+  switch (cmd) {
+    case W25QX_CMD_WRITE_ENABLE:
+      chip.write_enabled = true;
+      return;
+    case W25QX_CMD_SECTOR_ERASE: size = W25QX_SECTOR_SIZE; kind = 0; break;
+    case W25QX_CMD_BLOCK_ERASE_32K: size = W25QX_BLOCK_32K_SIZE; kind = 1; break;
+    case W25QX_CMD_BLOCK_ERASE_64K: size = W25QX_BLOCK_64K_SIZE; kind = 2; break;
+    case W25QX_CMD_CHIP_ERASE: size = W25QX_SIZE; kind = 3; break;
+    default: return;
+  }
+
+  const uint32_t start = kind == 3 ? 0 : addr;
+  if (chip.write_enabled == false || start % size != 0 || start + size > W25QX_SIZE || (kind != 3 && chip.frame_len != 4)) {
+    ++chip.errors;
+    return;
+  }
+  chip.write_enabled = false;
+  ++chip.commands[kind];
+  for (uint32_t sector = start / W25QX_SECTOR_SIZE; sector < (start + size) / W25QX_SECTOR_SIZE; ++sector) {
+    ++chip.erase_counts[sector];
+  }
+}
+
+static void frame_append(const uint8_t *data, uint32_t len) {
+  for (uint32_t i = 0; i < len; ++i) {
+    if (chip.frame_len < sizeof(chip.frame)) chip.frame[chip.frame_len] = data[i];
+    ++chip.frame_len;
+  }
+}
+
+static errno_t cs_init(const Device_GPIO *const pd) {
+  (void)pd;
+  return ESUCCESS;
+}
+
+static errno_t cs_write(const Device_GPIO *const pd, const Pin_value value) {
+  (void)pd;
+  if (value == PIN_VALUE_0) {
+    chip.selected = true;
+    chip.frame_len = 0;
+  } else if (chip.selected) {
+    chip.selected = false;
+    frame_end();
+  }
+  return ESUCCESS;
+}
+
+static errno_t spi_init(const Device_SPI *const pd) {
+  (void)pd;
+  return ESUCCESS;
+}
+
+static errno_t spi_transmit(const Device_SPI *const pd, const uint8_t *const data, uint32_t len) {
+  (void)pd;
+  if (chip.selected == false) return EIO;
+  frame_append(data, len);
+  return ESUCCESS;
+}
+
+// 擦除瞬间完成, 状态寄存器始终不忙; 读 ID 返回 W25Q64
+static errno_t spi_receive(const Device_SPI *const pd, uint8_t *data, uint32_t len) {
+  (void)pd;
+  if (chip.selected == false) return EIO;
+  memset(data, 0, len);
+  if (chip.frame_len && chip.frame[0] == W25QX_CMD_JEDEC_ID && len == 3) {
+    data[0] = (W25QX_ID >> 16) & 0xFF;
+    data[1] = (W25QX_ID >> 8) & 0xFF;
+    data[2] = W25QX_ID & 0xFF;
+  }
+  return ESUCCESS;
+}
+
+static errno_t spi_lock(const Device_SPI *const pd) {
+  (void)pd;
+  return ESUCCESS;
+}
+
+static errno_t spi_configure(const Device_SPI *const pd, uint8_t mode, uint16_t divider) {
+  (void)pd;
+  (void)mode;
+  (void)divider;
+  return ESUCCESS;
+}
+
+static errno_t spi_submit(const Device_SPI *const pd, Device_SPI_transfer *const pt) {
+  (void)pd;
+  if (queue_count >= QUEUE_SIZE) return EBUSY;
+  queue[queue_count++] = pt;
+  return ESUCCESS;
+}
+
+// 按提交顺序执行排队传输, 回调中提交的传输也在本次执行
+static void bus_run(void) {
+  while (queue_count) {
+    Device_SPI_transfer *const pt = queue[0];
+    memmove(queue, queue + 1, --queue_count * sizeof(queue[0]));
+
+    cs_write(pt->cs, PIN_VALUE_0);
+    if (pt->cmd_len) spi_transmit(&spi, pt->cmd, pt->cmd_len);
+    if (pt->tx_len) spi_transmit(&spi, pt->tx, pt->tx_len);
+    if (pt->rx_len) spi_receive(&spi, pt->rx, pt->rx_len);
+    cs_write(pt->cs, PIN_VALUE_1);
+    if (pt->callback) pt->callback(pt, ESUCCESS);
+  }
+}
+
+static bool async_done = false;
+static errno_t async_err = ESUCCESS;
+
+static void erase_done(void *arg, errno_t err) {
+  (void)arg;
+  async_done = true;
+  async_err = err;
+}
+
+// 覆盖 [first, end) 扇区的最少命令数
+static uint32_t min_commands(uint32_t first, uint32_t end) {
+  static uint32_t dp[W25QX_SECTOR_NUM + 1];
+
+  if (first == 0 && end == W25QX_SECTOR_NUM) return 1;
+
+  dp[end] = 0;
+  for (uint32_t i = end; i-- > first; ) {
+    uint32_t best = dp[i + 1] + 1;
+    if (i % SECTOR_BLOCK_32K == 0 && i + SECTOR_BLOCK_32K <= end && dp[i + SECTOR_BLOCK_32K] + 1 < best) best = dp[i + SECTOR_BLOCK_32K] + 1;
+    if (i % SECTOR_BLOCK_64K == 0 && i + SECTOR_BLOCK_64K <= end && dp[i + SECTOR_BLOCK_64K] + 1 < best) best = dp[i + SECTOR_BLOCK_64K] + 1;
+    dp[i] = best;
+  }
+  return dp[first];
+}
+
+// 检查一次擦除的结果, 返回使用的命令数
+static uint32_t check(const char *name, uint32_t first, uint32_t count) {
+  const uint32_t end = first + count;
+  uint32_t commands = 0;
+  bool ok = chip.errors == 0;
+
+  for (uint32_t sector = 0; sector < W25QX_SECTOR_NUM; ++sector) {
+    const uint16_t expected = sector >= first && sector < end ? 1 : 0;
+    if (chip.erase_counts[sector] != expected) ok = false;
+  }
+  for (uint8_t i = 0; i < 4; ++i) commands += chip.commands[i];
+  if (commands != min_commands(first, end)) ok = false;
+
+  if (!ok && failures++ < 10) {
+    printf("  %s [%lu, %lu): %lu commands (minimum %lu), %lu errors\r\n", name, (unsigned long)first, (unsigned long)end,
+      (unsigned long)commands, (unsigned long)min_commands(first, end), (unsigned long)chip.errors);
+  }
+  return commands;
+}
+
+static void chip_reset(void) {
+  memset(&chip, 0, sizeof(chip));
+}
+
+// 随机范围, 小范围居多, 也包含跨多个 64K 块和到末尾的范围
+static void random_range(uint32_t *rt_first, uint32_t *rt_count) {
+  uint32_t first = next_rand() % W25QX_SECTOR_NUM;
+  uint32_t count = 0;
+
+  switch (next_rand() % 4) {
+    case 0: count = 1 + next_rand() % 8; break;
+    case 1: count = 1 + next_rand() % 64; break;
+    case 2: count = 1 + next_rand() % 512; break;
+    default:
+      if (next_rand() % 2) first -= first % SECTOR_BLOCK_32K;
+      count = W25QX_SECTOR_NUM - first;
+      if (next_rand() % 2 && count > 1) count -= next_rand() % count;
+      break;
+  }
+  if (first + count > W25QX_SECTOR_NUM) count = W25QX_SECTOR_NUM - first;
+
+  *rt_first = first;
+  *rt_count = count;
+}
+
+int main(void) {
+  Device_W25QX_module_init();
+  Device_W25QX_register(&flash);
+  timebase_sim_reset();
+
+  errno_t err = flash.ops->init(&flash);
+  if (err) {
+    printf("init err %d\r\n", err);
+    return 1;
+  }
+
+  const uint32_t iterations = 20000;
+  uint64_t commands = 0, sectors = 0;
+  // 固定的边界用例之后是随机范围
+  static const uint32_t fixed[][2] = {
+    {0, W25QX_SECTOR_NUM}, {0, W25QX_SECTOR_NUM - 1}, {1, W25QX_SECTOR_NUM - 1},
+    {0, 16}, {8, 8}, {8, 16}, {15, 18}, {W25QX_SECTOR_NUM - 1, 1},
+  };
+  const uint32_t fixed_count = sizeof(fixed) / sizeof(fixed[0]);
+
+  for (uint32_t i = 0; i < fixed_count + iterations; ++i) {
+    uint32_t first = 0, count = 0;
+    if (i < fixed_count) {
+      first = fixed[i][0];
+      count = fixed[i][1];
+    } else {
+      random_range(&first, &count);
+    }
+    const uint32_t addr = first * W25QX_SECTOR_SIZE;
+
+    chip_reset();
+    err = flash.ops->erase(&flash, addr, (uint16_t)count);
+    if (err && failures++ < 10) printf("  erase [%lu, +%lu) err %d\r\n", (unsigned long)first, (unsigned long)count, err);
+    commands += check("erase", first, count);
+    sectors += count;
+
+    chip_reset();
+    async_done = false;
+    err = flash.ops->erase_async(&flash, addr, (uint16_t)count, erase_done, NULL);
+    // 每条命令查询一次状态即完成, 超过这个时间说明擦除计划没有收敛到范围末尾
+    const uint32_t timeout_ms = (count + 2) * 20;
+    for (uint32_t ms = 0; err == ESUCCESS && async_done == false && ms < timeout_ms; ++ms) {
+      bus_run();
+      timebase_sim_advance(1000);
+    }
+    if (err == ESUCCESS) err = async_done ? async_err : ETIMEDOUT;
+    if (err && failures++ < 10) printf("  erase_async [%lu, +%lu) err %d\r\n", (unsigned long)first, (unsigned long)count, err);
+    check("erase_async", first, count);
+  }
+
+  printf("w25qx erase plan: %lu ranges, %llu sectors in %llu commands (%.2f sectors/command)\r\n",
+    (unsigned long)(fixed_count + iterations), (unsigned long long)sectors, (unsigned long long)commands, (double)sectors / commands);
+  printf("w25qx: %s\r\n", failures ? "FAIL" : "ok");
+  return failures ? 1 : 0;
+}